@@ -51,6 +51,12 @@ static int transfer_data(ES_p es, TS_writer_p output, uint32_t pmt_pid,
   int err = 0;
   int count = 0;
 
+  // Each ES unit is written out as soon as it is read, so its data need
+  // not be copied out of the ES reader's own data
+  err = use_ES_unit_views(es);
+  if (err)
+    return err;
+
   // Write out a PAT and PMT first, or our stream won't make sense
   if (!quiet)
     fprint_msg("Using transport stream id 1, PMT PID %#x, program 1 ="
@@ -138,6 +144,14 @@ static void print_usage() {
       "                    Writes output (over TCP/IP) to the named <host>,\n"
       "                    instead of to a named file. If <port> is not\n"
       "                    specified, it defaults to 88.\n"
+      "  -direct           Write the output file with O_DIRECT (bypassing\n"
+      "                    the page cache), which may help for large files.\n"
+      "  -dest <dest>      Also write output to <dest>, which may be\n"
+      "                    udp:<host>[:<port>], tcp:<host>[:<port>],\n"
+      "                    file:<name> or stdout. This may be given more\n"
+      "                    than once - the input is still only read once.\n"
+      "                    As with -stdout, -dest stdout forces -quiet and\n"
+      "                    -err stderr.\n"
       "  -max <n>, -m <n>  Maximum number of ES data units to read\n"
       "\n"
       "Stream type:\n"
@@ -172,6 +186,10 @@ int main(int argc, char **argv) {
   char *output_name = nullptr;
   int had_input_name = false;
   int had_output_name = false;
+  int use_direct_io = false;
+  char *dest_specs[TSWRITE_MAX_DESTS]; // any other destinations
+  int num_dest_specs = 0;
+  int dest_stdout = false; // is one of them <stdout>?
   TS_writer_p output = nullptr;
   ES_p es;
   int verbose = false;
@@ -207,6 +225,22 @@ int main(int argc, char **argv) {
       } else if (!strcmp("-avs", argv[ii])) {
         force_stream_type = true;
         video_type = VIDEO_AVS;
+      } else if (!strcmp("-direct", argv[ii])) {
+        use_direct_io = true;
+      } else if (!strcmp("-dest", argv[ii])) {
+        CHECKARG("es2ts", ii);
+        if (num_dest_specs == TSWRITE_MAX_DESTS - 1) {
+          fprint_err("### es2ts: No more than %d -dest switches are"
+                     " allowed\n",
+                     TSWRITE_MAX_DESTS - 1);
+          return 1;
+        }
+        dest_specs[num_dest_specs++] = argv[ii + 1];
+        if (tswrite_dest_spec_is_stdout(argv[ii + 1])) {
+          dest_stdout = true;
+          redirect_output_stderr();
+        }
+        ii++;
       } else if (!strcmp("-stdin", argv[ii])) {
         had_input_name = true; // more or less
         use_stdin = true;
@@ -291,7 +325,7 @@ int main(int argc, char **argv) {
   }
 
   // Try to stop extraneous data ending up in our output stream
-  if (use_stdout) {
+  if (use_stdout || dest_stdout) {
     verbose = false;
     quiet = true;
   }
@@ -360,6 +394,17 @@ int main(int argc, char **argv) {
     fprint_err("### es2ts: Unable to open %s\n", output_name);
     return 1;
   }
+  if (use_direct_io && !use_stdout && !use_tcpip)
+    (void)tswrite_use_direct_io(output);
+  for (ii = 0; ii < num_dest_specs; ii++) {
+    err = tswrite_add_destination_spec(output, dest_specs[ii], nullptr, quiet);
+    if (err) {
+      fprint_err("### es2ts: Unable to open %s\n", dest_specs[ii]);
+      close_elementary_stream(&es);
+      (void)tswrite_close(output, true);
+      return 1;
+    }
+  }
 
   if (max2 && !quiet)
     fprint_msg("Stopping after %d ES data units\n", max2);
@@ -20,6 +20,7 @@
 #include "es.h"
 #include "h222.h"
 #include "h262.h"
+#include "hevc.h"
 #include "misc.h"
 #include "nalunit.h"
 #include "pes.h"
@@ -322,8 +323,11 @@ static int report_avs_file_as_dots(ES_p es, int max, int verbose) {
 /*
  * Returns a single character which specifies the type of the access unit
  * The value of gop_start_found says whether that unit is a recovery point
+ *
+ * `nac` is the NAL unit context, used to decode any SEI we need to look at
  */
-static char choose_nal_type(access_unit_p access_unit, int *gop_start_found) {
+static char choose_nal_type(nal_unit_context_p nac, access_unit_p access_unit,
+                            int *gop_start_found) {
   char character_nal_type = '?';
   int ii;
   int gop_start = false;
@@ -360,6 +364,8 @@ static char choose_nal_type(access_unit_p access_unit, int *gop_start_found) {
         for (ii = 0; ii < access_unit->nal_units->length; ii++) {
           temp_nal_unit = access_unit->nal_units->array[ii];
           if (temp_nal_unit->nal_unit_type == NAL_SEI) {
+            if (decode_nal_unit(nac, temp_nal_unit))
+              continue;
             if (temp_nal_unit->u.sei_recovery.payloadType == 6) {
               gop_start = true;
               // Print a warning if more than one frame are needed for a
@@ -432,6 +438,7 @@ static int dots_by_access_unit(ES_p es, int max, int verbose, int hash_eos,
   err = build_access_unit_context(es, &context);
   if (err)
     return err;
+  set_nal_headers_only(context->nac, true);
 
   for (;;) {
     access_unit_p access_unit;
@@ -445,7 +452,8 @@ static int dots_by_access_unit(ES_p es, int max, int verbose, int hash_eos,
       return 1;
     }
 
-    char_nal_type = choose_nal_type(access_unit, &gop_start_found);
+    char_nal_type =
+        choose_nal_type(context->nac, access_unit, &gop_start_found);
 
     // No real gop exists in h.264 but we try to find the distance between two
     // random access points. These can be: IDR frame or I frame with a
@@ -529,6 +537,131 @@ static int dots_by_access_unit(ES_p es, int max, int verbose, int hash_eos,
   return 0;
 }
 
+/*
+ * Returns a single character which specifies the type of an HEVC access
+ * unit. Only the NAL unit header of its first VCL NAL unit is looked at.
+ */
+static char choose_hevc_type(hevc_access_unit_p access_unit) {
+  int nal_unit_type = access_unit->nal_unit_type;
+
+  if (!access_unit->has_picture)
+    return '_';
+  else if (is_hevc_IDR_nal_type(nal_unit_type))
+    return 'D';
+  else if (is_hevc_CRA_nal_type(nal_unit_type))
+    return 'C';
+  else if (is_hevc_BLA_nal_type(nal_unit_type))
+    return 'L';
+  else if (is_hevc_IRAP_nal_type(nal_unit_type))
+    return 'K';
+  else if (is_hevc_non_ref_nal_type(nal_unit_type))
+    return 'n';
+  else
+    return 'R';
+}
+
+/*
+ * Report on HEVC data by access unit, as single characters
+ * Returns 0 if all went well, 1 if something went wrong.
+ */
+static int dots_by_hevc_access_unit(ES_p es, int max, int verbose,
+                                    int show_gop_time) {
+  int err = 0;
+  int access_unit_count = 0;
+  hevc_context_p context;
+
+  int k_frame = 0;
+  int size_gop;
+  int size_gop_max = 0;
+  int size_gop_min = 100000;
+  int gops = 0;
+  int size_gop_tot = 0;
+  int is_first_k_frame = true;
+  unsigned long num_irap = 0;
+  unsigned long num_ref = 0;
+  unsigned long num_non_ref = 0;
+
+  if (verbose)
+    print_msg(
+        "\n"
+        "Each character represents a single access unit\n"
+        "\n"
+        "    D       means an IDR picture.\n"
+        "    C       means a CRA picture.\n"
+        "    L       means a BLA picture.\n"
+        "    K       means some other (reserved) IRAP picture.\n"
+        "    R       means any other picture that may be used for reference.\n"
+        "    n       means a sub-layer non-reference picture.\n"
+        "    _       means that the access unit doesn't contain a picture.\n"
+        "\n");
+
+  err = build_hevc_context(es, &context);
+  if (err)
+    return err;
+
+  for (;;) {
+    hevc_access_unit_p access_unit;
+    char char_nal_type;
+
+    // We never need to keep any of the access unit data
+    err = get_next_hevc_access_unit(context, true, false, true, &access_unit);
+    if (err == EOF)
+      break;
+    else if (err) {
+      free_hevc_context(&context);
+      return 1;
+    }
+
+    char_nal_type = choose_hevc_type(access_unit);
+
+    // The nearest thing to a GOP is the distance between IRAP pictures
+    if (is_hevc_IRAP_access_unit(access_unit)) {
+      if (!is_first_k_frame) {
+        size_gop = access_unit_count - k_frame;
+        size_gop_max = max(size_gop_max, size_gop);
+        size_gop_min = min(size_gop_min, size_gop);
+        size_gop_tot += size_gop;
+        gops++;
+        if (show_gop_time)
+          fprint_msg(": %2.4f\n", (double)size_gop / frame_rate);
+      }
+      is_first_k_frame = false;
+      k_frame = access_unit_count;
+      num_irap++;
+    } else if (access_unit->has_picture &&
+               !is_hevc_non_ref_nal_type(access_unit->nal_unit_type))
+      num_ref++;
+    else if (access_unit->has_picture)
+      num_non_ref++;
+
+    fprint_msg("%c", char_nal_type);
+    access_unit_count++;
+
+    fflush(stdout);
+    free_hevc_access_unit(&access_unit);
+
+    if (max > 0 && context->count >= max) {
+      fprint_msg("\nStopping because %d NAL units have been read\n",
+                 context->count);
+      break;
+    }
+  }
+
+  fprint_msg("\nFound %d NAL unit%s in %d access unit%s\n", context->count,
+             (context->count == 1 ? "" : "s"), access_unit_count,
+             (access_unit_count == 1 ? "" : "s"));
+  fprint_msg("%lu IRAP, %lu other reference, %lu non-reference access units\n",
+             num_irap, num_ref, num_non_ref);
+
+  if (gops) // only if there is more than 1 gop
+    fprint_msg(
+        "GOP size (s): max=%2.4f, min=%2.4f, mean=%2.5f (frame rate = %2.2f)\n",
+        (double)size_gop_max / frame_rate, (double)size_gop_min / frame_rate,
+        (double)size_gop_tot / (frame_rate * gops), frame_rate);
+  free_hevc_context(&context);
+  return 0;
+}
+
 /*
  * Simply report on the content of an ES file as single characters for each ES
  * unit
@@ -547,6 +680,7 @@ static int report_file_as_ES_dots(ES_p es, int what_data, int max,
   struct ES_unit unit;
 
   (void)setup_ES_unit(&unit);
+  (void)use_ES_unit_views(es); // we're done with each unit when we've shown it
 
   if (verbose) {
     print_msg("\n"
@@ -729,9 +863,9 @@ static void print_usage() {
   REPORT_VERSION("esdots");
   print_msg(
       "\n"
-      "  Present the content of an H.264 (MPEG-4/AVC), H.262 (MPEG-2) or AVS\n"
-      "  elementary stream as a sequence of characters, representing access\n"
-      "  units/MPEG-2 items/AVS items.\n"
+      "  Present the content of an H.264 (MPEG-4/AVC), H.265 (HEVC), H.262\n"
+      "  (MPEG-2) or AVS elementary stream as a sequence of characters,\n"
+      "  representing access units/MPEG-2 items/AVS items.\n"
       "\n"
       "  (Note that for H.264 it is access units and not frames that are\n"
       "  represented, and for H.262 it is items and not pictures.)\n"
@@ -778,6 +912,7 @@ static void print_usage() {
       "\n"
       "  -h264, -avc       Force the program to treat the input as "
       "MPEG-4/AVC.\n"
+      "  -h265, -hevc      Force the program to treat the input as HEVC.\n"
       "  -h262             Force the program to treat the input as MPEG-2.\n"
       "  -avs              Force the program to treat the input as AVS.\n");
 }
@@ -833,6 +968,9 @@ int main(int argc, char **argv) {
       } else if (!strcmp("-avc", argv[ii]) || !strcmp("-h264", argv[ii])) {
         force_stream_type = true;
         want_data = VIDEO_H264;
+      } else if (!strcmp("-hevc", argv[ii]) || !strcmp("-h265", argv[ii])) {
+        force_stream_type = true;
+        want_data = VIDEO_H265;
       } else if (!strcmp("-h262", argv[ii])) {
         force_stream_type = true;
         want_data = VIDEO_H262;
@@ -897,6 +1035,8 @@ int main(int argc, char **argv) {
     err = report_h262_file_as_dots(es, max, verbose, show_gop_time);
   else if (is_data == VIDEO_H264)
     err = dots_by_access_unit(es, max, verbose, hash_eos, show_gop_time);
+  else if (is_data == VIDEO_H265)
+    err = dots_by_hevc_access_unit(es, max, verbose, show_gop_time);
   else if (is_data == VIDEO_AVS)
     err = report_avs_file_as_dots(es, max, verbose);
   else {
@@ -21,6 +21,7 @@
 #include "filter.h"
 #include "h222.h"
 #include "h262.h"
+#include "hevc.h"
 #include "misc.h"
 #include "nalunit.h"
 #include "pes.h"
@@ -424,6 +425,7 @@ static int strip_access_units(ES_p es, WRITER output, int as_TS, int max,
     print_err("### Unable to build access unit context\n");
     return 1;
   }
+  set_nal_headers_only(acontext->nac, true);
   err = build_h264_filter_context_strip(&fcontext, acontext, keep_all_ref);
   if (err) {
     print_err("### Unable to build filter context\n");
@@ -509,6 +511,7 @@ static int filter_access_units(ES_p es, WRITER output, int as_TS, int max,
     print_err("### Unable to build access unit context\n");
     return 1;
   }
+  set_nal_headers_only(acontext->nac, true);
   err = build_h264_filter_context(&fcontext, acontext, frequency);
   if (err) {
     print_err("### Unable to build filter context\n");
@@ -590,6 +593,247 @@ static int filter_access_units(ES_p es, WRITER output, int as_TS, int max,
   return 0;
 }
 
+/*
+ * Copy HEVC NAL units from input to output.
+ *
+ * Since we don't need to understand the NAL units to copy them, we just
+ * treat them as ES units.
+ *
+ * Returns 0 if it succeeds, 1 if some error occurs.
+ */
+static int copy_hevc(ES_p es, WRITER output, int as_TS, int max, int quiet) {
+  int err;
+  int count = 0;
+  ES_unit_p unit = nullptr;
+
+  err = build_ES_unit(&unit);
+  if (err)
+    return 1;
+
+  for (;;) {
+    err = find_next_ES_unit(es, unit);
+    if (err == EOF)
+      break;
+    else if (err) {
+      print_err("### Error copying NAL units\n");
+      free_ES_unit(&unit);
+      return err;
+    }
+    count++;
+
+    if (as_TS)
+      err = write_ES_as_TS_PES_packet(output.ts_output, unit->data,
+                                      unit->data_len, DEFAULT_VIDEO_PID,
+                                      DEFAULT_VIDEO_STREAM_ID);
+    else
+      err = write_ES_unit(output.es_output, unit);
+    if (err) {
+      print_err("### Error writing NAL unit\n");
+      free_ES_unit(&unit);
+      return err;
+    }
+
+    if (max > 0 && count >= max)
+      break;
+  }
+  free_ES_unit(&unit);
+  if (!quiet)
+    fprint_msg("Copied %d NAL unit%s\n", count, (count == 1 ? "" : "s"));
+  return 0;
+}
+
+/*
+ * Output an HEVC access unit, appropriately.
+ *
+ * Returns 0 if it succeeds, 1 if some error occurs.
+ */
+static int write_hevc_frame(WRITER output, int as_TS,
+                            hevc_access_unit_p access_unit) {
+  if (as_TS)
+    return write_hevc_access_unit_as_TS(access_unit, output.ts_output,
+                                        DEFAULT_VIDEO_PID);
+  else
+    return write_hevc_access_unit_as_ES(access_unit, output.es_output);
+}
+
+/*
+ * Output just the IRAP (and maybe all reference) HEVC access units.
+ *
+ * Returns 0 if all went well, 1 if something went wrong.
+ */
+static int strip_hevc(ES_p es, WRITER output, int as_TS, int max,
+                      int keep_all_ref, int verbose, int quiet) {
+  int err = 0;
+  int count;
+  hevc_context_p hevc = nullptr;
+  hevc_filter_context_p fcontext = nullptr;
+
+  // It's nice to output some statistics at the end
+  int access_units_seen = 0;
+  int access_units_kept = 0;
+
+  err = build_hevc_context(es, &hevc);
+  if (err) {
+    print_err("### Unable to build HEVC context\n");
+    return 1;
+  }
+  err = build_hevc_filter_context_strip(&fcontext, hevc, keep_all_ref);
+  if (err) {
+    print_err("### Unable to build filter context\n");
+    free_hevc_context(&hevc);
+    return 1;
+  }
+
+  for (count = 1;; count++) {
+    hevc_access_unit_p access_unit = nullptr;
+    int delta_access_units_seen;
+    err = get_next_stripped_hevc_frame(fcontext, verbose, quiet, &access_unit,
+                                       &delta_access_units_seen);
+    if (err == EOF)
+      break;
+    else if (err) {
+      print_err("### Error getting next stripped picture\n");
+      free_hevc_filter_context(&fcontext);
+      free_hevc_context(&hevc);
+      return 1;
+    }
+
+    access_units_seen += delta_access_units_seen;
+    access_units_kept++;
+
+    err = write_hevc_frame(output, as_TS, access_unit);
+    if (err) {
+      print_err("### Error writing picture\n");
+      free_hevc_access_unit(&access_unit);
+      free_hevc_filter_context(&fcontext);
+      free_hevc_context(&hevc);
+      return 1;
+    }
+    free_hevc_access_unit(&access_unit);
+
+    if (max > 0 && count >= max) {
+      if (!quiet)
+        fprint_msg("Ending after %d frames\n", count);
+      break;
+    }
+  }
+
+  free_hevc_filter_context(&fcontext);
+  free_hevc_context(&hevc);
+
+  if (!quiet) {
+    print_msg("\n");
+    print_msg("Summary\n");
+    print_msg("=======\n");
+    print_msg("                  Found    Written\n");
+    fprint_msg("Access units %10d %10d (%4.1f%%)\n", access_units_seen,
+               access_units_kept,
+               100 * (((double)access_units_kept) / access_units_seen));
+  }
+  return 0;
+}
+
+/*
+ * Filter out HEVC access units, aiming to keep one every `frequency`.
+ *
+ * Returns 0 if all went well, 1 if something went wrong.
+ */
+static int filter_hevc(ES_p es, WRITER output, int as_TS, int max,
+                       int frequency, int verbose, int quiet) {
+  int err = 0;
+  int count;
+  hevc_context_p hevc = nullptr;
+  hevc_filter_context_p fcontext = nullptr;
+
+  // It's nice to output some statistics at the end
+  int access_units_seen = 0;
+  int access_units_kept = 0;
+  int access_units_written = 0;
+
+  hevc_access_unit_p this_access_unit = nullptr;
+  hevc_access_unit_p last_access_unit = nullptr;
+
+  err = build_hevc_context(es, &hevc);
+  if (err) {
+    print_err("### Unable to build HEVC context\n");
+    return 1;
+  }
+  err = build_hevc_filter_context(&fcontext, hevc, frequency);
+  if (err) {
+    print_err("### Unable to build filter context\n");
+    free_hevc_context(&hevc);
+    return 1;
+  }
+
+  for (count = 1;; count++) {
+    int delta_access_units_seen;
+    err = get_next_filtered_hevc_frame(
+        fcontext, verbose, quiet, &this_access_unit, &delta_access_units_seen);
+    if (err == EOF)
+      break;
+    else if (err) {
+      print_err("### Error getting next filtered picture\n");
+      free_hevc_access_unit(&last_access_unit);
+      free_hevc_filter_context(&fcontext);
+      free_hevc_context(&hevc);
+      return 1;
+    }
+
+    access_units_seen += delta_access_units_seen;
+
+    if (this_access_unit == nullptr) {
+      // We need to repeat the last access unit
+      this_access_unit = last_access_unit;
+      last_access_unit = nullptr;
+    } else
+      access_units_kept++;
+
+    if (this_access_unit != nullptr) {
+      err = write_hevc_frame(output, as_TS, this_access_unit);
+      if (err) {
+        print_err("### Error writing picture\n");
+        free_hevc_access_unit(&this_access_unit);
+        free_hevc_access_unit(&last_access_unit);
+        free_hevc_filter_context(&fcontext);
+        free_hevc_context(&hevc);
+        return 1;
+      }
+      access_units_written++;
+    }
+
+    free_hevc_access_unit(&last_access_unit);
+    last_access_unit = this_access_unit;
+
+    if (max > 0 && count >= max) {
+      if (!quiet)
+        fprint_msg("Ending after %d frames\n", count);
+      free_hevc_access_unit(&this_access_unit);
+      break;
+    }
+  }
+
+  free_hevc_access_unit(&last_access_unit);
+  free_hevc_filter_context(&fcontext);
+  free_hevc_context(&hevc);
+
+  if (!quiet) {
+    print_msg("\n");
+    print_msg("Summary\n");
+    print_msg("=======\n");
+    print_msg("            Found       Kept            Written\n");
+    fprint_msg("Frames %10d %10d (%4.1f%%) %10d (%4.1f%%)\n", access_units_seen,
+               access_units_kept,
+               100 * (((double)access_units_kept) / access_units_seen),
+               access_units_written,
+               100 * (((double)access_units_written) / access_units_seen));
+    if (frequency != 0)
+      fprint_msg("Target (frames) . %10d (%4.1f%%) at requested"
+                 " frequency %d\n",
+                 access_units_seen / frequency, 100.0 / frequency, frequency);
+  }
+  return 0;
+}
+
 /*
  * Perform whatever action we have been requested to do on the input
  * stream.
@@ -597,8 +841,9 @@ static int filter_access_units(ES_p es, WRITER output, int as_TS, int max,
  * Returns 0 if all went well, 1 if something went wrong.
  */
 static int do_action(ACTION action, ES_p es, WRITER output, int max,
-                     int frequency, int is_h262, int as_TS, int keep_all_ref,
-                     byte stream_type, int verbose, int quiet) {
+                     int frequency, int video_type, int as_TS,
+                     int keep_all_ref, byte stream_type, int verbose,
+                     int quiet) {
   int err = 0;
 
   // If we're writing Transport Stream, start with the PAT and PMT
@@ -615,24 +860,30 @@ static int do_action(ACTION action, ES_p es, WRITER output, int max,
 
   switch (action) {
   case ACTION_FILTER:
-    if (is_h262)
+    if (video_type == VIDEO_H262)
       err = filter_h262(es, output, as_TS, frequency, max, verbose, quiet);
+    else if (video_type == VIDEO_H265)
+      err = filter_hevc(es, output, as_TS, max, frequency, verbose, quiet);
     else
       err = filter_access_units(es, output, as_TS, max, frequency, verbose,
                                 quiet);
     break;
 
   case ACTION_STRIP:
-    if (is_h262)
+    if (video_type == VIDEO_H262)
       err = strip_h262(es, output, as_TS, max, keep_all_ref, verbose, quiet);
+    else if (video_type == VIDEO_H265)
+      err = strip_hevc(es, output, as_TS, max, keep_all_ref, verbose, quiet);
     else
       err = strip_access_units(es, output, as_TS, max, keep_all_ref, verbose,
                                quiet);
     break;
 
   case ACTION_COPY:
-    if (is_h262)
+    if (video_type == VIDEO_H262)
       err = copy_h262(es, output, as_TS, max, quiet);
+    else if (video_type == VIDEO_H265)
+      err = copy_hevc(es, output, as_TS, max, quiet);
     else
       err = copy_nal_units(es, output, as_TS, max, verbose, quiet);
     break;
@@ -652,7 +903,7 @@ static void print_usage() {
   print_msg(
       "\n"
       "  Output a filtered or truncated version of an elementary stream.\n"
-      "  The input is either H.264 (MPEG-4/AVC) or H.262 (MPEG-2).\n"
+      "  The input is H.264 (MPEG-4/AVC), H.265 (HEVC) or H.262 (MPEG-2).\n"
       "  The output is either an elementary stream, or an H.222 transport\n"
       "  stream\n"
       "\n"
@@ -671,7 +922,8 @@ static void print_usage() {
       "  -filter   Filter data from input to output, aiming to keep every\n"
       "            <n>th frame (where <n> is specified by -freq).\n"
       "  -strip    For H.264, output just the IDR and I pictures, for H.262,\n"
-      "            output just the I pictures, but see -allref below.\n"
+      "            output just the I pictures, and for HEVC, output just the\n"
+      "            IRAP pictures, but see -allref below.\n"
       "\n"
       "Switches:\n"
       "  -verbose, -v      Output extra (debugging) messages\n"
@@ -691,8 +943,8 @@ static void print_usage() {
       "                    and -strip), or ES units/NAL units (for -copy).\n"
       "  -freq <n>         Specify the frequency of frames to try to keep\n"
       "                    with -filter. Defaults to 8.\n"
-      "  -allref           With -strip, keep all reference pictures (H.264)\n"
-      "                    or all I and P pictures (H.262)\n"
+      "  -allref           With -strip, keep all reference pictures (H.264\n"
+      "                    and HEVC) or all I and P pictures (H.262)\n"
       "  -tsout            Output data as Transport Stream PES packets\n"
       "                    (the default is as Elementary Stream)\n"
       "  -pes, -ts         The input file is TS or PS, to be read via the\n"
@@ -713,6 +965,8 @@ static void print_usage() {
       "\n"
       "  -h264, -avc       Force the program to treat the input as "
       "MPEG-4/AVC.\n"
+      "  -h265, -hevc      Force the program to treat the input as HEVC.\n"
+      "                    HEVC input is never recognised automatically.\n"
       "  -h262             Force the program to treat the input as MPEG-2.\n");
 }
 
@@ -761,6 +1015,9 @@ int main(int argc, char **argv) {
       } else if (!strcmp("-avc", argv[ii]) || !strcmp("-h264", argv[ii])) {
         force_stream_type = true;
         want_data = VIDEO_H264;
+      } else if (!strcmp("-hevc", argv[ii]) || !strcmp("-h265", argv[ii])) {
+        force_stream_type = true;
+        want_data = VIDEO_H265;
       } else if (!strcmp("-h262", argv[ii])) {
         force_stream_type = true;
         want_data = VIDEO_H262;
@@ -887,6 +1144,8 @@ int main(int argc, char **argv) {
     stream_type = MPEG2_VIDEO_STREAM_TYPE;
   else if (is_data == VIDEO_H264)
     stream_type = AVC_VIDEO_STREAM_TYPE;
+  else if (is_data == VIDEO_H265)
+    stream_type = H265_VIDEO_STREAM_TYPE;
   else {
     print_err("### esfilter: Unexpected type of video data\n");
     return 1;
@@ -930,6 +1189,11 @@ int main(int argc, char **argv) {
           print_msg("Just keeping I and P pictures\n");
         else
           print_msg("Just keep I pictures\n");
+      } else if (want_data == VIDEO_H265) {
+        if (keep_all_ref)
+          print_msg("Just keeping reference pictures\n");
+        else
+          print_msg("Just keep IRAP pictures\n");
       } else {
         if (keep_all_ref)
           print_msg("Just keeping reference pictures\n");
@@ -941,8 +1205,8 @@ int main(int argc, char **argv) {
       fprint_msg("Stopping as soon after %d NAL units as possible\n", max);
   }
 
-  err = do_action(action, es, output, max, frequency, want_data == VIDEO_H262,
-                  as_TS, keep_all_ref, stream_type, verbose, quiet);
+  err = do_action(action, es, output, max, frequency, want_data, as_TS,
+                  keep_all_ref, stream_type, verbose, quiet);
   if (err) {
     fprint_err("### esfilter: Error doing '%s'\n", action_switch);
     (void)close_input_as_ES(input_name, &es);
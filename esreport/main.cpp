@@ -205,6 +205,7 @@ static void report_ES_units(ES_p es, int max, int verbose, int quiet) {
   struct ES_unit unit;
 
   (void)setup_ES_unit(&unit);
+  (void)use_ES_unit_views(es); // we're done with each unit when we've shown it
 
   for (;;) {
     err = find_next_ES_unit(es, &unit);
@@ -655,6 +656,7 @@ static void find_h264_fields(ES_p es, int max, int quiet, int verbose,
 
   if (show_nal_details)
     set_show_nal_reading_details(context->nac, true);
+  set_nal_headers_only(context->nac, true);
 
   for (;;) {
     access_unit_p access_unit;
@@ -727,6 +729,7 @@ static void report_h264_frames(ES_p es, int max, int quiet, int verbose,
 
   if (show_nal_details)
     set_show_nal_reading_details(context->nac, true);
+  set_nal_headers_only(context->nac, true);
 
   for (;;) {
     access_unit_p access_unit;
@@ -928,6 +931,8 @@ static void print_usage() {
       "  -pes, -ts         The input file is TS or PS, to be read via the\n"
       "                    PES->ES reading mechanisms\n"
       "  -pesreport        Report on PES headers. Implies -pes and -q.\n"
+      "  -mmap             Memory map the input file, rather than reading it.\n"
+      "                    Ignored with -pes or -stdin.\n"
       "\n"
       "Stream type:\n"
       "  If input is from a file, then the program will look at the start of\n"
@@ -969,6 +974,7 @@ int main(int argc, char **argv) {
   int ii = 1;
 
   int use_pes = false;
+  int use_mmap = false;
 
   int want_data = VIDEO_H262;
   int is_data;
@@ -1038,6 +1044,8 @@ int main(int argc, char **argv) {
         ii++;
       } else if (!strcmp("-pes", argv[ii]) || !strcmp("-ts", argv[ii]))
         use_pes = true;
+      else if (!strcmp("-mmap", argv[ii]))
+        use_mmap = true;
       else if (!strcmp("-pesreport", argv[ii])) {
         report_pes_headers = true;
         use_pes = true;
@@ -1074,6 +1082,9 @@ int main(int argc, char **argv) {
     print_err("### esreport: Error opening input file\n");
     return 1;
   }
+  if (use_mmap && !use_pes && !use_stdin && map_elementary_stream(es) &&
+      !quiet)
+    print_msg("!!! Unable to memory map input - reading it instead\n");
 
   if (report_pes_headers) {
     es->reader->debug_read_packets = true;
@@ -49,6 +49,7 @@
 #include "filter.h"
 #include "h222.h"
 #include "h262.h"
+#include "hevc.h"
 #include "l2audio.h"
 #include "misc.h"
 #include "nalunit.h"
@@ -186,53 +187,59 @@ static int output_parameter_sets(WRITER output, access_unit_context_p context,
   int err;
 
   for (ii = 0; ii < seq_param_dict->length; ii++) {
-    ES_offset posn = seq_param_dict->posns[ii];
-    uint32_t length = seq_param_dict->data_lens[ii];
-    byte *data = nullptr;
+    int id = seq_param_dict->ids[ii];
+    ES_offset posn = seq_param_dict->posns[id];
+    uint32_t length = seq_param_dict->data_lens[id];
+    byte *buffer = nullptr;
+    byte *data;
     if (!quiet)
-      fprint_msg("Writing out sequence parameter set %d\n",
-                 seq_param_dict->ids[ii]);
+      fprint_msg("Writing out sequence parameter set %d\n", id);
 
-    err = read_ES_data(nac->es, posn, length, nullptr, &data);
+    err = get_ES_data(nac->es, posn, length, nullptr, &buffer, &data);
     if (err) {
+      if (buffer != nullptr)
+        free(buffer);
       fprint_err("### Error reading (sequence parameter set %d) data"
                  " from " OFFSET_T_FORMAT "/%d for %d\n",
-                 seq_param_dict->ids[ii], posn.infile, posn.inpacket, length);
+                 id, posn.infile, posn.inpacket, length);
       return 1;
     }
     err = write_packet_data(output, as_TS, data, length, DEFAULT_VIDEO_PID,
                             DEFAULT_VIDEO_STREAM_ID);
-    free(data);
+    if (buffer != nullptr)
+      free(buffer);
     if (err) {
       fprint_err("### Error writing out (sequence parameter set %d)"
-                 "data\n",
-                 seq_param_dict->ids[ii]);
+                 "data\n", id);
       return 1;
     }
   }
 
   for (ii = 0; ii < pic_param_dict->length; ii++) {
-    ES_offset posn = pic_param_dict->posns[ii];
-    uint32_t length = pic_param_dict->data_lens[ii];
-    byte *data = nullptr;
+    int id = pic_param_dict->ids[ii];
+    ES_offset posn = pic_param_dict->posns[id];
+    uint32_t length = pic_param_dict->data_lens[id];
+    byte *buffer = nullptr;
+    byte *data;
     if (!quiet)
-      fprint_msg("Writing out picture parameter set %d\n",
-                 pic_param_dict->ids[ii]);
+      fprint_msg("Writing out picture parameter set %d\n", id);
 
-    err = read_ES_data(nac->es, posn, length, nullptr, &data);
+    err = get_ES_data(nac->es, posn, length, nullptr, &buffer, &data);
     if (err) {
+      if (buffer != nullptr)
+        free(buffer);
       fprint_err("### Error reading (picture parameter set %d) data"
                  " from " OFFSET_T_FORMAT "/%d for %d\n",
-                 pic_param_dict->ids[ii], posn.infile, posn.inpacket, length);
+                 id, posn.infile, posn.inpacket, length);
       return 1;
     }
     err = write_packet_data(output, as_TS, data, length, DEFAULT_VIDEO_PID,
                             DEFAULT_VIDEO_STREAM_ID);
-    free(data);
+    if (buffer != nullptr)
+      free(buffer);
     if (err) {
       fprint_err("### Error writing out (picture parameter set %d)"
-                 "data\n",
-                 pic_param_dict->ids[ii]);
+                 "data\n", id);
       return 1;
     }
   }
@@ -253,6 +260,7 @@ static int reverse_access_units(ES_p es, WRITER output, int max, int frequency,
   err = build_access_unit_context(es, &acontext);
   if (err)
     return 1;
+  set_nal_headers_only(acontext->nac, true);
 
   err = build_reverse_data(&reverse_data, true);
   if (err) {
@@ -337,14 +345,147 @@ static int reverse_access_units(ES_p es, WRITER output, int max, int frequency,
   return err;
 }
 
+/*
+ * Output a list of HEVC parameter sets (VPS, SPS or PPS), skipping the ids
+ * we haven't seen
+ *
+ * Returns 0 if all went well, 1 if something went wrong.
+ */
+static int output_hevc_parameter_set_list(WRITER output, ES_unit_p units[],
+                                          int num_ids, int as_TS, int quiet) {
+  int ii;
+  int err;
+
+  for (ii = 0; ii < num_ids; ii++) {
+    ES_unit_p unit = units[ii];
+    if (unit == nullptr)
+      continue;
+    if (!quiet)
+      fprint_msg("Writing out %s %d\n",
+                 HEVC_NAL_UNIT_TYPE_STR(HEVC_NAL_UNIT_TYPE(unit)), ii);
+
+    err = write_packet_data(output, as_TS, unit->data, unit->data_len,
+                            DEFAULT_VIDEO_PID, DEFAULT_VIDEO_STREAM_ID);
+    if (err) {
+      fprint_err("### Error writing out (%s) data\n",
+                 HEVC_NAL_UNIT_TYPE_STR(HEVC_NAL_UNIT_TYPE(unit)));
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/*
+ * Output the latest HEVC parameter sets (VPS, SPS and PPS) for each id
+ *
+ * Returns 0 if all went well, 1 if something went wrong.
+ */
+static int output_hevc_parameter_sets(WRITER output, hevc_context_p context,
+                                      int as_TS, int quiet) {
+  int err = output_hevc_parameter_set_list(output, context->vps,
+                                           HEVC_MAX_VPS_IDS, as_TS, quiet);
+  if (!err)
+    err = output_hevc_parameter_set_list(output, context->sps,
+                                         HEVC_MAX_SPS_IDS, as_TS, quiet);
+  if (!err)
+    err = output_hevc_parameter_set_list(output, context->pps,
+                                         HEVC_MAX_PPS_IDS, as_TS, quiet);
+  return err;
+}
+
+/*
+ * Find HEVC IRAP access units, and output them in reverse order.
+ *
+ * Returns 0 if all went well, 1 if something went wrong.
+ */
+static int reverse_hevc(ES_p es, WRITER output, int max, int frequency,
+                        int as_TS, int verbose, int quiet) {
+  int err = 0;
+  reverse_data_p reverse_data = nullptr;
+  hevc_context_p hcontext = nullptr;
+
+  err = build_hevc_context(es, &hcontext);
+  if (err)
+    return 1;
+
+  err = build_reverse_data(&reverse_data, true);
+  if (err) {
+    free_hevc_context(&hcontext);
+    return 1;
+  }
+
+  if (!quiet)
+    print_msg("\nScanning forwards\n");
+
+  add_hevc_reverse_context(hcontext, reverse_data);
+  err = collect_reverse_hevc(hcontext, max, verbose, quiet);
+  if (err && err != EOF) {
+    if (reverse_data->length > 0) {
+      fprint_err("!!! Collected %d access units,"
+                 " continuing to reverse\n",
+                 reverse_data->length);
+    } else {
+      free_reverse_data(&reverse_data);
+      free_hevc_context(&hcontext);
+      return 1;
+    }
+  }
+
+  if (!es->reading_ES) {
+    // Just in case (it can't hurt)
+    stop_server_output(es->reader);
+    // But this is important
+    set_PES_reader_video_only(es->reader, true);
+  }
+
+  // As for H.264, write out the parameter sets before any reverse data
+  if (!quiet)
+    print_msg("\nPreparing to output reverse data\n");
+  err = output_hevc_parameter_sets(output, hcontext, as_TS, quiet);
+  if (err) {
+    free_reverse_data(&reverse_data);
+    free_hevc_context(&hcontext);
+    return 1;
+  }
+
+  if (!quiet)
+    print_msg("\nOutputting in reverse order\n");
+
+  if (as_TS)
+    err = output_in_reverse_as_TS(es, output.ts_output, frequency, verbose,
+                                  quiet, -1, 0, reverse_data);
+  else
+    err = output_in_reverse_as_ES(es, output.es_output, frequency, verbose,
+                                  quiet, -1, 0, reverse_data);
+  if (!err && !quiet) {
+    uint32_t final_index = reverse_data->index[reverse_data->first_written];
+    print_msg("\n");
+    print_msg("Summary\n");
+    print_msg("=======\n");
+    print_msg("              Considered       Used            Written\n");
+    fprint_msg("Access units  %10d %10d (%4.1f%%) %10d (%4.1f%%)\n",
+               final_index, reverse_data->pictures_kept,
+               100 * (((double)reverse_data->pictures_kept) / final_index),
+               reverse_data->pictures_written,
+               100 * (((double)reverse_data->pictures_written) / final_index));
+    if (frequency != 0)
+      fprint_msg("Target (access units)  . %10d (%4.1f%%) at requested"
+                 " frequency %d\n",
+                 final_index / frequency, 100.0 / frequency, frequency);
+  }
+  free_reverse_data(&reverse_data);
+  free_hevc_context(&hcontext);
+  return err;
+}
+
 static void print_usage() {
   print_msg("Usage: esreverse [switches] [<infile>] [<outfile>]\n"
             "\n");
   REPORT_VERSION("esreverse");
   print_msg(
       "\n"
-      "  Output a reversed stream derived from the input H.264 (MPEG-4/AVC)\n"
-      "  or H.262 (MPEG-2) elementary stream.\n"
+      "  Output a reversed stream derived from the input H.264 (MPEG-4/AVC),\n"
+      "  H.265 (HEVC) or H.262 (MPEG-2) elementary stream.\n"
       "\n"
       "  If output is to an H.222 Transport Stream, then fixed values for\n"
       "  the PMT PID (0x66) and video PID (0x68) are used.\n"
@@ -375,6 +516,8 @@ static void print_usage() {
       "\n"
       "  -pes, -ts         The input file is TS or PS, to be read via the\n"
       "                    PES->ES reading mechanisms\n"
+      "  -mmap             Memory map the input file, rather than reading it.\n"
+      "                    Ignored with -pes.\n"
       "  -server           Also output as normal forward video as reversal\n"
       "                    data is being collected. Implies -pes and -tsout.\n"
 #if SHOW_REVERSE_DATA
@@ -390,6 +533,9 @@ static void print_usage() {
       "\n"
       "  -h264, -avc       Force the program to treat the input as "
       "MPEG-4/AVC.\n"
+      "  -h265, -hevc      Force the program to treat the input as HEVC.\n"
+      "                    HEVC input is not recognised automatically, except\n"
+      "                    in TS with -pes.\n"
       "  -h262             Force the program to treat the input as MPEG-2.\n");
 }
 
@@ -413,6 +559,7 @@ int main(int argc, char **argv) {
 
   int use_pes = false;
   int use_server = false;
+  int use_mmap = false;
 
   int want_data = VIDEO_H262;
   int is_data;
@@ -440,11 +587,16 @@ int main(int argc, char **argv) {
       else if (!strcmp("-avc", argv[ii]) || !strcmp("-h264", argv[ii])) {
         force_stream_type = true;
         want_data = VIDEO_H264;
+      } else if (!strcmp("-hevc", argv[ii]) || !strcmp("-h265", argv[ii])) {
+        force_stream_type = true;
+        want_data = VIDEO_H265;
       } else if (!strcmp("-h262", argv[ii])) {
         force_stream_type = true;
         want_data = VIDEO_H262;
       } else if (!strcmp("-pes", argv[ii]) || !strcmp("-ts", argv[ii]))
         use_pes = true;
+      else if (!strcmp("-mmap", argv[ii]))
+        use_mmap = true;
       else if (!strcmp("-server", argv[ii])) {
         use_server = true;
         use_pes = true;
@@ -540,11 +692,15 @@ int main(int argc, char **argv) {
     print_err("### esreverse: Error opening input file\n");
     return 1;
   }
+  if (use_mmap && !use_pes && map_elementary_stream(es) && !quiet)
+    print_msg("!!! Unable to memory map input - reading it instead\n");
 
   if (is_data == VIDEO_H262)
     stream_type = MPEG2_VIDEO_STREAM_TYPE;
   else if (is_data == VIDEO_H264)
     stream_type = AVC_VIDEO_STREAM_TYPE;
+  else if (is_data == VIDEO_H265)
+    stream_type = H265_VIDEO_STREAM_TYPE;
   else {
     print_err("### esreverse: Unexpected type of video data\n");
     return 1;
@@ -639,6 +795,8 @@ int main(int argc, char **argv) {
 
   if (is_data == VIDEO_H262)
     err = reverse_h262(es, output, max, frequency, as_TS, verbose, quiet);
+  else if (is_data == VIDEO_H265)
+    err = reverse_hevc(es, output, max, frequency, as_TS, verbose, quiet);
   else
     err =
         reverse_access_units(es, output, max, frequency, as_TS, verbose, quiet);
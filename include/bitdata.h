@@ -34,13 +34,12 @@
 #include <cassert>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 
 #include "bitdata_fns.h"
 #include "compat.h"
 #include "printing_fns.h"
 
-static int MASK[] = {0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01};
-
 /*
  * Build a new bitdata datastructure.
  *
@@ -56,15 +55,36 @@ int build_bitdata(bitdata_p *bitdata, byte data[], int data_len) {
     return 1;
   }
 
-  new2->data = data;
-  new2->data_len = data_len;
-  new2->cur_byte = 0;
-  new2->cur_bit = -1;
+  setup_bitdata(new2, data, data_len, false);
 
   *bitdata = new2;
   return 0;
 }
 
+/*
+ * Set up an existing bitdata datastructure to read from a byte array.
+ *
+ * This is for a bitdata datastructure that the caller owns (for instance,
+ * one that is reused for each NAL unit), and so must not be freed with
+ * `free_bitdata()`.
+ *
+ * - `data` is the byte array we're extracting bits from.
+ * - `data_len` is its length (in bytes).
+ * - if `escaped` is true, then `data` may contain emulation prevention
+ *   bytes (00 00 03), and the 03 bytes will be skipped over as we go,
+ *   so that there is no need to remove them from the whole array first.
+ */
+void setup_bitdata(bitdata_p bitdata, byte data[], int data_len,
+                   int escaped) {
+  bitdata->data = data;
+  bitdata->data_len = data_len;
+  bitdata->cur_byte = 0;
+  bitdata->cache = 0;
+  bitdata->cache_bits = 0;
+  bitdata->escaped = escaped;
+  bitdata->zeros = 0;
+}
+
 /*
  * Tidy up and free a bitdata datastructure after we've finished with it.
  *
@@ -77,29 +97,142 @@ void free_bitdata(bitdata_p *bitdata) {
     return;
   (*bitdata)->data = nullptr;
   (*bitdata)->cur_byte = 0;
-  (*bitdata)->cur_bit = -1;
+  (*bitdata)->cache = 0;
+  (*bitdata)->cache_bits = 0;
   free(*bitdata);
   *bitdata = nullptr;
 }
 
 /*
- * Return the next bit from the data.
- *
- * Returns 0 or 1 if it reads the bit correctly, -1 if there are no more
- * bits to be read.
+ * Count the leading zero bits in a (non-zero) 64-bit value.
  */
-static inline int next_bit(bitdata_p bitdata) {
-  bitdata->cur_bit += 1;
-  if (bitdata->cur_bit == 8) {
-    bitdata->cur_bit = 0;
-    bitdata->cur_byte += 1;
-    if (bitdata->cur_byte > (bitdata->data_len - 1)) {
-      print_err("### No more bits to read from input stream\n");
-      return -1;
+static inline int leading_zeros64(uint64_t value) {
+#if defined(__GNUC__)
+  return __builtin_clzll(value);
+#else
+  int count = 0;
+  while (!(value & 0x8000000000000000ULL)) {
+    value <<= 1;
+    count++;
+  }
+  return count;
+#endif
+}
+
+/*
+ * Top up the cache from escaped data, dropping emulation prevention bytes.
+ */
+static void refill_escaped_bitdata(bitdata_p bitdata) {
+  while (bitdata->cache_bits <= 56 && bitdata->cur_byte < bitdata->data_len) {
+    byte next = bitdata->data[bitdata->cur_byte++];
+    if (bitdata->zeros >= 2 && next == 0x03) {
+      bitdata->zeros = 0; // and ignore the 03
+      continue;
     }
+    bitdata->zeros = (next == 0x00 ? bitdata->zeros + 1 : 0);
+    bitdata->cache |= (uint64_t)next << (56 - bitdata->cache_bits);
+    bitdata->cache_bits += 8;
   }
-  return (bitdata->data[bitdata->cur_byte] & MASK[bitdata->cur_bit]) >>
-         (7 - bitdata->cur_bit);
+}
+
+/*
+ * Top up the cache with as many whole bytes as will fit in it, or as
+ * are left in the data.
+ */
+static inline void refill_bitdata(bitdata_p bitdata) {
+  if (bitdata->cache_bits > 56)
+    return;
+  if (bitdata->escaped) {
+    refill_escaped_bitdata(bitdata);
+  } else if (bitdata->cur_byte + 8 <= bitdata->data_len) {
+    // Load eight bytes at once, and keep as many of them as fit
+    uint64_t word;
+    int count = (64 - bitdata->cache_bits) >> 3;
+    memcpy(&word, &bitdata->data[bitdata->cur_byte], 8);
+#if defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    word = __builtin_bswap64(word);
+#elif !defined(__GNUC__)
+    {
+      byte *ptr = &bitdata->data[bitdata->cur_byte];
+      word = 0;
+      for (int ii = 0; ii < 8; ii++)
+        word = (word << 8) | ptr[ii];
+    }
+#endif
+    if (count < 8)
+      word &= ~((1ULL << (64 - 8 * count)) - 1);
+    bitdata->cache |= word >> bitdata->cache_bits;
+    bitdata->cache_bits += 8 * count;
+    bitdata->cur_byte += count;
+  } else {
+    while (bitdata->cache_bits <= 56 &&
+           bitdata->cur_byte < bitdata->data_len) {
+      bitdata->cache |= (uint64_t)bitdata->data[bitdata->cur_byte]
+                        << (56 - bitdata->cache_bits);
+      bitdata->cache_bits += 8;
+      bitdata->cur_byte++;
+    }
+  }
+}
+
+/*
+ * Discard `count` bits (0..64) from the cache, which must hold them.
+ */
+static inline void consume_bits(bitdata_p bitdata, int count) {
+  if (count == 64)
+    bitdata->cache = 0;
+  else
+    bitdata->cache <<= count;
+  bitdata->cache_bits -= count;
+}
+
+/*
+ * We've run off the end of the data, so complain, and make sure that
+ * there's nothing left for any later reads.
+ *
+ * Always returns 1.
+ */
+static int no_more_bits(bitdata_p bitdata) {
+  print_err("### No more bits to read from input stream\n");
+  bitdata->cur_byte = bitdata->data_len;
+  bitdata->cache = 0;
+  bitdata->cache_bits = 0;
+  return 1;
+}
+
+/*
+ * Look at the next `count` bits (0..32) in the data, without reading them.
+ *
+ * Returns 0 if all went well, 1 if there were not enough bits in the data
+ * (in which case nothing is reported).
+ */
+int peek_bits(bitdata_p bitdata, int count, uint32_t *bits) {
+  assert((count >= 0 && count <= 32));
+
+  if (bitdata->cache_bits < count) {
+    refill_bitdata(bitdata);
+    if (bitdata->cache_bits < count)
+      return 1;
+  }
+  *bits = (count == 0 ? 0 : (uint32_t)(bitdata->cache >> (64 - count)));
+  return 0;
+}
+
+/*
+ * Skip over the next `count` bits (0..32) in the data.
+ *
+ * Returns 0 if all went well, 1 if there were not enough bits in the data.
+ */
+int skip_bits(bitdata_p bitdata, int count) {
+  assert((count >= 0 && count <= 32));
+
+  if (bitdata->cache_bits < count) {
+    refill_bitdata(bitdata);
+    if (bitdata->cache_bits < count)
+      return no_more_bits(bitdata);
+  }
+  consume_bits(bitdata, count);
+  return 0;
 }
 
 /*
@@ -109,13 +242,14 @@ static inline int next_bit(bitdata_p bitdata) {
  * bits to be read.
  */
 int read_bit(bitdata_p bitdata, byte *bit) {
-  int next = next_bit(bitdata);
-  if (next < 0)
-    return 1;
-  else {
-    *bit = next;
-    return 0;
+  if (bitdata->cache_bits == 0) {
+    refill_bitdata(bitdata);
+    if (bitdata->cache_bits == 0)
+      return no_more_bits(bitdata);
   }
+  *bit = (byte)(bitdata->cache >> 63);
+  consume_bits(bitdata, 1);
+  return 0;
 }
 
 /*
@@ -126,19 +260,19 @@ int read_bit(bitdata_p bitdata, byte *bit) {
  * Returns 0 if all went well, 1 if there were not enough bits in the data.
  */
 int read_bits(bitdata_p bitdata, int count, uint32_t *bits) {
-  int index = 0;
-  uint32_t result = 0;
-
   assert((count >= 0 && count <= 32));
 
-  for (index = 0; index < count; index++) {
-    int bit = next_bit(bitdata);
-    if (bit < 0)
-      return 1;
-    else
-      result = (result << 1) | bit;
+  if (count == 0) {
+    *bits = 0;
+    return 0;
   }
-  *bits = result;
+  if (bitdata->cache_bits < count) {
+    refill_bitdata(bitdata);
+    if (bitdata->cache_bits < count)
+      return no_more_bits(bitdata);
+  }
+  *bits = (uint32_t)(bitdata->cache >> (64 - count));
+  consume_bits(bitdata, count);
   return 0;
 }
 
@@ -150,22 +284,45 @@ int read_bits(bitdata_p bitdata, int count, uint32_t *bits) {
  * Returns 0 if all went well, 1 if there were not enough bits in the data.
  */
 int read_bits_into_byte(bitdata_p bitdata, int count, byte *bits) {
-  int index = 0;
-  byte result = 0;
+  uint32_t result;
+  int err;
 
   assert((count >= 0 && count <= 8));
 
-  for (index = 0; index < count; index++) {
-    int bit = next_bit(bitdata);
-    if (bit < 0)
-      return 1;
-    else
-      result = (result << 1) | bit;
-  }
-  *bits = result;
+  err = read_bits(bitdata, count, &result);
+  if (err)
+    return err;
+  *bits = (byte)result;
   return 0;
 }
 
+/*
+ * Read zero bits, counting them, up to and including the first non-zero bit.
+ *
+ * - `count` is returned as the number of zero bits.
+ *
+ * Returns 0 if all went well, 1 if we ran out of data before finding a
+ * non-zero bit.
+ */
+static inline int read_zero_bits(bitdata_p bitdata, int *count) {
+  *count = 0;
+  for (;;) {
+    int zeros;
+    refill_bitdata(bitdata);
+    if (bitdata->cache_bits == 0)
+      return no_more_bits(bitdata);
+    // Bits below those in the cache are always zero
+    zeros = (bitdata->cache == 0 ? 64 : leading_zeros64(bitdata->cache));
+    if (zeros < bitdata->cache_bits) {
+      *count += zeros;
+      consume_bits(bitdata, zeros + 1);
+      return 0;
+    }
+    *count += bitdata->cache_bits;
+    consume_bits(bitdata, bitdata->cache_bits);
+  }
+}
+
 /*
  * Read zero bits, counting them. Stop at the first non-zero bit.
  *
@@ -174,9 +331,8 @@ int read_bits_into_byte(bitdata_p bitdata, int count, byte *bits) {
  * thereafter.
  */
 int count_zero_bits(bitdata_p bitdata) {
-  int count = 0;
-  while (next_bit(bitdata) == 0)
-    count++;
+  int count;
+  (void)read_zero_bits(bitdata, &count);
   return count;
 }
 
@@ -189,14 +345,37 @@ int count_zero_bits(bitdata_p bitdata) {
  */
 int read_exp_golomb(bitdata_p bitdata, uint32_t *result) {
   uint32_t next = 0;
-  int leading_zero_bits = count_zero_bits(bitdata);
-  int err = read_bits(bitdata, leading_zero_bits, &next);
+  int leading_zero_bits;
+  int err;
+
+  // The common case is a short code that is entirely within the cache,
+  // in which case we can find its length and value at once
+  if (bitdata->cache_bits < 32)
+    refill_bitdata(bitdata);
+  if (bitdata->cache != 0) {
+    leading_zero_bits = leading_zeros64(bitdata->cache);
+    if (2 * leading_zero_bits + 1 <= bitdata->cache_bits &&
+        leading_zero_bits < 32) {
+      int length = 2 * leading_zero_bits + 1;
+      *result = (uint32_t)((bitdata->cache >> (64 - length)) - 1);
+      consume_bits(bitdata, length);
+      return 0;
+    }
+  }
+
+  err = read_zero_bits(bitdata, &leading_zero_bits);
+  if (!err) {
+    if (leading_zero_bits > 32)
+      err = 1;
+    else
+      err = read_bits(bitdata, leading_zero_bits, &next);
+  }
   if (err) {
     fprint_err("### Unable to read ExpGolomb value - not enough bits (%d)\n",
                leading_zero_bits);
     return err;
   }
-  *result = (int)(pow(2, leading_zero_bits) - 1 + next);
+  *result = (uint32_t)((1ULL << leading_zero_bits) - 1 + next);
   return 0;
 }
 
@@ -214,6 +393,10 @@ int read_signed_exp_golomb(bitdata_p bitdata, int32_t *result) {
     print_err("### Unable to read signed ExpGolomb value\n");
     return err;
   }
-  *result = (int)(pow(-1, (val + 1)) * ceil(val / 2.0));
+  // Odd values are positive, even values negative
+  if (val & 1)
+    *result = (int32_t)((val + 1) / 2);
+  else
+    *result = -(int32_t)(val / 2);
   return 0;
 }
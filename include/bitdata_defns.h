@@ -34,11 +34,22 @@
 
 #include "compat.h"
 
+// Bits are read through a 64-bit cache word, which holds the next
+// `cache_bits` bits to be read, most significant bit first (any bits
+// below those are zero). It is refilled from `data` a byte at a time
+// (or eight bytes at a time, when there is room).
+//
+// If `escaped` is true, then `data` still contains H.264 emulation
+// prevention bytes (the 03 in 00 00 03), and these are dropped as the
+// cache is refilled, so that the bits read are those of the RBSP.
 struct bitdata {
-  byte *data;   // The data we're reading from
-  int data_len; // It's length
-  int cur_byte; // Which byte our current bit is in
-  int cur_bit;  // Which bit within that byte
+  byte *data;     // The data we're reading from
+  int data_len;   // It's length
+  int cur_byte;   // The next byte to be loaded into the cache
+  uint64_t cache; // The next bits to be read
+  int cache_bits; // How many bits are in the cache
+  int escaped;    // Are we dropping emulation prevention bytes?
+  int zeros;      // If so, how many 00 bytes we've just loaded
 };
 typedef struct bitdata *bitdata_p;
 #define SIZEOF_BITDATA sizeof(struct bitdata)
@@ -51,6 +51,37 @@ int build_bitdata(bitdata_p *bitdata, byte data[], int data_len);
  */
 void free_bitdata(bitdata_p *bitdata);
 
+/*
+ * Set up an existing bitdata datastructure to read from a byte array.
+ *
+ * This is for a bitdata datastructure that the caller owns (for instance,
+ * one that is reused for each NAL unit), and so must not be freed with
+ * `free_bitdata()`.
+ *
+ * - `data` is the byte array we're extracting bits from.
+ * - `data_len` is its length (in bytes).
+ * - if `escaped` is true, then `data` may contain emulation prevention
+ *   bytes (00 00 03), and the 03 bytes will be skipped over as we go,
+ *   so that there is no need to remove them from the whole array first.
+ */
+void setup_bitdata(bitdata_p bitdata, byte data[], int data_len,
+                   int escaped);
+
+/*
+ * Look at the next `count` bits (0..32) in the data, without reading them.
+ *
+ * Returns 0 if all went well, 1 if there were not enough bits in the data
+ * (in which case nothing is reported).
+ */
+int peek_bits(bitdata_p bitdata, int count, uint32_t *bits);
+
+/*
+ * Skip over the next `count` bits (0..32) in the data.
+ *
+ * Returns 0 if all went well, 1 if there were not enough bits in the data.
+ */
+int skip_bits(bitdata_p bitdata, int count);
+
 /*
  * Return the next bit from the data.
  *
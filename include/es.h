@@ -32,6 +32,8 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "compat.h"
@@ -149,6 +151,11 @@ int build_elementary_stream_file(int input, ES_p *es) {
   new2->reading_ES = true;
   new2->input = input;
   new2->reader = nullptr;
+  new2->unit_views = false;
+  new2->window = nullptr;
+  new2->window_size = 0;
+  new2->mapped = nullptr;
+  new2->mapped_len = 0;
 
   setup_readahead(new2);
 
@@ -179,6 +186,11 @@ int build_elementary_stream_PES(PES_reader_p reader, ES_p *es) {
   new2->reading_ES = false;
   new2->input = -1;
   new2->reader = reader;
+  new2->unit_views = false;
+  new2->window = nullptr;
+  new2->window_size = 0;
+  new2->mapped = nullptr;
+  new2->mapped_len = 0;
 
   setup_readahead(new2);
 
@@ -200,6 +212,10 @@ int build_elementary_stream_PES(PES_reader_p reader, ES_p *es) {
  */
 void free_elementary_stream(ES_p *es) {
   (*es)->input = -1; // "forget" our input
+  if ((*es)->window != nullptr)
+    free((*es)->window);
+  if ((*es)->mapped != nullptr)
+    (void)munmap((*es)->mapped, (*es)->mapped_len);
   free(*es);
   *es = nullptr;
 }
@@ -247,6 +263,114 @@ int es_command_changed(ES_p es) {
   return tswrite_command_changed(es->reader->tswriter);
 }
 
+/*
+ * Ask an elementary stream to return ES units as views into its own data,
+ * rather than copying each unit's data into the unit's own buffer.
+ *
+ * After this, the `data` of an ES unit found by `find_next_ES_unit()` (or
+ * `find_and_build_next_ES_unit()`) is only valid until the next ES unit is
+ * read from `es`, or `es` is seeked. A caller that wants to keep an ES unit
+ * for longer must call `keep_ES_unit_data()` on it first. Appending an ES
+ * unit to an ES unit list always takes a copy of its data, as before.
+ *
+ * Units whose data does not lie entirely within one PES packet (or, for
+ * "bare" ES data, within our read window) are still copied.
+ *
+ * Returns 0 if all goes well, 1 if something goes wrong.
+ */
+int use_ES_unit_views(ES_p es) {
+  if (es->unit_views)
+    return 0;
+
+  es->unit_views = true;
+  if (es->mapped != nullptr)
+    return 0; // all of our data is in the mapping already
+
+  // For PES data, the views are into each PES packet's ES data. For "bare"
+  // ES data, our read-ahead buffer is too small to hold most units, so swap
+  // it for a much larger window, taking whatever we have not yet read with us
+  if (es->reading_ES) {
+    int32_t left = 0;
+    es->window = (byte *)malloc(ES_VIEW_WINDOW_SIZE);
+    if (es->window == nullptr) {
+      print_err("### Unable to allocate ES read window\n");
+      es->unit_views = false;
+      return 1;
+    }
+    es->window_size = ES_VIEW_WINDOW_SIZE;
+    if (es->data_ptr != nullptr) {
+      left = es->data_end - es->data_ptr;
+      memcpy(es->window, es->data_ptr, left);
+      es->read_ahead_posn += es->data_ptr - es->data;
+    }
+    es->read_ahead_len = left;
+    es->data = es->data_ptr = es->window;
+    es->data_end = es->window + left;
+  }
+  return 0;
+}
+
+/*
+ * Memory map the file an elementary stream is reading "bare" ES data from,
+ * so that all of its data is addressable at once, rather than being read
+ * into our read-ahead buffer a bit at a time.
+ *
+ * This means that seeking (`seek_ES()`) no longer needs to seek the file,
+ * and `get_ES_data()` can return a pointer into the mapping, rather than
+ * reading the data again - which is what reversing does for each picture.
+ *
+ * If the elementary stream is reading PES data, or standard input (or a
+ * pipe), or the mapping fails for some other reason, then it is left to
+ * carry on using read() as normal.
+ *
+ * The mapping is private and writable, so ES unit data may still be altered
+ * in place by the caller (without changing the file).
+ *
+ * Returns 0 if the file was mapped, 1 if it was not.
+ */
+int map_elementary_stream(ES_p es) {
+  struct stat info;
+  void *addr;
+  offset_t posn;
+
+  if (es->mapped != nullptr)
+    return 0;
+  if (!es->reading_ES || es->input == -1 || es->input == STDIN_FILENO)
+    return 1;
+
+  if (fstat(es->input, &info) == -1 || !S_ISREG(info.st_mode) ||
+      info.st_size == 0)
+    return 1;
+
+  addr = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+              es->input, 0);
+  if (addr == MAP_FAILED)
+    return 1;
+  (void)madvise(addr, info.st_size, MADV_SEQUENTIAL);
+
+  // Work out where the next byte we would have read is, and carry on from
+  // there in the mapping
+  posn = es->read_ahead_posn;
+  if (es->data_ptr != nullptr)
+    posn += es->data_ptr - es->data;
+
+  es->mapped = (byte *)addr;
+  es->mapped_len = info.st_size;
+  es->read_ahead_posn = 0;
+  es->read_ahead_len = info.st_size;
+  es->data = es->mapped;
+  es->data_ptr = es->mapped + posn;
+  es->data_end = es->mapped + es->mapped_len;
+
+  // Any (view) window we had is no longer needed
+  if (es->window != nullptr) {
+    free(es->window);
+    es->window = nullptr;
+    es->window_size = 0;
+  }
+  return 0;
+}
+
 // ------------------------------------------------------------
 // Handling elementary stream data units
 // ------------------------------------------------------------
@@ -258,11 +382,12 @@ int es_command_changed(ES_p es) {
  * Returns 0 if it succeeds, 1 if some error occurs.
  */
 int setup_ES_unit(ES_unit_p unit) {
-  unit->data = (byte *)malloc(ES_UNIT_DATA_START_SIZE);
-  if (unit->data == nullptr) {
+  unit->buffer = (byte *)malloc(ES_UNIT_DATA_START_SIZE);
+  if (unit->buffer == nullptr) {
     print_err("### Unable to allocate ES unit data buffer\n");
     return 1;
   }
+  unit->data = unit->buffer;
   unit->data_len = 0;
   unit->data_size = ES_UNIT_DATA_START_SIZE;
   unit->start_posn.infile = 0;
@@ -278,12 +403,12 @@ int setup_ES_unit(ES_unit_p unit) {
  * (Frees the internal data array, and unsets the counts)
  */
 void clear_ES_unit(ES_unit_p unit) {
-  if (unit->data != nullptr) {
-    free(unit->data);
-    unit->data = nullptr;
-    unit->data_size = 0;
-    unit->data_len = 0;
-  }
+  if (unit->buffer != nullptr)
+    free(unit->buffer);
+  unit->buffer = nullptr;
+  unit->data = nullptr;
+  unit->data_size = 0;
+  unit->data_len = 0;
 }
 
 /*
@@ -321,7 +446,7 @@ int build_ES_unit_from_data(ES_unit_p *unit, byte *data, uint32_t data_len) {
     print_err("### Unable to allocate ES unit datastructure\n");
     return 1;
   }
-  new2->data = (byte *)malloc(data_len);
+  new2->data = new2->buffer = (byte *)malloc(data_len);
   if (new2->data == nullptr) {
     print_err("### Unable to allocate ES unit data buffer\n");
     return 1;
@@ -352,6 +477,51 @@ void free_ES_unit(ES_unit_p *unit) {
   *unit = nullptr;
 }
 
+/*
+ * Make sure that the unit's own buffer can hold `size` bytes.
+ *
+ * Any data already in the buffer is retained, but note that if `data` is
+ * a view, it is left pointing at the view.
+ *
+ * Returns 0 if it succeeds, 1 if some error occurs.
+ */
+static inline int ensure_ES_unit_buffer(ES_unit_p unit, uint32_t size) {
+  byte *newbuf;
+  uint32_t newsize;
+  int is_view = (unit->data != unit->buffer);
+  if (size <= unit->data_size)
+    return 0;
+  newsize = max(max(size, unit->data_size * 2), ES_UNIT_DATA_START_SIZE);
+  newbuf = (byte *)realloc(unit->buffer, newsize);
+  if (newbuf == nullptr) {
+    print_err("### Unable to extend ES unit data array\n");
+    return 1;
+  }
+  unit->buffer = newbuf;
+  unit->data_size = newsize;
+  if (!is_view)
+    unit->data = newbuf;
+  return 0;
+}
+
+/*
+ * Make sure that an ES unit's data is held in its own buffer, so that it
+ * remains valid after the next ES unit is read.
+ *
+ * Does nothing if the data is already in the ES unit's own buffer.
+ *
+ * Returns 0 if it succeeds, 1 if some error occurs.
+ */
+int keep_ES_unit_data(ES_unit_p unit) {
+  if (unit->data == unit->buffer)
+    return 0;
+  if (ensure_ES_unit_buffer(unit, unit->data_len))
+    return 1;
+  memcpy(unit->buffer, unit->data, unit->data_len);
+  unit->data = unit->buffer;
+  return 0;
+}
+
 /*
  * Print out some information this ES unit, on normal or error output
  */
@@ -416,6 +586,45 @@ static inline int get_next_pes_packet(ES_p es) {
   return 0;
 }
 
+/*
+ * Read some more "bare" ES data into our (view) window.
+ *
+ * - `keep` is nullptr if none of the current data need be kept, or else
+ *   the first byte that must be kept. That byte, and those after it, are
+ *   moved to the start of the window (so `keep` becomes `es->data`), and
+ *   new data is read in after them. There must be room for at least some
+ *   new data.
+ *
+ * Returns 0 if it succeeds, EOF if the end-of-file is read, otherwise
+ * 1 if some error occurs. At EOF, `es->data_ptr` is left at `es->data_end`.
+ */
+static int get_more_window_data(ES_p es, byte *keep) {
+  int32_t kept = 0;
+  ssize_t len;
+
+  if (keep == nullptr) {
+    es->read_ahead_posn += es->read_ahead_len; // length of the *last* buffer
+  } else {
+    kept = es->data_end - keep;
+    es->read_ahead_posn += keep - es->data;
+    memmove(es->window, keep, kept);
+  }
+  es->read_ahead_len = kept;
+  es->data = es->window;
+  es->data_ptr = es->data_end = es->window + kept;
+
+  len = read(es->input, es->data_end, es->window_size - kept);
+  if (len == 0)
+    return EOF;
+  else if (len == -1) {
+    fprint_err("### Error reading next bytes: %s\n", strerror(errno));
+    return 1;
+  }
+  es->read_ahead_len += len;
+  es->data_end += len;
+  return 0;
+}
+
 /*
  * Read some more data into our read-ahead buffer. For a "bare" file,
  * reads the next buffer-full in, and for PES based data, reads the
@@ -425,7 +634,11 @@ static inline int get_next_pes_packet(ES_p es) {
  * 1 if some error occurs.
  */
 static inline int get_more_data(ES_p es) {
-  if (es->reading_ES) {
+  if (es->mapped != nullptr) {
+    return EOF; // we already have all of the file's data
+  } else if (es->window != nullptr) {
+    return get_more_window_data(es, nullptr);
+  } else if (es->reading_ES) {
     // Call `read` directly - we don't particularly mind if we get a "short"
     // read, since we'll just catch up later on
     ssize_t len = read(es->input, &es->read_ahead, ES_READ_AHEAD_SIZE);
@@ -446,6 +659,42 @@ static inline int get_more_data(ES_p es) {
   }
 }
 
+/*
+ * Find the end of the next 00 00 01 start code prefix in our current data.
+ *
+ * - `from` is the first byte to look at, and `end` is one beyond the last
+ * - `prev2` and `prev1` are the two bytes before `from` (which may have
+ *   been in the previous buffer or PES packet), so that a prefix split
+ *   over that boundary is still found.
+ *
+ * Returns a pointer to the 01 of the prefix, or `end` if there is none.
+ */
+static inline byte *find_start_code_end(byte *from, byte *end, byte prev2,
+                                        byte prev1) {
+  int offset;
+  if (from < end && prev2 == 0x00 && prev1 == 0x00 && from[0] == 0x01)
+    return from;
+  if (from + 1 < end && prev1 == 0x00 && from[0] == 0x00 && from[1] == 0x01)
+    return from + 1;
+  offset = find_start_code_prefix(from, end - from);
+  return (offset < 0 ? end : from + offset + 2);
+}
+
+/*
+ * Work out the two bytes before `end`, having looked at the bytes from
+ * `from` onwards, given the two bytes that came before `from`.
+ */
+static inline void last_two_bytes(byte *from, byte *end, byte *prev2,
+                                  byte *prev1) {
+  if (end - from >= 2) {
+    *prev2 = end[-2];
+    *prev1 = end[-1];
+  } else if (end - from == 1) {
+    *prev2 = *prev1;
+    *prev1 = end[-1];
+  }
+}
+
 /*
  * Find the start of the next ES unit - i.e., a 00 00 01 start code prefix.
  *
@@ -467,33 +716,40 @@ static int find_ES_unit_start(ES_p es, ES_unit_p unit) {
   // a previous call to find_ES_unit_end will already have positioned us
   // "over" the start of the next unit
   for (;;) {
-    byte *ptr;
-    for (ptr = es->data_ptr; ptr < es->data_end; ptr++) {
-      if (prev2 == 0x00 && prev1 == 0x00 && *ptr == 0x01) {
-        es->prev1_byte = es->prev2_byte = 0x00;
-        es->cur_byte = 0x01;
-        if (es->reading_ES) {
-          unit->start_posn.infile = es->read_ahead_posn + (ptr - es->data) - 2;
-        } else {
-          unit->start_posn.infile = es->reader->packet->posn;
-          unit->start_posn.inpacket = (ptr - es->data) - 2;
-          if (unit->start_posn.inpacket < 0) {
-            unit->start_posn.infile = es->last_packet_posn;
-            unit->start_posn.inpacket += es->last_packet_es_data_len;
-          }
-          // Does the PES packet that we are starting in have a PTS?
-          unit->PES_had_PTS = es->reader->packet->has_PTS;
+    byte *ptr = find_start_code_end(es->data_ptr, es->data_end, prev2, prev1);
+    if (ptr < es->data_end) {
+      es->prev1_byte = es->prev2_byte = 0x00;
+      es->cur_byte = 0x01;
+      if (es->reading_ES) {
+        unit->start_posn.infile = es->read_ahead_posn + (ptr - es->data) - 2;
+      } else {
+        unit->start_posn.infile = es->reader->packet->posn;
+        unit->start_posn.inpacket = (ptr - es->data) - 2;
+        if (unit->start_posn.inpacket < 0) {
+          unit->start_posn.infile = es->last_packet_posn;
+          unit->start_posn.inpacket += es->last_packet_es_data_len;
         }
-        es->data_ptr = ptr + 1; // the *next* byte to read
-        unit->data[0] = 0x00;   // i.e., the values we just read
-        unit->data[1] = 0x00;
-        unit->data[2] = 0x01;
-        unit->data_len = 3;
+        // Does the PES packet that we are starting in have a PTS?
+        unit->PES_had_PTS = es->reader->packet->has_PTS;
+      }
+      es->data_ptr = ptr + 1; // the *next* byte to read
+      unit->data_len = 3;
+      if (es->unit_views && ptr - 2 >= es->data) {
+        // The whole start code prefix is in our current data, so we can
+        // start a view on it
+        unit->data = ptr - 2;
         return 0;
       }
-      prev2 = prev1;
-      prev1 = *ptr;
+      // Otherwise, we must use our own buffer
+      unit->data = unit->buffer;
+      if (ensure_ES_unit_buffer(unit, 3))
+        return 1;
+      unit->data[0] = 0x00; // i.e., the values we just read
+      unit->data[1] = 0x00;
+      unit->data[2] = 0x01;
+      return 0;
     }
+    last_two_bytes(es->data_ptr, es->data_end, &prev2, &prev1);
 
     // We've run out of data - get some more
     err = get_more_data(es);
@@ -534,49 +790,59 @@ static int find_ES_unit_end(ES_p es, ES_unit_p unit) {
   byte prev1 = es->cur_byte;
   byte prev2 = es->prev1_byte;
   for (;;) {
-    byte *ptr;
-    for (ptr = es->data_ptr; ptr < es->data_end; ptr++) {
-      // Have we reached the end of our unit?
-      // We know we are if we've found the next 00 00 01 start code prefix.
-      // (as stated in the header comment above, we're ignoring the H.264
-      // ability to end if we've found a 00 00 00 sequence)
-      if (prev2 == 0x00 && prev1 == 0x00 && *ptr == 0x01) {
-        es->data_ptr = ptr;    // remember where we've got to
-        es->prev2_byte = 0x00; // we know prev1_byte is already 0
-        es->cur_byte = 0x01;
-        // We've read two 00 bytes we don't need into our data buffer...
-        unit->data_len -= 2;
-
-        if (es->reading_ES) {
-          es->posn_of_next_byte.infile =
-              es->read_ahead_posn + (ptr - es->data) - 2;
-        } else {
-          es->posn_of_next_byte.infile = es->reader->packet->posn;
-          es->posn_of_next_byte.inpacket = (ptr - es->data) - 2;
-        }
-        return 0;
-      }
+    // Have we reached the end of our unit?
+    // We know we are if we've found the next 00 00 01 start code prefix.
+    // (as stated in the header comment above, we're ignoring the H.264
+    // ability to end if we've found a 00 00 00 sequence)
+    byte *ptr = find_start_code_end(es->data_ptr, es->data_end, prev2, prev1);
+
+    // Everything before that is data. If we're a view, it's already in
+    // place, and otherwise we copy it all at once
+    int32_t len = ptr - es->data_ptr;
+    int is_view = (unit->data != unit->buffer);
+    if (len > 0 && !is_view) {
+      if (ensure_ES_unit_buffer(unit, unit->data_len + len))
+        return 1;
+      memcpy(&unit->data[unit->data_len], es->data_ptr, len);
+    }
+    unit->data_len += len;
 
-      // Otherwise, it's a data byte
-      if (unit->data_len == unit->data_size) {
-        int newsize = unit->data_size + ES_UNIT_DATA_INCREMENT;
-        unit->data = (byte *)realloc(unit->data, newsize);
-        if (unit->data == nullptr) {
-          print_err("### Unable to extend ES unit data array\n");
-          return 1;
-        }
-        unit->data_size = newsize;
-      }
-      unit->data[unit->data_len++] = *ptr;
+    if (ptr < es->data_end) {
+      es->data_ptr = ptr;    // remember where we've got to
+      es->prev2_byte = 0x00; // we know prev1_byte is already 0
+      es->cur_byte = 0x01;
+      // We've read two 00 bytes we don't need into our data buffer...
+      unit->data_len -= 2;
 
-      prev2 = prev1;
-      prev1 = *ptr;
+      if (es->reading_ES) {
+        es->posn_of_next_byte.infile =
+            es->read_ahead_posn + (ptr - es->data) - 2;
+      } else {
+        es->posn_of_next_byte.infile = es->reader->packet->posn;
+        es->posn_of_next_byte.inpacket = (ptr - es->data) - 2;
+      }
+      return 0;
     }
+    last_two_bytes(es->data_ptr, es->data_end, &prev2, &prev1);
 
     // We've run out of data (ptr == es->data_end) - get some more
-    err = get_more_data(es);
+    if (!is_view || es->mapped != nullptr) {
+      err = get_more_data(es);
+    } else if (es->window != nullptr &&
+               unit->data_len <= (uint32_t)es->window_size / 2) {
+      // Keep our view in the window, and read more in after it
+      err = get_more_window_data(es, unit->data);
+      unit->data = es->data;
+    } else {
+      // Our view cannot outlast the current data, so copy it before
+      // carrying on as normal
+      if (keep_ES_unit_data(unit))
+        return 1;
+      err = get_more_data(es);
+    }
     if (err == EOF) {
       // Reaching the end of file is a legitimate way of stopping!
+      ptr = es->data_end;
       es->data_ptr = ptr; // remember where we've got to
       es->prev2_byte = prev2;
       es->prev1_byte = prev1;
@@ -652,9 +918,25 @@ int find_next_ES_unit(ES_p es, ES_unit_p unit) {
 int find_and_build_next_ES_unit(ES_p es, ES_unit_p *unit) {
   int err;
 
-  err = build_ES_unit(unit);
-  if (err)
-    return 1;
+  if (es->unit_views) {
+    // Most units will not need a buffer of their own, so don't give them one
+    // until they do
+    ES_unit_p new2 = (ES_unit_p)malloc(SIZEOF_ES_UNIT);
+    if (new2 == nullptr) {
+      print_err("### Unable to allocate ES unit datastructure\n");
+      return 1;
+    }
+    new2->data = new2->buffer = nullptr;
+    new2->data_len = new2->data_size = 0;
+    new2->start_posn.infile = 0;
+    new2->start_posn.inpacket = 0;
+    new2->PES_had_PTS = false; // See the header file
+    *unit = new2;
+  } else {
+    err = build_ES_unit(unit);
+    if (err)
+      return 1;
+  }
 
   err = find_next_ES_unit(es, *unit);
   if (err) {
@@ -709,7 +991,7 @@ static int seek_in_PES(ES_p es, ES_offset where) {
 
   // Force the reader to forget its current packet
   if (es->reader->packet != nullptr)
-    free_PES_packet_data(&es->reader->packet);
+    release_PES_packet_data(es->reader, &es->reader->packet);
 
   // Seek to the right packet in the PES data
   err = set_PES_reader_position(es->reader, where.infile);
@@ -747,7 +1029,10 @@ static inline void deduce_correct_position(ES_p es) {
   es->prev1_byte = 0xff;
   es->prev2_byte = 0xff;
 
-  if (es->reading_ES) {
+  if (es->mapped != nullptr) {
+    // For mapped ES data, we already have the data, so just point at it
+    es->data_ptr = es->mapped + es->posn_of_next_byte.infile;
+  } else if (es->reading_ES) {
     // For ES data, we want to force new data to be read in from the file
     es->data_ptr = es->data_end = nullptr;
     es->read_ahead_len = 0; // to stop the read ahead posn being incremented
@@ -775,7 +1060,14 @@ static inline void deduce_correct_position(ES_p es) {
  */
 int seek_ES(ES_p es, ES_offset where) {
   int err;
-  if (es->reading_ES) {
+  if (es->mapped != nullptr) {
+    if (where.infile < 0 || where.infile > es->mapped_len) {
+      fprint_err("### Error seeking within ES file: offset " OFFSET_T_FORMAT
+                 " is outside the file\n",
+                 where.infile);
+      return 1;
+    }
+  } else if (es->reading_ES) {
     err = seek_file(es->input, where.infile);
     if (err) {
       print_err("### Error seeking within ES file\n");
@@ -880,7 +1172,14 @@ int read_ES_data(ES_p es, ES_offset start_posn, uint32_t num_bytes,
   err = seek_ES(es, start_posn);
   if (err)
     return err;
-  if (es->reading_ES) {
+  if (es->mapped != nullptr) {
+    if (num_bytes > es->mapped_len - start_posn.infile) {
+      fprint_err("### Error (EOF) reading %d bytes\n", num_bytes);
+      return 1;
+    }
+    memcpy(*data, es->mapped + start_posn.infile, num_bytes);
+    es->posn_of_next_byte.infile = start_posn.infile + num_bytes;
+  } else if (es->reading_ES) {
     err = read_bytes(es->input, num_bytes, *data);
     if (err) {
       if (err == EOF) {
@@ -911,6 +1210,47 @@ int read_ES_data(ES_p es, ES_offset start_posn, uint32_t num_bytes,
   return 0;
 }
 
+/*
+ * Find some ES data, as `read_ES_data()`, but without copying it if we can
+ * avoid it.
+ *
+ * If the elementary stream is memory mapped (see `map_elementary_stream()`),
+ * then `data` is returned pointing directly into the mapping, and `buffer`
+ * is not touched. Otherwise, the data is read into `buffer` by
+ * `read_ES_data()` (which see for the meaning of `data_len` and `buffer`),
+ * and `data` is returned as `buffer`.
+ *
+ * Either way, `data` is only valid until `buffer` is next used, or the
+ * elementary stream is freed, and it is up to the caller to free `buffer`
+ * (which may still be nullptr) when it is no longer needed.
+ *
+ * Returns 0 if all went well, 1 if something went wrong.
+ */
+int get_ES_data(ES_p es, ES_offset start_posn, uint32_t num_bytes,
+                uint32_t *data_len, byte **buffer, byte **data) {
+  int err;
+  if (es->mapped == nullptr) {
+    err = read_ES_data(es, start_posn, num_bytes, data_len, buffer);
+    if (err)
+      return err;
+    *data = *buffer;
+    return 0;
+  }
+
+  err = seek_ES(es, start_posn);
+  if (err)
+    return err;
+  if (num_bytes > es->mapped_len - start_posn.infile) {
+    fprint_err("### Error (EOF) reading %d bytes\n", num_bytes);
+    return 1;
+  }
+  *data = es->mapped + start_posn.infile;
+  // And leave ourselves as if we'd read it, as `read_ES_data()` does
+  es->posn_of_next_byte.infile = start_posn.infile + num_bytes;
+  deduce_correct_position(es);
+  return 0;
+}
+
 /*
  * Retrieve ES data from the end of a PES packet. It is assumed (i.e, things
  * will go wrong if it is not true) that at least one ES unit has been read
@@ -1036,7 +1376,7 @@ int append_to_ES_unit_list(ES_unit_list_p list, ES_unit_p unit) {
   // Some things can be copied directly
   *ptr = *unit;
   // But some need adjusting
-  ptr->data = (byte *)malloc(unit->data_len);
+  ptr->data = ptr->buffer = (byte *)malloc(unit->data_len);
   if (ptr->data == nullptr) {
     print_err("### Unable to copy ES unit data array\n");
     return 1;
@@ -50,6 +50,11 @@ typedef struct _ES_offset *ES_offset_p;
 // elementary stream
 #define ES_READ_AHEAD_SIZE 1000
 
+// When ES units are being returned as views (see `use_ES_unit_views`), the
+// size of the (much larger) window we read "bare" ES data into instead, so
+// that most units lie entirely within it
+#define ES_VIEW_WINDOW_SIZE (4 * 1024 * 1024)
+
 // ------------------------------------------------------------
 // A datastructure to represent our input elementary stream (ES)
 // (*output* elementary streams shouldn't need any particular housekeeping)
@@ -88,6 +93,19 @@ struct elementary_stream {
   byte cur_byte;   // The current (last read) byte
   byte prev1_byte; // The previous byte
   byte prev2_byte; // The byte before *that*
+
+  // If true, ES units are returned as views into our data, rather than
+  // being copied (see `use_ES_unit_views`). For "bare" ES data, we then
+  // read into `window`, rather than `read_ahead`.
+  int unit_views;
+  byte *window;
+  int32_t window_size;
+
+  // If we're reading "bare" ES data from a regular file, it may instead be
+  // memory mapped (see `map_elementary_stream`), in which case `data` is
+  // the whole mapping, and neither `read_ahead` nor `window` is used.
+  byte *mapped;        // the start of the mapped file, or nullptr
+  offset_t mapped_len; // the length of the mapping
 };
 typedef struct elementary_stream *ES_p;
 #define SIZEOF_ES sizeof(struct elementary_stream)
@@ -105,10 +123,17 @@ typedef struct elementary_stream *ES_p;
 // correctly with `setup_ES_unit()` before it is passed to any of the
 // functions that use it, otherwise the contents will not be valid (and,
 // particularly, the "data" pointer will reference random memory).
+//
+// Normally `data` is the unit's own `buffer`. If the elementary stream is
+// returning views (see `use_ES_unit_views()`), then `data` may instead point
+// into the elementary stream's own data, in which case it is only valid until
+// the next ES unit is read (or the stream is seeked). `keep_ES_unit_data()`
+// copies such data into `buffer`, so that it can be kept.
 struct ES_unit {
   ES_offset start_posn; // The start of the current data unit
   byte *data;           // Its data, including the leading 00 00 01
   uint32_t data_len;    // Its length
+  byte *buffer;         // Our own buffer, which `data` normally points to
   uint32_t data_size;   // The total buffer size
 
   byte start_code; // The byte after the 00 00 01 prefix
@@ -123,6 +123,43 @@ void close_elementary_stream(ES_p *es);
  */
 int es_command_changed(ES_p es);
 
+/*
+ * Ask an elementary stream to return ES units as views into its own data,
+ * rather than copying each unit's data into the unit's own buffer.
+ *
+ * After this, the `data` of an ES unit found by `find_next_ES_unit()` (or
+ * `find_and_build_next_ES_unit()`) is only valid until the next ES unit is
+ * read from `es`, or `es` is seeked. A caller that wants to keep an ES unit
+ * for longer must call `keep_ES_unit_data()` on it first. Appending an ES
+ * unit to an ES unit list always takes a copy of its data, as before.
+ *
+ * Units whose data does not lie entirely within one PES packet (or, for
+ * "bare" ES data, within our read window) are still copied.
+ *
+ * Returns 0 if all goes well, 1 if something goes wrong.
+ */
+int use_ES_unit_views(ES_p es);
+
+/*
+ * Memory map the file an elementary stream is reading "bare" ES data from,
+ * so that all of its data is addressable at once, rather than being read
+ * into our read-ahead buffer a bit at a time.
+ *
+ * This means that seeking (`seek_ES()`) no longer needs to seek the file,
+ * and `get_ES_data()` can return a pointer into the mapping, rather than
+ * reading the data again - which is what reversing does for each picture.
+ *
+ * If the elementary stream is reading PES data, or standard input (or a
+ * pipe), or the mapping fails for some other reason, then it is left to
+ * carry on using read() as normal.
+ *
+ * The mapping is private and writable, so ES unit data may still be altered
+ * in place by the caller (without changing the file).
+ *
+ * Returns 0 if the file was mapped, 1 if it was not.
+ */
+int map_elementary_stream(ES_p es);
+
 // ============================================================
 // Elementary stream functions - item/unit reading
 // ============================================================
@@ -168,6 +205,16 @@ int build_ES_unit_from_data(ES_unit_p *unit, byte *data, uint32_t data_len);
  */
 void free_ES_unit(ES_unit_p *unit);
 
+/*
+ * Make sure that an ES unit's data is held in its own buffer, so that it
+ * remains valid after the next ES unit is read.
+ *
+ * Does nothing if the data is already in the ES unit's own buffer.
+ *
+ * Returns 0 if it succeeds, 1 if some error occurs.
+ */
+int keep_ES_unit_data(ES_unit_p unit);
+
 /*
  * Print out some information this ES unit, on normal or error output
  */
@@ -278,6 +325,25 @@ int seek_ES(ES_p es, ES_offset where);
 int read_ES_data(ES_p es, ES_offset start_posn, uint32_t num_bytes,
                  uint32_t *data_len, byte **data);
 
+/*
+ * Find some ES data, as `read_ES_data()`, but without copying it if we can
+ * avoid it.
+ *
+ * If the elementary stream is memory mapped (see `map_elementary_stream()`),
+ * then `data` is returned pointing directly into the mapping, and `buffer`
+ * is not touched. Otherwise, the data is read into `buffer` by
+ * `read_ES_data()` (which see for the meaning of `data_len` and `buffer`),
+ * and `data` is returned as `buffer`.
+ *
+ * Either way, `data` is only valid until `buffer` is next used, or the
+ * elementary stream is freed, and it is up to the caller to free `buffer`
+ * (which may still be nullptr) when it is no longer needed.
+ *
+ * Returns 0 if all went well, 1 if something went wrong.
+ */
+int get_ES_data(ES_p es, ES_offset start_posn, uint32_t num_bytes,
+                uint32_t *data_len, byte **buffer, byte **data);
+
 // ============================================================
 // Lists of ES units
 // ============================================================
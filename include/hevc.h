@@ -0,0 +1,990 @@
+#pragma once
+
+/*
+ * Datastructures and prototypes for reading H.265 (HEVC) elementary streams.
+ *
+ * ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is the MPEG TS, PS and ES tools.
+ *
+ * The Initial Developer of the Original Code is Amino Communications Ltd.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *   Amino Communications Ltd, Swavesey, Cambridge UK
+ *
+ * ***** END LICENSE BLOCK *****
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "bitdata_fns.h"
+#include "compat.h"
+#include "es_fns.h"
+#include "hevc_fns.h"
+#include "misc_fns.h"
+#include "printing_fns.h"
+#include "reverse_fns.h"
+#include "ts_fns.h"
+#include "tswrite_fns.h"
+
+// Unlike H.264, we never need to look inside an HEVC NAL unit further than
+// the first bit of its slice segment header. Access unit boundaries are
+// decided from the two byte NAL unit header (and first_slice_segment_in_pic_
+// flag), and IRAP pictures are recognised from their NAL unit type alone.
+// So everything here works directly on the ES units found by the start code
+// scanner, with no RBSP decoding at all.
+
+// ------------------------------------------------------------
+// NAL units
+// ------------------------------------------------------------
+/*
+ * Print out useful information about an HEVC NAL unit, on the given stream.
+ *
+ * This is intended as a single line of information.
+ */
+void report_hevc_nal_unit(int is_msg, ES_unit_p unit) {
+  int nal_unit_type;
+  if (unit->data_len < 5) {
+    fprint_msg_or_err(is_msg,
+                      OFFSET_T_FORMAT_08 "/%04d: HEVC NAL unit too short"
+                                         " (%d bytes)\n",
+                      unit->start_posn.infile, unit->start_posn.inpacket,
+                      unit->data_len);
+    return;
+  }
+  nal_unit_type = HEVC_NAL_UNIT_TYPE(unit);
+  fprint_msg_or_err(is_msg,
+                    OFFSET_T_FORMAT_08 "/%04d: NAL unit %02d (%s)"
+                                       " layer %d tid %d",
+                    unit->start_posn.infile, unit->start_posn.inpacket,
+                    nal_unit_type, HEVC_NAL_UNIT_TYPE_STR(nal_unit_type),
+                    HEVC_NUH_LAYER_ID(unit), HEVC_TEMPORAL_ID(unit));
+  if (is_hevc_VCL_nal_type(nal_unit_type) && unit->data_len > 5 &&
+      HEVC_FIRST_SLICE_SEGMENT_IN_PIC(unit))
+    fprint_msg_or_err(is_msg, " [first slice]");
+  fprint_msg_or_err(is_msg, " size %d\n", unit->data_len - 3);
+}
+
+/*
+ * Does this NAL unit (which follows a VCL NAL unit in the current access
+ * unit) start a new access unit? See H.265 7.4.2.4.4.
+ *
+ * We only consider the base layer, since a NAL unit with a non-zero
+ * nuh_layer_id cannot start an access unit.
+ */
+static inline int hevc_nal_unit_starts_access_unit(ES_unit_p unit,
+                                                   int nal_unit_type) {
+  if (HEVC_NUH_LAYER_ID(unit) != 0)
+    return false;
+  if (is_hevc_VCL_nal_type(nal_unit_type))
+    return unit->data_len > 5 && HEVC_FIRST_SLICE_SEGMENT_IN_PIC(unit);
+  return (nal_unit_type >= HEVC_NAL_VPS && nal_unit_type <= HEVC_NAL_AUD) ||
+         nal_unit_type == HEVC_NAL_PREFIX_SEI ||
+         (nal_unit_type >= 41 && nal_unit_type <= 44) ||
+         (nal_unit_type >= 48 && nal_unit_type <= 55);
+}
+
+/*
+ * Read the id of a parameter set NAL unit (VPS, SPS or PPS).
+ *
+ * For an SPS, this means skipping over its profile_tier_level() (H.265
+ * 7.3.3), whose size depends on the number of sub-layers.
+ *
+ * Returns 0 if it succeeds, 1 if the NAL unit is too short.
+ */
+static int read_hevc_param_set_id(ES_unit_p unit, int nal_unit_type,
+                                  uint32_t *id) {
+  struct bitdata bits;
+  uint32_t max_sub_layers_minus1, flags = 0;
+  int ii, err;
+
+  setup_bitdata(&bits, &unit->data[5], unit->data_len - 5, true);
+  if (nal_unit_type == HEVC_NAL_VPS)
+    return read_bits(&bits, 4, id);
+  if (nal_unit_type == HEVC_NAL_PPS)
+    return read_exp_golomb(&bits, id);
+
+  // sps_video_parameter_set_id, sps_max_sub_layers_minus1 and
+  // sps_temporal_id_nesting_flag
+  err = skip_bits(&bits, 4);
+  if (!err)
+    err = read_bits(&bits, 3, &max_sub_layers_minus1);
+  if (!err)
+    err = skip_bits(&bits, 1);
+  // The general profile, tier and level take 96 bits
+  for (ii = 0; ii < 3 && !err; ii++)
+    err = skip_bits(&bits, 32);
+  // Then there are two bits for each sub-layer, padded out to 16 bits
+  if (!err && max_sub_layers_minus1 > 0)
+    err = read_bits(&bits, 16, &flags);
+  for (ii = 0; ii < (int)max_sub_layers_minus1 && !err; ii++) {
+    // sub_layer_profile_present_flag means 88 bits of profile...
+    if (flags & (0x8000 >> (2 * ii)))
+      err = skip_bits(&bits, 32) || skip_bits(&bits, 32) ||
+            skip_bits(&bits, 24);
+    // ...and sub_layer_level_present_flag 8 bits of level
+    if (!err && (flags & (0x4000 >> (2 * ii))))
+      err = skip_bits(&bits, 8);
+  }
+  if (!err)
+    err = read_exp_golomb(&bits, id);
+  return err;
+}
+
+/*
+ * Remember a parameter set NAL unit, replacing any earlier one of the same
+ * kind with the same id (unless it has the same content).
+ *
+ * A parameter set whose id we cannot read, or which is out of range, is
+ * ignored with a warning.
+ *
+ * Returns 0 if it succeeds, 1 if some error occurs.
+ */
+static int remember_hevc_param_set(hevc_context_p context, ES_unit_p unit,
+                                   int nal_unit_type) {
+  ES_unit_p *slot;
+  uint32_t id;
+  int max_ids;
+
+  if (read_hevc_param_set_id(unit, nal_unit_type, &id)) {
+    fprint_err("!!! Ignoring %s without a readable id\n",
+               HEVC_NAL_UNIT_TYPE_STR(nal_unit_type));
+    return 0;
+  }
+  if (nal_unit_type == HEVC_NAL_VPS) {
+    slot = context->vps;
+    max_ids = HEVC_MAX_VPS_IDS;
+  } else if (nal_unit_type == HEVC_NAL_SPS) {
+    slot = context->sps;
+    max_ids = HEVC_MAX_SPS_IDS;
+  } else {
+    slot = context->pps;
+    max_ids = HEVC_MAX_PPS_IDS;
+  }
+  if (id >= (uint32_t)max_ids) {
+    fprint_err("!!! Ignoring %s with id %u, which is out of range (0..%d)\n",
+               HEVC_NAL_UNIT_TYPE_STR(nal_unit_type), id, max_ids - 1);
+    return 0;
+  }
+
+  slot = &slot[id];
+  if (*slot != nullptr) {
+    if ((*slot)->data_len == unit->data_len &&
+        !memcmp((*slot)->data, unit->data, unit->data_len))
+      return 0;
+    free_ES_unit(slot);
+  }
+  return build_ES_unit_from_data(slot, unit->data, unit->data_len);
+}
+
+// ------------------------------------------------------------
+// HEVC context
+// ------------------------------------------------------------
+/*
+ * Build a new HEVC access unit reading context.
+ *
+ * This acts as a "jacket" around the ES context, and is used when reading
+ * HEVC access units with get_next_hevc_access_unit().
+ *
+ * - `es` is the ES reading context to read from.
+ * - `context` is the new HEVC context.
+ *
+ * Returns 0 if it succeeds, 1 if some error occurs.
+ */
+int build_hevc_context(ES_p es, hevc_context_p *context) {
+  int err;
+  hevc_context_p new2 = (hevc_context_p)malloc(SIZEOF_HEVC_CONTEXT);
+  if (new2 == nullptr) {
+    print_err("### Unable to allocate HEVC context datastructure\n");
+    return 1;
+  }
+
+  err = build_ES_unit(&new2->unit);
+  if (err) {
+    free(new2);
+    return 1;
+  }
+
+  new2->es = es;
+  new2->count = 0;
+  new2->access_unit_index = 0;
+  new2->reverse_data = nullptr;
+  new2->pending = false;
+  new2->no_more_data = false;
+  new2->max_temporal_id = -1;
+  memset(new2->vps, 0, sizeof(new2->vps));
+  memset(new2->sps, 0, sizeof(new2->sps));
+  memset(new2->pps, 0, sizeof(new2->pps));
+
+  *context = new2;
+  return 0;
+}
+
+/*
+ * Free an HEVC context.
+ *
+ * Clears the datastructure, frees it, and returns `context` as nullptr.
+ *
+ * Does not free any `reverse_data` datastructure.
+ *
+ * Does nothing if `context` is already nullptr.
+ */
+void free_hevc_context(hevc_context_p *context) {
+  hevc_context_p cc = *context;
+  int ii;
+
+  if (cc == nullptr)
+    return;
+
+  free_ES_unit(&cc->unit);
+  for (ii = 0; ii < HEVC_MAX_VPS_IDS; ii++)
+    free_ES_unit(&cc->vps[ii]);
+  for (ii = 0; ii < HEVC_MAX_SPS_IDS; ii++)
+    free_ES_unit(&cc->sps[ii]);
+  for (ii = 0; ii < HEVC_MAX_PPS_IDS; ii++)
+    free_ES_unit(&cc->pps[ii]);
+  cc->reverse_data = nullptr;
+
+  free(*context);
+  *context = nullptr;
+  return;
+}
+
+/*
+ * "Reset" an HEVC context, after the underlying ES has been moved
+ * (for instance, by reversing or by seeking), so that it does not try to
+ * use a NAL unit it read from the old position.
+ *
+ * Doesn't forget the parameter sets that have been found so far.
+ */
+void reset_hevc_context(hevc_context_p context) {
+  context->pending = false;
+  context->no_more_data = false;
+}
+
+/*
+ * If the last access unit read was ended by finding the first NAL unit of
+ * the next access unit, return that NAL unit (which is where the next
+ * access unit will start), otherwise nullptr.
+ */
+ES_unit_p hevc_pending_unit(hevc_context_p context) {
+  return context->pending ? context->unit : nullptr;
+}
+
+/*
+ * Rewind a file being read as HEVC access units.
+ *
+ * This is a wrapper for `seek_ES` that also knows to unset things
+ * appropriate to the HEVC context.
+ *
+ * If a reverse context is attached to this context, it also will
+ * be "rewound" appropriately.
+ *
+ * Doesn't forget the parameter sets that have been found so far.
+ *
+ * Returns 0 if all goes well, 1 if something goes wrong.
+ */
+int rewind_hevc_context(hevc_context_p context) {
+  ES_offset start_of_file = {0, 0};
+
+  context->pending = false;
+  context->no_more_data = false;
+  context->access_unit_index = 0; // no access units read from this file yet
+
+  if (context->reverse_data) {
+    context->reverse_data->last_posn_added = -1; // next entry to be 0
+  }
+
+  return seek_ES(context->es, start_of_file);
+}
+
+// ------------------------------------------------------------
+// HEVC access units
+// ------------------------------------------------------------
+/*
+ * Build a new, empty, HEVC access unit datastructure.
+ *
+ * Returns 0 if it succeeds, 1 if some error occurs.
+ */
+static int build_hevc_access_unit(hevc_access_unit_p *access_unit) {
+  int err;
+  hevc_access_unit_p new2 =
+      (hevc_access_unit_p)malloc(SIZEOF_HEVC_ACCESS_UNIT);
+  if (new2 == nullptr) {
+    print_err("### Unable to allocate HEVC access unit datastructure\n");
+    return 1;
+  }
+
+  err = build_ES_unit_list(&new2->list);
+  if (err) {
+    free(new2);
+    return 1;
+  }
+
+  new2->index = 0;
+  new2->start_posn.infile = 0;
+  new2->start_posn.inpacket = 0;
+  new2->data_len = 0;
+  new2->num_nal_units = 0;
+  new2->has_picture = false;
+  new2->nal_unit_type = 0;
+  new2->temporal_id = 0;
+
+  *access_unit = new2;
+  return 0;
+}
+
+/*
+ * Free an HEVC access unit datastructure.
+ *
+ * Clears the datastructure, frees it, and returns `access_unit` as nullptr.
+ *
+ * Does nothing if `access_unit` is already nullptr.
+ */
+void free_hevc_access_unit(hevc_access_unit_p *access_unit) {
+  if (*access_unit == nullptr)
+    return;
+  free_ES_unit_list(&(*access_unit)->list);
+  free(*access_unit);
+  *access_unit = nullptr;
+}
+
+/*
+ * Add a NAL unit to an access unit.
+ *
+ * If `keep` is false, then we just account for the NAL unit's position
+ * and size, and don't take a copy of its data.
+ *
+ * Returns 0 if it succeeds, 1 if some error occurs.
+ */
+static int append_to_hevc_access_unit(hevc_access_unit_p access_unit,
+                                      ES_unit_p unit, int keep) {
+  if (access_unit->num_nal_units == 0)
+    access_unit->start_posn = unit->start_posn;
+  access_unit->data_len += unit->data_len;
+  access_unit->num_nal_units++;
+  if (keep)
+    return append_to_ES_unit_list(access_unit->list, unit);
+  return 0;
+}
+
+/*
+ * Remember an IRAP access unit for reversing.
+ *
+ * Returns 0 if it succeeds, 1 if some error occurs.
+ */
+static int maybe_remember_hevc_access_unit(reverse_data_p reverse_data,
+                                           hevc_access_unit_p access_unit,
+                                           int verbose) {
+  int err;
+  if (!is_hevc_IRAP_access_unit(access_unit))
+    return 0;
+
+  // Reversing H.265 is just like reversing H.264 - all we need
+  // to remember is where each access unit is, and how big it is
+  err = remember_reverse_h264_data(reverse_data, access_unit->index,
+                                   access_unit->start_posn,
+                                   access_unit->data_len);
+  if (err) {
+    fprint_err("### Error remembering access unit %d for reversing\n",
+               access_unit->index);
+    return 1;
+  }
+  if (verbose)
+    fprint_msg("REMEMBER IRAP %5d at " OFFSET_T_FORMAT_08 "/%04d for %5d\n",
+               access_unit->index, access_unit->start_posn.infile,
+               access_unit->start_posn.inpacket, access_unit->data_len);
+  return 0;
+}
+
+/*
+ * Retrieve the next access unit from the given HEVC elementary stream.
+ *
+ * - `context` is the HEVC context to read from
+ * - if `irap_data_only` is true, then only IRAP access units keep their
+ *   NAL unit data. Other access units are still returned (so that they can
+ *   be counted, and so that their position and size are known), but with
+ *   an empty ES unit list. This makes skipping from IRAP picture to IRAP
+ *   picture (for fast forward or reverse) much cheaper.
+ * - if `verbose` is true, then each NAL unit is reported on as it is read
+ * - if `quiet` is true, then only errors will be reported
+ * - `access_unit` is the access unit read
+ *
+ * If a reverse context is attached to `context`, then IRAP access units
+ * will be remembered in it.
+ *
+ * Returns 0 if it succeeds, EOF if there is no more data to read, and 1
+ * if some error occurs.
+ *
+ * If command input is enabled, then it can also return COMMAND_RETURN_CODE
+ * if the current command has changed.
+ */
+int get_next_hevc_access_unit(hevc_context_p context, int irap_data_only,
+                              int verbose, int quiet,
+                              hevc_access_unit_p *access_unit) {
+  int err;
+  int keep = true; // Until we know what sort of picture this is
+  hevc_access_unit_p this_unit = nullptr;
+  ES_unit_p unit = context->unit;
+
+  if (context->no_more_data)
+    return EOF;
+
+  err = build_hevc_access_unit(&this_unit);
+  if (err)
+    return 1;
+
+  for (;;) {
+    int nal_unit_type;
+
+    if (context->pending) {
+      // The NAL unit that ended the previous access unit starts this one
+      context->pending = false;
+    } else {
+      if (es_command_changed(context->es)) {
+        free_hevc_access_unit(&this_unit);
+        return COMMAND_RETURN_CODE;
+      }
+      err = find_next_ES_unit(context->es, unit);
+      if (err == EOF) {
+        context->no_more_data = true;
+        break;
+      } else if (err) {
+        free_hevc_access_unit(&this_unit);
+        return 1;
+      }
+      context->count++;
+    }
+
+    if (unit->data_len < 5) {
+      // Too short to have a NAL unit header
+      if (!quiet)
+        fprint_err("!!! Ignoring HEVC NAL unit at " OFFSET_T_FORMAT
+                   "/%d with only %d bytes\n",
+                   unit->start_posn.infile, unit->start_posn.inpacket,
+                   unit->data_len);
+      continue;
+    }
+
+    nal_unit_type = HEVC_NAL_UNIT_TYPE(unit);
+
+    if (this_unit->has_picture &&
+        hevc_nal_unit_starts_access_unit(unit, nal_unit_type)) {
+      // Keep this NAL unit for the next access unit - that means it must
+      // survive our reading the next NAL unit
+      err = keep_ES_unit_data(unit);
+      if (err) {
+        free_hevc_access_unit(&this_unit);
+        return 1;
+      }
+      context->pending = true;
+      break;
+    }
+
+    if (verbose)
+      report_hevc_nal_unit(true, unit);
+
+    if (is_hevc_VCL_nal_type(nal_unit_type) && !this_unit->has_picture) {
+      this_unit->has_picture = true;
+      this_unit->nal_unit_type = nal_unit_type;
+      this_unit->temporal_id = HEVC_TEMPORAL_ID(unit);
+      if (irap_data_only && !is_hevc_IRAP_nal_type(nal_unit_type)) {
+        // We don't need any of this access unit's data
+        keep = false;
+        reset_ES_unit_list(this_unit->list);
+      }
+    } else if (nal_unit_type >= HEVC_NAL_VPS &&
+               nal_unit_type <= HEVC_NAL_PPS) {
+      err = remember_hevc_param_set(context, unit, nal_unit_type);
+      if (err) {
+        free_hevc_access_unit(&this_unit);
+        return 1;
+      }
+      if (nal_unit_type == HEVC_NAL_SPS && unit->data_len >= 6 &&
+          HEVC_NUH_LAYER_ID(unit) == 0 &&
+          HEVC_SPS_MAX_TEMPORAL_ID(unit) > context->max_temporal_id)
+        context->max_temporal_id = HEVC_SPS_MAX_TEMPORAL_ID(unit);
+    }
+
+    err = append_to_hevc_access_unit(this_unit, unit, keep);
+    if (err) {
+      free_hevc_access_unit(&this_unit);
+      return 1;
+    }
+  }
+
+  if (this_unit->num_nal_units == 0) {
+    free_hevc_access_unit(&this_unit);
+    return EOF;
+  }
+
+  this_unit->index = ++context->access_unit_index;
+
+  if (context->reverse_data) {
+    err = maybe_remember_hevc_access_unit(context->reverse_data, this_unit,
+                                          verbose);
+    if (err) {
+      free_hevc_access_unit(&this_unit);
+      return 1;
+    }
+  }
+
+  *access_unit = this_unit;
+  return 0;
+}
+
+/*
+ * Write out an HEVC access unit as ES.
+ *
+ * - `access_unit` is the access unit to write out
+ * - `output` is the ES file to write to
+ *
+ * Returns 0 if it succeeds, 1 if some error occurs.
+ */
+int write_hevc_access_unit_as_ES(hevc_access_unit_p access_unit,
+                                 FILE *output) {
+  int ii, err;
+  for (ii = 0; ii < access_unit->list->length; ii++) {
+    err = write_ES_unit(output, &(access_unit->list->array[ii]));
+    if (err) {
+      print_err("### Error writing NAL unit ");
+      report_hevc_nal_unit(false, &(access_unit->list->array[ii]));
+      return err;
+    }
+  }
+  return 0;
+}
+
+/*
+ * Write out an HEVC access unit as TS.
+ *
+ * - `access_unit` is the access unit to write out
+ * - `tswriter` is the TS context to write with
+ * - `video_pid` is the PID to use to write the data
+ *
+ * Returns 0 if it succeeds, 1 if some error occurs.
+ */
+int write_hevc_access_unit_as_TS(hevc_access_unit_p access_unit,
+                                 TS_writer_p tswriter, uint32_t video_pid) {
+  int ii, err;
+  for (ii = 0; ii < access_unit->list->length; ii++) {
+    ES_unit_p unit = &(access_unit->list->array[ii]);
+    err = write_ES_as_TS_PES_packet(tswriter, unit->data, unit->data_len,
+                                    video_pid, DEFAULT_VIDEO_STREAM_ID);
+    if (err) {
+      print_err("### Error writing NAL unit ");
+      report_hevc_nal_unit(false, unit);
+      return err;
+    }
+  }
+  return 0;
+}
+
+/*
+ * Report on an HEVC access unit.
+ *
+ * - if `report_data` is true, then its NAL units are listed as well.
+ */
+void report_hevc_access_unit(hevc_access_unit_p access_unit,
+                             int report_data) {
+  int ii;
+  fprint_msg("Access unit %u at " OFFSET_T_FORMAT_08 "/%04d for %u bytes,"
+             " %d NAL unit%s",
+             access_unit->index, access_unit->start_posn.infile,
+             access_unit->start_posn.inpacket, access_unit->data_len,
+             access_unit->num_nal_units,
+             (access_unit->num_nal_units == 1 ? "" : "s"));
+  if (access_unit->has_picture)
+    fprint_msg(": %s tid %d%s\n",
+               HEVC_NAL_UNIT_TYPE_STR(access_unit->nal_unit_type),
+               access_unit->temporal_id,
+               (is_hevc_IRAP_access_unit(access_unit) ? " (IRAP)" : ""));
+  else
+    print_msg(": no picture\n");
+
+  if (report_data) {
+    for (ii = 0; ii < access_unit->list->length; ii++) {
+      print_msg("    ");
+      report_hevc_nal_unit(true, &(access_unit->list->array[ii]));
+    }
+  }
+}
+
+// ------------------------------------------------------------
+// Reversing
+// ------------------------------------------------------------
+/*
+ * Add a reversing context to an HEVC context (and vice versa).
+ *
+ * The reverse data should have been built with `build_reverse_data()`
+ * with `is_h264` true, since HEVC reversing works just as H.264 does.
+ *
+ * Does not check if there is one present already.
+ *
+ * Returns 0 if all is well, 1 if something goes wrong.
+ */
+int add_hevc_reverse_context(hevc_context_p context,
+                             reverse_data_p reverse_data) {
+  if (!reverse_data->is_h264) {
+    print_err("### Cannot add an HEVC context to an H.262 reverse data"
+              " context\n");
+    return 1;
+  }
+  context->reverse_data = reverse_data;
+  reverse_data->hevc = context;
+  return 0;
+}
+
+/*
+ * Find IRAP access units, and remember them for later output in
+ * reverse order.
+ *
+ * Only the IRAP access units' data is read in, so this skips through the
+ * rest of the stream as fast as the start code scanner allows.
+ *
+ * - `context` is the HEVC reading context
+ * - if `max` is non-zero, then collecting will stop after `max` access units
+ * - if `verbose` is true, then extra information will be output
+ * - if `quiet` is true, then only errors will be reported
+ *
+ * Returns 0 if all went well, EOF if the end of file is reached,
+ * and 1 if an error occurred.
+ *
+ * If command input is enabled, then it can also return COMMAND_RETURN_CODE
+ * if the current command has changed.
+ */
+int collect_reverse_hevc(hevc_context_p context, int max, int verbose,
+                         int quiet) {
+  int err = 0;
+  int access_unit_count = 0;
+
+  if (context->reverse_data == nullptr) {
+    print_err("### Unable to collect reverse data for HEVC access units\n");
+    print_err("    HEVC context does not have reverse data"
+              " information attached to it\n");
+    return 1;
+  }
+
+  for (;;) {
+    hevc_access_unit_p access_unit;
+
+    err = get_next_hevc_access_unit(context, true, verbose, quiet,
+                                    &access_unit);
+    if (err == EOF)
+      return EOF;
+    else if (err)
+      return err;
+
+    access_unit_count++;
+    free_hevc_access_unit(&access_unit);
+
+    if (!verbose && !quiet && (access_unit_count % 5000 == 0))
+      fprint_msg("Scanned %d NAL units in %d frames,"
+                 " remembered %d frames\n",
+                 context->count, access_unit_count,
+                 context->reverse_data->length);
+
+    if (max > 0 && access_unit_count >= max) {
+      if (verbose)
+        fprint_msg("\nStopping because %d frames have been read\n",
+                   access_unit_count);
+      break;
+    }
+  }
+  return 0;
+}
+
+// ------------------------------------------------------------
+// Filtering
+// ------------------------------------------------------------
+/*
+ * Build a new HEVC filter context
+ *
+ * Returns 0 if all goes well, 1 if something goes wrong
+ */
+static int new_hevc_filter_context(hevc_filter_context_p *fcontext) {
+  hevc_filter_context_p new2 =
+      (hevc_filter_context_p)malloc(SIZEOF_HEVC_FILTER_CONTEXT);
+  if (new2 == nullptr) {
+    print_err("### Unable to allocate HEVC filter context\n");
+    return 1;
+  }
+
+  new2->hevc = nullptr;
+  new2->filter = false;
+  new2->freq = 0;
+  new2->allref = false;
+
+  reset_hevc_filter_context(new2);
+
+  *fcontext = new2;
+  return 0;
+}
+
+/*
+ * Build a new filter context for "stripping" HEVC data
+ *
+ * - `fcontext` is the new filter context
+ * - `hevc` is the HEVC context to read from
+ * - `allref` is true if the software should keep all reference pictures,
+ *   rather than just the IRAP pictures. A sub-layer non-reference picture
+ *   is only dropped if it is in the highest sub-layer (TemporalId) that the
+ *   SPS allows, since otherwise a higher sub-layer may refer to it.
+ *
+ * Returns 0 if all goes well, 1 if something goes wrong
+ */
+int build_hevc_filter_context_strip(hevc_filter_context_p *fcontext,
+                                    hevc_context_p hevc, int allref) {
+  int err = new_hevc_filter_context(fcontext);
+  if (err)
+    return 1;
+
+  (*fcontext)->hevc = hevc;
+  (*fcontext)->filter = false;
+  (*fcontext)->allref = allref;
+  return 0;
+}
+
+/*
+ * Build a new filter context for "filtering" HEVC data
+ *
+ * - `fcontext` is the new filter context
+ * - `hevc` is the HEVC context to read from
+ * - `freq` is the desired speed-up, or the frequency at which frames
+ *   should (ideally) be kept
+ *
+ * Returns 0 if all goes well, 1 if something goes wrong
+ */
+int build_hevc_filter_context(hevc_filter_context_p *fcontext,
+                              hevc_context_p hevc, int freq) {
+  int err = new_hevc_filter_context(fcontext);
+  if (err)
+    return 1;
+
+  (*fcontext)->hevc = hevc;
+  (*fcontext)->filter = true;
+  (*fcontext)->freq = freq;
+  return 0;
+}
+
+/*
+ * Reset an HEVC filter context, ready to start filtering anew.
+ */
+void reset_hevc_filter_context(hevc_filter_context_p fcontext) {
+  fcontext->had_previous_access_unit = false;
+  fcontext->count = 0;
+  fcontext->frames_seen = 0;
+  fcontext->frames_written = 0;
+}
+
+/*
+ * Free an HEVC filter context
+ *
+ * NOTE that this does *not* free the HEVC context to which the
+ * filter context refers.
+ *
+ * - `fcontext` is the filter context, which will be freed, and returned
+ *   as nullptr.
+ */
+void free_hevc_filter_context(hevc_filter_context_p *fcontext) {
+  if ((*fcontext) == nullptr)
+    return;
+
+  // Just lose our reference to the HEVC context, don't free it
+  (*fcontext)->hevc = nullptr;
+
+  free(*fcontext);
+  *fcontext = nullptr;
+  return;
+}
+
+/*
+ * Retrieve the next IRAP (and/or, if fcontext->allref, reference) frame
+ * in this HEVC ES.
+ *
+ * Note that the ES data being read should be video-only.
+ *
+ * - `fcontext` is the information that tells us what to filter and how
+ * - if `verbose` is true, then extra information will be output
+ * - if `quiet` is true, then only errors will be reported
+ * - `frame` is the next frame to output.
+ *   Note that it is the caller's responsibility to free this with
+ *   `free_hevc_access_unit()`.
+ *   If an error or EOF is returned, this value is undefined.
+ * - `frames_seen` is the number of frames found by this call
+ *   of the function, including the frame returned.
+ *
+ * Returns 0 if it succeeds, EOF if end-of-file is read, 1 if some error
+ * occurs.
+ *
+ * If command input is enabled, then it can also return COMMAND_RETURN_CODE
+ * if the current command has changed.
+ */
+int get_next_stripped_hevc_frame(hevc_filter_context_p fcontext, int verbose,
+                                 int quiet, hevc_access_unit_p *frame,
+                                 int *frames_seen) {
+  int err = 0;
+  int keep = false; // Should we keep the current access unit?
+  int max_tid;      // The highest sub-layer in the stream
+  hevc_access_unit_p this_access_unit = nullptr;
+
+  *frames_seen = 0;
+
+  for (;;) {
+    if (verbose)
+      print_msg("\n");
+
+    err = get_next_hevc_access_unit(fcontext->hevc, !fcontext->allref,
+                                    verbose, quiet, &this_access_unit);
+    if (err)
+      return err; // EOF, 1 or COMMAND_RETURN_CODE
+
+    (*frames_seen)++;
+    max_tid = HEVC_HIGHEST_TEMPORAL_ID(fcontext->hevc);
+
+    if (!this_access_unit->has_picture) {
+      keep = false;
+      if (verbose)
+        print_msg("++ DROP: no picture\n");
+    } else if (is_hevc_IRAP_access_unit(this_access_unit)) {
+      keep = true;
+      if (verbose)
+        print_msg("++ KEEP: IRAP picture\n");
+    } else if (fcontext->allref &&
+               is_hevc_ref_access_unit(this_access_unit, max_tid)) {
+      keep = true;
+      if (verbose)
+        print_msg("++ KEEP: reference picture\n");
+    } else {
+      keep = false;
+      if (verbose)
+        print_msg("++ DROP: not IRAP\n");
+    }
+
+    if (keep) {
+      *frame = this_access_unit;
+      return 0;
+    }
+    // We've no further use for this access unit
+    free_hevc_access_unit(&this_access_unit);
+  }
+}
+
+/*
+ * Retrieve the next frame from the HEVC ES, aiming for an "apparent" kept
+ * frequency as stated.
+ *
+ * Only IRAP frames are ever kept, since they are the only ones we can be
+ * sure can be decoded without the frames we are skipping.
+ *
+ * Note that the ES data being read should be video-only.
+ *
+ * - `fcontext` is the information that tells us what to filter and how
+ *   (including the desired frequency)
+ * - if `verbose` is true, then extra information will be output
+ * - if `quiet` is true, then only errors will be reported
+ *
+ * - `frame` is the next frame to output.
+ *
+ *   If the function succeeds and `frame` is nullptr, it means that the
+ *   last frame should be output again.
+ *
+ *   Note that it is the caller's responsibility to free this frame with
+ *   `free_hevc_access_unit()`.
+ *
+ *   If an error or EOF is returned, this value is undefined.
+ *
+ * - `frames_seen` is the number of frames found by this call of the function,
+ *   including the frame returned.
+ *
+ * Returns 0 if all went well, EOF if end-of-file is read, 1 if something
+ * went wrong.
+ *
+ * If command input is enabled, then it can also return COMMAND_RETURN_CODE
+ * if the current command has changed.
+ */
+int get_next_filtered_hevc_frame(hevc_filter_context_p fcontext, int verbose,
+                                 int quiet, hevc_access_unit_p *frame,
+                                 int *frames_seen) {
+  int err = 0;
+  int keep = false; // Should we keep the current access unit?
+  hevc_access_unit_p this_access_unit = nullptr;
+
+  *frames_seen = 0;
+
+  for (;;) {
+    if (verbose)
+      print_msg("\n");
+
+    err = get_next_hevc_access_unit(fcontext->hevc, true, verbose, quiet,
+                                    &this_access_unit);
+    if (err)
+      return err; // EOF, 1 or COMMAND_RETURN_CODE
+
+    fcontext->count++;
+    (*frames_seen)++;
+
+    fcontext->frames_seen++;
+
+    if (!is_hevc_IRAP_access_unit(this_access_unit)) {
+      keep = false;
+      if (verbose)
+        fprint_msg("++ %d/%d DROP: not IRAP\n", fcontext->count,
+                   fcontext->freq);
+    } else if (!fcontext->had_previous_access_unit) {
+      // Start with the first IRAP we find, regardless of the count
+      keep = true;
+      if (verbose)
+        fprint_msg("++ %d/%d KEEP: first IRAP of filter run\n",
+                   fcontext->count, fcontext->freq);
+    } else if (fcontext->count < fcontext->freq) {
+      keep = false;
+      if (verbose)
+        fprint_msg("++ %d/%d DROP: Too soon\n", fcontext->count,
+                   fcontext->freq);
+    } else {
+      keep = true;
+      if (verbose)
+        fprint_msg("++ %d/%d KEEP: IRAP\n", fcontext->count, fcontext->freq);
+    }
+
+    if (keep) {
+      *frame = this_access_unit;
+      fcontext->had_previous_access_unit = true;
+      fcontext->frames_written++;
+      fcontext->count = 0;
+      return 0;
+    } else {
+      if (fcontext->freq > 0) {
+        int access_units_wanted = fcontext->frames_seen / fcontext->freq;
+        int repeat = access_units_wanted - fcontext->frames_written;
+        if (repeat > 0 && fcontext->had_previous_access_unit) {
+          if (verbose)
+            print_msg(">>> output last access unit again\n");
+          free_hevc_access_unit(&this_access_unit);
+          *frame = nullptr;
+          fcontext->frames_written++;
+          return 0;
+        }
+      }
+      // We've no further use for this access unit
+      free_hevc_access_unit(&this_access_unit);
+    }
+  }
+}
@@ -0,0 +1,256 @@
+/*
+ * Datastructures for reading H.265 (HEVC) elementary streams.
+ *
+ * ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is the MPEG TS, PS and ES tools.
+ *
+ * The Initial Developer of the Original Code is Amino Communications Ltd.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *   Amino Communications Ltd, Swavesey, Cambridge UK
+ *
+ * ***** END LICENSE BLOCK *****
+ */
+
+#ifndef _hevc_defns
+#define _hevc_defns
+
+#include "compat.h"
+#include "es_defns.h"
+
+// Since reverse_data refers to the HEVC context, and *it* refers to
+// reverse_data, we need to break the circular referencing at some point
+typedef struct hevc_context *hevc_context_p;
+struct reverse_data;
+
+// ------------------------------------------------------------
+// HEVC NAL unit types (H.265 table 7-1)
+#define HEVC_NAL_TRAIL_N 0
+#define HEVC_NAL_TRAIL_R 1
+#define HEVC_NAL_TSA_N 2
+#define HEVC_NAL_TSA_R 3
+#define HEVC_NAL_STSA_N 4
+#define HEVC_NAL_STSA_R 5
+#define HEVC_NAL_RADL_N 6
+#define HEVC_NAL_RADL_R 7
+#define HEVC_NAL_RASL_N 8
+#define HEVC_NAL_RASL_R 9
+#define HEVC_NAL_BLA_W_LP 16
+#define HEVC_NAL_BLA_W_RADL 17
+#define HEVC_NAL_BLA_N_LP 18
+#define HEVC_NAL_IDR_W_RADL 19
+#define HEVC_NAL_IDR_N_LP 20
+#define HEVC_NAL_CRA 21
+#define HEVC_NAL_VPS 32
+#define HEVC_NAL_SPS 33
+#define HEVC_NAL_PPS 34
+#define HEVC_NAL_AUD 35
+#define HEVC_NAL_EOS 36
+#define HEVC_NAL_EOB 37
+#define HEVC_NAL_FILLER 38
+#define HEVC_NAL_PREFIX_SEI 39
+#define HEVC_NAL_SUFFIX_SEI 40
+
+#define HEVC_NAL_UNIT_TYPE_STR(a)                                              \
+  ((a) == HEVC_NAL_TRAIL_N       ? "TRAIL_N"                                   \
+   : (a) == HEVC_NAL_TRAIL_R     ? "TRAIL_R"                                   \
+   : (a) == HEVC_NAL_TSA_N       ? "TSA_N"                                     \
+   : (a) == HEVC_NAL_TSA_R       ? "TSA_R"                                     \
+   : (a) == HEVC_NAL_STSA_N      ? "STSA_N"                                    \
+   : (a) == HEVC_NAL_STSA_R      ? "STSA_R"                                    \
+   : (a) == HEVC_NAL_RADL_N      ? "RADL_N"                                    \
+   : (a) == HEVC_NAL_RADL_R      ? "RADL_R"                                    \
+   : (a) == HEVC_NAL_RASL_N      ? "RASL_N"                                    \
+   : (a) == HEVC_NAL_RASL_R      ? "RASL_R"                                    \
+   : (a) == HEVC_NAL_BLA_W_LP    ? "BLA_W_LP"                                  \
+   : (a) == HEVC_NAL_BLA_W_RADL  ? "BLA_W_RADL"                                \
+   : (a) == HEVC_NAL_BLA_N_LP    ? "BLA_N_LP"                                  \
+   : (a) == HEVC_NAL_IDR_W_RADL  ? "IDR_W_RADL"                                \
+   : (a) == HEVC_NAL_IDR_N_LP    ? "IDR_N_LP"                                  \
+   : (a) == HEVC_NAL_CRA         ? "CRA"                                       \
+   : (a) == HEVC_NAL_VPS         ? "video param set"                           \
+   : (a) == HEVC_NAL_SPS         ? "seq param set"                             \
+   : (a) == HEVC_NAL_PPS         ? "pic param set"                             \
+   : (a) == HEVC_NAL_AUD         ? "access unit delim"                         \
+   : (a) == HEVC_NAL_EOS         ? "end of seq"                                \
+   : (a) == HEVC_NAL_EOB         ? "end of bitstream"                          \
+   : (a) == HEVC_NAL_FILLER      ? "filler"                                    \
+   : (a) == HEVC_NAL_PREFIX_SEI  ? "prefix SEI"                                \
+   : (a) == HEVC_NAL_SUFFIX_SEI  ? "suffix SEI"                                \
+   : (a) < 32                    ? "reserved VCL"                              \
+   : (a) < 48                    ? "reserved"                                  \
+                                 : "unspecified")
+
+// The following macros work on NAL unit type values
+#define is_hevc_VCL_nal_type(t) ((t) < 32)
+// IRAP (Intra Random Access Point) pictures are BLA, IDR and CRA pictures,
+// (and the two reserved IRAP types, 22 and 23). Decoding can start at any
+// of them, which is what makes them useful for fast forward and reverse.
+#define is_hevc_IRAP_nal_type(t) ((t) >= HEVC_NAL_BLA_W_LP && (t) <= 23)
+#define is_hevc_IDR_nal_type(t)                                                \
+  ((t) == HEVC_NAL_IDR_W_RADL || (t) == HEVC_NAL_IDR_N_LP)
+#define is_hevc_BLA_nal_type(t)                                                \
+  ((t) >= HEVC_NAL_BLA_W_LP && (t) <= HEVC_NAL_BLA_N_LP)
+#define is_hevc_CRA_nal_type(t) ((t) == HEVC_NAL_CRA)
+// Sub-layer non-reference pictures (TRAIL_N, TSA_N, ..., RSV_VCL_N14)
+// are not used for reference by pictures of the same sub-layer - but they
+// may still be used by pictures with a higher TemporalId
+#define is_hevc_non_ref_nal_type(t) ((t) <= 14 && ((t) & 1) == 0)
+
+// TemporalId runs from 0 to 6 (sps_max_sub_layers_minus1 is at most 6)
+#define HEVC_MAX_TEMPORAL_ID 6
+
+// The HEVC NAL unit header is two bytes long, and follows the 00 00 01
+// start code prefix of an ES unit. These macros pick it apart, for an
+// ES unit that is at least 5 bytes long.
+#define HEVC_NAL_UNIT_TYPE(unit) (((unit)->data[3] >> 1) & 0x3F)
+#define HEVC_NUH_LAYER_ID(unit)                                                \
+  ((((unit)->data[3] & 0x01) << 5) | ((unit)->data[4] >> 3))
+#define HEVC_TEMPORAL_ID(unit) (((unit)->data[4] & 0x07) - 1)
+// The first bit of a slice segment header, for a VCL NAL unit at least 6
+// bytes long, says if this is the first slice segment of a picture
+#define HEVC_FIRST_SLICE_SEGMENT_IN_PIC(unit) (((unit)->data[5] & 0x80) != 0)
+// The first byte of an SPS (for an SPS NAL unit at least 6 bytes long, with
+// nuh_layer_id 0) holds sps_max_sub_layers_minus1, which is also the highest
+// TemporalId that pictures using that SPS may have
+#define HEVC_SPS_MAX_TEMPORAL_ID(unit) (((unit)->data[5] >> 1) & 0x07)
+
+// The number of ids each kind of parameter set may have (H.265 7.4.3)
+#define HEVC_MAX_VPS_IDS 16
+#define HEVC_MAX_SPS_IDS 16
+#define HEVC_MAX_PPS_IDS 64
+
+// ------------------------------------------------------------
+// A single HEVC access unit
+struct hevc_access_unit {
+  uint32_t index; // The (notional) index of this unit in the stream
+                  // (i.e., from the context's access_unit_index)
+
+  // The NAL units (as ES units) that form us. If the access unit was read
+  // with only IRAP data wanted, and it is not an IRAP access unit, then
+  // this will be empty.
+  ES_unit_list_p list;
+
+  // Where our data starts in the input, and how many bytes it occupies.
+  // These are kept even if `list` has been left empty.
+  ES_offset start_posn;
+  uint32_t data_len;
+
+  int num_nal_units;  // How many NAL units were read for us
+  int has_picture;    // Did we contain any VCL NAL units?
+  byte nal_unit_type; // The NAL unit type of our first VCL NAL unit
+  byte temporal_id;   // And its TemporalId
+};
+typedef struct hevc_access_unit *hevc_access_unit_p;
+#define SIZEOF_HEVC_ACCESS_UNIT sizeof(struct hevc_access_unit)
+
+// The following macros work on HEVC access units
+#define is_hevc_IRAP_access_unit(au)                                           \
+  ((au)->has_picture && is_hevc_IRAP_nal_type((au)->nal_unit_type))
+#define is_hevc_IDR_access_unit(au)                                            \
+  ((au)->has_picture && is_hevc_IDR_nal_type((au)->nal_unit_type))
+// A sub-layer non-reference picture is only certain not to be used for
+// reference if it is in the highest sub-layer, `max_tid`
+#define is_hevc_ref_access_unit(au, max_tid)                                   \
+  ((au)->has_picture && (!is_hevc_non_ref_nal_type((au)->nal_unit_type) ||    \
+                         (au)->temporal_id < (max_tid)))
+
+// ------------------------------------------------------------
+// Context for looping over the access units in an HEVC elementary stream
+struct hevc_context {
+  ES_p es;
+
+  // The number of NAL units read so far
+  int count;
+
+  // We count all of the access units as we read them (this is useful
+  // when we are building up reverse_data arrays). If functions
+  // move around in the data stream, we assume that they will
+  // (re)set this to a sensible value.
+  // The index of the first access unit read is 1, and this value is
+  // incremented by each call of `get_next_hevc_access_unit`
+  uint32_t access_unit_index; // The index of the last access unit read
+
+  // If we are collecting reversing information, then we keep a reference
+  // to the reverse data here
+  struct reverse_data *reverse_data;
+
+  // The latest parameter set NAL unit (VPS, SPS and PPS) we have seen for
+  // each id, or nullptr if there hasn't been one. A new parameter set with
+  // the same id replaces the old one. When reversing, these need to be
+  // output before any of the pictures.
+  ES_unit_p vps[HEVC_MAX_VPS_IDS];
+  ES_unit_p sps[HEVC_MAX_SPS_IDS];
+  ES_unit_p pps[HEVC_MAX_PPS_IDS];
+
+  // The highest TemporalId allowed by any SPS we have seen, or -1 if we
+  // have not seen an SPS yet
+  int max_temporal_id;
+
+  // -------------------------------------------------------------
+  // Private information - used internally by the software, not to
+  // be relied upon by outsiders
+  // -------------------------------------------------------------
+  // Each NAL unit is read into the same ES unit, to save allocating
+  // a new one each time
+  ES_unit_p unit;
+  // If we ended the previous access unit because of finding a NAL
+  // unit that starts a *new* access unit, then `unit` still holds it
+  int pending;
+  // If we read EOF on the input stream, then next time we try to read
+  // an access unit, we want to know that there is no point
+  int no_more_data;
+};
+#define SIZEOF_HEVC_CONTEXT sizeof(struct hevc_context)
+
+// The highest sub-layer to assume for `is_hevc_ref_access_unit`. Until we
+// have seen an SPS, we can't tell which sub-layer non-reference pictures
+// are really not referenced, so assume they all might be.
+#define HEVC_HIGHEST_TEMPORAL_ID(context)                                      \
+  ((context)->max_temporal_id < 0 ? HEVC_MAX_TEMPORAL_ID + 1                   \
+                                  : (context)->max_temporal_id)
+
+// ------------------------------------------------------------
+// Filtering HEVC comes in the same two varieties as for H.262 and H.264
+// (see filter_defns.h), but since we only look at NAL unit headers, we
+// can only be sure that IRAP pictures are decodable on their own. Thus
+// "stripping" keeps the IRAP pictures (or maybe all reference pictures),
+// and "filtering" only ever keeps IRAP pictures.
+struct hevc_filter_context {
+  hevc_context_p hevc; // The HEVC stream we are reading from
+  int filter;          // true if filtering, false if stripping
+  int freq;            // Frequency of frames to try to keep if filtering
+  int allref;          // Keep all reference pictures if stripping?
+
+  // When filtering, we want:
+  int count; // a rolling count to compare with the desired frequency
+  int had_previous_access_unit;
+
+  int frames_seen;    // number seen this filter run
+  int frames_written; // number written (or, returned)
+};
+typedef struct hevc_filter_context *hevc_filter_context_p;
+#define SIZEOF_HEVC_FILTER_CONTEXT sizeof(struct hevc_filter_context)
+
+#endif // _hevc_defns
+
+// Local Variables:
+// tab-width: 8
+// indent-tabs-mode: nil
+// c-basic-offset: 2
+// End:
+// vim: set tabstop=8 shiftwidth=2 expandtab:
@@ -0,0 +1,312 @@
+/*
+ * Prototypes for reading H.265 (HEVC) elementary streams.
+ *
+ * ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is the MPEG TS, PS and ES tools.
+ *
+ * The Initial Developer of the Original Code is Amino Communications Ltd.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *   Amino Communications Ltd, Swavesey, Cambridge UK
+ *
+ * ***** END LICENSE BLOCK *****
+ */
+
+#ifndef _hevc_fns
+#define _hevc_fns
+
+#include "hevc_defns.h"
+#include "reverse_defns.h"
+#include "tswrite_defns.h"
+
+/*
+ * Print out useful information about an HEVC NAL unit, on the given stream.
+ *
+ * This is intended as a single line of information.
+ */
+void report_hevc_nal_unit(int is_msg, ES_unit_p unit);
+
+/*
+ * Build a new HEVC access unit reading context.
+ *
+ * This acts as a "jacket" around the ES context, and is used when reading
+ * HEVC access units with get_next_hevc_access_unit().
+ *
+ * - `es` is the ES reading context to read from.
+ * - `context` is the new HEVC context.
+ *
+ * Returns 0 if it succeeds, 1 if some error occurs.
+ */
+int build_hevc_context(ES_p es, hevc_context_p *context);
+
+/*
+ * Free an HEVC context.
+ *
+ * Clears the datastructure, frees it, and returns `context` as nullptr.
+ *
+ * Does not free any `reverse_data` datastructure.
+ *
+ * Does nothing if `context` is already nullptr.
+ */
+void free_hevc_context(hevc_context_p *context);
+
+/*
+ * "Reset" an HEVC context, after the underlying ES has been moved
+ * (for instance, by reversing or by seeking), so that it does not try to
+ * use a NAL unit it read from the old position.
+ *
+ * Doesn't forget the parameter sets that have been found so far.
+ */
+void reset_hevc_context(hevc_context_p context);
+
+/*
+ * If the last access unit read was ended by finding the first NAL unit of
+ * the next access unit, return that NAL unit (which is where the next
+ * access unit will start), otherwise nullptr.
+ */
+ES_unit_p hevc_pending_unit(hevc_context_p context);
+
+/*
+ * Rewind a file being read as HEVC access units.
+ *
+ * This is a wrapper for `seek_ES` that also knows to unset things
+ * appropriate to the HEVC context.
+ *
+ * If a reverse context is attached to this context, it also will
+ * be "rewound" appropriately.
+ *
+ * Doesn't forget the parameter sets that have been found so far.
+ *
+ * Returns 0 if all goes well, 1 if something goes wrong.
+ */
+int rewind_hevc_context(hevc_context_p context);
+
+/*
+ * Free an HEVC access unit datastructure.
+ *
+ * Clears the datastructure, frees it, and returns `access_unit` as nullptr.
+ *
+ * Does nothing if `access_unit` is already nullptr.
+ */
+void free_hevc_access_unit(hevc_access_unit_p *access_unit);
+
+/*
+ * Retrieve the next access unit from the given HEVC elementary stream.
+ *
+ * - `context` is the HEVC context to read from
+ * - if `irap_data_only` is true, then only IRAP access units keep their
+ *   NAL unit data. Other access units are still returned (so that they can
+ *   be counted, and so that their position and size are known), but with
+ *   an empty ES unit list. This makes skipping from IRAP picture to IRAP
+ *   picture (for fast forward or reverse) much cheaper.
+ * - if `verbose` is true, then each NAL unit is reported on as it is read
+ * - if `quiet` is true, then only errors will be reported
+ * - `access_unit` is the access unit read
+ *
+ * If a reverse context is attached to `context`, then IRAP access units
+ * will be remembered in it.
+ *
+ * Returns 0 if it succeeds, EOF if there is no more data to read, and 1
+ * if some error occurs.
+ *
+ * If command input is enabled, then it can also return COMMAND_RETURN_CODE
+ * if the current command has changed.
+ */
+int get_next_hevc_access_unit(hevc_context_p context, int irap_data_only,
+                              int verbose, int quiet,
+                              hevc_access_unit_p *access_unit);
+
+/*
+ * Write out an HEVC access unit as ES.
+ *
+ * - `access_unit` is the access unit to write out
+ * - `output` is the ES file to write to
+ *
+ * Returns 0 if it succeeds, 1 if some error occurs.
+ */
+int write_hevc_access_unit_as_ES(hevc_access_unit_p access_unit,
+                                 FILE *output);
+
+/*
+ * Write out an HEVC access unit as TS.
+ *
+ * - `access_unit` is the access unit to write out
+ * - `tswriter` is the TS context to write with
+ * - `video_pid` is the PID to use to write the data
+ *
+ * Returns 0 if it succeeds, 1 if some error occurs.
+ */
+int write_hevc_access_unit_as_TS(hevc_access_unit_p access_unit,
+                                 TS_writer_p tswriter, uint32_t video_pid);
+
+/*
+ * Report on an HEVC access unit.
+ *
+ * - if `report_data` is true, then its NAL units are listed as well.
+ */
+void report_hevc_access_unit(hevc_access_unit_p access_unit,
+                             int report_data);
+
+/*
+ * Add a reversing context to an HEVC context (and vice versa).
+ *
+ * The reverse data should have been built with `build_reverse_data()`
+ * with `is_h264` true, since HEVC reversing works just as H.264 does.
+ *
+ * Does not check if there is one present already.
+ *
+ * Returns 0 if all is well, 1 if something goes wrong.
+ */
+int add_hevc_reverse_context(hevc_context_p context,
+                             reverse_data_p reverse_data);
+
+/*
+ * Find IRAP access units, and remember them for later output in
+ * reverse order.
+ *
+ * Only the IRAP access units' data is read in, so this skips through the
+ * rest of the stream as fast as the start code scanner allows.
+ *
+ * - `context` is the HEVC reading context
+ * - if `max` is non-zero, then collecting will stop after `max` access units
+ * - if `verbose` is true, then extra information will be output
+ * - if `quiet` is true, then only errors will be reported
+ *
+ * Returns 0 if all went well, EOF if the end of file is reached,
+ * and 1 if an error occurred.
+ *
+ * If command input is enabled, then it can also return COMMAND_RETURN_CODE
+ * if the current command has changed.
+ */
+int collect_reverse_hevc(hevc_context_p context, int max, int verbose,
+                         int quiet);
+
+/*
+ * Build a new filter context for "stripping" HEVC data
+ *
+ * - `fcontext` is the new filter context
+ * - `hevc` is the HEVC context to read from
+ * - `allref` is true if the software should keep all reference pictures,
+ *   rather than just the IRAP pictures. A sub-layer non-reference picture
+ *   is only dropped if it is in the highest sub-layer (TemporalId) that the
+ *   SPS allows, since otherwise a higher sub-layer may refer to it.
+ *
+ * Returns 0 if all goes well, 1 if something goes wrong
+ */
+int build_hevc_filter_context_strip(hevc_filter_context_p *fcontext,
+                                    hevc_context_p hevc, int allref);
+
+/*
+ * Build a new filter context for "filtering" HEVC data
+ *
+ * - `fcontext` is the new filter context
+ * - `hevc` is the HEVC context to read from
+ * - `freq` is the desired speed-up, or the frequency at which frames
+ *   should (ideally) be kept
+ *
+ * Returns 0 if all goes well, 1 if something goes wrong
+ */
+int build_hevc_filter_context(hevc_filter_context_p *fcontext,
+                              hevc_context_p hevc, int freq);
+
+/*
+ * Reset an HEVC filter context, ready to start filtering anew.
+ */
+void reset_hevc_filter_context(hevc_filter_context_p fcontext);
+
+/*
+ * Free an HEVC filter context
+ *
+ * NOTE that this does *not* free the HEVC context to which the
+ * filter context refers.
+ *
+ * - `fcontext` is the filter context, which will be freed, and returned
+ *   as nullptr.
+ */
+void free_hevc_filter_context(hevc_filter_context_p *fcontext);
+
+/*
+ * Retrieve the next IRAP (and/or, if fcontext->allref, reference) frame
+ * in this HEVC ES.
+ *
+ * Note that the ES data being read should be video-only.
+ *
+ * - `fcontext` is the information that tells us what to filter and how
+ * - if `verbose` is true, then extra information will be output
+ * - if `quiet` is true, then only errors will be reported
+ * - `frame` is the next frame to output.
+ *   Note that it is the caller's responsibility to free this with
+ *   `free_hevc_access_unit()`.
+ *   If an error or EOF is returned, this value is undefined.
+ * - `frames_seen` is the number of frames found by this call
+ *   of the function, including the frame returned.
+ *
+ * Returns 0 if it succeeds, EOF if end-of-file is read, 1 if some error
+ * occurs.
+ *
+ * If command input is enabled, then it can also return COMMAND_RETURN_CODE
+ * if the current command has changed.
+ */
+int get_next_stripped_hevc_frame(hevc_filter_context_p fcontext, int verbose,
+                                 int quiet, hevc_access_unit_p *frame,
+                                 int *frames_seen);
+
+/*
+ * Retrieve the next frame from the HEVC ES, aiming for an "apparent" kept
+ * frequency as stated.
+ *
+ * Only IRAP frames are ever kept, since they are the only ones we can be
+ * sure can be decoded without the frames we are skipping.
+ *
+ * Note that the ES data being read should be video-only.
+ *
+ * - `fcontext` is the information that tells us what to filter and how
+ *   (including the desired frequency)
+ * - if `verbose` is true, then extra information will be output
+ * - if `quiet` is true, then only errors will be reported
+ *
+ * - `frame` is the next frame to output.
+ *
+ *   If the function succeeds and `frame` is nullptr, it means that the
+ *   last frame should be output again.
+ *
+ *   Note that it is the caller's responsibility to free this frame with
+ *   `free_hevc_access_unit()`.
+ *
+ *   If an error or EOF is returned, this value is undefined.
+ *
+ * - `frames_seen` is the number of frames found by this call of the function,
+ *   including the frame returned.
+ *
+ * Returns 0 if all went well, EOF if end-of-file is read, 1 if something
+ * went wrong.
+ *
+ * If command input is enabled, then it can also return COMMAND_RETURN_CODE
+ * if the current command has changed.
+ */
+int get_next_filtered_hevc_frame(hevc_filter_context_p fcontext, int verbose,
+                                 int quiet, hevc_access_unit_p *frame,
+                                 int *frames_seen);
+
+#endif // _hevc_fns
+
+// Local Variables:
+// tab-width: 8
+// indent-tabs-mode: nil
+// c-basic-offset: 2
+// End:
+// vim: set tabstop=8 shiftwidth=2 expandtab:
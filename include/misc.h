@@ -49,6 +49,11 @@
 #include <sys/types.h>
 #include <unistd.h> // open, close
 
+// For the CRC and start code search intrinsics
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
+
 #include "compat.h"
 #include "es_fns.h"
 #include "misc_fns.h"
@@ -60,22 +65,112 @@
 // ============================================================
 // CRC calculation
 // ============================================================
+//
+// The CRC used by MPEG-2 (for PSI sections, etc.) is the non-reflected
+// CRC32 with polynomial 0x04C11DB7, so each byte is taken most significant
+// bit first.
+//
+// crc_table[0] is the traditional byte-at-a-time table. crc_table[k] gives
+// the effect of a byte followed by k zero bytes, which lets us fold eight
+// bytes into the CRC at once ("slicing-by-8").
+//
+// Where the CPU has a carry-less multiply instruction (PCLMULQDQ), we can do
+// better still by folding 16 bytes at a time. Which method to use is decided
+// (once) at run time.
+
+static uint32_t crc_table[8][256];
+
+typedef uint32_t (*crc32_fn)(uint32_t crc, const byte *data, int len);
+static crc32_fn crc32_impl = nullptr;
+static pthread_once_t crc_table_once = PTHREAD_ONCE_INIT;
 
-static uint32_t crc_table[256];
+/*
+ * Compute CRC32 over a block of data, by slicing-by-8.
+ */
+static uint32_t crc32_block_sliced(uint32_t crc, const byte *data, int len) {
+  while (len >= 8) {
+    uint32_t hi = ((uint32_t)data[0] << 24 | (uint32_t)data[1] << 16 |
+                   (uint32_t)data[2] << 8 | data[3]) ^
+                  crc;
+    crc = crc_table[7][hi >> 24] ^ crc_table[6][(hi >> 16) & 0xff] ^
+          crc_table[5][(hi >> 8) & 0xff] ^ crc_table[4][hi & 0xff] ^
+          crc_table[3][data[4]] ^ crc_table[2][data[5]] ^
+          crc_table[1][data[6]] ^ crc_table[0][data[7]];
+    data += 8;
+    len -= 8;
+  }
+  while (len-- > 0)
+    crc = (crc << 8) ^ crc_table[0][((crc >> 24) ^ *data++) & 0xff];
+  return crc;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+// x^192 mod P and x^128 mod P, for folding 128 bits forwards by 128 bits
+static uint64_t crc_fold_k1 = 0;
+static uint64_t crc_fold_k2 = 0;
 
 /*
- * Populate the (internal) CRC table. May safely be called more than once.
+ * Compute CRC32 over a block of data, by folding with carry-less multiply.
+ *
+ * The data is loaded 16 bytes at a time and byte reversed, so that the
+ * first bit of the data is the top bit of the 128 bit value. The running
+ * value is repeatedly multiplied forwards past the next 16 bytes and added
+ * to them. What is left is then reduced to 32 bits by the table method.
+ */
+__attribute__((target("pclmul,ssse3"))) static uint32_t
+crc32_block_clmul(uint32_t crc, const byte *data, int len) {
+  const __m128i reverse =
+      _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+  const __m128i k = _mm_set_epi64x((long long)crc_fold_k1,
+                                   (long long)crc_fold_k2);
+  byte folded[16];
+  __m128i x;
+
+  if (len < 32)
+    return crc32_block_sliced(crc, data, len);
+
+  x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)data), reverse);
+  x = _mm_xor_si128(x, _mm_set_epi32((int)crc, 0, 0, 0));
+  data += 16;
+  len -= 16;
+  while (len >= 16) {
+    __m128i next =
+        _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)data), reverse);
+    __m128i hi = _mm_clmulepi64_si128(x, k, 0x11);
+    __m128i lo = _mm_clmulepi64_si128(x, k, 0x00);
+    x = _mm_xor_si128(_mm_xor_si128(hi, lo), next);
+    data += 16;
+    len -= 16;
+  }
+  _mm_storeu_si128((__m128i *)folded, _mm_shuffle_epi8(x, reverse));
+  crc = crc32_block_sliced(0, folded, 16);
+  return crc32_block_sliced(crc, data, len);
+}
+
+/*
+ * Return x^n modulo the CRC polynomial
+ */
+static uint32_t crc_x_pow_mod(int n) {
+  uint32_t value = 1;
+  while (n-- > 0) {
+    if (value & 0x80000000L)
+      value = (value << 1) ^ CRC32_POLY;
+    else
+      value = (value << 1);
+  }
+  return value;
+}
+#endif // __x86_64__ && __GNUC__
+
+/*
+ * Populate the (internal) CRC tables, and choose how to calculate CRCs.
+ *
+ * Called (once) via pthread_once.
  */
 static void make_crc_table(void) {
   int i, j;
-  int already_done = 0;
   uint32_t crc;
 
-  if (already_done)
-    return;
-  else
-    already_done = 1;
-
   for (i = 0; i < 256; i++) {
     crc = i << 24;
     for (j = 0; j < 8; j++) {
@@ -84,12 +179,28 @@ static void make_crc_table(void) {
       else
         crc = (crc << 1);
     }
-    crc_table[i] = crc;
+    crc_table[0][i] = crc;
+  }
+  for (i = 0; i < 256; i++) {
+    for (j = 1; j < 8; j++) {
+      crc = crc_table[j - 1][i];
+      crc_table[j][i] = (crc << 8) ^ crc_table[0][crc >> 24];
+    }
+  }
+
+  crc32_impl = crc32_block_sliced;
+#if defined(__x86_64__) && defined(__GNUC__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3")) {
+    crc_fold_k1 = crc_x_pow_mod(192);
+    crc_fold_k2 = crc_x_pow_mod(128);
+    crc32_impl = crc32_block_clmul;
   }
+#endif
 }
 
 /*
- * Compute CRC32 over a block of data, by table method.
+ * Compute CRC32 over a block of data, using the fastest method available.
  *
  * Returns a working value, suitable for re-input for further blocks
  *
@@ -98,17 +209,149 @@ static void make_crc_table(void) {
  *        needs complementing before being passed back in).
  */
 uint32_t crc32_block(uint32_t crc, byte *pData, int blk_len) {
-  static int table_made = false;
-  int i, j;
+  (void)pthread_once(&crc_table_once, make_crc_table);
+  return crc32_impl(crc, pData, blk_len);
+}
 
-  if (!table_made)
-    make_crc_table();
+// ============================================================
+// Start code prefix search
+// ============================================================
+//
+// Splitting ES data into units means finding each 00 00 01 start code
+// prefix, which is (nearly) all the time spent reading a large ES file.
+// Rather than looking at each byte in turn, we compare 16 (SSE2) or 32
+// (AVX2) positions at once, or else let memchr find the candidate 01 bytes.
+// Which method to use is decided (once) at run time.
+//
+// The same search, for 00 00 03, finds H.264 emulation prevention bytes.
+
+typedef int (*start_code_fn)(const byte *data, int data_len, byte last);
+static start_code_fn start_code_impl = nullptr;
+static pthread_once_t start_code_once = PTHREAD_ONCE_INIT;
 
-  for (j = 0; j < blk_len; j++) {
-    i = ((crc >> 24) ^ *pData++) & 0xff;
-    crc = (crc << 8) ^ crc_table[i];
+/*
+ * Find the first 00 00 `last` in a byte array, by looking for its `last`
+ * byte (which must not be 00) with memchr
+ */
+static int find_start_code_memchr(const byte *data, int data_len, byte last) {
+  const byte *end = data + data_len;
+  const byte *ptr = data + 2;
+
+  while (ptr < end) {
+    ptr = (const byte *)memchr(ptr, last, end - ptr);
+    if (ptr == nullptr)
+      return -1;
+    if (ptr[-1] == 0x00 && ptr[-2] == 0x00)
+      return (ptr - data) - 2;
+    // Since this byte is not 00, neither of the next two can end a prefix
+    ptr += 3;
   }
-  return crc;
+  return -1;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+/*
+ * Find the first 00 00 `last` in a byte array, 16 positions at a time
+ */
+__attribute__((target("sse2"))) static int
+find_start_code_sse2(const byte *data, int data_len, byte last) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i want = _mm_set1_epi8((char)last);
+  int posn = 0;
+
+  // Each time round, we look at the prefixes starting at posn..posn+15,
+  // which needs the bytes up to posn+17
+  for (; posn + 18 <= data_len; posn += 16) {
+    __m128i b0 = _mm_loadu_si128((const __m128i *)(data + posn));
+    __m128i b1 = _mm_loadu_si128((const __m128i *)(data + posn + 1));
+    __m128i b2 = _mm_loadu_si128((const __m128i *)(data + posn + 2));
+    __m128i found = _mm_and_si128(
+        _mm_and_si128(_mm_cmpeq_epi8(b0, zero), _mm_cmpeq_epi8(b1, zero)),
+        _mm_cmpeq_epi8(b2, want));
+    int mask = _mm_movemask_epi8(found);
+    if (mask != 0)
+      return posn + __builtin_ctz(mask);
+  }
+  if (posn < data_len) {
+    int rest = find_start_code_memchr(data + posn, data_len - posn, last);
+    if (rest >= 0)
+      return posn + rest;
+  }
+  return -1;
+}
+
+/*
+ * Find the first 00 00 `last` in a byte array, 32 positions at a time
+ */
+__attribute__((target("avx2"))) static int
+find_start_code_avx2(const byte *data, int data_len, byte last) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i want = _mm256_set1_epi8((char)last);
+  int posn = 0;
+
+  for (; posn + 34 <= data_len; posn += 32) {
+    __m256i b0 = _mm256_loadu_si256((const __m256i *)(data + posn));
+    __m256i b1 = _mm256_loadu_si256((const __m256i *)(data + posn + 1));
+    __m256i b2 = _mm256_loadu_si256((const __m256i *)(data + posn + 2));
+    __m256i found = _mm256_and_si256(
+        _mm256_and_si256(_mm256_cmpeq_epi8(b0, zero),
+                         _mm256_cmpeq_epi8(b1, zero)),
+        _mm256_cmpeq_epi8(b2, want));
+    unsigned mask = (unsigned)_mm256_movemask_epi8(found);
+    if (mask != 0)
+      return posn + __builtin_ctz(mask);
+  }
+  if (posn < data_len) {
+    int rest = find_start_code_sse2(data + posn, data_len - posn, last);
+    if (rest >= 0)
+      return posn + rest;
+  }
+  return -1;
+}
+#endif // __x86_64__ && __GNUC__
+
+/*
+ * Choose how to search for start code prefixes.
+ *
+ * Called (once) via pthread_once.
+ */
+static void choose_start_code_search(void) {
+  start_code_impl = find_start_code_memchr;
+#if defined(__x86_64__) && defined(__GNUC__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    start_code_impl = find_start_code_avx2;
+  else if (__builtin_cpu_supports("sse2"))
+    start_code_impl = find_start_code_sse2;
+#endif
+}
+
+/*
+ * Find the first 00 00 01 start code prefix in a byte array, using the
+ * fastest method available.
+ *
+ * Returns the offset of the first 00 of the prefix, or -1 if there is no
+ * (complete) start code prefix in the array.
+ */
+int find_start_code_prefix(const byte *data, int data_len) {
+  if (data_len < 3)
+    return -1;
+  (void)pthread_once(&start_code_once, choose_start_code_search);
+  return start_code_impl(data, data_len, 0x01);
+}
+
+/*
+ * Find the first 00 00 03 emulation prevention sequence in a byte array,
+ * using the fastest method available.
+ *
+ * Returns the offset of the first 00 of the sequence, or -1 if there is no
+ * (complete) such sequence in the array.
+ */
+int find_emulation_prevention(const byte *data, int data_len) {
+  if (data_len < 3)
+    return -1;
+  (void)pthread_once(&start_code_once, choose_start_code_search);
+  return start_code_impl(data, data_len, 0x03);
 }
 
 /*
@@ -349,6 +592,267 @@ int close_file(int filedes) {
     return 0;
 }
 
+// ============================================================
+// Asynchronous read-ahead
+// ============================================================
+/*
+ * The body of the read-ahead thread: keep filling empty buffers until we're
+ * told to stop.
+ *
+ * The thread only holds the lock whilst deciding which buffer to fill, and
+ * whilst handing it over afterwards, so the caller can always get at the
+ * buffers that are already full. Cancellation is only enabled whilst we're
+ * actually reading, so that we can't be stuck waiting on a quiet pipe when
+ * asked to stop.
+ */
+static void *async_read_thread(void *arg) {
+  async_reader_p reader = (async_reader_p)arg;
+
+  (void)pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, nullptr);
+  pthread_mutex_lock(&reader->lock);
+  for (;;) {
+    while (!reader->stopping &&
+           (reader->finished || reader->count == reader->num_buffers))
+      pthread_cond_wait(&reader->emptied, &reader->lock);
+    if (reader->stopping)
+      break;
+
+    int which = (reader->first + reader->count) % reader->num_buffers;
+    int generation = reader->generation;
+    offset_t posn = reader->next_posn;
+    byte *buffer = reader->buffer[which];
+    ssize_t total = 0;
+    ssize_t length = 0;
+    int error = 0;
+    pthread_mutex_unlock(&reader->lock);
+
+    (void)pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, nullptr);
+    if (reader->seekable) {
+      // Fill the whole buffer if we can, allowing for short reads
+      while ((size_t)total < reader->buffer_size) {
+        length = pread(reader->file, buffer + total,
+                       reader->buffer_size - total, posn + total);
+        if (length == 0)
+          break;
+        else if (length == -1) {
+          if (errno == EINTR)
+            continue;
+          error = errno;
+          break;
+        }
+        total += length;
+      }
+    } else {
+      // For a pipe, take whatever we're given, so we don't sit on it
+      do
+        length = read(reader->file, buffer, reader->buffer_size);
+      while (length == -1 && errno == EINTR);
+      if (length == -1)
+        error = errno;
+      else
+        total = length;
+    }
+    (void)pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, nullptr);
+
+    pthread_mutex_lock(&reader->lock);
+    if (generation != reader->generation)
+      continue; // someone seeked whilst we were reading - forget it
+    if (total > 0) {
+      reader->length[which] = total;
+      reader->count++;
+      reader->next_posn += total;
+    }
+    if (error != 0 || length == 0) {
+      reader->finished = true;
+      reader->error = error;
+    }
+    pthread_cond_signal(&reader->filled);
+  }
+  pthread_mutex_unlock(&reader->lock);
+  return nullptr;
+}
+
+/*
+ * Start reading a file asynchronously.
+ *
+ * A separate thread is started, which keeps up to `num_buffers` buffers of
+ * `buffer_size` bytes filled with the data following the current position
+ * in the file, so that the next chunk of the file is already arriving while
+ * the caller is dealing with the last. `async_read` is then used instead of
+ * read() on the file.
+ *
+ * - `file` is the file to read from. If it is seekable, then the thread
+ *   uses pread(), starting at the current position in the file, and
+ *   `seek_async_reader` may be used. Otherwise (e.g., for a pipe) it just
+ *   uses read().
+ * - `num_buffers` is how many buffers to use, between 2 and
+ *   ASYNC_READ_MAX_BUFFERS.
+ * - `buffer_size` is the size of each, or 0 for ASYNC_READ_BUFFER_SIZE.
+ * - `reader` is the new asynchronous reader.
+ *
+ * Returns 0 if all goes well, 1 if something goes wrong.
+ */
+int build_async_reader(int file, int num_buffers, size_t buffer_size,
+                       async_reader_p *reader) {
+  int ii, err;
+  offset_t posn;
+  async_reader_p new2;
+
+  if (num_buffers < 2 || num_buffers > ASYNC_READ_MAX_BUFFERS) {
+    fprint_err("### Cannot read ahead with %d buffers (must be 2..%d)\n",
+               num_buffers, ASYNC_READ_MAX_BUFFERS);
+    return 1;
+  }
+  if (buffer_size == 0)
+    buffer_size = ASYNC_READ_BUFFER_SIZE;
+
+  new2 = (async_reader_p)malloc(SIZEOF_ASYNC_READER);
+  if (new2 == nullptr) {
+    print_err("### Unable to allocate asynchronous reader\n");
+    return 1;
+  }
+  memset(new2, '\0', SIZEOF_ASYNC_READER);
+
+  for (ii = 0; ii < num_buffers; ii++) {
+    new2->buffer[ii] = (byte *)malloc(buffer_size);
+    if (new2->buffer[ii] == nullptr) {
+      print_err("### Unable to allocate asynchronous read buffers\n");
+      for (ii--; ii >= 0; ii--)
+        free(new2->buffer[ii]);
+      free(new2);
+      return 1;
+    }
+  }
+
+  posn = lseek(file, 0, SEEK_CUR);
+  new2->file = file;
+  new2->seekable = (posn != -1);
+  new2->next_posn = (posn == -1 ? 0 : posn);
+  new2->buffer_size = buffer_size;
+  new2->num_buffers = num_buffers;
+
+  pthread_mutex_init(&new2->lock, nullptr);
+  pthread_cond_init(&new2->filled, nullptr);
+  pthread_cond_init(&new2->emptied, nullptr);
+
+  err = pthread_create(&new2->thread, nullptr, async_read_thread, new2);
+  if (err) {
+    fprint_err("### Unable to start read-ahead thread: %s\n", strerror(err));
+    pthread_mutex_destroy(&new2->lock);
+    pthread_cond_destroy(&new2->filled);
+    pthread_cond_destroy(&new2->emptied);
+    for (ii = 0; ii < num_buffers; ii++)
+      free(new2->buffer[ii]);
+    free(new2);
+    return 1;
+  }
+
+  *reader = new2;
+  return 0;
+}
+
+/*
+ * Stop an asynchronous reader's thread, and free it.
+ *
+ * Does not close the file. Sets `reader` to nullptr.
+ */
+void free_async_reader(async_reader_p *reader) {
+  int ii;
+  async_reader_p old = *reader;
+
+  if (old == nullptr)
+    return;
+
+  pthread_mutex_lock(&old->lock);
+  old->stopping = true;
+  pthread_cond_signal(&old->emptied);
+  pthread_mutex_unlock(&old->lock);
+  // If it's in the middle of a read, there's no need to wait for it
+  (void)pthread_cancel(old->thread);
+  (void)pthread_join(old->thread, nullptr);
+
+  pthread_mutex_destroy(&old->lock);
+  pthread_cond_destroy(&old->filled);
+  pthread_cond_destroy(&old->emptied);
+  for (ii = 0; ii < old->num_buffers; ii++)
+    free(old->buffer[ii]);
+  free(old);
+  *reader = nullptr;
+}
+
+/*
+ * Read up to `num_bytes` bytes from an asynchronous reader.
+ *
+ * This behaves like read(), and in particular may return fewer bytes than
+ * were asked for (it never returns data from more than one buffer at once).
+ *
+ * Returns the number of bytes read, 0 at end of file, or -1 if an error
+ * occurred (in which case `errno` is set appropriately).
+ */
+ssize_t async_read(async_reader_p reader, byte *data, size_t num_bytes) {
+  size_t length;
+  byte *buffer;
+
+  pthread_mutex_lock(&reader->lock);
+  while (reader->count == 0 && !reader->finished)
+    pthread_cond_wait(&reader->filled, &reader->lock);
+  if (reader->count == 0) {
+    int error = reader->error;
+    pthread_mutex_unlock(&reader->lock);
+    if (error == 0)
+      return 0;
+    errno = error;
+    return -1;
+  }
+  buffer = reader->buffer[reader->first];
+  length = reader->length[reader->first] - reader->used;
+  pthread_mutex_unlock(&reader->lock);
+
+  // The full buffers are ours, so there's no need to hold the lock whilst
+  // we copy from one
+  if (length > num_bytes)
+    length = num_bytes;
+  memcpy(data, buffer + reader->used, length);
+  reader->used += length;
+
+  if (reader->used == (size_t)reader->length[reader->first]) {
+    // Give the buffer back to the thread
+    pthread_mutex_lock(&reader->lock);
+    reader->first = (reader->first + 1) % reader->num_buffers;
+    reader->count--;
+    reader->used = 0;
+    pthread_cond_signal(&reader->emptied);
+    pthread_mutex_unlock(&reader->lock);
+  }
+  return length;
+}
+
+/*
+ * Reposition an asynchronous reader, discarding any data already read
+ * ahead.
+ *
+ * Returns 0 if all went well, 1 if the file is not seekable.
+ */
+int seek_async_reader(async_reader_p reader, offset_t posn) {
+  if (!reader->seekable) {
+    fprint_err("### Error moving (seeking) to position " OFFSET_T_FORMAT
+               " in file: it is not seekable\n",
+               posn);
+    return 1;
+  }
+  pthread_mutex_lock(&reader->lock);
+  reader->generation++;
+  reader->next_posn = posn;
+  reader->first = 0;
+  reader->count = 0;
+  reader->used = 0;
+  reader->finished = false;
+  reader->error = 0;
+  pthread_cond_signal(&reader->emptied);
+  pthread_mutex_unlock(&reader->lock);
+  return 0;
+}
+
 // ============================================================
 // More complex file I/O utilities
 // ============================================================
@@ -390,6 +894,7 @@ static int open_input_as_ES_using_PES(char *name, int quiet,
       fprint_msg("Reading input as %s\n",
                  (*is_data == VIDEO_H262   ? "MPEG-2 (H.262)"
                   : *is_data == VIDEO_H264 ? "MPEG-4/AVC (H.264)"
+                  : *is_data == VIDEO_H265 ? "HEVC (H.265)"
                   : *is_data == VIDEO_AVS  ? "AVS"
                                            : "???"));
   } else {
@@ -433,6 +938,7 @@ static int open_input_as_ES_direct(char *name, int quiet, int force_stream_type,
       fprint_msg("Reading input as %s\n",
                  (*is_data == VIDEO_H262   ? "MPEG-2 (H.262)"
                   : *is_data == VIDEO_H264 ? "MPEG-4/AVC (H.264)"
+                  : *is_data == VIDEO_H265 ? "HEVC (H.265)"
                   : *is_data == VIDEO_AVS  ? "AVS"
                                            : "???"));
   } else {
@@ -468,6 +974,7 @@ static int open_input_as_ES_direct(char *name, int quiet, int force_stream_type,
       fprint_msg("Input appears to be %s\n",
                  (*is_data == VIDEO_H262      ? "MPEG-2 (H.262)"
                   : *is_data == VIDEO_H264    ? "MPEG-4/AVC (H.264)"
+                  : *is_data == VIDEO_H265    ? "HEVC (H.265)"
                   : *is_data == VIDEO_AVS     ? "AVS"
                   : *is_data == VIDEO_UNKNOWN ? "Unknown"
                                               : "???"));
@@ -494,7 +1001,7 @@ static int open_input_as_ES_direct(char *name, int quiet, int force_stream_type,
  *   might be deduced from looking at the file itself.
  *
  * - If `force_stream_type` is true, then `want_data` should be one of
- *   VIDEO_H262, VIDEO_H264 or VIDEO_AVS. `is_data` will then be
+ *   VIDEO_H262, VIDEO_H264, VIDEO_H265 or VIDEO_AVS. `is_data` will then be
  *   returned with the same value.
  *
  * - If `force_stream_type` is false, then the function will attempt
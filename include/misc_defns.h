@@ -29,6 +29,8 @@
 #ifndef _misc_defns
 #define _misc_defns
 
+#include <pthread.h>
+
 #include "tswrite_defns.h"
 #include "video_defns.h"
 
@@ -54,6 +56,43 @@ typedef union _writer WRITER;
 // A simple macro to return a bit from a bitfield, for use in printf()
 #define ON(byt, msk) ((byt & msk) ? 1 : 0)
 
+// ------------------------------------------------------------
+// Asynchronous read-ahead
+// A thread that keeps reading the next few buffers of a file while the
+// caller is still busy with the data it already has (see
+// `build_async_reader`). The thread owns the buffers that are not yet
+// full, and the caller owns the full ones.
+#define ASYNC_READ_MAX_BUFFERS 8
+#define ASYNC_READ_BUFFERS 3 // what the utilities use for -async
+#define ASYNC_READ_BUFFER_SIZE (1024 * 1024)
+
+struct _async_reader {
+  int file;           // the file to read from
+  int seekable;       // true if we can use pread() (and thus seek)
+  offset_t next_posn; // where the thread should read from next
+  size_t buffer_size; // the size of each buffer
+
+  int num_buffers;
+  byte *buffer[ASYNC_READ_MAX_BUFFERS];
+  ssize_t length[ASYNC_READ_MAX_BUFFERS]; // how much data each one holds
+
+  int first;   // the oldest full buffer, which the caller is reading from
+  int count;   // how many full buffers there are
+  size_t used; // how much of buffer[first] the caller has already used
+
+  int finished;   // the thread read EOF (or an error)
+  int error;      // if it was an error, the errno for it
+  int generation; // changed on each seek, so stale reads can be discarded
+  int stopping;   // the thread should exit
+
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t filled;  // signalled when a buffer becomes full
+  pthread_cond_t emptied; // signalled when a buffer is given back
+};
+typedef struct _async_reader *async_reader_p;
+#define SIZEOF_ASYNC_READER sizeof(struct _async_reader)
+
 #endif // _misc_defns
 
 // Local Variables:
@@ -12,7 +12,7 @@
 #define CRC32_POLY 0x04c11db7L
 
 /*
- * Compute CRC32 over a block of data, by table method.
+ * Compute CRC32 over a block of data, using the fastest method available.
  *
  * Returns a working value, suitable for re-input for further blocks
  *
@@ -22,6 +22,24 @@
  */
 uint32_t crc32_block(uint32_t crc, byte *pData, int blk_len);
 
+/*
+ * Find the first 00 00 01 start code prefix in a byte array, using the
+ * fastest method available.
+ *
+ * Returns the offset of the first 00 of the prefix, or -1 if there is no
+ * (complete) start code prefix in the array.
+ */
+int find_start_code_prefix(const byte *data, int data_len);
+
+/*
+ * Find the first 00 00 03 emulation prevention sequence in a byte array,
+ * using the fastest method available.
+ *
+ * Returns the offset of the first 00 of the sequence, or -1 if there is no
+ * (complete) such sequence in the array.
+ */
+int find_emulation_prevention(const byte *data, int data_len);
+
 /*
  * Print out the bottom N bits from a byte
  */
@@ -138,6 +156,55 @@ int open_binary_file(char *filename, int for_write);
  */
 int close_file(int filedes);
 
+// ============================================================
+// Asynchronous read-ahead
+// ============================================================
+/*
+ * Start reading a file asynchronously.
+ *
+ * A separate thread is started, which keeps up to `num_buffers` buffers of
+ * `buffer_size` bytes filled with the data following the current position
+ * in the file, so that the next chunk of the file is already arriving while
+ * the caller is dealing with the last. `async_read` is then used instead of
+ * read() on the file.
+ *
+ * - `file` is the file to read from. If it is seekable, then the thread
+ *   uses pread(), starting at the current position in the file, and
+ *   `seek_async_reader` may be used. Otherwise (e.g., for a pipe) it just
+ *   uses read().
+ * - `num_buffers` is how many buffers to use, between 2 and
+ *   ASYNC_READ_MAX_BUFFERS.
+ * - `buffer_size` is the size of each, or 0 for ASYNC_READ_BUFFER_SIZE.
+ * - `reader` is the new asynchronous reader.
+ *
+ * Returns 0 if all goes well, 1 if something goes wrong.
+ */
+int build_async_reader(int file, int num_buffers, size_t buffer_size,
+                       async_reader_p *reader);
+/*
+ * Stop an asynchronous reader's thread, and free it.
+ *
+ * Does not close the file. Sets `reader` to nullptr.
+ */
+void free_async_reader(async_reader_p *reader);
+/*
+ * Read up to `num_bytes` bytes from an asynchronous reader.
+ *
+ * This behaves like read(), and in particular may return fewer bytes than
+ * were asked for (it never returns data from more than one buffer at once).
+ *
+ * Returns the number of bytes read, 0 at end of file, or -1 if an error
+ * occurred (in which case `errno` is set appropriately).
+ */
+ssize_t async_read(async_reader_p reader, byte *data, size_t num_bytes);
+/*
+ * Reposition an asynchronous reader, discarding any data already read
+ * ahead.
+ *
+ * Returns 0 if all went well, 1 if the file is not seekable.
+ */
+int seek_async_reader(async_reader_p reader, offset_t posn);
+
 // ============================================================
 // More complex file I/O utilities
 // ============================================================
@@ -160,7 +227,7 @@ int close_file(int filedes);
  *   might be deduced from looking at the file itself.
  *
  * - If `force_stream_type` is true, then `want_data` should be one of
- *   VIDEO_H262, VIDEO_H264 or VIDEO_AVS. `is_data` will then be
+ *   VIDEO_H262, VIDEO_H264, VIDEO_H265 or VIDEO_AVS. `is_data` will then be
  *   returned with the same value.
  *
  * - If `force_stream_type` is false, then the function will attempt
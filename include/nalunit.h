@@ -54,6 +54,22 @@ void set_show_nal_reading_details(nal_unit_context_p context, int show) {
   context->show_nal_details = show;
 }
 
+/*
+ * Only decode as much of each NAL unit as access unit boundary detection
+ * needs.
+ *
+ * If `headers_only` is true, then `find_next_NAL_unit` decodes the slice
+ * headers and the sequence and picture parameter sets, but leaves the
+ * innards of any other NAL unit (SEI, for instance) alone. Call
+ * `decode_nal_unit` to decode such a NAL unit later on, if it turns out
+ * to be wanted.
+ *
+ * This is ignored if details of the NAL unit contents are being shown.
+ */
+void set_nal_headers_only(nal_unit_context_p context, int headers_only) {
+  context->headers_only = headers_only;
+}
+
 // ------------------------------------------------------------
 // NAL unit context
 // ------------------------------------------------------------
@@ -72,12 +88,15 @@ int build_nal_unit_context(ES_p es, nal_unit_context_p *context) {
   new2->es = es;
   new2->count = 0;
   new2->show_nal_details = false;
-  err = build_param_dict(&new2->seq_param_dict);
+  new2->headers_only = false;
+  new2->rbsp = nullptr;
+  new2->rbsp_size = 0;
+  err = build_param_dict(&new2->seq_param_dict, NAL_MAX_SEQ_PARAM_SETS);
   if (err) {
     free(new2);
     return err;
   }
-  err = build_param_dict(&new2->pic_param_dict);
+  err = build_param_dict(&new2->pic_param_dict, NAL_MAX_PIC_PARAM_SETS);
   if (err) {
     free_param_dict(&new2->seq_param_dict);
     free(new2);
@@ -102,6 +121,8 @@ void free_nal_unit_context(nal_unit_context_p *context) {
 
   free_param_dict(&cc->seq_param_dict);
   free_param_dict(&cc->pic_param_dict);
+  if (cc->rbsp != nullptr)
+    free(cc->rbsp);
 
   free(*context);
   *context = nullptr;
@@ -209,66 +230,83 @@ void free_nal_unit(nal_unit_p *nal) {
  * 0xxx can take, but we shall assume that they have been followed
  * by the encoder).  See H.264 7.3.1
  *
+ * Rather than looking at each byte in turn, we search for the next
+ * 00 00 03 sequence, and copy everything before it in one go.
+ *
  * - `data` is the NAL unit data array, including the first byte,
  *   which contains the nal_ref_idc and nal_unit_type.
  * - `rbsp` is the processed data, not including said first byte.
- *
- * Returns 0 if it succeeds, 1 if some error occurs.
+ *   It must have room for at least `data_len` bytes.
  */
-static int remove_emulation_prevention(byte data[], int data_len, byte *rbsp[],
-                                       int *rbsp_len) {
-  int ii;
+static void remove_emulation_prevention(byte data[], int data_len, byte rbsp[],
+                                        int *rbsp_len) {
   int posn = 0;
-  byte prev1 = 27; // J. Random Number
-  byte prev2 = 27;
-  byte *tgt = nullptr;
-
-  // We know we're going to produce data that is no longer than our input
-  tgt = (byte *)malloc(data_len);
-  if (tgt == nullptr) {
-    print_err("### Cannot malloc RBSP target array\n");
-    return 1;
-  }
-
-  for (ii = 1; ii < data_len; ii++) // NB: ignoring that first byte
-  {
-    if (prev2 == 0x00 && prev1 == 0x00 && data[ii] == 0x03)
-      ; // ignore the emulation prevention 03 byte
-    else
-      tgt[posn++] = data[ii];
-    prev2 = prev1;
-    prev1 = data[ii];
+  int from = 1; // NB: ignoring that first byte
+
+  while (from < data_len) {
+    int offset = find_emulation_prevention(&data[from], data_len - from);
+    int run = (offset < 0 ? data_len - from : offset + 2);
+    memcpy(&rbsp[posn], &data[from], run);
+    posn += run;
+    from += run;
+    if (offset >= 0)
+      from++; // ignore the emulation prevention 03 byte
   }
-  *rbsp = tgt;
   *rbsp_len = posn;
-  return 0;
 }
 
 /*
  * Prepare for reading bit data from the RBSP.
  *
+ * - `context` is the NAL unit context we're reading from. If this is not
+ *   nullptr, then its scratch RBSP array and bitdata are used, rather than
+ *   allocating new ones for this NAL unit, and slices (which are large, and
+ *   of which we only want the header) are read in place, without removing
+ *   the emulation prevention bytes from the whole of their data first.
+ *
  * (Note that calling this more than once is safe.)
  *
  * Returns 0 if it succeeds, 1 if some error occurs.
  */
-static inline int prepare_rbsp(nal_unit_p nal) {
+static inline int prepare_rbsp(nal_unit_context_p context, nal_unit_p nal) {
   int err;
   bitdata_p bd = nullptr;
 
   if (nal->bit_data != nullptr)
     return 0;
 
-  // Only remove the emulation 03 bytes when we think we need to
-  // (of course, we *could* do this as part of the bitdata byte
-  // reading code, but unless/until it's clear that the tradeoff
-  // in time/complexity is worth it, let's not bother).
+  if (context != nullptr) {
+    if (nal_is_slice(nal)) {
+      setup_bitdata(&context->bits, &nal->data[1], nal->data_len - 1, true);
+    } else {
+      if (nal->data_len > context->rbsp_size) {
+        byte *newbuf = (byte *)realloc(context->rbsp, nal->data_len);
+        if (newbuf == nullptr) {
+          print_err("### Cannot extend RBSP scratch array\n");
+          return 1;
+        }
+        context->rbsp = newbuf;
+        context->rbsp_size = nal->data_len;
+      }
+      remove_emulation_prevention(nal->data, nal->data_len, context->rbsp,
+                                  &(nal->rbsp_len));
+      nal->rbsp = context->rbsp;
+      setup_bitdata(&context->bits, nal->rbsp, nal->rbsp_len, false);
+    }
+    nal->bit_data = &context->bits;
+    return 0;
+  }
+
+  // Without a context, we must make our own RBSP
   if (nal->rbsp == nullptr) {
-    err = remove_emulation_prevention(nal->data, nal->data_len, &(nal->rbsp),
-                                      &(nal->rbsp_len));
-    if (err) {
-      print_err("### Error removing emulation prevention bytes\n");
+    // We know we're going to produce data that is no longer than our input
+    nal->rbsp = (byte *)malloc(nal->data_len);
+    if (nal->rbsp == nullptr) {
+      print_err("### Cannot malloc RBSP target array\n");
       return 1;
     }
+    remove_emulation_prevention(nal->data, nal->data_len, nal->rbsp,
+                                &(nal->rbsp_len));
   }
 
   err = build_bitdata(&bd, nal->rbsp, nal->rbsp_len);
@@ -280,6 +318,26 @@ static inline int prepare_rbsp(nal_unit_p nal) {
   return 0;
 }
 
+/*
+ * Forget a NAL unit's RBSP (and bitdata), after we've finished reading it.
+ *
+ * If they belong to `context`, they are just left for the next NAL unit.
+ */
+static inline void release_rbsp(nal_unit_context_p context, nal_unit_p nal) {
+  if (context != nullptr && nal->bit_data == &context->bits) {
+    nal->bit_data = nullptr;
+    nal->rbsp = nullptr;
+    nal->rbsp_len = 0;
+    return;
+  }
+  if (nal->rbsp != nullptr) {
+    free(nal->rbsp);
+    nal->rbsp = nullptr;
+    nal->rbsp_len = 0;
+  }
+  free_bitdata(&nal->bit_data);
+}
+
 /*
  * Look at the start of the slice header.
  *
@@ -860,6 +918,9 @@ static int read_SEI(nal_unit_p nal, int show_nal_details) {
  * Decodes some or all of the data for slices, sequence parameter sets
  * and picture parameter sets.
  *
+ * `context` may be nullptr, in which case the RBSP is built in an array of
+ * its own, rather than the context's scratch array.
+ *
  * (Note that calling this more than once does not read the data
  * more than once. Also note that the RBSP and bitdata datastructures
  * in the NAL unit do not persist after this call.)
@@ -874,16 +935,21 @@ static int read_SEI(nal_unit_p nal, int show_nal_details) {
  *
  * Returns 0 if it succeeds, 1 if some error occurs.
  */
-static int read_rbsp_data(nal_unit_p nal, param_dict_p seq_param_dict,
+static int read_rbsp_data(nal_unit_context_p context, nal_unit_p nal,
+                          param_dict_p seq_param_dict,
                           param_dict_p pic_param_dict, int show_nal_details) {
   int err = 0;
 
   if (nal->decoded)
     return 0;
 
-  err = prepare_rbsp(nal);
-  if (err)
-    return err;
+  // There's no point extracting the RBSP of a NAL unit we don't interpret
+  if (nal_is_slice(nal) || nal->nal_unit_type == 6 ||
+      nal->nal_unit_type == 7 || nal->nal_unit_type == 8) {
+    err = prepare_rbsp(context, nal);
+    if (err)
+      return err;
+  }
 
   if (nal->nal_unit_type == 1 ||
       nal->nal_unit_type == 5) // Coded slice of a (non) IDR picture
@@ -912,12 +978,7 @@ static int read_rbsp_data(nal_unit_p nal, param_dict_p seq_param_dict,
 
   // At this point, we've finished with the actual RBSP data
   // so we might as well free it and save some space.
-  if (nal->rbsp != nullptr) {
-    free(nal->rbsp);
-    nal->rbsp = nullptr;
-    nal->rbsp_len = 0;
-    free_bitdata(&nal->bit_data);
-  }
+  release_rbsp(context, nal);
   return err;
 }
 
@@ -1144,7 +1205,8 @@ void report_nal(int is_msg, nal_unit_p nal) {
  * This function should be called on the first sequence parameter set
  * NAL unit in the bitstream, after its innards have been decoded.
  */
-static void check_profile(nal_unit_p nal, int show_nal_details) {
+static void check_profile(nal_unit_context_p context, nal_unit_p nal,
+                          int show_nal_details) {
   struct nal_seq_param_data data;
   char *name;
 
@@ -1160,7 +1222,7 @@ static void check_profile(nal_unit_p nal, int show_nal_details) {
     // Note that we believe ourselves safe in passing nullptrs for the
     // parameter NAL units, since we are reading a sequence parameter set,
     // which does not depend on anything else
-    int err = read_rbsp_data(nal, nullptr, nullptr, show_nal_details);
+    int err = read_rbsp_data(context, nal, nullptr, nullptr, show_nal_details);
     if (err) {
       print_err("### Error trying to decode RBSP for first sequence"
                 " parameter set\n");
@@ -1317,19 +1379,25 @@ int find_next_NAL_unit(nal_unit_context_p context, int verbose,
   // That also serves to bootstrap the decoding of other items
   if (nal_is_seq_param_set(*nal)) {
     if (need_first_seq_param_set) {
-      check_profile(*nal, context->show_nal_details);
+      check_profile(context, *nal, context->show_nal_details);
       need_first_seq_param_set = false;
     }
   }
 
   // Once we know we've got the first sequence parameter set in hand
   // (which we *assume* and hope is the first thing we find!), we can
-  // decode the innards of later things.
-  err = read_rbsp_data(*nal, context->seq_param_dict, context->pic_param_dict,
-                       context->show_nal_details);
-  if (err) {
-    free_nal_unit(nal);
-    return 2;
+  // decode the innards of later things. If we only want what is needed
+  // to find access unit boundaries, that's the slice headers and the
+  // parameter sets they refer to.
+  if (!context->headers_only || context->show_nal_details ||
+      nal_is_slice(*nal) || nal_is_seq_param_set(*nal) ||
+      nal_is_pic_param_set(*nal)) {
+    err = read_rbsp_data(context, *nal, context->seq_param_dict,
+                         context->pic_param_dict, context->show_nal_details);
+    if (err) {
+      free_nal_unit(nal);
+      return 2;
+    }
   }
 
   // If this is a picture parameter set, or a sequence parameter set,
@@ -1357,6 +1425,20 @@ int find_next_NAL_unit(nal_unit_context_p context, int verbose,
   return 0;
 }
 
+/*
+ * Decode the innards of a NAL unit, if that hasn't already been done.
+ *
+ * This is for NAL units that `find_next_NAL_unit` left undecoded because
+ * `set_nal_headers_only` was in effect. The parameter set dictionaries
+ * in `context` are used when decoding a slice.
+ *
+ * Returns 0 if it succeeds, 1 if some error occurs.
+ */
+int decode_nal_unit(nal_unit_context_p context, nal_unit_p nal) {
+  return read_rbsp_data(context, nal, context->seq_param_dict,
+                        context->pic_param_dict, false);
+}
+
 /*
  * Write (copy) the current NAL unit to the ES output stream.
  *
@@ -1406,60 +1488,44 @@ int write_NAL_unit_as_TS(TS_writer_p tswriter, nal_unit_p nal,
  * Create a new "dictionary" for remembering picture or sequence
  * parameter sets.
  *
+ * - `max_ids` is the number of ids the dictionary must cope with, i.e.,
+ *   NAL_MAX_PIC_PARAM_SETS or NAL_MAX_SEQ_PARAM_SETS.
+ *
  * Returns 0 if it succeeds, 1 if some error occurs.
  */
-int build_param_dict(param_dict_p *param_dict) {
-  param_dict_p new2 = (param_dict_p)malloc(SIZEOF_PARAM_DICT);
-  if (new2 == nullptr) {
-    print_err("### Unable to allocate parameter 'dictionary' datastructure\n");
-    return 1;
-  }
-
-  new2->last_id = -1;
-  new2->last_index = -1;
-
-  new2->ids = (int *)malloc(sizeof(uint32_t) * NAL_PIC_PARAM_START_SIZE);
-  if (new2->ids == nullptr) {
-    print_err("### Unable to allocate array within 'dictionary'"
-              " datastructure\n");
-    free(new2);
-    return 1;
-  }
+int build_param_dict(param_dict_p *param_dict, int max_ids) {
+  param_dict_p new2;
 
-  new2->params =
-      (nal_innards_p)malloc(SIZEOF_NAL_INNARDS * NAL_PIC_PARAM_START_SIZE);
-  if (new2->params == nullptr) {
-    print_err("### Unable to allocate array within 'dictionary'"
-              " datastructure\n");
-    free(new2->ids);
-    free(new2);
+  if (max_ids <= 0 || max_ids > NAL_MAX_PIC_PARAM_SETS) {
+    fprint_err("### Cannot build parameter 'dictionary' for %d ids\n",
+               max_ids);
     return 1;
   }
 
-  new2->posns =
-      (ES_offset_p)malloc(SIZEOF_ES_OFFSET * NAL_PIC_PARAM_START_SIZE);
-  if (new2->posns == nullptr) {
-    print_err("### Unable to allocate array within 'dictionary'"
-              " datastructure\n");
-    free(new2->params);
-    free(new2->ids);
-    free(new2);
+  new2 = (param_dict_p)calloc(1, SIZEOF_PARAM_DICT);
+  if (new2 == nullptr) {
+    print_err("### Unable to allocate parameter 'dictionary' datastructure\n");
     return 1;
   }
 
-  new2->data_lens =
-      (uint32_t *)malloc(sizeof(uint32_t) * NAL_PIC_PARAM_START_SIZE);
-  if (new2->data_lens == nullptr) {
-    print_err("### Unable to allocate array within 'dictionary'"
-              " datastructure\n");
-    free(new2->params);
-    free(new2->ids);
-    free(new2);
+  new2->max_ids = max_ids;
+  new2->present = (byte *)calloc(max_ids, sizeof(byte));
+  new2->params = (union nal_innards *)malloc(max_ids * SIZEOF_NAL_INNARDS);
+  new2->posns = (ES_offset *)malloc(max_ids * sizeof(ES_offset));
+  new2->data_lens = (uint32_t *)malloc(max_ids * sizeof(uint32_t));
+  new2->crcs = (uint32_t *)malloc(max_ids * sizeof(uint32_t));
+  new2->versions = (uint32_t *)calloc(max_ids, sizeof(uint32_t));
+  new2->ids = (int *)malloc(max_ids * sizeof(int));
+  if (new2->present == nullptr || new2->params == nullptr ||
+      new2->posns == nullptr || new2->data_lens == nullptr ||
+      new2->crcs == nullptr || new2->versions == nullptr ||
+      new2->ids == nullptr) {
+    print_err("### Unable to allocate parameter 'dictionary' arrays\n");
+    free_param_dict(&new2);
     return 1;
   }
-
-  new2->size = NAL_PIC_PARAM_START_SIZE;
   new2->length = 0;
+  new2->version = 0;
 
   *param_dict = new2;
   return 0;
@@ -1474,17 +1540,17 @@ int build_param_dict(param_dict_p *param_dict) {
  * Does nothing if `param_dict` is already nullptr.
  */
 void free_param_dict(param_dict_p *param_dict) {
-  if (*param_dict == nullptr)
+  param_dict_p dict = *param_dict;
+  if (dict == nullptr)
     return;
-  free((*param_dict)->ids);
-  free((*param_dict)->params);
-  free((*param_dict)->posns);
-  free((*param_dict)->data_lens);
-  (*param_dict)->ids = nullptr;
-  (*param_dict)->params = nullptr;
-  (*param_dict)->posns = nullptr;
-  (*param_dict)->data_lens = nullptr;
-  free(*param_dict);
+  free(dict->present);
+  free(dict->params);
+  free(dict->posns);
+  free(dict->data_lens);
+  free(dict->crcs);
+  free(dict->versions);
+  free(dict->ids);
+  free(dict);
   *param_dict = nullptr;
 }
 
@@ -1500,64 +1566,44 @@ void free_param_dict(param_dict_p *param_dict) {
  *   means that the caller may free the NAL unit.
  *
  * Any previous data for this picture or sequence parameter set id will be
- * forgotten (overwritten).
+ * forgotten (overwritten). If the new NAL unit data differs from the old
+ * (or there was no old data), the dictionary's version is incremented.
+ *
+ * A parameter set whose id is out of range (presumably because it is
+ * corrupt) is ignored, with a warning, rather than treated as an error.
  *
  * Returns 0 if it succeeds, 1 if some error occurs.
  */
 int remember_param_data(param_dict_p param_dict, uint32_t param_id,
                         nal_unit_p nal) {
-  int ii;
-  if (param_id == param_dict->last_id) {
-    param_dict->params[param_dict->last_index] = nal->u;
+  int changed;
+  uint32_t crc;
+
+  if (param_id >= (uint32_t)param_dict->max_ids) {
+    fprint_err("!!! Ignoring %s parameter set with id %u, which is out of"
+               " range (0..%d)\n",
+               (nal_is_seq_param_set(nal) ? "sequence" : "picture"), param_id,
+               param_dict->max_ids - 1);
     return 0;
   }
 
-  for (ii = 0; ii < param_dict->length; ii++) {
-    if (param_dict->ids[ii] == param_id) {
-      param_dict->params[ii] = nal->u;
-      param_dict->posns[ii] = nal->unit.start_posn;
-      param_dict->data_lens[ii] = nal->unit.data_len;
-      param_dict->last_id = param_id;
-      param_dict->last_index = ii;
-      return 0;
-    }
-  }
-
-  if (param_dict->length == param_dict->size) {
-    int newsize = param_dict->size + NAL_PIC_PARAM_INCREMENT;
-    param_dict->ids =
-        (int *)realloc(param_dict->ids, newsize * sizeof(uint32_t));
-    if (param_dict->ids == nullptr) {
-      print_err("### Unable to extend parameter set dictionary array\n");
-      return 1;
-    }
-    param_dict->params = (nal_innards_p)realloc(param_dict->params,
-                                                newsize * SIZEOF_NAL_INNARDS);
-    if (param_dict->params == nullptr) {
-      print_err("### Unable to extend parameter set dictionary array\n");
-      return 1;
-    }
-    param_dict->posns =
-        (ES_offset_p)realloc(param_dict->params, newsize * SIZEOF_ES_OFFSET);
-    if (param_dict->posns == nullptr) {
-      print_err("### Unable to extend parameter set dictionary array\n");
-      return 1;
-    }
-    param_dict->data_lens =
-        (uint32_t *)realloc(param_dict->params, newsize * sizeof(uint32_t));
-    if (param_dict->data_lens == nullptr) {
-      print_err("### Unable to extend parameter set dictionary array\n");
-      return 1;
-    }
-    param_dict->size = newsize;
+  crc = crc32_block(0xffffffff, nal->unit.data, nal->unit.data_len);
+  if (!param_dict->present[param_id]) {
+    param_dict->present[param_id] = true;
+    param_dict->ids[param_dict->length++] = param_id;
+    changed = true;
+  } else
+    changed = (param_dict->data_lens[param_id] != nal->unit.data_len ||
+               param_dict->crcs[param_id] != crc);
+
+  param_dict->params[param_id] = nal->u;
+  param_dict->posns[param_id] = nal->unit.start_posn;
+  param_dict->data_lens[param_id] = nal->unit.data_len;
+  param_dict->crcs[param_id] = crc;
+  if (changed) {
+    param_dict->versions[param_id]++;
+    param_dict->version++;
   }
-  param_dict->ids[param_dict->length] = param_id;
-  param_dict->params[param_dict->length] = nal->u;
-  param_dict->posns[param_dict->length] = nal->unit.start_posn;
-  param_dict->data_lens[param_dict->length] = nal->unit.data_len;
-  param_dict->last_id = param_id;
-  param_dict->last_index = param_dict->length;
-  param_dict->length++;
   return 0;
 }
 
@@ -1569,25 +1615,19 @@ int remember_param_data(param_dict_p param_dict, uint32_t param_id,
  * - `param_data` is the data for that id. Do not free this, it refers
  *   into the "dictionary" datastructure.
  *
- * Note that calls of `remember_param_data()` (i.e., altering the
- * "dictionary") may cause the underlying datastructures to be realloc'ed,
- * which in turn means that the address returned as `param_data` may not be
- * valid after such a call.
+ * The address returned as `param_data` stays valid for the life of the
+ * "dictionary", but its content will change if `remember_param_data()` is
+ * called for the same id.
  *
  * Returns 0 if it succeeds, 1 if the id is not present.
  */
 static inline int lookup_param_data(param_dict_p param_dict, uint32_t param_id,
                                     nal_innards_p *param_data) {
-  int ii;
-  for (ii = 0; ii < param_dict->length; ii++) {
-    if (param_dict->ids[ii] == param_id) {
-      *param_data = &param_dict->params[ii];
-      param_dict->last_id = param_id;
-      param_dict->last_index = ii;
-      return 0;
-    }
-  }
-  return 1;
+  if (param_id >= (uint32_t)param_dict->max_ids ||
+      !param_dict->present[param_id])
+    return 1;
+  *param_data = &param_dict->params[param_id];
+  return 0;
 }
 
 /*
@@ -1598,10 +1638,8 @@ static inline int lookup_param_data(param_dict_p param_dict, uint32_t param_id,
  * - `pic_param_data` is the data for that id. Do not free this, it refers
  *   into the "dictionary" datastructure.
  *
- * Note that altering the "dictionary" (with `remember_param_data()`) may
- * cause the underlying datastructures to be realloc'ed, which in turn means
- * that the address returned as `pic_param_data` may not be valid after such
- * an action.
+ * Note that altering the "dictionary" (with `remember_param_data()`) for
+ * the same id will change the data that `pic_param_data` refers to.
  *
  * Returns 0 if it succeeds, 1 if the id is not recognised.
  */
@@ -1626,10 +1664,8 @@ int get_pic_param_data(param_dict_p pic_param_dict, uint32_t pic_param_id,
  * - `seq_param_data` is the data for that id. Do not free this, it refers
  *   into the "dictionary" datastructure.
  *
- * Note that altering the "dictionary" (with `remember_param_data()`) may
- * cause the underlying datastructures to be realloc'ed, which in turn means
- * that the address returned as `seq_param_data` may not be valid after such
- * an action.
+ * Note that altering the "dictionary" (with `remember_param_data()`) for
+ * the same id will change the data that `seq_param_data` refers to.
  *
  * Returns 0 if it succeeds, 1 if the id is not recognised.
  */
@@ -180,21 +180,39 @@ typedef union nal_innards *nal_innards_p;
 // sequence parameter set
 // Picture parameter set ids are in the range 0..255
 // Sequence parameter set ids are in the range 0..31
+#define NAL_MAX_PIC_PARAM_SETS 256
+#define NAL_MAX_SEQ_PARAM_SETS 32
+
+// Since the ids are so constrained, the tables are indexed directly by
+// parameter set id, are allocated with room for all the ids the dictionary
+// allows, and never need to grow.
 struct param_dict {
-  int last_id;               // The id of the last parameter set we wanted
-  int last_index;            // and its index in the arrays
-  int *ids;                  // The ids for...
-  union nal_innards *params; // ...the data
-  ES_offset *posns;          // Where each was read from...
+  int max_ids; // How many ids we allow (i.e., 0..max_ids-1)
+
+  // The following are all arrays of `max_ids` entries, indexed by id
+  byte *present;             // Do we have it?
+  union nal_innards *params; // Its (decoded) data
+  ES_offset *posns;          // Where it was read from...
   uint32_t *data_lens;       // ...and its size
-  int size, length;          // of the arrays and their content
+  uint32_t *crcs;            // The CRC32 of its NAL unit data
+  uint32_t *versions;        // See `version` below
+
+  // The ids we have, in the order we first saw them, for anyone who
+  // wants to look at all of them
+  int *ids;
+  int length;
+
+  // Whenever a parameter set arrives whose NAL unit data (as compared by
+  // its CRC) differs from what we already had for that id, its entry in
+  // `versions` and the dictionary's own `version` are incremented.
+  // Repeating an identical parameter set (as broadcast streams do) changes
+  // neither, so callers can remember a version and only re-derive their
+  // state when it moves.
+  uint32_t version;
 };
 typedef struct param_dict *param_dict_p;
 #define SIZEOF_PARAM_DICT sizeof(struct param_dict)
 
-#define NAL_PIC_PARAM_START_SIZE 20
-#define NAL_PIC_PARAM_INCREMENT 20
-
 // ------------------------------------------------------------
 // A single NAL unit
 struct nal_unit {
@@ -253,6 +271,14 @@ struct nal_unit_context {
 
   // Show details of each NAL units content as it is read?
   int show_nal_details;
+  // Only decode what is needed to find access unit boundaries?
+  int headers_only;
+
+  // Scratch space for decoding each NAL unit's RBSP in turn, so that we
+  // don't need to allocate (and free) it for every NAL unit
+  byte *rbsp;          // Room for the RBSP of the current NAL unit
+  int rbsp_size;       // The size of that array
+  struct bitdata bits; // And for reading bits from it
 };
 typedef struct nal_unit_context *nal_unit_context_p;
 #define SIZEOF_NAL_UNIT_CONTEXT sizeof(struct nal_unit_context)
@@ -36,6 +36,20 @@
  */
 void set_show_nal_reading_details(nal_unit_context_p context, int show);
 
+/*
+ * Only decode as much of each NAL unit as access unit boundary detection
+ * needs.
+ *
+ * If `headers_only` is true, then `find_next_NAL_unit` decodes the slice
+ * headers and the sequence and picture parameter sets, but leaves the
+ * innards of any other NAL unit (SEI, for instance) alone. Call
+ * `decode_nal_unit` to decode such a NAL unit later on, if it turns out
+ * to be wanted.
+ *
+ * This is ignored if details of the NAL unit contents are being shown.
+ */
+void set_nal_headers_only(nal_unit_context_p context, int headers_only);
+
 /*
  * Build a new NAL unit context, for reading NAL units from an ES.
  *
@@ -96,6 +110,17 @@ void free_nal_unit(nal_unit_p *nal);
 int find_next_NAL_unit(nal_unit_context_p context, int verbose,
                        nal_unit_p *nal);
 
+/*
+ * Decode the innards of a NAL unit, if that hasn't already been done.
+ *
+ * This is for NAL units that `find_next_NAL_unit` left undecoded because
+ * `set_nal_headers_only` was in effect. The parameter set dictionaries
+ * in `context` are used when decoding a slice.
+ *
+ * Returns 0 if it succeeds, 1 if some error occurs.
+ */
+int decode_nal_unit(nal_unit_context_p context, nal_unit_p nal);
+
 /*
  * Write (copy) the current NAL unit to the ES output stream.
  *
@@ -122,9 +147,12 @@ int write_NAL_unit_as_TS(TS_writer_p tswriter, nal_unit_p nal,
  * Create a new "dictionary" for remembering picture or sequence
  * parameter sets.
  *
+ * - `max_ids` is the number of ids the dictionary must cope with, i.e.,
+ *   NAL_MAX_PIC_PARAM_SETS or NAL_MAX_SEQ_PARAM_SETS.
+ *
  * Returns 0 if it succeeds, 1 if some error occurs.
  */
-int build_param_dict(param_dict_p *param_dict);
+int build_param_dict(param_dict_p *param_dict, int max_ids);
 
 /*
  * Tidy up and free a parameters "dictionary" datastructure after we've
@@ -148,7 +176,11 @@ void free_param_dict(param_dict_p *param_dict);
  *   means that the caller may free the NAL unit.
  *
  * Any previous data for this picture or sequence parameter set id will be
- * forgotten (overwritten).
+ * forgotten (overwritten). If the new NAL unit data differs from the old
+ * (or there was no old data), the dictionary's version is incremented.
+ *
+ * A parameter set whose id is out of range (presumably because it is
+ * corrupt) is ignored, with a warning, rather than treated as an error.
  *
  * Returns 0 if it succeeds, 1 if some error occurs.
  */
@@ -163,10 +195,8 @@ int remember_param_data(param_dict_p param_dict, uint32_t param_id,
  * - `pic_param_data` is the data for that id. Do not free this, it refers
  *   into the "dictionary" datastructure.
  *
- * Note that altering the "dictionary" (with `remember_param_data()`) may
- * cause the underlying datastructures to be realloc'ed, which in turn means
- * that the address returned as `pic_param_data` may not be valid after such
- * an action.
+ * Note that altering the "dictionary" (with `remember_param_data()`) for
+ * the same id will change the data that `pic_param_data` refers to.
  *
  * Returns 0 if it succeeds, 1 if the id is not recognised.
  */
@@ -181,10 +211,8 @@ int get_pic_param_data(param_dict_p pic_param_dict, uint32_t pic_param_id,
  * - `seq_param_data` is the data for that id. Do not free this, it refers
  *   into the "dictionary" datastructure.
  *
- * Note that altering the "dictionary" (with `remember_param_data()`) may
- * cause the underlying datastructures to be realloc'ed, which in turn means
- * that the address returned as `seq_param_data` may not be valid after such
- * an action.
+ * Note that altering the "dictionary" (with `remember_param_data()`) for
+ * the same id will change the data that `seq_param_data` refers to.
  *
  * Returns 0 if it succeeds, 1 if the id is not recognised.
  */
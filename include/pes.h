@@ -91,19 +91,81 @@ static int build_PES_packet_data(PES_packet_data_p *data) {
 
   new2->data = nullptr;
   new2->data_len = 0;
+  new2->size = 0;
   new2->es_data_len = 0;
   new2->length = 0;
   new2->posn = 0;
   new2->is_video = true;                  // a guess
   new2->data_alignment_indicator = false; // another
   new2->has_PTS = false;                  // assumed until told otherwise
+  new2->flat_len = 0;
+  new2->slice = nullptr;
+  new2->num_slices = 0;
+  new2->slices_size = 0;
 
   *data = new2;
   return 0;
 }
 
 /*
- * Add some data to a PES packet datastructure
+ * Get a PES packet datastructure from a PES reader, reusing one that it
+ * has finished with if it can, and otherwise building a new one.
+ *
+ * Returns 0 if all goes well, 1 if something goes wrong
+ */
+static int get_PES_packet_data(PES_reader_p reader, PES_packet_data_p *data) {
+  struct PES_packet_pool *pool = &reader->pool;
+  PES_packet_data_p packet;
+
+  if (pool->num_packets == 0)
+    return build_PES_packet_data(data);
+
+  // Keep the data and slice arrays (and their sizes), but forget what was
+  // in them
+  packet = pool->packet[--pool->num_packets];
+  packet->data_len = 0;
+  packet->flat_len = 0;
+  packet->num_slices = 0;
+  packet->es_data = nullptr;
+  packet->es_data_len = 0;
+  packet->length = 0;
+  packet->posn = 0;
+  packet->is_video = true;
+  packet->data_alignment_indicator = false;
+  packet->has_PTS = false;
+
+  *data = packet;
+  return 0;
+}
+
+/*
+ * Make sure a PES packet datastructure has room for (at least) `size`
+ * bytes of data. To avoid growing it a little at a time, its size is at
+ * least doubled each time.
+ *
+ * Returns 0 if all goes well, 1 if something goes wrong
+ */
+static int grow_PES_packet_data(PES_packet_data_p data, int32_t size) {
+  int32_t newsize;
+  byte *newdata;
+
+  if (size <= data->size)
+    return 0;
+
+  newsize = max(max(size, data->size * 2), PES_DATA_MIN_SIZE);
+  newdata = (byte *)realloc(data->data, newsize);
+  if (newdata == nullptr) {
+    print_err("### Unable to extend PES packet data array\n");
+    return 1;
+  }
+  data->data = newdata;
+  data->size = newsize;
+  return 0;
+}
+
+/*
+ * Add some data to a PES packet datastructure, by copying it into its
+ * `data` array. This must not be used once the packet has any slices.
  *
  * - `data` is the PES packet datastructure concerned
  * - `bytes` is the data to add
@@ -113,23 +175,85 @@ static int build_PES_packet_data(PES_packet_data_p *data) {
  */
 static inline int extend_PES_packet_data(PES_packet_data_p data, byte bytes[],
                                          int bytes_len) {
-  if (data->data == nullptr) {
-    data->data = (byte *)malloc(bytes_len);
-    if (data->data == nullptr) {
-      print_err("### Unable to extend PES packet data array\n");
-      return 1;
-    }
-    memcpy(data->data, bytes, bytes_len);
-    data->data_len = bytes_len;
-  } else {
-    data->data = (byte *)realloc(data->data, data->data_len + bytes_len);
-    if (data->data == nullptr) {
-      print_err("### Unable to extend PES packet data array\n");
+  if (data->data_len + bytes_len > data->size &&
+      grow_PES_packet_data(data, data->data_len + bytes_len))
+    return 1;
+  memcpy(&(data->data[data->data_len]), bytes, bytes_len);
+  data->data_len = data->data_len + bytes_len;
+  data->flat_len = data->data_len;
+  return 0;
+}
+
+/*
+ * Add some data to a PES packet datastructure, by remembering where it is,
+ * rather than copying it. The data must stay where it is until the PES
+ * packet has been finished with (or flattened).
+ *
+ * - `data` is the PES packet datastructure concerned
+ * - `bytes` is the data to add
+ * - `bytes_len` is how much data there is
+ *
+ * Returns 0 if all goes well, 1 if something goes wrong
+ */
+static int add_PES_packet_slice(PES_packet_data_p data, byte bytes[],
+                                int bytes_len) {
+  if (data->num_slices == data->slices_size) {
+    int newsize = max(data->slices_size * 2, PES_SLICES_MIN_SIZE);
+    struct iovec *newslice = (struct iovec *)realloc(
+        data->slice, newsize * sizeof(struct iovec));
+    if (newslice == nullptr) {
+      print_err("### Unable to extend PES packet slice array\n");
       return 1;
     }
-    memcpy(&(data->data[data->data_len]), bytes, bytes_len);
-    data->data_len = data->data_len + bytes_len;
+    data->slice = newslice;
+    data->slices_size = newsize;
+  }
+  data->slice[data->num_slices].iov_base = bytes;
+  data->slice[data->num_slices].iov_len = bytes_len;
+  data->num_slices++;
+  data->data_len += bytes_len;
+  return 0;
+}
+
+/*
+ * Decide if the next chunk of a PES packet can be left in place as a slice.
+ *
+ * That is only so if the TS data it comes from is memory mapped (so that it
+ * will stay put), and if we already have all of the PES header in `data`
+ * (so that the things that only look at the PES header need not care about
+ * slices). It is simplest to insist on H.222.0 PES packets for this.
+ */
+static inline int can_slice_PES_packet_data(PES_reader_p reader,
+                                            PES_packet_data_p data) {
+  if (reader->tsreader == nullptr || reader->tsreader->mapped == nullptr)
+    return false;
+  if (data->num_slices > 0)
+    return true;
+  return data->flat_len >= 9 && IS_H222_PES(data->data) &&
+         data->flat_len >= 9 + data->data[8];
+}
+
+/*
+ * Make sure that all of a PES packet's data is in its `data` array,
+ * copying in any slices that were left in place (see `map_PES_reader`).
+ * Afterwards, `flat_len` is the same as `data_len`.
+ *
+ * - `data` is the PES packet datastructure concerned
+ *
+ * Returns 0 if all goes well, 1 if something goes wrong
+ */
+int flatten_PES_packet_data(PES_packet_data_p data) {
+  int ii;
+  if (data->num_slices == 0)
+    return 0;
+  if (grow_PES_packet_data(data, data->data_len))
+    return 1;
+  for (ii = 0; ii < data->num_slices; ii++) {
+    memcpy(&(data->data[data->flat_len]), data->slice[ii].iov_base,
+           data->slice[ii].iov_len);
+    data->flat_len += data->slice[ii].iov_len;
   }
+  data->num_slices = 0;
   return 0;
 }
 
@@ -203,13 +327,46 @@ void free_PES_packet_data(PES_packet_data_p *data) {
     free((*data)->data);
     (*data)->data = nullptr;
   }
+  if ((*data)->slice != nullptr) {
+    free((*data)->slice);
+    (*data)->slice = nullptr;
+  }
   (*data)->data_len = 0;
+  (*data)->size = 0;
   (*data)->length = 0;
   free(*data);
   *data = nullptr;
   return;
 }
 
+/*
+ * Give a PES packet datastructure back to the PES reader it came from, so
+ * that it (and its data array) can be reused for a later PES packet. If the
+ * reader already has enough packets to reuse, it is just freed.
+ *
+ * - `reader` is the PES reader
+ * - `data` is the PES packet datastructure, which is returned as nullptr.
+ */
+void release_PES_packet_data(PES_reader_p reader, PES_packet_data_p *data) {
+  struct PES_packet_pool *pool = &reader->pool;
+  if ((*data) == nullptr)
+    return;
+  if (pool->num_packets == PES_POOL_SIZE) {
+    free_PES_packet_data(data);
+    return;
+  }
+  pool->packet[pool->num_packets++] = *data;
+  *data = nullptr;
+}
+
+/*
+ * Free the PES packet datastructures that a PES reader was keeping to reuse
+ */
+static void free_PES_packet_pool(struct PES_packet_pool *pool) {
+  while (pool->num_packets > 0)
+    free_PES_packet_data(&pool->packet[--pool->num_packets]);
+}
+
 // ============================================================
 // Transport Stream support - PID -> PES data
 // (datastructure support based on that for pidint lists in ts.c)
@@ -233,6 +390,11 @@ static int init_peslist(peslist_p list) {
     print_err("### Unable to allocate PID array in PID/PES data array\n");
     return 1;
   }
+  if (build_pid_index(&list->index)) {
+    free(list->data);
+    free(list->pid);
+    return 1;
+  }
   // Just in case...
   for (ii = 0; ii < list->size; ii++)
     list->data[ii] = nullptr;
@@ -282,6 +444,7 @@ static void free_peslist(peslist_p *peslist) {
     free(list->pid);
     list->pid = nullptr;
   }
+  free_pid_index(&list->index);
   list->length = 0;
   list->size = 0;
   free(list);
@@ -296,14 +459,9 @@ static void free_peslist(peslist_p *peslist) {
  * Returns its index (0 or more) if the PID is in the list, -1 if it is not.
  */
 static inline int pid_index_in_peslist(peslist_p list, uint32_t pid) {
-  int ii;
   if (list == nullptr)
     return -1;
-  for (ii = 0; ii < list->length; ii++) {
-    if (list->pid[ii] == pid)
-      return ii;
-  }
-  return -1;
+  return lookup_pid_index(list->index, pid);
 }
 
 /*
@@ -336,7 +494,7 @@ static int start_packet_in_peslist(PES_reader_p reader, uint32_t pid,
     return 1;
   }
 
-  err = build_PES_packet_data(data);
+  err = get_PES_packet_data(reader, data);
   if (err) {
     print_err("### Unable to build new PES packet datastructure"
               " for PID/PES data array\n");
@@ -344,23 +502,22 @@ static int start_packet_in_peslist(PES_reader_p reader, uint32_t pid,
   }
   (*data)->is_video = is_video;
 
-  for (ii = 0; ii < list->length; ii++) {
-    if (list->pid[ii] == pid) {
-      // There is already an entry for this PID - does it have data?
-      if (list->data[ii] != nullptr) {
-        PES_packet_data_p packet = list->data[ii];
-        if (reader->give_warning)
-          fprint_err(
-              "!!! PID %04x (%d) already has an unfinished PES packet"
-              " associated with it\n    %d byte%s of %d bytes were already"
-              " read - ignoring them\n",
-              pid, pid, packet->data_len, (packet->data_len == 1 ? "" : "s"),
-              packet->length);
-        free_PES_packet_data(&(list->data[ii]));
-      }
-      list->data[ii] = *data;
-      return 0;
-    }
+  ii = pid_index_in_peslist(list, pid);
+  if (ii != -1) {
+    // There is already an entry for this PID - does it have data?
+    if (list->data[ii] != nullptr) {
+      PES_packet_data_p packet = list->data[ii];
+      if (reader->give_warning)
+        fprint_err(
+            "!!! PID %04x (%d) already has an unfinished PES packet"
+            " associated with it\n    %d byte%s of %d bytes were already"
+            " read - ignoring them\n",
+            pid, pid, packet->data_len, (packet->data_len == 1 ? "" : "s"),
+            packet->length);
+      release_PES_packet_data(reader, &(list->data[ii]));
+    }
+    list->data[ii] = *data;
+    return 0;
   }
 
   // Otherwise, we need to add a new entry to the list
@@ -381,6 +538,11 @@ static int start_packet_in_peslist(PES_reader_p reader, uint32_t pid,
     }
     list->size = newsize;
   }
+  if (set_pid_index(list->index, pid, list->length, true)) {
+    fprint_err("### Unable to index PID %04x in PID/PES data array\n", pid);
+    free_PES_packet_data(data);
+    return 1;
+  }
   list->pid[list->length] = pid;
   list->data[list->length] = *data;
   list->length++;
@@ -539,13 +701,18 @@ static int read_next_PES_packet_from_PS(PES_reader_p reader,
     }
 
     if (keep) {
-      err = build_PES_packet_data(packet_data);
+      err = get_PES_packet_data(reader, packet_data);
       if (err)
         return 1;
       // We needn't copy the bytes from one "packet" to another,
       // it's easier to just transfer the array, if we're careful
+      // (which means not keeping any array the PES packet already had)
+      if ((*packet_data)->data != nullptr)
+        free((*packet_data)->data);
       (*packet_data)->data = packet.data;
       (*packet_data)->data_len = packet.data_len;
+      (*packet_data)->flat_len = packet.data_len;
+      (*packet_data)->size = packet.data_len;
       (*packet_data)->length = packet.data_len;
       (*packet_data)->posn = reader->posn;
       (*packet_data)->is_video = is_video;
@@ -597,6 +764,10 @@ static void decide_pids(PES_reader_p reader) {
           reader->is_h264 = true;
           reader->video_type = VIDEO_H264;
           break;
+        case H265_VIDEO_STREAM_TYPE:
+          reader->is_h264 = false;
+          reader->video_type = VIDEO_H265;
+          break;
         case MPEG2_VIDEO_STREAM_TYPE:
         case MPEG1_VIDEO_STREAM_TYPE: // well, more-or-less
           reader->is_h264 = false;
@@ -1031,8 +1202,14 @@ static int start_new_PES_packet(PES_reader_p reader, uint32_t pid,
 #endif
 
   data->length = ((payload[4] << 8) | payload[5]);
-  if (data->length != 0)
+  if (data->length != 0) {
     data->length += 6; // correct to the actual packet length
+    // Now we know how big it is, we can make room for all of it at once
+    // (unless most of it is going to be left in place, as slices)
+    if (!can_slice_PES_packet_data(reader, data) &&
+        grow_PES_packet_data(data, data->length))
+      return 1;
+  }
 #if DEBUG_PES_ASSEMBLY
   else
     print_msg("@@@ PES packet marked as length 0\n");
@@ -1122,7 +1299,10 @@ static int continue_PES_packet(PES_reader_p reader, uint32_t pid,
 
   // fprint_msg("%c",(pid==reader->video_pid?'v':'a'));fflush(stdout);
 
-  err = extend_PES_packet_data(data, payload, payload_len);
+  if (can_slice_PES_packet_data(reader, data))
+    err = add_PES_packet_slice(data, payload, payload_len);
+  else
+    err = extend_PES_packet_data(data, payload, payload_len);
   if (err) {
     print_err("### Error remembering data to continue PES packet\n");
     return 1;
@@ -1211,7 +1391,7 @@ static int read_next_PES_packet_from_TS(PES_reader_p reader,
   // just return it
   if (reader->deferred) {
     if (reader->video_only && !reader->deferred->is_video) {
-      free_PES_packet_data(&reader->deferred);
+      release_PES_packet_data(reader, &reader->deferred);
     } else {
       *packet_data = reader->deferred;
       reader->deferred = nullptr;
@@ -1383,7 +1563,7 @@ static int read_next_PES_packet_from_TS(PES_reader_p reader,
       if (finished) {
 #if DEBUG_PES_ASSEMBLY
         fprint_msg("@@@ PES packet with pid %x finished\n", pid);
-        report_PES_data_array("    ", finished->data, finished->data_len, true);
+        report_PES_data_array("    ", finished->data, finished->flat_len, true);
 #endif
 
         if (pid == reader->audio_pid && reader->video_only) {
@@ -1391,7 +1571,7 @@ static int read_next_PES_packet_from_TS(PES_reader_p reader,
           // (we check this now because the user can alter this over
           // time, and when we *started* collecting the packet, they
           // might have said they *were* interested in audio)
-          free_PES_packet_data(&finished);
+          release_PES_packet_data(reader, &finished);
         } else {
 #if DEBUG_PES_ASSEMBLY
           print_msg("@@@ return it\n");
@@ -1527,6 +1707,7 @@ static int build_PES_reader_datastructure(int give_info, int give_warnings,
   new2->is_h264 = false;
   new2->video_type = VIDEO_UNKNOWN;
   new2->packet = nullptr;
+  new2->pool.num_packets = 0;
 
   new2->program_number = 0;
   new2->program_map = nullptr;
@@ -1818,6 +1999,30 @@ int open_PES_reader(char *filename, int give_info, int give_warnings,
     return build_PES_reader(input, false, give_info, give_warnings, 0, reader);
 }
 
+/*
+ * Memory map the TS file a PES reader is reading from (see `map_TS_reader`).
+ *
+ * As well as saving the copy of each TS packet into the read-ahead buffer,
+ * this means that (H.222.0) PES packets are no longer copied together from
+ * their TS packets as they are read. Instead, each PES packet keeps its
+ * header in its `data` array, and refers to the rest of its data as slices
+ * of the mapped file. Writing a PES packet out again as TS (see
+ * `set_server_output`) then uses those slices directly, and
+ * `read_next_PES_ES_packet` flattens video packets as it needs to.
+ * Anyone using `read_next_PES_packet` must cope with the slices, or call
+ * `flatten_PES_packet_data`.
+ *
+ * This does nothing for PS data.
+ *
+ * Returns 0 if the file was mapped, 1 if it was not (in which case the
+ * reader carries on as normal).
+ */
+int map_PES_reader(PES_reader_p reader) {
+  if (!reader->is_TS)
+    return 1;
+  return map_TS_reader(reader->tsreader);
+}
+
 /*
  * Tell the PES reader whether we only want video data
  *
@@ -1997,9 +2202,9 @@ int set_PES_reader_position(PES_reader_p reader, offset_t posn) {
   if (reader->is_TS) {
     int ii;
     for (ii = 0; ii < reader->packets->length; ii++)
-      free_PES_packet_data(&reader->packets->data[ii]);
+      release_PES_packet_data(reader, &reader->packets->data[ii]);
     if (reader->deferred)
-      free_PES_packet_data(&reader->deferred);
+      release_PES_packet_data(reader, &reader->deferred);
     reader->had_eof = false;
   }
   return 0;
@@ -2021,6 +2226,7 @@ int free_PES_reader(PES_reader_p *reader) {
     return 0;
   if ((*reader)->packet != nullptr)
     free_PES_packet_data(&(*reader)->packet);
+  free_PES_packet_pool(&(*reader)->pool);
 
   // Forget any file
   (*reader)->tsreader = nullptr;
@@ -2128,9 +2334,14 @@ int read_next_PES_packet(PES_reader_p reader) {
         pid = reader->output_audio_pid;
         stream_id = DEFAULT_AUDIO_STREAM_ID;
       }
-      err = write_PES_as_TS_PES_packet(reader->tswriter, reader->packet->data,
-                                       reader->packet->data_len, pid, stream_id,
-                                       false, 0, 0);
+      if (reader->packet->num_slices > 0)
+        err = write_PES_slices_as_TS_PES_packet(
+            reader->tswriter, reader->packet->data, reader->packet->flat_len,
+            reader->packet->slice, reader->packet->num_slices, pid);
+      else
+        err = write_PES_as_TS_PES_packet(
+            reader->tswriter, reader->packet->data, reader->packet->data_len,
+            pid, stream_id, false, 0, 0);
       if (err) {
         print_err("### Error writing out PES packet as TS\n");
         return 1;
@@ -2154,7 +2365,8 @@ int read_next_PES_packet(PES_reader_p reader) {
       }
     }
     // And it's our job to free each PES packet as it is no longer needed
-    free_PES_packet_data(&reader->packet);
+    // (or rather, to keep it for reuse)
+    release_PES_packet_data(reader, &reader->packet);
   }
   // We always undo the "don't write the current packet flag" after we (might)
   // have written it out
@@ -2324,6 +2536,9 @@ int read_next_PES_ES_packet(PES_reader_p reader) {
 #endif
 
     if (reader->packet->is_video) {
+      // The ES data needs to be contiguous
+      if (flatten_PES_packet_data(reader->packet))
+        return 1;
       if (reader->debug_read_packets)
         report_PES_data_array("", reader->packet->data,
                               reader->packet->data_len, true);
@@ -3448,6 +3663,9 @@ int write_program_data(PES_reader_p reader, TS_writer_p output) {
     case VIDEO_H264:
       prog_type[0] = AVC_VIDEO_STREAM_TYPE;
       break;
+    case VIDEO_H265:
+      prog_type[0] = H265_VIDEO_STREAM_TYPE;
+      break;
     case VIDEO_H262:
       prog_type[0] = MPEG2_VIDEO_STREAM_TYPE;
       break;
@@ -35,11 +35,14 @@
 #include "ts_defns.h"
 #include "tswrite_defns.h"
 
+#include <sys/uio.h> // for struct iovec
+
 // ------------------------------------------------------------
 // A PES packet comes with some useful associated data
 struct PES_packet_data {
   byte *data;       // The actual packet data
   int32_t data_len; // The length of the `data` array [1]
+  int32_t size;     // How much space has been allocated for `data`
   int32_t length;   // Its length
   offset_t posn;    // The offset of its start in the file [2]
   int is_video;     // Is this video data? (as opposed to audio)
@@ -57,6 +60,15 @@ struct PES_packet_data {
   // Some applications want to know if a particular packet contains
   // a PTS or not
   int has_PTS;
+
+  // When the PES packet is being read from a memory mapped TS file (see
+  // `map_PES_reader`), only its start (which always includes the PES
+  // header) is copied into `data`. The rest is left where it is, as a list
+  // of slices of the TS packet payloads in the mapping [3].
+  int32_t flat_len;     // How much of the packet is actually in `data`
+  struct iovec *slice;  // The rest of the packet, in order
+  int num_slices;       // How many slices there are
+  int slices_size;      // How much space has been allocated for `slice`
 };
 // [1] For PS data, data_len and length will always be the same.
 //     For TS data, length is set when the first TS packet of the
@@ -64,6 +76,10 @@ struct PES_packet_data {
 //     as "chunks" of the PES packet are read in
 // [2] For TS data, this is actually the offset of the first TS packet
 //     containing the PES packet
+// [3] So data_len is flat_len plus the lengths of all the slices. If there
+//     are no slices, flat_len and data_len are the same. Anything that
+//     wants to look past the PES header should call
+//     `flatten_PES_packet_data` first.
 typedef struct PES_packet_data *PES_packet_data_p;
 #define SIZEOF_PES_PACKET_DATA sizeof(struct PES_packet_data)
 
@@ -74,6 +90,7 @@ struct peslist {
   PES_packet_data_p *data; // An array of the corresponding PES data
   int length;              // How many there are
   int size;                // How big the arrays are
+  pid_index_p index;       // PID -> index in the arrays
 };
 typedef struct peslist *peslist_p;
 #define SIZEOF_PESLIST sizeof(struct peslist)
@@ -81,6 +98,27 @@ typedef struct peslist *peslist_p;
 #define PESLIST_START_SIZE 2 // Guess at one audio, one video
 #define PESLIST_INCREMENT 1  // And a very conservative extension policy
 
+// ------------------------------------------------------------
+// PES packets that have been finished with are kept by their PES reader
+// (along with their data arrays) to be used again, rather than freed. Since
+// a data array is only ever grown, once the reader has seen the largest
+// PES packets in its input, it need not allocate any more memory.
+//
+// Only a few PES packets are ever in use at once (the current one, one
+// being built per PID, and perhaps a deferred one), so the pool is small.
+#define PES_POOL_SIZE 8
+struct PES_packet_pool {
+  PES_packet_data_p packet[PES_POOL_SIZE];
+  int num_packets; // how many are waiting to be reused
+};
+
+// The least space to allocate for a PES packet's data, when growing it
+#define PES_DATA_MIN_SIZE 4096
+
+// The least number of slices to allocate for a PES packet, when growing its
+// list of slices (there is one per TS packet)
+#define PES_SLICES_MIN_SIZE 64
+
 // ------------------------------------------------------------
 // A PES "reader" datastructure is the interface through which one reads
 // PES packets from a TS or PS file
@@ -172,6 +210,9 @@ struct PES_reader {
   // that, we can remember it here...
   PES_packet_data_p deferred;
 
+  // PES packets that we have finished with, waiting to be reused
+  struct PES_packet_pool pool;
+
   // If we ended such a packet on EOF, it's moderately convenient to
   // remember that we had found EOF, rather than try to bump into it again
   int had_eof;
@@ -39,6 +39,25 @@
  *   and returned as nullptr.
  */
 void free_PES_packet_data(PES_packet_data_p *data);
+/*
+ * Give a PES packet datastructure back to the PES reader it came from, so
+ * that it (and its data array) can be reused for a later PES packet. If the
+ * reader already has enough packets to reuse, it is just freed.
+ *
+ * - `reader` is the PES reader
+ * - `data` is the PES packet datastructure, which is returned as nullptr.
+ */
+void release_PES_packet_data(PES_reader_p reader, PES_packet_data_p *data);
+/*
+ * Make sure that all of a PES packet's data is in its `data` array,
+ * copying in any slices that were left in place (see `map_PES_reader`).
+ * Afterwards, `flat_len` is the same as `data_len`.
+ *
+ * - `data` is the PES packet datastructure concerned
+ *
+ * Returns 0 if all goes well, 1 if something goes wrong
+ */
+int flatten_PES_packet_data(PES_packet_data_p data);
 /*
  * Look at the start of a file to determine if it appears to be transport
  * stream. Rewinds the file when it is finished.
@@ -159,6 +178,25 @@ int open_PES_reader_for_PS(char *filename, int give_info, int give_warnings,
  */
 int open_PES_reader(char *filename, int give_info, int give_warnings,
                     PES_reader_p *reader);
+/*
+ * Memory map the TS file a PES reader is reading from (see `map_TS_reader`).
+ *
+ * As well as saving the copy of each TS packet into the read-ahead buffer,
+ * this means that (H.222.0) PES packets are no longer copied together from
+ * their TS packets as they are read. Instead, each PES packet keeps its
+ * header in its `data` array, and refers to the rest of its data as slices
+ * of the mapped file. Writing a PES packet out again as TS (see
+ * `set_server_output`) then uses those slices directly, and
+ * `read_next_PES_ES_packet` flattens video packets as it needs to.
+ * Anyone using `read_next_PES_packet` must cope with the slices, or call
+ * `flatten_PES_packet_data`.
+ *
+ * This does nothing for PS data.
+ *
+ * Returns 0 if the file was mapped, 1 if it was not (in which case the
+ * reader carries on as normal).
+ */
+int map_PES_reader(PES_reader_p reader);
 /*
  * Tell the PES reader whether we only want video data
  *
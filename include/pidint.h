@@ -39,6 +39,91 @@
 #include "printing_fns.h"
 #include "ts_fns.h"
 
+// ============================================================================
+// PID index maintenance
+// ============================================================================
+/*
+ * Clear a PID index, so that no PIDs are present in it.
+ */
+void clear_pid_index(pid_index_p index) {
+  memset(index->slot, 0, sizeof(index->slot));
+}
+
+/*
+ * Build a new (empty) PID index datastructure.
+ *
+ * Returns 0 if it succeeds, 1 if some error occurs.
+ */
+int build_pid_index(pid_index_p *index) {
+  pid_index_p new2 = (pid_index_p)calloc(1, SIZEOF_PID_INDEX);
+  if (new2 == nullptr) {
+    print_err("### Unable to allocate PID index datastructure\n");
+    return 1;
+  }
+  *index = new2;
+  return 0;
+}
+
+/*
+ * Free a PID index datastructure, and return `index` as nullptr.
+ *
+ * Does nothing if `index` is already nullptr.
+ */
+void free_pid_index(pid_index_p *index) {
+  if (*index == nullptr)
+    return;
+  free(*index);
+  *index = nullptr;
+}
+
+/*
+ * Associate a value with a PID in a PID index.
+ *
+ * If `replace` is false and the PID already has a value, that value is
+ * left alone.
+ *
+ * Returns 0 if it succeeds, 1 if the PID or value cannot be represented
+ * (`pid` must be less than PID_INDEX_SIZE, `value` must be in the range
+ * 0..PID_INDEX_MAX_VALUE).
+ */
+int set_pid_index(pid_index_p index, uint32_t pid, int value, int replace) {
+  if (pid >= PID_INDEX_SIZE || value < 0 || value > PID_INDEX_MAX_VALUE)
+    return 1;
+  if (replace || index->slot[pid] == 0)
+    index->slot[pid] = (uint16_t)(value + 1);
+  return 0;
+}
+
+/*
+ * Remove a PID from a PID index. Does nothing if it is not there.
+ */
+void unset_pid_index(pid_index_p index, uint32_t pid) {
+  if (pid < PID_INDEX_SIZE)
+    index->slot[pid] = 0;
+}
+
+/*
+ * Lookup a PID in a PID index.
+ *
+ * Returns the value associated with the PID (0 or more), or -1 if it is not
+ * present (which is always the case if `pid` is PID_INDEX_SIZE or more).
+ */
+int lookup_pid_index(pid_index_p index, uint32_t pid) {
+  if (pid >= PID_INDEX_SIZE)
+    return -1;
+  return (int)index->slot[pid] - 1;
+}
+
+/*
+ * Rebuild a pid/int list's PID index from its arrays.
+ */
+static void reindex_pidint_list(pidint_list_p list) {
+  int ii;
+  clear_pid_index(list->index);
+  for (ii = 0; ii < list->length; ii++)
+    (void)set_pid_index(list->index, list->pid[ii], ii, false);
+}
+
 // ============================================================================
 // PIDINT LIST maintenance
 // ============================================================================
@@ -48,6 +133,7 @@
 int init_pidint_list(pidint_list_p list) {
   list->length = 0;
   list->size = PIDINT_LIST_START_SIZE;
+  list->index = nullptr;
   list->number = (int *)malloc(sizeof(int) * PIDINT_LIST_START_SIZE);
   if (list->number == nullptr) {
     print_err("### Unable to allocate array in program list datastructure\n");
@@ -59,6 +145,11 @@ int init_pidint_list(pidint_list_p list) {
     print_err("### Unable to allocate array in program list datastructure\n");
     return 1;
   }
+  if (build_pid_index(&list->index)) {
+    free(list->number);
+    free(list->pid);
+    return 1;
+  }
   return 0;
 }
 
@@ -108,6 +199,8 @@ int append_to_pidint_list(pidint_list_p list, uint32_t pid, int program) {
   }
   list->number[list->length] = program;
   list->pid[list->length] = pid;
+  // PIDs that don't fit in the index are found by searching, instead
+  (void)set_pid_index(list->index, pid, list->length, false);
   list->length++;
   return 0;
 }
@@ -138,6 +231,7 @@ int remove_from_pidint_list(pidint_list_p list, uint32_t pid) {
     list->number[ii] = list->number[ii + 1];
   }
   (list->length)--;
+  reindex_pidint_list(list);
   return 0;
 }
 
@@ -159,6 +253,7 @@ void free_pidint_list(pidint_list_p *list) {
     free((*list)->pid);
     (*list)->pid = nullptr;
   }
+  free_pid_index(&(*list)->index);
   (*list)->length = 0;
   (*list)->size = 0;
   free(*list);
@@ -201,6 +296,8 @@ int pid_index_in_pidint_list(pidint_list_p list, uint32_t pid) {
   int ii;
   if (list == nullptr)
     return -1;
+  if (pid < PID_INDEX_SIZE && list->length <= PID_INDEX_MAX_VALUE + 1)
+    return lookup_pid_index(list->index, pid);
   for (ii = 0; ii < list->length; ii++) {
     if (list->pid[ii] == pid)
       return ii;
@@ -214,16 +311,11 @@ int pid_index_in_pidint_list(pidint_list_p list, uint32_t pid) {
  * Returns 0 if the PID is in the list, -1 if it is not.
  */
 int pid_int_in_pidint_list(pidint_list_p list, uint32_t pid, int *number) {
-  int ii;
-  if (list == nullptr)
+  int index = pid_index_in_pidint_list(list, pid);
+  if (index == -1)
     return -1;
-  for (ii = 0; ii < list->length; ii++) {
-    if (list->pid[ii] == pid) {
-      *number = list->number[ii];
-      return 0;
-    }
-  }
-  return -1;
+  *number = list->number[index];
+  return 0;
 }
 
 /*
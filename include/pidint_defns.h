@@ -37,13 +37,29 @@
 
 #include "compat.h"
 
+// ----------------------------------------------------------------------------
+// A direct lookup table from PID to (small) integer
+//
+// There are only 8192 possible PIDs, so rather than searching an array
+// for a PID, we can just index a table by it. Each slot holds the value
+// plus one, so that an all-zero table (e.g., from calloc) is empty.
+#define PID_INDEX_SIZE 0x2000
+#define PID_INDEX_MAX_VALUE 0xFFFE // the largest value a slot can hold
+
+struct pid_index {
+  uint16_t slot[PID_INDEX_SIZE];
+};
+typedef struct pid_index *pid_index_p;
+#define SIZEOF_PID_INDEX sizeof(struct pid_index)
+
 // ----------------------------------------------------------------------------
 // An expandable list of PID vs. integer
 struct pidint_list {
-  int *number;   // The integers
-  uint32_t *pid; // The corresponding PIDs
-  int length;    // How many there are
-  int size;      // How big the arrays are
+  int *number;       // The integers
+  uint32_t *pid;     // The corresponding PIDs
+  int length;        // How many there are
+  int size;          // How big the arrays are
+  pid_index_p index; // PID -> index in the arrays (first if repeated)
 };
 typedef struct pidint_list *pidint_list_p;
 #define SIZEOF_PIDINT_LIST sizeof(struct pidint_list)
@@ -31,6 +31,48 @@
 
 #include "pidint_defns.h"
 
+// ============================================================================
+// PID index maintenance
+// ============================================================================
+/*
+ * Clear a PID index, so that no PIDs are present in it.
+ */
+void clear_pid_index(pid_index_p index);
+/*
+ * Build a new (empty) PID index datastructure.
+ *
+ * Returns 0 if it succeeds, 1 if some error occurs.
+ */
+int build_pid_index(pid_index_p *index);
+/*
+ * Free a PID index datastructure, and return `index` as nullptr.
+ *
+ * Does nothing if `index` is already nullptr.
+ */
+void free_pid_index(pid_index_p *index);
+/*
+ * Associate a value with a PID in a PID index.
+ *
+ * If `replace` is false and the PID already has a value, that value is
+ * left alone.
+ *
+ * Returns 0 if it succeeds, 1 if the PID or value cannot be represented
+ * (`pid` must be less than PID_INDEX_SIZE, `value` must be in the range
+ * 0..PID_INDEX_MAX_VALUE).
+ */
+int set_pid_index(pid_index_p index, uint32_t pid, int value, int replace);
+/*
+ * Remove a PID from a PID index. Does nothing if it is not there.
+ */
+void unset_pid_index(pid_index_p index, uint32_t pid);
+/*
+ * Lookup a PID in a PID index.
+ *
+ * Returns the value associated with the PID (0 or more), or -1 if it is not
+ * present (which is always the case if `pid` is PID_INDEX_SIZE or more).
+ */
+int lookup_pid_index(pid_index_p index, uint32_t pid);
+
 // ============================================================================
 // PIDINT LIST maintenance
 // ============================================================================
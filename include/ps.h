@@ -95,7 +95,11 @@ struct program_data {
 static inline int get_more_data(PS_reader_p ps) {
   // Call `read` directly - we don't particularly mind if we get a "short"
   // read, since we'll just catch up later on
-  ssize_t len = read(ps->input, &ps->data, PS_READ_AHEAD_SIZE);
+  ssize_t len;
+  if (ps->async != nullptr)
+    len = async_read(ps->async, ps->data, PS_READ_AHEAD_SIZE);
+  else
+    len = read(ps->input, &ps->data, PS_READ_AHEAD_SIZE);
   if (len == 0)
     return EOF;
   else if (len == -1) {
@@ -131,6 +135,7 @@ int build_PS_reader(int input, int quiet, PS_reader_p *ps) {
   new2->data_posn = 0;
   new2->data_len = 0;
   new2->start = 0;
+  new2->async = nullptr;
 
   err = get_more_data(new2);
   if (err) {
@@ -182,6 +187,7 @@ int build_PS_reader(int input, int quiet, PS_reader_p *ps) {
  */
 void free_PS_reader(PS_reader_p *ps) {
   if (*ps != nullptr) {
+    free_async_reader(&(*ps)->async);
     (*ps)->input = -1; // "forget" our input
     free(*ps);
     *ps = nullptr;
@@ -219,6 +225,8 @@ int open_PS_file(char *name, int quiet, PS_reader_p *ps) {
  * Returns 0 if all goes well, 1 otherwise.
  */
 int close_PS_file(PS_reader_p *ps) {
+  // Make sure the read-ahead thread isn't still using the file
+  free_async_reader(&(*ps)->async);
   if ((*ps)->input != STDIN_FILENO) {
     int err = close_file((*ps)->input);
     if (err)
@@ -228,6 +236,23 @@ int close_PS_file(PS_reader_p *ps) {
   return 0;
 }
 
+/*
+ * Start reading the PS reader's input in a separate thread, so that the
+ * next `num_buffers`-1 chunks of the file are already being read while the
+ * current one is being dealt with (see `build_async_reader`).
+ *
+ * Any data already in the reader's buffer is kept, and reading carries on
+ * from where it left off.
+ *
+ * Returns 0 if all goes well, 1 if the thread could not be started (in
+ * which case the reader will carry on reading the file itself).
+ */
+int start_PS_read_ahead(PS_reader_p ps, int num_buffers) {
+  if (ps->async != nullptr)
+    return 0;
+  return build_async_reader(ps->input, num_buffers, 0, &ps->async);
+}
+
 /*
  * Given a program stream, attempt to determine if it holds H.262 or H.264
  * data.
@@ -327,7 +352,11 @@ int determine_PS_video_type(PS_reader_p ps, int *video_type) {
  * Return 0 if all goes well, 1 if something goes wrong
  */
 int seek_using_PS_reader(PS_reader_p ps, offset_t posn) {
-  int err = seek_file(ps->input, posn);
+  int err;
+  if (ps->async != nullptr)
+    err = seek_async_reader(ps->async, posn);
+  else
+    err = seek_file(ps->input, posn);
   if (err)
     return 1;
 
@@ -48,6 +48,10 @@ struct ps_reader {
   int32_t data_len;   // actual number of bytes in the buffer
   byte *data_end;     // off the end of `data`
   byte *data_ptr;     // which byte we're interested in (next)
+
+  // If the input is being read by a separate thread (see
+  // `start_PS_read_ahead`), then this is it
+  struct _async_reader *async;
 };
 typedef struct ps_reader *PS_reader_p;
 #define SIZEOF_PS_READER sizeof(struct ps_reader)
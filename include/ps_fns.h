@@ -76,6 +76,18 @@ int open_PS_file(char *name, int quiet, PS_reader_p *ps);
  * Returns 0 if all goes well, 1 otherwise.
  */
 int close_PS_file(PS_reader_p *ps);
+/*
+ * Start reading the PS reader's input in a separate thread, so that the
+ * next `num_buffers`-1 chunks of the file are already being read while the
+ * current one is being dealt with (see `build_async_reader`).
+ *
+ * Any data already in the reader's buffer is kept, and reading carries on
+ * from where it left off.
+ *
+ * Returns 0 if all goes well, 1 if the thread could not be started (in
+ * which case the reader will carry on reading the file itself).
+ */
+int start_PS_read_ahead(PS_reader_p ps, int num_buffers);
 /*
  * Given a program stream, attempt to determine if it holds H.262 or H.264
  * data.
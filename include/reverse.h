@@ -90,7 +90,8 @@
  * unit context (with add_h262/access_unit_reverse_context), and then use
  * get_next_h262_frame() or get_next_h264_frame() to read through the data
  * stream - appropriate pictures/access units will be remembered
- * automatically.
+ * automatically. HEVC data is handled like H.264 (so `is_h264` should be
+ * true), but attached with add_hevc_reverse_context() instead.
  *
  * Returns 0 if it succeeds, 1 if some error occurs.
  */
@@ -166,6 +167,9 @@ int build_reverse_data(reverse_data_p *reverse_data, int is_h264) {
   new2->num_pictures = 0;
 
   new2->is_h264 = is_h264;
+  new2->h262 = nullptr;
+  new2->h264 = nullptr;
+  new2->hevc = nullptr;
   new2->pictures_written = 0;
   new2->pictures_kept = 0;
   new2->first_written = 0;
@@ -824,7 +828,8 @@ static int output_sequence_header(ES_p es, WRITER output, int as_TS,
   int err;
   ES_offset seq_posn;
   uint32_t seq_len;
-  byte *seq_data = nullptr;
+  byte *seq_buffer = nullptr;
+  byte *seq_data;
   err = get_reverse_data(reverse_data, seq_index, nullptr, &seq_posn, &seq_len,
                          nullptr, nullptr);
   if (err) {
@@ -838,8 +843,10 @@ static int output_sequence_header(ES_p es, WRITER output, int as_TS,
                "/%04d for %5d\n",
                seq_index, seq_posn.infile, seq_posn.inpacket, seq_len);
 
-  err = read_ES_data(es, seq_posn, seq_len, nullptr, &seq_data);
+  err = get_ES_data(es, seq_posn, seq_len, nullptr, &seq_buffer, &seq_data);
   if (err) {
+    if (seq_buffer != nullptr)
+      free(seq_buffer);
     fprint_err("### Error reading (sequence header) data"
                " from " OFFSET_T_FORMAT "/%d for %d\n",
                seq_posn.infile, seq_posn.inpacket, seq_len);
@@ -847,7 +854,8 @@ static int output_sequence_header(ES_p es, WRITER output, int as_TS,
   }
   err = write_packet_data(output, as_TS, seq_data, seq_len, reverse_data->pid,
                           reverse_data->stream_id);
-  free(seq_data);
+  if (seq_buffer != nullptr)
+    free(seq_buffer);
   if (err) {
     print_err("### Error writing (sequence header) data as"
               " TS PES packet\n");
@@ -955,27 +963,32 @@ static int output_from_reverse_data(ES_p es, WRITER output, int as_TS,
     }
     free_h262_picture(&picture);
   } else {
-    byte *data = nullptr;
-    uint32_t data_len = 0;
-    err = read_ES_data(es, start_posn, num_bytes, &data_len, &data);
+    byte *buffer = nullptr;
+    uint32_t buffer_len = 0;
+    byte *data;
+    err = get_ES_data(es, start_posn, num_bytes, &buffer_len, &buffer, &data);
     if (err) {
       fprint_err("### Error reading data from " OFFSET_T_FORMAT "/%d for %d\n",
                  start_posn.infile, start_posn.inpacket, num_bytes);
+      if (buffer != nullptr)
+        free(buffer);
       return 1;
     }
     err = write_packet_data(output, as_TS, data, num_bytes, reverse_data->pid,
                             reverse_data->stream_id);
+    if (buffer != nullptr)
+      free(buffer);
     if (err) {
       print_err("### Error writing picture as TS PES packet\n");
-      free(data);
       return 1;
     }
-    free(data);
   }
 
   // And let our "outer" contexts know which picture that *is* in the
   // sequence of pictures
-  if (reverse_data->is_h264)
+  if (reverse_data->hevc != nullptr)
+    reverse_data->hevc->access_unit_index = reverse_data->index[which];
+  else if (reverse_data->is_h264)
     reverse_data->h264->access_unit_index = reverse_data->index[which];
   else
     reverse_data->h262->picture_index = reverse_data->index[which];
@@ -1080,8 +1093,9 @@ static int output_in_reverse(ES_p es, WRITER output, int as_TS, int frequency,
                              int max, reverse_data_p reverse_data) {
   int ii;
   int with_sequence_headers = reverse_data->output_sequence_headers;
+  byte *buffer = nullptr;           // our own picture data, if we need it
+  uint32_t buffer_len = 0;          // the current size of `buffer`
   byte *data = nullptr;             // picture data, as a "chunk"
-  uint32_t data_len = 0;            // the current size of `data`
   h262_picture_p picture = nullptr; // H.262 picture data as a "picture"
   uint32_t last_seq_index = reverse_data->length; // impossible value
   int max_pic_index = reverse_data->length - 1;
@@ -1163,8 +1177,8 @@ static int output_in_reverse(ES_p es, WRITER output, int as_TS, int frequency,
     uint32_t seq_index;
 
     if (as_TS && tswrite_command_changed(output.ts_output)) {
-      if (data != nullptr)
-        free(data);
+      if (buffer != nullptr)
+        free(buffer);
       if (picture != nullptr)
         free_h262_picture(&picture);
       return COMMAND_RETURN_CODE;
@@ -1229,8 +1243,8 @@ static int output_in_reverse(ES_p es, WRITER output, int as_TS, int frequency,
                                     reverse_data->pid, reverse_data->stream_id);
             if (err) {
               print_err("### Error writing (picture) data\n");
-              if (data != nullptr)
-                free(data);
+              if (buffer != nullptr)
+                free(buffer);
               if (picture != nullptr)
                 free_h262_picture(&picture);
               return 1;
@@ -1265,8 +1279,8 @@ static int output_in_reverse(ES_p es, WRITER output, int as_TS, int frequency,
             fprint_err("### Error retrieving sequence header"
                        " for picture %d (offset %d)\n",
                        ii, seq_offset);
-            if (data != nullptr)
-              free(data);
+            if (buffer != nullptr)
+              free(buffer);
             if (picture != nullptr)
               free_h262_picture(&picture);
             return 1;
@@ -1299,21 +1313,22 @@ static int output_in_reverse(ES_p es, WRITER output, int as_TS, int frequency,
           return 1;
         }
       } else {
-        err = read_ES_data(es, start_posn, num_bytes, &data_len, &data);
+        err = get_ES_data(es, start_posn, num_bytes, &buffer_len, &buffer,
+                          &data);
         if (err) {
           fprint_err("### Error reading data from " OFFSET_T_FORMAT
                      "/%d for %d\n",
                      start_posn.infile, start_posn.inpacket, num_bytes);
-          if (data != nullptr)
-            free(data);
+          if (buffer != nullptr)
+            free(buffer);
           return 1;
         }
         err = write_packet_data(output, as_TS, data, num_bytes,
                                 reverse_data->pid, reverse_data->stream_id);
         if (err) {
           print_err("### Error writing picture\n");
-          if (data != nullptr)
-            free(data);
+          if (buffer != nullptr)
+            free(buffer);
           return 1;
         }
         last_num_bytes = num_bytes;
@@ -1325,7 +1340,9 @@ static int output_in_reverse(ES_p es, WRITER output, int as_TS, int frequency,
 
       // And let our "outer" contexts know which picture that *is* in the
       // sequence of pictures
-      if (reverse_data->is_h264)
+      if (reverse_data->hevc != nullptr)
+        reverse_data->hevc->access_unit_index = reverse_data->index[ii];
+      else if (reverse_data->is_h264)
         reverse_data->h264->access_unit_index = reverse_data->index[ii];
       else
         reverse_data->h262->picture_index = reverse_data->index[ii];
@@ -1348,8 +1365,8 @@ static int output_in_reverse(ES_p es, WRITER output, int as_TS, int frequency,
       break;
     }
   }
-  if (data != nullptr)
-    free(data);
+  if (buffer != nullptr)
+    free(buffer);
   if (picture != nullptr)
     free_h262_picture(&picture);
 
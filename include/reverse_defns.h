@@ -37,6 +37,7 @@
 typedef struct reverse_data *reverse_data_p;
 #include "accessunit_defns.h"
 #include "h262_defns.h"
+#include "hevc_defns.h"
 
 // ------------------------------------------------------------
 // As the software progresses through the data stream forwards, it remembers
@@ -50,6 +51,9 @@ struct reverse_data {
   // seem worth the bother at the moment).
   h262_context_p h262;
   access_unit_context_p h264;
+  // HEVC data is reversed just as H.264 is (so `is_h264` is also true),
+  // but is read with its own context
+  hevc_context_p hevc;
 
   // Information for managing our arrays. `use_seq_offset` will be true
   // for H.262 data, and false for H.264 (MPEG-4/AVC)
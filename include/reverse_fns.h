@@ -44,7 +44,8 @@
  * unit context (with add_h262/access_unit_reverse_context), and then use
  * get_next_h262_frame() or get_next_h264_frame() to read through the data
  * stream - appropriate pictures/access units will be remembered
- * automatically.
+ * automatically. HEVC data is handled like H.264 (so `is_h264` should be
+ * true), but attached with add_hevc_reverse_context() instead.
  *
  * Returns 0 if it succeeds, 1 if some error occurs.
  */
@@ -33,6 +33,8 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "compat.h"
@@ -53,6 +55,11 @@
 // to set this to false in utilities that it matters for.
 static int report_bad_reserved_bits = false;
 
+// Should we check the CRC on the PSI sections (PAT, PMT) we parse?
+// And how many have we found to be wrong so far?
+static int check_PSI_CRC = true;
+static int PSI_CRC_error_count = 0;
+
 // ============================================================
 // Suppport for the creation of Transport Streams.
 // ============================================================
@@ -218,15 +225,11 @@ static int write_TS_packet_parts(TS_writer_p output,
     return 1;
   }
 
-  // We want to make a single write, so we need to assemble the package
-  // into our packet buffer
-  if (pes_hdr_len > 0)
-    memcpy(&(TS_packet[TS_hdr_len]), pes_hdr, pes_hdr_len);
-
-  if (data_len > 0)
-    memcpy(&(TS_packet[TS_hdr_len + pes_hdr_len]), data, data_len);
-
-  err = tswrite_write(output, TS_packet, pid, got_pcr, pcr);
+  // We want to make a single write, so the parts need to be assembled
+  // into a single packet - either straight into the output buffer (when
+  // writing to a file), or into our packet buffer
+  err = tswrite_write_parts(output, TS_packet, TS_hdr_len, pes_hdr,
+                            pes_hdr_len, data, data_len, pid, got_pcr, pcr);
   if (err) {
     fprint_err("### Error writing out TS packet: %s\n", strerror(errno));
     return 1;
@@ -604,6 +607,117 @@ int write_PES_as_TS_PES_packet(TS_writer_p output, byte data[],
 #endif // MPEG1_AS_ES
 }
 
+/*
+ * Write out a PES packet that is held as a start and a list of slices
+ * (see `flatten_PES_packet_data`) as Transport Stream PES packets, without
+ * first copying it into a single array.
+ *
+ * The TS packets written are exactly those that `write_PES_as_TS_PES_packet`
+ * would write for the same (H.222.0) PES packet, without a PCR.
+ *
+ * - `output` is the TS output context returned by `tswrite_open`
+ * - `head` is the start of the PES data, including its PES header
+ * - `head_len` is its length
+ * - `slice` is the rest of the PES data, in order
+ * - `num_slices` is how many slices there are
+ * - `pid` is the PID to use for the TS packets
+ *
+ * Returns 0 if it worked, 1 if something went wrong.
+ */
+int write_PES_slices_as_TS_PES_packet(TS_writer_p output, byte head[],
+                                      uint32_t head_len,
+                                      const struct iovec slice[],
+                                      int num_slices, uint32_t pid) {
+  byte TS_packet[TS_PACKET_SIZE];
+  uint32_t total = head_len; // how much is left to write
+  int start = true;
+  int index = -1; // which slice we are in, or -1 for `head`
+  byte *piece = head;
+  uint32_t piece_left = head_len;
+  int ii;
+  int err;
+
+  if (pid < 0x0010 || pid > 0x1ffe) {
+    fprint_err("### PID %03x is outside legal program stream range", pid);
+    return 1;
+  }
+  for (ii = 0; ii < num_slices; ii++)
+    total += slice[ii].iov_len;
+
+  while (total > 0) {
+    int TS_hdr_len;
+    uint32_t space_left;
+
+    while (piece_left == 0 && index + 1 < num_slices) {
+      index++;
+      piece = (byte *)slice[index].iov_base;
+      piece_left = slice[index].iov_len;
+    }
+
+    TS_packet[0] = 0x47;
+    TS_packet[1] = (byte)((start ? 0x40 : 0x00) | ((pid & 0x1f00) >> 8));
+    TS_packet[2] = (byte)(pid & 0xff);
+    if (total >= MAX_TS_PAYLOAD_SIZE) {
+      TS_packet[3] = (byte)(0x10 | next_continuity_count(pid));
+      TS_hdr_len = 4;
+    } else {
+      // Pad out the last packet with an adaptation field, just as
+      // `write_some_TS_PES_packet` does
+      TS_packet[3] = (byte)(0x30 | next_continuity_count(pid));
+      if (total == MAX_TS_PAYLOAD_SIZE - 1) {
+        TS_packet[4] = 0;
+        TS_hdr_len = 5;
+      } else {
+        TS_packet[4] = (byte)(MAX_TS_PAYLOAD_SIZE - 1 - total);
+        TS_packet[5] = 0;
+        memset(&TS_packet[6], 0xFF, MAX_TS_PAYLOAD_SIZE - 2 - total);
+        TS_hdr_len = TS_PACKET_SIZE - total;
+      }
+    }
+    space_left = TS_PACKET_SIZE - TS_hdr_len;
+    start = false;
+    total -= space_left;
+
+    if (piece_left >= space_left) {
+      err = write_TS_packet_parts(output, TS_packet, TS_hdr_len, nullptr, 0,
+                                  piece, space_left, pid, false, 0);
+      piece += space_left;
+      piece_left -= space_left;
+    } else if (index + 1 < num_slices &&
+               piece_left + slice[index + 1].iov_len >= space_left) {
+      // The payload straddles two pieces, which the writer can cope with
+      uint32_t rest = space_left - piece_left;
+      err = write_TS_packet_parts(output, TS_packet, TS_hdr_len, piece,
+                                  piece_left, (byte *)slice[index + 1].iov_base,
+                                  rest, pid, false, 0);
+      index++;
+      piece = (byte *)slice[index].iov_base + rest;
+      piece_left = slice[index].iov_len - rest;
+    } else {
+      // It's spread over more pieces than that, so gather it ourselves
+      uint32_t got = 0;
+      while (got < space_left) {
+        uint32_t count;
+        while (piece_left == 0) {
+          index++;
+          piece = (byte *)slice[index].iov_base;
+          piece_left = slice[index].iov_len;
+        }
+        count = min(piece_left, space_left - got);
+        memcpy(&TS_packet[TS_hdr_len + got], piece, count);
+        got += count;
+        piece += count;
+        piece_left -= count;
+      }
+      err = write_TS_packet_parts(output, TS_packet, TS_PACKET_SIZE, nullptr, 0,
+                                  nullptr, 0, pid, false, 0);
+    }
+    if (err)
+      return err;
+  }
+  return 0;
+}
+
 /*
  * Construct a Transport Stream packet header for PAT or PMT data.
  *
@@ -1162,6 +1276,88 @@ int open_file_for_TS_read(char *filename, TS_reader_p *tsreader) {
   return 0;
 }
 
+/*
+ * Memory map the file a TS reader is reading from, so that subsequent TS
+ * packets are returned as pointers directly into the mapping, rather than
+ * being copied into the read-ahead buffer first.
+ *
+ * This only makes sense for a regular file that is being read from its
+ * start. If the reader is using standard input (or a pipe, or its own
+ * `read_fn`), or the mapping fails for some other reason, then the reader is
+ * left to carry on using read() as normal.
+ *
+ * The mapping is private and writable, so packets may still be altered in
+ * place by the caller (without changing the file).
+ *
+ * Returns 0 if the file was mapped, 1 if it was not.
+ */
+int map_TS_reader(TS_reader_p tsreader) {
+  struct stat info;
+  void *addr;
+
+  if (tsreader->mapped != nullptr)
+    return 0;
+  if (tsreader->read_fn != nullptr || tsreader->file == -1 ||
+      tsreader->file == STDIN_FILENO)
+    return 1;
+
+  if (fstat(tsreader->file, &info) == -1 || !S_ISREG(info.st_mode) ||
+      info.st_size == 0)
+    return 1;
+
+  addr = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+              tsreader->file, 0);
+  if (addr == MAP_FAILED)
+    return 1;
+  (void)madvise(addr, info.st_size, MADV_SEQUENTIAL);
+
+  tsreader->mapped = (byte *)addr;
+  tsreader->mapped_len = info.st_size;
+  tsreader->advised = 0;
+  // Anything already in the read-ahead buffer is also in the mapping, and
+  // `posn` tells us where we are in it
+  tsreader->read_ahead_ptr = nullptr;
+  tsreader->read_ahead_end = nullptr;
+  return 0;
+}
+
+/*
+ * Tell a TS reader whether it should resynchronise on losing sync.
+ *
+ * Normally, it is assumed that the input is a clean sequence of TS packets,
+ * and a packet that doesn't start with 0x47 is returned as-is (so that, for
+ * instance, `split_TS_packet` will complain about it). If `resync` is true,
+ * then instead the reader skips forwards until it finds TS_RESYNC_PACKETS
+ * sync bytes at the right spacing, and carries on from there. This copes
+ * with (for instance) a recording that has gained or lost a byte.
+ *
+ * The number of times this happens, and the number of bytes skipped, are
+ * counted in `resync_count` and `resync_skipped`.
+ */
+void set_TS_reader_resync(TS_reader_p tsreader, int resync) {
+  tsreader->resync = resync;
+}
+
+/*
+ * Start reading the TS reader's input in a separate thread, so that the
+ * next `num_buffers`-1 chunks of the file are already being read while the
+ * current one is being dealt with (see `build_async_reader`).
+ *
+ * This does not make sense (and is not done) for a reader that has been
+ * memory mapped, or that is using its own `read_fn`.
+ *
+ * Returns 0 if the read-ahead thread was started, 1 if it was not (in
+ * which case the reader will carry on reading the file itself).
+ */
+int start_TS_read_ahead(TS_reader_p tsreader, int num_buffers) {
+  if (tsreader->async != nullptr)
+    return 0;
+  if (tsreader->mapped != nullptr || tsreader->read_fn != nullptr ||
+      tsreader->file == -1)
+    return 1;
+  return build_async_reader(tsreader->file, num_buffers, 0, &tsreader->async);
+}
+
 /*
  * Free a TS packet read-ahead buffer
  *
@@ -1171,6 +1367,9 @@ void free_TS_reader(TS_reader_p *tsreader) {
   if (*tsreader != nullptr) {
     if ((*tsreader)->pcrbuf != nullptr)
       free((*tsreader)->pcrbuf);
+    free_async_reader(&(*tsreader)->async);
+    if ((*tsreader)->mapped != nullptr)
+      (void)munmap((*tsreader)->mapped, (*tsreader)->mapped_len);
     (*tsreader)->file = -1;
     free(*tsreader);
     *tsreader = nullptr;
@@ -1189,6 +1388,8 @@ int close_TS_reader(TS_reader_p *tsreader) {
   int err = 0;
   if (*tsreader == nullptr)
     return 0;
+  // Make sure the read-ahead thread isn't still using the file
+  free_async_reader(&(*tsreader)->async);
   if ((*tsreader)->file != STDIN_FILENO && (*tsreader)->file != -1)
     err = close_file((*tsreader)->file);
 
@@ -1212,15 +1413,217 @@ int close_TS_reader(TS_reader_p *tsreader) {
 int seek_using_TS_reader(TS_reader_p tsreader, offset_t posn) {
   tsreader->read_ahead_ptr = nullptr;
   tsreader->read_ahead_end = nullptr;
+  tsreader->read_ahead_extra = 0;
   tsreader->posn = posn;
 
-  if (tsreader->seek_fn) {
+  if (tsreader->mapped != nullptr) {
+    tsreader->advised = 0; // so we advise about the new position
+    return 0;
+  } else if (tsreader->async != nullptr) {
+    return seek_async_reader(tsreader->async, posn);
+  } else if (tsreader->seek_fn) {
     return tsreader->seek_fn(tsreader->handle, posn);
   } else {
     return seek_file(tsreader->file, posn);
   }
 }
 
+/*
+ * Look for where TS packets start again, after losing sync.
+ *
+ * - `data` is the data to look in, and `len` its length
+ * - `from` is the first offset in `data` worth considering
+ * - `at_eof` is true if there is no more data after `data`, in which case
+ *   we accept a run of sync bytes that is cut short by the end of the data
+ *   (as long as it gives at least one whole packet)
+ * - `checked` is set to the offset before which we now know there can be no
+ *   start of packet, if we don't find one
+ *
+ * Candidate sync bytes are found with memchr(), which the C library
+ * vectorises, and we then insist on seeing TS_RESYNC_PACKETS of them in
+ * a row.
+ *
+ * Returns the offset of the start of the next packet, or -1 if none was
+ * found (possibly because more data is needed to be sure).
+ */
+static offset_t find_TS_sync(byte *data, offset_t len, offset_t from,
+                             int at_eof, offset_t *checked) {
+  byte *ptr = data + from;
+  byte *end = data + len;
+
+  while (ptr < end) {
+    offset_t posn;
+    int ii;
+
+    ptr = (byte *)memchr(ptr, 0x47, end - ptr);
+    if (ptr == nullptr)
+      break;
+    posn = ptr - data;
+
+    for (ii = 1; ii < TS_RESYNC_PACKETS; ii++) {
+      offset_t next = posn + ii * TS_PACKET_SIZE;
+      if (next >= len || data[next] != 0x47)
+        break;
+    }
+    if (ii == TS_RESYNC_PACKETS)
+      return posn;
+    else if (posn + ii * TS_PACKET_SIZE >= len) {
+      // We ran out of data before we could decide
+      if (!at_eof) {
+        *checked = posn;
+        return -1;
+      } else if (posn + TS_PACKET_SIZE <= len)
+        return posn;
+      else
+        break;
+    }
+    ptr++;
+  }
+  *checked = len;
+  return -1;
+}
+
+/*
+ * Report on having (tried to) resynchronise, and remember we did so.
+ */
+static void note_TS_resync(TS_reader_p tsreader, offset_t skipped) {
+  fprint_err("!!! Lost TS sync at " OFFSET_T_FORMAT ", skipped " OFFSET_T_FORMAT
+             " byte%s to find it again\n",
+             tsreader->posn, skipped, (skipped == 1 ? "" : "s"));
+  tsreader->posn += skipped;
+  tsreader->resync_count++;
+  tsreader->resync_skipped += skipped;
+}
+
+/*
+ * Return the next TS packet from a memory mapped TS reader.
+ *
+ * Works as `read_next_TS_packets`, but there is no need to worry about
+ * any bytes of the first packet we may already have in hand, since they
+ * are in the mapping as well.
+ */
+static int next_mapped_TS_packet(TS_reader_p tsreader, byte **packet) {
+  offset_t left = tsreader->mapped_len - tsreader->posn;
+
+  if (tsreader->resync && left > 0 &&
+      tsreader->mapped[tsreader->posn] != 0x47) {
+    offset_t checked;
+    offset_t found = find_TS_sync(tsreader->mapped + tsreader->posn, left, 1,
+                                  true, &checked);
+    note_TS_resync(tsreader, (found == -1 ? left : found));
+    if (found == -1)
+      return EOF;
+    left -= found;
+  }
+
+  if (left < TS_PACKET_SIZE) {
+    if (left > 0) {
+      fprint_err("!!! %d byte%s ignored at end of file - not enough"
+                 " to make a TS packet\n",
+                 (int)left, (left == 1 ? "" : "s"));
+      tsreader->posn += left; // so we only complain once
+    }
+    return EOF;
+  }
+
+  // Keep the kernel reading ahead of us, a window at a time
+  if (tsreader->posn + TS_MMAP_WINDOW / 2 >= tsreader->advised &&
+      tsreader->advised < tsreader->mapped_len) {
+    offset_t start = tsreader->posn & ~((offset_t)getpagesize() - 1);
+    offset_t end = min(start + TS_MMAP_WINDOW, tsreader->mapped_len);
+    (void)madvise(tsreader->mapped + start, end - start, MADV_WILLNEED);
+    tsreader->advised = end;
+  }
+
+  *packet = tsreader->mapped + tsreader->posn;
+  tsreader->posn += TS_PACKET_SIZE;
+  return 0;
+}
+
+/*
+ * Read up to `num_bytes` of the TS reader's input into `data`, allowing
+ * for partial reads.
+ *
+ * Sets `at_eof` if the end of file was reached.
+ *
+ * Returns the number of bytes read, or -1 if an error occurred (in which
+ * case it will already have output a message on stderr about the problem).
+ */
+static ssize_t read_TS_data(TS_reader_p tsreader, byte *data, size_t num_bytes,
+                            int *at_eof) {
+  ssize_t total = 0;
+  ssize_t length;
+
+  while ((size_t)total < num_bytes) {
+    if (tsreader->read_fn)
+      length =
+          tsreader->read_fn(tsreader->handle, &data[total], num_bytes - total);
+    else if (tsreader->async)
+      length = async_read(tsreader->async, &data[total], num_bytes - total);
+    else
+      length = read(tsreader->file, &data[total], num_bytes - total);
+
+    if (length == 0) { // EOF - no more data to read
+      *at_eof = true;
+      break;
+    } else if (length == -1) {
+      fprint_err("### Error reading TS packets: %s\n", strerror(errno));
+      return -1;
+    }
+    total += length;
+  }
+  return total;
+}
+
+/*
+ * Resynchronise the read-ahead buffer, starting at `read_ahead_ptr`, which
+ * is assumed to be a packet that does not start with 0x47.
+ *
+ * Returns 0 if all goes well, EOF if the end of file was reached before
+ * finding another packet, or 1 if some other error occurred.
+ */
+static int resync_TS_reader(TS_reader_p tsreader) {
+  offset_t skipped = 0;
+  offset_t from = 1; // we know the first byte isn't a sync byte
+  int at_eof = false;
+
+  for (;;) {
+    ssize_t have = (tsreader->read_ahead_end - tsreader->read_ahead_ptr) +
+                   tsreader->read_ahead_extra;
+    offset_t found, checked, rest;
+
+    // Keep what we have, and top it up with as much more as we can
+    memmove(tsreader->read_ahead, tsreader->read_ahead_ptr, have);
+    if (!at_eof) {
+      ssize_t length = read_TS_data(tsreader, tsreader->read_ahead + have,
+                                    TS_READ_AHEAD_BYTES - have, &at_eof);
+      if (length == -1)
+        return 1;
+      have += length;
+    }
+
+    found = find_TS_sync(tsreader->read_ahead, have, from, at_eof, &checked);
+    if (found != -1)
+      checked = found;
+
+    skipped += checked;
+    rest = have - checked;
+    tsreader->read_ahead_ptr = tsreader->read_ahead + checked;
+    tsreader->read_ahead_end =
+        tsreader->read_ahead_ptr + rest - (rest % TS_PACKET_SIZE);
+    tsreader->read_ahead_extra = rest % TS_PACKET_SIZE;
+
+    if (found != -1 || at_eof)
+      break;
+    from = 0;
+  }
+
+  note_TS_resync(tsreader, skipped);
+  if (tsreader->read_ahead_ptr == tsreader->read_ahead_end)
+    return EOF;
+  return 0;
+}
+
 /*
  * Read the next several TS packets, possibly not from the start
  *
@@ -1242,48 +1645,59 @@ static int read_next_TS_packets(TS_reader_p tsreader, int start_len,
                                 byte *packet[TS_PACKET_SIZE]) {
   ssize_t total = start_len;
   ssize_t length;
+  int at_eof = false;
 
   // If we exit with an error make sure we don't return anything valid here!
   *packet = nullptr;
 
-  if (tsreader->read_ahead_ptr == tsreader->read_ahead_end) {
-    // Try to allow for partial reads
-    while (total < TS_READ_AHEAD_BYTES) {
-      if (tsreader->read_fn)
-        length =
-            tsreader->read_fn(tsreader->handle, &(tsreader->read_ahead[total]),
-                              TS_READ_AHEAD_BYTES - total);
-      else
-        length = read(tsreader->file, &(tsreader->read_ahead[total]),
-                      TS_READ_AHEAD_BYTES - total);
+  if (tsreader->mapped != nullptr)
+    return next_mapped_TS_packet(tsreader, packet);
 
-      if (length == 0) // EOF - no more data to read
-        break;
-      else if (length == -1) {
-        fprint_err("### Error reading TS packets: %s\n", strerror(errno));
-        return 1;
-      }
-      total += length;
+  if (tsreader->read_ahead_ptr == tsreader->read_ahead_end) {
+    // If resynchronising left us part of a packet, it comes first
+    if (tsreader->read_ahead_extra > 0) {
+      memmove(tsreader->read_ahead, tsreader->read_ahead_end,
+              tsreader->read_ahead_extra);
+      total = tsreader->read_ahead_extra;
+      tsreader->read_ahead_extra = 0;
     }
 
+    length = read_TS_data(tsreader, &(tsreader->read_ahead[total]),
+                          TS_READ_AHEAD_BYTES - total, &at_eof);
+    if (length == -1)
+      return 1;
+    total += length;
+
     // If we didn't manage to read anything at all, then indicate EOF this
     // time - we assume that if we actually read to the EOF but got some data,
     // we'll "hit" EOF again next time we try to read.
     if (total == 0)
       return EOF;
 
-    if (total % TS_PACKET_SIZE != 0) {
-      fprint_err("!!! %d byte%s ignored at end of file - not enough"
-                 " to make a TS packet\n",
-                 (int)(total % TS_PACKET_SIZE),
-                 (total % TS_PACKET_SIZE == 1 ? "" : "s"));
-      // Retain whatever full packets we *do* have
-      total = total - (total % TS_PACKET_SIZE);
-      if (total == 0)
-        return EOF;
-    }
     tsreader->read_ahead_ptr = tsreader->read_ahead;
-    tsreader->read_ahead_end = tsreader->read_ahead + total;
+    if (tsreader->resync && tsreader->read_ahead[0] != 0x47) {
+      // Look for sync before deciding what's left over at the end
+      tsreader->read_ahead_end = tsreader->read_ahead;
+      tsreader->read_ahead_extra = total;
+    } else {
+      if (total % TS_PACKET_SIZE != 0) {
+        fprint_err("!!! %d byte%s ignored at end of file - not enough"
+                   " to make a TS packet\n",
+                   (int)(total % TS_PACKET_SIZE),
+                   (total % TS_PACKET_SIZE == 1 ? "" : "s"));
+        // Retain whatever full packets we *do* have
+        total = total - (total % TS_PACKET_SIZE);
+        if (total == 0)
+          return EOF;
+      }
+      tsreader->read_ahead_end = tsreader->read_ahead + total;
+    }
+  }
+
+  if (tsreader->resync && tsreader->read_ahead_ptr[0] != 0x47) {
+    int err = resync_TS_reader(tsreader);
+    if (err)
+      return err;
   }
 
   *packet = tsreader->read_ahead_ptr;
@@ -1855,6 +2269,21 @@ void report_payload(int show_data, int stream_type,
     print_data(true, "Data", payload, payload_len, 1000);
 }
 
+/*
+ * Choose whether extract_prog_list_from_pat() and extract_pmt() check the
+ * CRC at the end of each section. This is on by default.
+ */
+void set_PSI_CRC_checking(int check) {
+  check_PSI_CRC = check;
+}
+
+/*
+ * Return how many PSI sections have been found with a bad CRC so far.
+ */
+int get_PSI_CRC_error_count(void) {
+  return PSI_CRC_error_count;
+}
+
 /*
  * Extract the program list from a PAT packet (PID 0x0000).
  *
@@ -1956,12 +2385,15 @@ int extract_prog_list_from_pat(int verbose, byte data[], int data_len,
   crc = (crc << 8) | data[data_len - 1];
 
   // Let's check the CRC
-  check_crc = crc32_block(0xffffffff, data, data_len);
-  if (check_crc != 0) {
-    fprint_err("!!! Calculated CRC for PAT is %08x, not 00000000"
-               " (CRC in data was %08x)\n",
-               check_crc, crc);
-    return 1;
+  if (check_PSI_CRC) {
+    check_crc = crc32_block(0xffffffff, data, data_len);
+    if (check_crc != 0) {
+      PSI_CRC_error_count++;
+      fprint_err("!!! Calculated CRC for PAT is %08x, not 00000000"
+                 " (CRC in data was %08x)\n",
+                 check_crc, crc);
+      return 1;
+    }
   }
 
   // (remember the section length is for the bytes *after* the section
@@ -2924,13 +3356,17 @@ int extract_pmt(int verbose, byte data[], int data_len, uint32_t pid,
   crc = (crc << 8) | data[data_len - 1];
 
   // Let's check the CRC
-  check_crc = crc32_block(0xffffffff, data, data_len);
-  if (check_crc != 0) {
-    fprint_err("!!! Calculated CRC for PMT (PID %04x) is %08x, not 00000000"
-               " (CRC in data was %08x)\n",
-               pid, check_crc, crc);
-    // Should we carry on or give up (if "give up", then "!!!" should be "###").
-    // return 1;
+  if (check_PSI_CRC) {
+    check_crc = crc32_block(0xffffffff, data, data_len);
+    if (check_crc != 0) {
+      PSI_CRC_error_count++;
+      fprint_err("!!! Calculated CRC for PMT (PID %04x) is %08x, not 00000000"
+                 " (CRC in data was %08x)\n",
+                 pid, check_crc, crc);
+      // Should we carry on or give up (if "give up", then "!!!" should be
+      // "###").
+      // return 1;
+    }
   }
 
   // So we can work out the length of the actual program data
@@ -3288,6 +3724,105 @@ int split_TS_packet(byte buf[TS_PACKET_SIZE], uint32_t *pid,
   return 0;
 }
 
+/*
+ * Decode the headers of the packets in a batch.
+ *
+ * This is deliberately written as a branch-free loop over the batch, so that
+ * the compiler can pipeline (and, where it can, vectorise) it.
+ */
+static inline void decode_TS_packet_batch(TS_packet_batch_p batch) {
+  int ii;
+  for (ii = 0; ii < batch->count; ii++) {
+    byte *buf = batch->packet[ii];
+    uint32_t pid = ((buf[1] & 0x1f) << 8) | buf[2];
+    uint32_t not_null = (pid != 0x1FFF);
+    uint32_t has_adapt = ((buf[3] >> 5) & 1) & not_null;
+    uint32_t has_payload = ((buf[3] >> 4) & 1) & not_null;
+    uint32_t adapt_len = buf[4] * has_adapt;
+    uint32_t payload_off = 4 + has_adapt * (1 + adapt_len);
+
+    batch->pid[ii] = (uint16_t)pid;
+    batch->pusi[ii] = (buf[1] >> 6) & 1;
+    batch->cc[ii] = buf[3] & 0x0f;
+    batch->adapt_len[ii] = (byte)adapt_len;
+    batch->payload_off[ii] =
+        (byte)(payload_off * (has_payload & (payload_off < TS_PACKET_SIZE)));
+    batch->bad_sync[ii] = (buf[0] != 0x47);
+  }
+}
+
+/*
+ * Read a batch of TS packets, and decode their headers.
+ *
+ * This returns (up to) the next `max` packets that the reader already has in
+ * hand (reading more data first only if it has none), along with their PIDs,
+ * payload_unit_start_indicators, continuity counters, adaptation field
+ * lengths and payload offsets, in parallel arrays. This is cheaper than
+ * calling `read_next_TS_packet` and `split_TS_packet` for each packet.
+ *
+ * - `tsreader` is the TS packet reading context
+ * - `max` is the most packets wanted, which is limited to TS_BATCH_SIZE.
+ * - `batch` is the batch to fill in.
+ *
+ * As with `read_next_TS_packet`, the packets are in the reader's read-ahead
+ * buffer (or mapping), so will not persist beyond the next read.
+ *
+ * The decoding agrees with `split_TS_packet`, except that no messages are
+ * output: a packet with a bad sync byte is just flagged in `bad_sync`, and
+ * one with a reserved adaptation_field_control, or an adaptation field that
+ * leaves no room for payload, is treated as having no payload.
+ *
+ * Returns 0 if all goes well, EOF if there are no more packets, or 1 if some
+ * other error occurred (in which case it will already have output a message
+ * on stderr about the problem).
+ */
+int read_TS_packet_batch(TS_reader_p tsreader, int max,
+                         TS_packet_batch_p batch) {
+  int err, ii;
+  int count;
+  offset_t in_hand;
+  byte *first;
+
+  batch->count = 0;
+  if (max > TS_BATCH_SIZE)
+    max = TS_BATCH_SIZE;
+  if (max < 1)
+    return 0;
+
+  // Reading the first packet refills the read-ahead buffer if need be
+  err = read_next_TS_packets(tsreader, 0, &first);
+  if (err)
+    return err;
+  batch->posn = tsreader->posn - TS_PACKET_SIZE;
+
+  // And then we can take as many of the following packets as we have
+  if (tsreader->mapped != nullptr)
+    in_hand = (tsreader->mapped_len - tsreader->posn) / TS_PACKET_SIZE;
+  else
+    in_hand =
+        (tsreader->read_ahead_end - tsreader->read_ahead_ptr) / TS_PACKET_SIZE;
+  count = 1 + (int)min(in_hand, (offset_t)(max - 1));
+
+  // If we're resynchronising, stop short of any packet that's lost sync,
+  // so that the next read can deal with it
+  if (tsreader->resync) {
+    for (ii = 1; ii < count; ii++)
+      if (first[ii * TS_PACKET_SIZE] != 0x47)
+        break;
+    count = ii;
+  }
+
+  if (tsreader->mapped == nullptr)
+    tsreader->read_ahead_ptr += (count - 1) * TS_PACKET_SIZE;
+  tsreader->posn += (count - 1) * TS_PACKET_SIZE;
+
+  batch->count = count;
+  for (ii = 0; ii < count; ii++)
+    batch->packet[ii] = first + ii * TS_PACKET_SIZE;
+  decode_TS_packet_batch(batch);
+  return 0;
+}
+
 /*
  * Return the next TS packet, as payload and adaptation controls.
  *
@@ -97,6 +97,15 @@ typedef struct _ts_pcr_buffer *TS_pcr_buffer_p;
 // Thus the number of bytes to read ahead
 #define TS_READ_AHEAD_BYTES TS_READ_AHEAD_COUNT *TS_PACKET_SIZE
 
+// When the input file is memory mapped, how much of it we ask the kernel
+// to read in ahead of us at a time (see `map_TS_reader`)
+#define TS_MMAP_WINDOW (8 * 1024 * 1024)
+
+// When resynchronising after losing sync, how many sync bytes we want to
+// see, TS_PACKET_SIZE bytes apart, before we believe we've found packets
+// again (see `set_TS_reader_resync`)
+#define TS_RESYNC_PACKETS 5
+
 // A read-ahead buffer for reading TS packets.
 //
 // Note that `posn` always gives the file position of the *next* TS packet to
@@ -115,6 +124,25 @@ struct _ts_reader {
   byte read_ahead[TS_READ_AHEAD_COUNT * TS_PACKET_SIZE];
   byte *read_ahead_ptr; // location of next packet in said array
   byte *read_ahead_end; // pointer just after the end of `read_ahead`
+  int read_ahead_extra;  // bytes of a partial packet following that end
+
+  // If we're allowed to resynchronise when a packet doesn't start with
+  // 0x47, then we keep count of how often we did so, and how many bytes
+  // we had to skip over in total
+  int resync;
+  int resync_count;
+  offset_t resync_skipped;
+
+  // If the input is a regular file, it may instead be memory mapped, in
+  // which case packets are returned as pointers into the mapping, and
+  // `read_ahead` is not used.
+  byte *mapped;        // the start of the mapped file, or nullptr
+  offset_t mapped_len; // the length of the mapping
+  offset_t advised;    // how far into it we've asked the kernel to read
+
+  // Alternatively, the file may be read by a separate thread, so that the
+  // next chunk of it is already arriving while we deal with this one
+  struct _async_reader *async;
 
   // If we are doing PCR read-ahead (so we have exact PCR values for our
   // TS packets), then we also need:
@@ -123,6 +151,37 @@ struct _ts_reader {
 typedef struct _ts_reader *TS_reader_p;
 #define SIZEOF_TS_READER sizeof(struct _ts_reader)
 
+// ------------------------------------------------------------
+// A batch of TS packets, as returned by `read_TS_packet_batch`, with the
+// interesting parts of each header decoded into parallel arrays (so that
+// a caller only wanting, e.g., the PIDs need only look at `pid`).
+#define TS_BATCH_SIZE 256 // the most packets we'll return at once
+
+struct _ts_packet_batch {
+  int count;     // how many packets there are in the batch
+  offset_t posn; // the file position of the first of them
+
+  byte *packet[TS_BATCH_SIZE];    // the packets themselves
+  uint16_t pid[TS_BATCH_SIZE];    // their PIDs
+  byte pusi[TS_BATCH_SIZE];       // their payload_unit_start_indicators
+  byte cc[TS_BATCH_SIZE];         // their continuity counters
+  byte adapt_len[TS_BATCH_SIZE];  // adaptation field length, 0 if none
+  byte payload_off[TS_BATCH_SIZE]; // offset of the payload, 0 if none
+  byte bad_sync[TS_BATCH_SIZE];   // true if it doesn't start with 0x47
+};
+typedef struct _ts_packet_batch *TS_packet_batch_p;
+#define SIZEOF_TS_PACKET_BATCH sizeof(struct _ts_packet_batch)
+
+// The adaptation field and payload of packet `ii` in a batch, in the same
+// form as returned by `split_TS_packet`
+#define TS_BATCH_ADAPT(batch, ii)                                              \
+  ((batch)->adapt_len[ii] ? (batch)->packet[ii] + 5 : nullptr)
+#define TS_BATCH_PAYLOAD(batch, ii)                                            \
+  ((batch)->payload_off[ii] ? (batch)->packet[ii] + (batch)->payload_off[ii]  \
+                            : nullptr)
+#define TS_BATCH_PAYLOAD_LEN(batch, ii)                                        \
+  ((batch)->payload_off[ii] ? TS_PACKET_SIZE - (batch)->payload_off[ii] : 0)
+
 #endif // _ts_defns
 
 // Local Variables:
@@ -36,6 +36,8 @@
 #include "ts_defns.h"
 #include "tswrite_defns.h"
 
+#include <sys/uio.h> // for struct iovec
+
 // ============================================================
 // Writing a Transport Stream
 // ============================================================
@@ -234,6 +236,27 @@ int write_PES_as_TS_PES_packet(TS_writer_p output, byte data[],
                                uint32_t data_len, uint32_t pid, byte stream_id,
                                int got_pcr, uint64_t pcr_base,
                                uint32_t pcr_extn);
+/*
+ * Write out a PES packet that is held as a start and a list of slices
+ * (see `flatten_PES_packet_data`) as Transport Stream PES packets, without
+ * first copying it into a single array.
+ *
+ * The TS packets written are exactly those that `write_PES_as_TS_PES_packet`
+ * would write for the same (H.222.0) PES packet, without a PCR.
+ *
+ * - `output` is the TS output context returned by `tswrite_open`
+ * - `head` is the start of the PES data, including its PES header
+ * - `head_len` is its length
+ * - `slice` is the rest of the PES data, in order
+ * - `num_slices` is how many slices there are
+ * - `pid` is the PID to use for the TS packets
+ *
+ * Returns 0 if it worked, 1 if something went wrong.
+ */
+int write_PES_slices_as_TS_PES_packet(TS_writer_p output, byte head[],
+                                      uint32_t head_len,
+                                      const struct iovec slice[],
+                                      int num_slices, uint32_t pid);
 /*
  * Write out a Transport Stream Null packet.
  *
@@ -276,6 +299,48 @@ int build_TS_reader_with_fns(void *handle,
  * Returns 0 if all goes well, 1 if something goes wrong.
  */
 int open_file_for_TS_read(char *filename, TS_reader_p *tsreader);
+/*
+ * Memory map the file a TS reader is reading from, so that subsequent TS
+ * packets are returned as pointers directly into the mapping, rather than
+ * being copied into the read-ahead buffer first.
+ *
+ * This only makes sense for a regular file that is being read from its
+ * start. If the reader is using standard input (or a pipe, or its own
+ * `read_fn`), or the mapping fails for some other reason, then the reader is
+ * left to carry on using read() as normal.
+ *
+ * The mapping is private and writable, so packets may still be altered in
+ * place by the caller (without changing the file).
+ *
+ * Returns 0 if the file was mapped, 1 if it was not.
+ */
+int map_TS_reader(TS_reader_p tsreader);
+/*
+ * Tell a TS reader whether it should resynchronise on losing sync.
+ *
+ * Normally, it is assumed that the input is a clean sequence of TS packets,
+ * and a packet that doesn't start with 0x47 is returned as-is (so that, for
+ * instance, `split_TS_packet` will complain about it). If `resync` is true,
+ * then instead the reader skips forwards until it finds TS_RESYNC_PACKETS
+ * sync bytes at the right spacing, and carries on from there. This copes
+ * with (for instance) a recording that has gained or lost a byte.
+ *
+ * The number of times this happens, and the number of bytes skipped, are
+ * counted in `resync_count` and `resync_skipped`.
+ */
+void set_TS_reader_resync(TS_reader_p tsreader, int resync);
+/*
+ * Start reading the TS reader's input in a separate thread, so that the
+ * next `num_buffers`-1 chunks of the file are already being read while the
+ * current one is being dealt with (see `build_async_reader`).
+ *
+ * This does not make sense (and is not done) for a reader that has been
+ * memory mapped, or that is using its own `read_fn`.
+ *
+ * Returns 0 if the read-ahead thread was started, 1 if it was not (in
+ * which case the reader will carry on reading the file itself).
+ */
+int start_TS_read_ahead(TS_reader_p tsreader, int num_buffers);
 /*
  * Free a TS packet read-ahead buffer
  *
@@ -506,6 +571,15 @@ void report_payload(int show_data, int stream_type,
  */
 int print_descriptors(int is_msg, char *leader1, char *leader2, byte *desc_data,
                       int desc_data_len);
+/*
+ * Choose whether extract_prog_list_from_pat() and extract_pmt() check the
+ * CRC at the end of each section. This is on by default.
+ */
+void set_PSI_CRC_checking(int check);
+/*
+ * Return how many PSI sections have been found with a bad CRC so far.
+ */
+int get_PSI_CRC_error_count(void);
 /*
  * Extract the program list from a PAT packet (PID 0x0000).
  *
@@ -609,6 +683,33 @@ int extract_pmt(int verbose, byte data[], int data_len, uint32_t pid,
 int split_TS_packet(byte buf[TS_PACKET_SIZE], uint32_t *pid,
                     int *payload_unit_start_indicator, byte *adapt[],
                     int *adapt_len, byte *payload[], int *payload_len);
+/*
+ * Read a batch of TS packets, and decode their headers.
+ *
+ * This returns (up to) the next `max` packets that the reader already has in
+ * hand (reading more data first only if it has none), along with their PIDs,
+ * payload_unit_start_indicators, continuity counters, adaptation field
+ * lengths and payload offsets, in parallel arrays. This is cheaper than
+ * calling `read_next_TS_packet` and `split_TS_packet` for each packet.
+ *
+ * - `tsreader` is the TS packet reading context
+ * - `max` is the most packets wanted, which is limited to TS_BATCH_SIZE.
+ * - `batch` is the batch to fill in.
+ *
+ * As with `read_next_TS_packet`, the packets are in the reader's read-ahead
+ * buffer (or mapping), so will not persist beyond the next read.
+ *
+ * The decoding agrees with `split_TS_packet`, except that no messages are
+ * output: a packet with a bad sync byte is just flagged in `bad_sync`, and
+ * one with a reserved adaptation_field_control, or an adaptation field that
+ * leaves no room for payload, is treated as having no payload.
+ *
+ * Returns 0 if all goes well, EOF if there are no more packets, or 1 if some
+ * other error occurred (in which case it will already have output a message
+ * on stderr about the problem).
+ */
+int read_TS_packet_batch(TS_reader_p tsreader, int max,
+                         TS_packet_batch_p batch);
 /*
  * Return the next TS packet, as payload and adaptation controls.
  *
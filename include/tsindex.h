@@ -0,0 +1,747 @@
+#pragma once
+
+/*
+ * Support for seek indices for Transport Stream files.
+ *
+ * ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is the MPEG TS, PS and ES tools.
+ *
+ * The Initial Developer of the Original Code is Amino Communications Ltd.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *   Amino Communications Ltd, Swavesey, Cambridge UK
+ *
+ * ***** END LICENSE BLOCK *****
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bitdata_fns.h"
+#include "compat.h"
+#include "fmtx.h"
+#include "h222_fns.h"
+#include "misc_fns.h"
+#include "pes_fns.h"
+#include "pidint_fns.h"
+#include "printing_fns.h"
+#include "ts_fns.h"
+#include "tsindex_fns.h"
+
+#define TS_INDEX_PTS_MODULUS ((uint64_t)1 << 33)
+#define TS_INDEX_PCR_MODULUS (TS_INDEX_PTS_MODULUS * 300)
+
+// ============================================================
+// Building an index
+// ============================================================
+/*
+ * Build a new, empty, index.
+ *
+ * Returns 0 if it succeeds, 1 if some error occurs.
+ */
+static int build_empty_TS_index(ts_index_p *index) {
+  ts_index_p new2 = (ts_index_p)calloc(1, SIZEOF_TS_INDEX);
+  if (new2 == nullptr) {
+    print_err("### Unable to allocate TS index datastructure\n");
+    return 1;
+  }
+  memcpy(new2->header.magic, TS_INDEX_MAGIC, sizeof(new2->header.magic));
+  new2->header.version = TS_INDEX_VERSION;
+  new2->header.byte_order = TS_INDEX_BYTE_ORDER;
+
+  new2->pcr = (ts_index_pcr_p)malloc(SIZEOF_TS_INDEX_PCR * TS_INDEX_START_SIZE);
+  new2->pes = (ts_index_pes_p)malloc(SIZEOF_TS_INDEX_PES * TS_INDEX_START_SIZE);
+  new2->rap = (ts_index_rap_p)malloc(SIZEOF_TS_INDEX_RAP * TS_INDEX_START_SIZE);
+  if (new2->pcr == nullptr || new2->pes == nullptr || new2->rap == nullptr) {
+    print_err("### Unable to allocate arrays in TS index datastructure\n");
+    free_TS_index(&new2);
+    return 1;
+  }
+  new2->pcrs_size = new2->pes_size = new2->raps_size = TS_INDEX_START_SIZE;
+  *index = new2;
+  return 0;
+}
+
+/*
+ * Make room for one more entry in an index array.
+ *
+ * Returns 0 if it succeeds, 1 if some error occurs.
+ */
+static int extend_TS_index_array(void **array, int *size, uint32_t length,
+                                 size_t entry_size) {
+  void *newarray;
+  if (length < (uint32_t)*size)
+    return 0;
+  newarray = realloc(*array, (*size + TS_INDEX_INCREMENT) * entry_size);
+  if (newarray == nullptr) {
+    print_err("### Unable to extend TS index array\n");
+    return 1;
+  }
+  *array = newarray;
+  *size += TS_INDEX_INCREMENT;
+  return 0;
+}
+
+// PTS/DTS and PCR values wrap around, which would stop us binary searching
+// them. So we keep track of how many times they have done so.
+struct _ts_index_clock {
+  int seen;        // have we had a value yet?
+  uint64_t last;   // the last (extended) value
+  uint64_t offset; // what we're adding to the values to extend them
+};
+
+/*
+ * Extend a timestamp, allowing for the wraparounds seen so far.
+ *
+ * Since PTS are not in order when there are B pictures, a value that
+ * goes back by less than half the modulus is taken to be just that.
+ */
+static uint64_t extend_TS_index_time(struct _ts_index_clock *clock,
+                                     uint64_t value, uint64_t modulus) {
+  uint64_t extended = value + clock->offset;
+  if (clock->seen) {
+    if (extended + modulus / 2 < clock->last) {
+      clock->offset += modulus;
+      extended += modulus;
+    } else if (extended > clock->last + modulus / 2 &&
+               clock->offset >= modulus) {
+      // A value from just before the last wraparound
+      extended -= modulus;
+    }
+  }
+  clock->seen = true;
+  clock->last = extended;
+  return extended;
+}
+
+/*
+ * Decide if the start of a video PES packet's ES data starts a random
+ * access point.
+ *
+ * Returns TS_INDEX_RAP_IDR or TS_INDEX_RAP_I if it does, 0 if it doesn't,
+ * and -1 if we need to see more data to decide.
+ */
+static int find_TS_index_rap_type(int stream_type, byte data[], int data_len) {
+  int ii;
+  for (ii = 0; ii + 3 < data_len; ii++) {
+    byte code;
+    if (data[ii] != 0 || data[ii + 1] != 0 || data[ii + 2] != 1)
+      continue;
+    code = data[ii + 3];
+
+    if (stream_type == AVC_VIDEO_STREAM_TYPE) {
+      int nal_unit_type = code & 0x1F;
+      if (nal_unit_type == 5)
+        return TS_INDEX_RAP_IDR;
+      else if (nal_unit_type == 1) {
+        // Is it an I slice? We need first_mb_in_slice and slice_type
+        bitdata_p bd;
+        uint32_t first_mb, slice_type;
+        int err;
+        if (ii + 12 > data_len)
+          return -1;
+        if (build_bitdata(&bd, &data[ii + 4], data_len - ii - 4))
+          return 0;
+        err = read_exp_golomb(bd, &first_mb);
+        if (!err)
+          err = read_exp_golomb(bd, &slice_type);
+        free_bitdata(&bd);
+        if (err)
+          return 0;
+        return (slice_type % 5 == 2 || slice_type % 5 == 4) ? TS_INDEX_RAP_I
+                                                            : 0;
+      } else if (nal_unit_type >= 2 && nal_unit_type <= 4)
+        return 0; // slice data partitions
+    } else if (stream_type == H265_VIDEO_STREAM_TYPE) {
+      int nal_unit_type = (code >> 1) & 0x3F;
+      if (nal_unit_type >= 16 && nal_unit_type <= 23)
+        return TS_INDEX_RAP_IDR;
+      else if (nal_unit_type < 16)
+        return 0;
+    } else if (stream_type == MPEG2_VIDEO_STREAM_TYPE ||
+               stream_type == MPEG1_VIDEO_STREAM_TYPE) {
+      if (code == 0x00) {
+        // A picture header - picture_coding_type follows temporal_reference
+        if (ii + 5 >= data_len)
+          return -1;
+        return ((data[ii + 5] >> 3) & 0x07) == 1 ? TS_INDEX_RAP_I : 0;
+      } else if (code >= 0x01 && code <= 0xAF)
+        return 0; // a slice, without a picture header first
+    } else
+      return 0;
+    ii += 3;
+  }
+  return -1;
+}
+
+/*
+ * Build an index by reading a Transport Stream from the current position
+ * to its end.
+ *
+ * The first PMT (for the requested program) says which PIDs to index. The
+ * reader is rewound to where it started after finding it, so the input
+ * must be seekable.
+ *
+ * - `tsreader` is the TS reader context
+ * - `req_prog_no` is which program to index (1 for the first)
+ * - if `max` is greater than zero, stop after that many TS packets
+ * - if `verbose`, report on each RAP as it is found
+ * - if `quiet`, only report errors
+ * - `index` is the new index
+ *
+ * Returns 0 if all went well, 1 if something went wrong.
+ */
+int build_TS_index(TS_reader_p tsreader, int req_prog_no, int max, int verbose,
+                   int quiet, ts_index_p *index) {
+  int err;
+  int ii;
+  int num_read;
+  int count = 0;
+  int done = false;
+  offset_t start_posn = tsreader->posn;
+  offset_t pat_posn = start_posn;
+  pmt_p pmt = nullptr;
+  ts_index_p new2 = nullptr;
+  struct pid_index streams; // PID -> index in the PMT streams
+  struct _ts_index_clock pts_clock = {};
+  struct _ts_index_clock pcr_clock = {};
+  struct _ts_packet_batch batch;
+  uint64_t last_video_pts = 0;
+  int got_first_pts = false;
+
+  // Looking for a RAP at the start of a video PES packet
+  byte scan[TS_INDEX_SCAN_SIZE];
+  int scan_len = 0;
+  int scanning = false;
+  struct _ts_index_rap rap = {};
+  struct stat info;
+
+  err = find_pmt(tsreader, req_prog_no, max, verbose, quiet, &num_read, &pmt);
+  if (err) {
+    print_err("### Unable to find a PMT to index\n");
+    return 1;
+  }
+  err = seek_using_TS_reader(tsreader, start_posn);
+  if (err) {
+    print_err("### Unable to return to start of data to index it\n");
+    free_pmt(&pmt);
+    return 1;
+  }
+
+  err = build_empty_TS_index(&new2);
+  if (err) {
+    free_pmt(&pmt);
+    return 1;
+  }
+
+  new2->header.pcr_pid = pmt->PCR_pid;
+  clear_pid_index(&streams);
+  for (ii = 0; ii < pmt->num_streams; ii++) {
+    uint32_t pid = pmt->streams[ii].elementary_PID;
+    byte stream_type = pmt->streams[ii].stream_type;
+    (void)set_pid_index(&streams, pid, ii, false);
+    if (new2->header.video_pid == 0 && IS_VIDEO_STREAM_TYPE(stream_type)) {
+      new2->header.video_pid = pid;
+      new2->header.video_stream_type = stream_type;
+    }
+  }
+  if (!quiet) {
+    fprint_msg("Indexing PCR PID %04x (%d)", pmt->PCR_pid, pmt->PCR_pid);
+    if (new2->header.video_pid)
+      fprint_msg(", video PID %04x (%d), %s\n", new2->header.video_pid,
+                 new2->header.video_pid,
+                 h222_stream_type_str(new2->header.video_stream_type));
+    else
+      print_msg(", no video stream\n");
+  }
+  free_pmt(&pmt);
+
+  while (!done) {
+    int jj;
+
+    err = read_TS_packet_batch(tsreader, TS_BATCH_SIZE, &batch);
+    if (err == EOF)
+      break;
+    else if (err) {
+      fprint_err("### Error reading TS packets at " OFFSET_T_FORMAT "\n",
+                 tsreader->posn);
+      free_TS_index(&new2);
+      return 1;
+    }
+
+    for (jj = 0; jj < batch.count; jj++) {
+      offset_t posn = batch.posn + jj * TS_PACKET_SIZE;
+      uint32_t pid = batch.pid[jj];
+      byte *payload = TS_BATCH_PAYLOAD(&batch, jj);
+      int payload_len = TS_BATCH_PAYLOAD_LEN(&batch, jj);
+      int es_offset = 0;
+
+      if (max > 0 && count >= max) {
+        done = true;
+        break;
+      }
+      count++;
+
+      if (batch.bad_sync[jj])
+        continue;
+
+      if (pid == 0x0000 && batch.pusi[jj])
+        pat_posn = posn;
+
+      if (pid == new2->header.pcr_pid && batch.adapt_len[jj]) {
+        int got_pcr;
+        uint64_t pcr;
+        get_PCR_from_adaptation_field(TS_BATCH_ADAPT(&batch, jj),
+                                      batch.adapt_len[jj], &got_pcr, &pcr);
+        if (got_pcr) {
+          ts_index_pcr_p entry;
+          err = extend_TS_index_array((void **)&new2->pcr, &new2->pcrs_size,
+                                      new2->header.num_pcrs,
+                                      SIZEOF_TS_INDEX_PCR);
+          if (err) {
+            free_TS_index(&new2);
+            return 1;
+          }
+          entry = &new2->pcr[new2->header.num_pcrs++];
+          entry->posn = posn;
+          entry->pcr =
+              extend_TS_index_time(&pcr_clock, pcr, TS_INDEX_PCR_MODULUS);
+        }
+      }
+
+      if (payload == nullptr || lookup_pid_index(&streams, pid) == -1)
+        continue;
+
+      if (batch.pusi[jj]) {
+        ts_index_pes_p entry;
+        int got_pts, got_dts;
+        uint64_t pts, dts;
+        err = find_PTS_DTS_in_PES(payload, payload_len, &got_pts, &pts,
+                                  &got_dts, &dts);
+        if (err)
+          got_pts = got_dts = false;
+
+        err = extend_TS_index_array((void **)&new2->pes, &new2->pes_size,
+                                    new2->header.num_pes, SIZEOF_TS_INDEX_PES);
+        if (err) {
+          free_TS_index(&new2);
+          return 1;
+        }
+        entry = &new2->pes[new2->header.num_pes++];
+        memset(entry, 0, SIZEOF_TS_INDEX_PES);
+        entry->posn = posn;
+        entry->pid = pid;
+        entry->got_pts = got_pts;
+        entry->got_dts = got_dts;
+        if (got_pts)
+          entry->pts =
+              extend_TS_index_time(&pts_clock, pts, TS_INDEX_PTS_MODULUS);
+        if (got_dts)
+          entry->dts =
+              extend_TS_index_time(&pts_clock, dts, TS_INDEX_PTS_MODULUS);
+
+        if (pid != new2->header.video_pid)
+          continue;
+
+        if (got_pts) {
+          if (!got_first_pts)
+            new2->header.first_pts = entry->pts;
+          got_first_pts = true;
+          last_video_pts = entry->pts;
+        }
+
+        // Start looking for a RAP, after the PES header
+        scanning = false;
+        if (payload_len < 9 || payload[0] != 0 || payload[1] != 0 ||
+            payload[2] != 1 || (payload[6] & 0xC0) != 0x80)
+          continue;
+        es_offset = 9 + payload[8];
+        if (es_offset > payload_len)
+          continue;
+        scanning = true;
+        scan_len = 0;
+        rap.posn = posn;
+        rap.pat_posn = pat_posn;
+        rap.pts = last_video_pts;
+        rap.pid = pid;
+      } else if (pid != new2->header.video_pid || !scanning)
+        continue;
+
+      {
+        int len = payload_len - es_offset;
+        int type;
+        if (len > TS_INDEX_SCAN_SIZE - scan_len)
+          len = TS_INDEX_SCAN_SIZE - scan_len;
+        memcpy(&scan[scan_len], &payload[es_offset], len);
+        scan_len += len;
+
+        type = find_TS_index_rap_type(new2->header.video_stream_type, scan,
+                                      scan_len);
+        if (type == -1 && scan_len < TS_INDEX_SCAN_SIZE)
+          continue;
+        scanning = false;
+        if (type <= 0)
+          continue;
+
+        err = extend_TS_index_array((void **)&new2->rap, &new2->raps_size,
+                                    new2->header.num_raps, SIZEOF_TS_INDEX_RAP);
+        if (err) {
+          free_TS_index(&new2);
+          return 1;
+        }
+        rap.type = type;
+        new2->rap[new2->header.num_raps++] = rap;
+        if (verbose)
+          fprint_msg("RAP (%s) at " OFFSET_T_FORMAT ", PTS " LLU_FORMAT "\n",
+                     (type == TS_INDEX_RAP_IDR ? "IDR" : "I"),
+                     (offset_t)rap.posn, rap.pts);
+      }
+    }
+  }
+
+  // The index is matched to its TS file by the file's size, so record all of
+  // it, even if we didn't read to the end (because of `max`, or because
+  // there was part of a packet left over)
+  if (tsreader->read_fn == nullptr && tsreader->file != -1 &&
+      fstat(tsreader->file, &info) == 0 && S_ISREG(info.st_mode))
+    new2->header.file_size = info.st_size;
+  else
+    new2->header.file_size = tsreader->posn;
+  if (!quiet)
+    fprint_msg("Indexed %d TS packet%s: %u PCR%s, %u PES packet%s,"
+               " %u random access point%s\n",
+               count, (count == 1 ? "" : "s"), new2->header.num_pcrs,
+               (new2->header.num_pcrs == 1 ? "" : "s"), new2->header.num_pes,
+               (new2->header.num_pes == 1 ? "" : "s"), new2->header.num_raps,
+               (new2->header.num_raps == 1 ? "" : "s"));
+  *index = new2;
+  return 0;
+}
+
+// ============================================================
+// Reading and writing index files
+// ============================================================
+/*
+ * Write an index out to a file.
+ *
+ * Returns 0 if all went well, 1 if something went wrong.
+ */
+int write_TS_index(ts_index_p index, const char *filename) {
+  FILE *file = fopen(filename, "wb");
+  size_t written = 0;
+  if (file == nullptr) {
+    fprint_err("### Unable to open index file %s: %s\n", filename,
+               strerror(errno));
+    return 1;
+  }
+  written += fwrite(&index->header, SIZEOF_TS_INDEX_HEADER, 1, file);
+  if (index->header.num_pcrs)
+    written += fwrite(index->pcr, SIZEOF_TS_INDEX_PCR * index->header.num_pcrs,
+                      1, file);
+  else
+    written++;
+  if (index->header.num_pes)
+    written += fwrite(index->pes, SIZEOF_TS_INDEX_PES * index->header.num_pes,
+                      1, file);
+  else
+    written++;
+  if (index->header.num_raps)
+    written += fwrite(index->rap, SIZEOF_TS_INDEX_RAP * index->header.num_raps,
+                      1, file);
+  else
+    written++;
+  if (fclose(file) != 0 || written != 4) {
+    fprint_err("### Error writing index file %s\n", filename);
+    return 1;
+  }
+  return 0;
+}
+
+/*
+ * Open an index file, by mapping it into memory.
+ *
+ * Returns 0 if all went well, 1 if something went wrong.
+ */
+int open_TS_index(const char *filename, ts_index_p *index) {
+  int file;
+  struct stat info;
+  void *addr;
+  ts_index_header_p header;
+  size_t expected;
+  ts_index_p new2;
+
+  file = open(filename, O_RDONLY);
+  if (file == -1) {
+    fprint_err("### Unable to open index file %s: %s\n", filename,
+               strerror(errno));
+    return 1;
+  }
+  if (fstat(file, &info) == -1 ||
+      (size_t)info.st_size < SIZEOF_TS_INDEX_HEADER) {
+    fprint_err("### Index file %s is too short to be an index\n", filename);
+    (void)close(file);
+    return 1;
+  }
+  addr = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, file, 0);
+  (void)close(file);
+  if (addr == MAP_FAILED) {
+    fprint_err("### Unable to map index file %s: %s\n", filename,
+               strerror(errno));
+    return 1;
+  }
+
+  header = (ts_index_header_p)addr;
+  expected = SIZEOF_TS_INDEX_HEADER +
+             SIZEOF_TS_INDEX_PCR * (size_t)header->num_pcrs +
+             SIZEOF_TS_INDEX_PES * (size_t)header->num_pes +
+             SIZEOF_TS_INDEX_RAP * (size_t)header->num_raps;
+  if (memcmp(header->magic, TS_INDEX_MAGIC, sizeof(header->magic)) != 0 ||
+      header->version != TS_INDEX_VERSION ||
+      header->byte_order != TS_INDEX_BYTE_ORDER ||
+      expected != (size_t)info.st_size) {
+    fprint_err("### File %s is not a (usable) TS index\n", filename);
+    (void)munmap(addr, info.st_size);
+    return 1;
+  }
+
+  new2 = (ts_index_p)calloc(1, SIZEOF_TS_INDEX);
+  if (new2 == nullptr) {
+    print_err("### Unable to allocate TS index datastructure\n");
+    (void)munmap(addr, info.st_size);
+    return 1;
+  }
+  new2->header = *header;
+  new2->mapped = (byte *)addr;
+  new2->mapped_len = info.st_size;
+  new2->pcr = (ts_index_pcr_p)(new2->mapped + SIZEOF_TS_INDEX_HEADER);
+  new2->pes = (ts_index_pes_p)(new2->pcr + header->num_pcrs);
+  new2->rap = (ts_index_rap_p)(new2->pes + header->num_pes);
+  (void)madvise(addr, info.st_size, MADV_RANDOM);
+  *index = new2;
+  return 0;
+}
+
+/*
+ * Open the index for a TS file, which is assumed to be named as the
+ * file with TS_INDEX_SUFFIX appended.
+ *
+ * The index is only accepted if it was made from a file of the same size.
+ *
+ * Returns 0 if all went well, 1 if something went wrong.
+ */
+int open_TS_index_for_file(const char *ts_filename, ts_index_p *index) {
+  char *index_name;
+  struct stat info;
+  int err;
+
+  if (stat(ts_filename, &info) == -1) {
+    fprint_err("### Unable to find TS file %s: %s\n", ts_filename,
+               strerror(errno));
+    return 1;
+  }
+
+  index_name =
+      (char *)malloc(strlen(ts_filename) + strlen(TS_INDEX_SUFFIX) + 1);
+  if (index_name == nullptr) {
+    print_err("### Unable to allocate index filename\n");
+    return 1;
+  }
+  strcpy(index_name, ts_filename);
+  strcat(index_name, TS_INDEX_SUFFIX);
+
+  err = open_TS_index(index_name, index);
+  if (!err && (*index)->header.file_size != (uint64_t)info.st_size) {
+    fprint_err("### Index file %s does not match %s (which has changed size)\n",
+               index_name, ts_filename);
+    free_TS_index(index);
+    err = 1;
+  }
+  free(index_name);
+  return err;
+}
+
+/*
+ * Tidy up and free an index, whether built or read from a file.
+ *
+ * Returns `index` as nullptr. Does nothing if it is already nullptr.
+ */
+void free_TS_index(ts_index_p *index) {
+  ts_index_p it = *index;
+  if (it == nullptr)
+    return;
+  if (it->mapped != nullptr)
+    (void)munmap(it->mapped, it->mapped_len);
+  else {
+    free(it->pcr);
+    free(it->pes);
+    free(it->rap);
+  }
+  free(it);
+  *index = nullptr;
+}
+
+// ============================================================
+// Looking things up
+// ============================================================
+/*
+ * Find the last PCR at or before the given file position.
+ *
+ * Returns its index in `index->pcr`, or -1 if there isn't one.
+ */
+int find_TS_index_pcr(ts_index_p index, offset_t posn) {
+  int lo = 0;
+  int hi = (int)index->header.num_pcrs;
+  // Find the first entry after `posn`
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if ((offset_t)index->pcr[mid].posn <= posn)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo - 1;
+}
+
+/*
+ * Find the last PES packet start at or before the given file position.
+ *
+ * If `pid` is non-zero, only PES packets for that PID are considered.
+ *
+ * Returns its index in `index->pes`, or -1 if there isn't one.
+ */
+int find_TS_index_pes(ts_index_p index, offset_t posn, uint32_t pid) {
+  int lo = 0;
+  int hi = (int)index->header.num_pes;
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if ((offset_t)index->pes[mid].posn <= posn)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  for (lo--; lo >= 0 && pid != 0 && index->pes[lo].pid != pid; lo--)
+    ;
+  return lo;
+}
+
+/*
+ * Find the random access point nearest to the given (extended) PTS.
+ *
+ * - if `after` is false, find the last RAP with a PTS at or before `pts`
+ * - if `after` is true, find the first RAP with a PTS at or after `pts`
+ *
+ * Returns its index in `index->rap`, or -1 if there isn't one.
+ */
+int find_TS_index_rap(ts_index_p index, uint64_t pts, int after) {
+  int num = (int)index->header.num_raps;
+  int lo = 0;
+  int hi = num;
+  if (after) {
+    // Find the first entry at or after `pts`
+    while (lo < hi) {
+      int mid = lo + (hi - lo) / 2;
+      if (index->rap[mid].pts < pts)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    return (lo < num ? lo : -1);
+  } else {
+    // Find the first entry after `pts`
+    while (lo < hi) {
+      int mid = lo + (hi - lo) / 2;
+      if (index->rap[mid].pts <= pts)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    return lo - 1;
+  }
+}
+
+/*
+ * Report on an index.
+ *
+ * If `verbose`, list all of its entries, otherwise just summarise it.
+ */
+void report_TS_index(ts_index_p index, int verbose) {
+  uint32_t ii;
+  ts_index_header_p header = &index->header;
+
+  fprint_msg("Index of " LLU_FORMAT " bytes of TS\n", header->file_size);
+  fprint_msg("PCR PID %04x (%d)", header->pcr_pid, header->pcr_pid);
+  if (header->video_pid)
+    fprint_msg(", video PID %04x (%d), %s\n", header->video_pid,
+               header->video_pid,
+               h222_stream_type_str(header->video_stream_type));
+  else
+    print_msg(", no video stream\n");
+  fprint_msg("%u PCR%s, %u PES packet%s, %u random access point%s\n",
+             header->num_pcrs, (header->num_pcrs == 1 ? "" : "s"),
+             header->num_pes, (header->num_pes == 1 ? "" : "s"),
+             header->num_raps, (header->num_raps == 1 ? "" : "s"));
+  if (header->num_raps > 0) {
+    uint64_t first = index->rap[0].pts;
+    uint64_t last = index->rap[header->num_raps - 1].pts;
+    fprint_msg("Random access points from %s",
+               fmtx_timestamp(first - header->first_pts, FMTX_TS_DISPLAY_HMS));
+    fprint_msg(" to %s\n",
+               fmtx_timestamp(last - header->first_pts, FMTX_TS_DISPLAY_HMS));
+  }
+  if (!verbose)
+    return;
+
+  print_msg("\nPCRs:\n");
+  for (ii = 0; ii < header->num_pcrs; ii++)
+    fprint_msg("  " OFFSET_T_FORMAT_08 ": PCR " LLU_FORMAT "\n",
+               (offset_t)index->pcr[ii].posn, index->pcr[ii].pcr);
+  print_msg("\nPES packets:\n");
+  for (ii = 0; ii < header->num_pes; ii++) {
+    ts_index_pes_p pes = &index->pes[ii];
+    fprint_msg("  " OFFSET_T_FORMAT_08 ": PID %04x", (offset_t)pes->posn,
+               pes->pid);
+    if (pes->got_pts)
+      fprint_msg(" PTS " LLU_FORMAT, pes->pts);
+    if (pes->got_dts)
+      fprint_msg(" DTS " LLU_FORMAT, pes->dts);
+    print_msg("\n");
+  }
+  print_msg("\nRandom access points:\n");
+  for (ii = 0; ii < header->num_raps; ii++) {
+    ts_index_rap_p rap = &index->rap[ii];
+    fprint_msg("  " OFFSET_T_FORMAT_08 ": %-3s PTS " LLU_FORMAT
+               " (%s), PAT at " OFFSET_T_FORMAT "\n",
+               (offset_t)rap->posn,
+               (rap->type == TS_INDEX_RAP_IDR ? "IDR" : "I"), rap->pts,
+               fmtx_timestamp(rap->pts - header->first_pts,
+                              FMTX_TS_DISPLAY_HMS),
+               (offset_t)rap->pat_posn);
+  }
+}
+
+// Local Variables:
+// tab-width: 8
+// indent-tabs-mode: nil
+// c-basic-offset: 2
+// End:
+// vim: set tabstop=8 shiftwidth=2 expandtab:
@@ -0,0 +1,142 @@
+/*
+ * Datastructures for seek indices for Transport Stream files.
+ *
+ * ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is the MPEG TS, PS and ES tools.
+ *
+ * The Initial Developer of the Original Code is Amino Communications Ltd.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *   Amino Communications Ltd, Swavesey, Cambridge UK
+ *
+ * ***** END LICENSE BLOCK *****
+ */
+
+#ifndef _tsindex_defns
+#define _tsindex_defns
+
+#include "compat.h"
+
+// ------------------------------------------------------------
+// A seek index is built by reading through a TS file once, and remembers
+// where (by byte offset) to find:
+//
+// * each PCR on the PCR PID
+// * the start of each PES packet on each of the program's streams, with
+//   its PTS and DTS (if any)
+// * each random access point (RAP) in the video stream - i.e., each PES
+//   packet that starts an IDR or I picture
+//
+// Each array is in file order, so can be binary searched by offset. PTS,
+// DTS and PCR values are "extended" past their natural 33 bits, so that
+// they do not wrap around, which means that the RAP array can also be
+// binary searched by PTS.
+//
+// On disk, an index is a header followed by the three arrays, with values
+// in native byte order (the header says which), so that the file can
+// just be memory mapped and used in place.
+
+#define TS_INDEX_MAGIC "TSINDEX"  // plus the terminating 0 makes 8 bytes
+#define TS_INDEX_VERSION 1
+#define TS_INDEX_BYTE_ORDER 0x01020304 // as written by this machine
+#define TS_INDEX_SUFFIX ".tsidx"       // default suffix for index files
+
+// The header at the start of an index file
+struct _ts_index_header {
+  char magic[8];              // TS_INDEX_MAGIC
+  uint32_t version;           // TS_INDEX_VERSION
+  uint32_t byte_order;        // TS_INDEX_BYTE_ORDER
+  uint64_t file_size;         // Size of the TS file that was indexed
+  uint32_t pcr_pid;           // The PCR PID, from the PMT
+  uint32_t video_pid;         // The video PID we found RAPs in, or 0
+  uint32_t video_stream_type; // Its stream type
+  uint32_t num_pcrs;          // The number of entries in each array
+  uint32_t num_pes;
+  uint32_t num_raps;
+  uint64_t first_pts; // The first (extended) PTS on the video PID
+};
+typedef struct _ts_index_header *ts_index_header_p;
+#define SIZEOF_TS_INDEX_HEADER sizeof(struct _ts_index_header)
+
+struct _ts_index_pcr {
+  uint64_t posn; // Offset of the TS packet containing the PCR
+  uint64_t pcr;  // The (extended) PCR, in 27MHz units
+};
+typedef struct _ts_index_pcr *ts_index_pcr_p;
+#define SIZEOF_TS_INDEX_PCR sizeof(struct _ts_index_pcr)
+
+struct _ts_index_pes {
+  uint64_t posn; // Offset of the TS packet starting the PES packet
+  uint64_t pts;  // The (extended) PTS, if `got_pts`
+  uint64_t dts;  // The (extended) DTS, if `got_dts`
+  uint32_t pid;
+  byte got_pts;
+  byte got_dts;
+  byte reserved[2];
+};
+typedef struct _ts_index_pes *ts_index_pes_p;
+#define SIZEOF_TS_INDEX_PES sizeof(struct _ts_index_pes)
+
+// What sort of picture a RAP starts with
+#define TS_INDEX_RAP_IDR 1 // H.264 IDR, or H.265 IRAP
+#define TS_INDEX_RAP_I 2   // H.264 I slice, or H.262 I picture
+
+struct _ts_index_rap {
+  uint64_t posn;     // Offset of the TS packet starting the PES packet
+  uint64_t pat_posn; // Offset of the last PAT before it (or `posn`)
+  uint64_t pts;      // Its (extended) PTS, or the last PTS before it
+  uint32_t pid;
+  uint32_t type; // TS_INDEX_RAP_xxx
+};
+typedef struct _ts_index_rap *ts_index_rap_p;
+#define SIZEOF_TS_INDEX_RAP sizeof(struct _ts_index_rap)
+
+// An index, either being built in memory, or mapped from a file
+struct _ts_index {
+  struct _ts_index_header header;
+
+  ts_index_pcr_p pcr;
+  ts_index_pes_p pes;
+  ts_index_rap_p rap;
+
+  // When building, how big the arrays are
+  int pcrs_size;
+  int pes_size;
+  int raps_size;
+
+  // When read from a file, the mapping of said file
+  byte *mapped;
+  size_t mapped_len;
+};
+typedef struct _ts_index *ts_index_p;
+#define SIZEOF_TS_INDEX sizeof(struct _ts_index)
+
+#define TS_INDEX_START_SIZE 1024
+#define TS_INDEX_INCREMENT 4096
+
+// How much of the start of a video PES packet we look at to decide if it
+// starts with a random access point
+#define TS_INDEX_SCAN_SIZE 1024
+
+#endif // _tsindex_defns
+
+// Local Variables:
+// tab-width: 8
+// indent-tabs-mode: nil
+// c-basic-offset: 2
+// End:
+// vim: set tabstop=8 shiftwidth=2 expandtab:
@@ -0,0 +1,118 @@
+/*
+ * Functions for building and using seek indices for Transport Stream files.
+ *
+ * ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is the MPEG TS, PS and ES tools.
+ *
+ * The Initial Developer of the Original Code is Amino Communications Ltd.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *   Amino Communications Ltd, Swavesey, Cambridge UK
+ *
+ * ***** END LICENSE BLOCK *****
+ */
+
+#ifndef _tsindex_fns
+#define _tsindex_fns
+
+#include "ts_defns.h"
+#include "tsindex_defns.h"
+
+/*
+ * Build an index by reading a Transport Stream from the current position
+ * to its end.
+ *
+ * The first PMT (for the requested program) says which PIDs to index. The
+ * reader is rewound to where it started after finding it, so the input
+ * must be seekable.
+ *
+ * - `tsreader` is the TS reader context
+ * - `req_prog_no` is which program to index (1 for the first)
+ * - if `max` is greater than zero, stop after that many TS packets
+ * - if `verbose`, report on each RAP as it is found
+ * - if `quiet`, only report errors
+ * - `index` is the new index
+ *
+ * Returns 0 if all went well, 1 if something went wrong.
+ */
+int build_TS_index(TS_reader_p tsreader, int req_prog_no, int max, int verbose,
+                   int quiet, ts_index_p *index);
+/*
+ * Write an index out to a file.
+ *
+ * Returns 0 if all went well, 1 if something went wrong.
+ */
+int write_TS_index(ts_index_p index, const char *filename);
+/*
+ * Open an index file, by mapping it into memory.
+ *
+ * Returns 0 if all went well, 1 if something went wrong.
+ */
+int open_TS_index(const char *filename, ts_index_p *index);
+/*
+ * Open the index for a TS file, which is assumed to be named as the
+ * file with TS_INDEX_SUFFIX appended.
+ *
+ * The index is only accepted if it was made from a file of the same size.
+ *
+ * Returns 0 if all went well, 1 if something went wrong.
+ */
+int open_TS_index_for_file(const char *ts_filename, ts_index_p *index);
+/*
+ * Tidy up and free an index, whether built or read from a file.
+ *
+ * Returns `index` as nullptr. Does nothing if it is already nullptr.
+ */
+void free_TS_index(ts_index_p *index);
+/*
+ * Find the last PCR at or before the given file position.
+ *
+ * Returns its index in `index->pcr`, or -1 if there isn't one.
+ */
+int find_TS_index_pcr(ts_index_p index, offset_t posn);
+/*
+ * Find the last PES packet start at or before the given file position.
+ *
+ * If `pid` is non-zero, only PES packets for that PID are considered.
+ *
+ * Returns its index in `index->pes`, or -1 if there isn't one.
+ */
+int find_TS_index_pes(ts_index_p index, offset_t posn, uint32_t pid);
+/*
+ * Find the random access point nearest to the given (extended) PTS.
+ *
+ * - if `after` is false, find the last RAP with a PTS at or before `pts`
+ * - if `after` is true, find the first RAP with a PTS at or after `pts`
+ *
+ * Returns its index in `index->rap`, or -1 if there isn't one.
+ */
+int find_TS_index_rap(ts_index_p index, uint64_t pts, int after);
+/*
+ * Report on an index.
+ *
+ * If `verbose`, list all of its entries, otherwise just summarise it.
+ */
+void report_TS_index(ts_index_p index, int verbose);
+
+#endif // _tsindex_fns
+
+// Local Variables:
+// tab-width: 8
+// indent-tabs-mode: nil
+// c-basic-offset: 2
+// End:
+// vim: set tabstop=8 shiftwidth=2 expandtab:
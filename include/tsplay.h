@@ -347,7 +347,8 @@ static int find_PCR_PID(TS_reader_p tsreader, TS_writer_p tswriter,
  * so that we read-ahead to get the next PCR, and thus have reliable
  * timing information.
  *
- * Assumes (strongly) that it is starting from the start of the file.
+ * Assumes (strongly) that it is starting from `seek_posn`, which is either
+ * the start of the file or the start of a PAT.
  *
  * - `tsreader` is the TS reader context
  * - `tswriter` is our (maybe buffered) writer
@@ -359,7 +360,7 @@ static int find_PCR_PID(TS_reader_p tsreader, TS_writer_p tswriter,
  * - if `max` is greater than zero, then at most `max` TS packets should
  *   be read from the input
  * - if `loop`, play the input file repeatedly (up to `max` TS packets
- *   if applicable)
+ *   if applicable), from `seek_posn` onwards
  * - if `quiet` is true, then only error messages should be written out
  * - if `verbose` is true, then give extra progress messages
  *
@@ -367,14 +368,15 @@ static int find_PCR_PID(TS_reader_p tsreader, TS_writer_p tswriter,
  */
 static int play_buffered_TS_packets(TS_reader_p tsreader, TS_writer_p tswriter,
                                     uint32_t pid_to_ignore,
-                                    uint32_t override_pcr_pid, int max,
-                                    int loop, int quiet, int verbose) {
+                                    uint32_t override_pcr_pid,
+                                    offset_t seek_posn, int max, int loop,
+                                    int quiet, int verbose) {
   int err;
   int total = 0;
   uint32_t count = 0;
   uint32_t pcr_pid;
   uint32_t start_count = 0; // which TS packet to loop from
-  offset_t start_posn = 0;
+  offset_t start_posn = seek_posn;
 
   // These are only used in the loop below, but the compiler grumbles if
   // they're uninitialised (it isn't sure if they're being set by the call
@@ -410,7 +412,7 @@ static int play_buffered_TS_packets(TS_reader_p tsreader, TS_writer_p tswriter,
   // If we're looping, remember the location of the first packet of (probable)
   // data - there's not much point rewinding before that point
   if (loop)
-    start_posn = start_count * TS_PACKET_SIZE;
+    start_posn = seek_posn + start_count * TS_PACKET_SIZE;
 
   count = start_count;
   for (;;) {
@@ -421,7 +423,7 @@ static int play_buffered_TS_packets(TS_reader_p tsreader, TS_writer_p tswriter,
     else if (err) {
       if (tsreader->file != STDIN_FILENO) {
         fprint_err("### Last TS packet read was at " LLU_FORMAT "\n",
-                   (uint64_t)count * TS_PACKET_SIZE);
+                   (uint64_t)(seek_posn + (offset_t)count * TS_PACKET_SIZE));
       }
       return 1;
     }
@@ -454,7 +456,8 @@ static int play_buffered_TS_packets(TS_reader_p tsreader, TS_writer_p tswriter,
 /*
  * Read TS packets and then output them.
  *
- * Assumes (strongly) that it is starting from the start of the file.
+ * Assumes (strongly) that it is starting from `seek_posn`, which is either
+ * the start of the file or the start of a PAT.
  *
  * - `tsreader` is the TS reader context
  * - `tswriter` is our (maybe buffered) writer
@@ -464,7 +467,7 @@ static int play_buffered_TS_packets(TS_reader_p tsreader, TS_writer_p tswriter,
  * - if `max` is greater than zero, then at most `max` TS packets should
  *   be read from the input
  * - if `loop`, play the input file repeatedly (up to `max` TS packets
- *   if applicable)
+ *   if applicable), from `seek_posn` onwards
  * - if `quiet` is true, then only error messages should be written out
  * - if `verbose` is true, then give extra progress messages
  *
@@ -472,8 +475,8 @@ static int play_buffered_TS_packets(TS_reader_p tsreader, TS_writer_p tswriter,
  */
 static int play_TS_packets(TS_reader_p tsreader, TS_writer_p tswriter,
                            const tsplay_output_pace_mode pace_mode,
-                           uint32_t pid_to_ignore, int max, int loop, int quiet,
-                           int verbose) {
+                           uint32_t pid_to_ignore, offset_t seek_posn, int max,
+                           int loop, int quiet, int verbose) {
   int err;
   int total = 0;
   uint32_t count = 0;
@@ -481,7 +484,7 @@ static int play_TS_packets(TS_reader_p tsreader, TS_writer_p tswriter,
   int pcrs_ignored = 0;
   uint32_t pcr_pid = ~0U;
   uint32_t start_count = 0; // which TS packet to loop from
-  offset_t start_posn = 0;
+  offset_t start_posn = seek_posn;
 
   if (pace_mode == TSPLAY_OUTPUT_PACE_PCR2_PMT) {
     // Before we can use PCRs for timing, we need to read a PMT which tells us
@@ -499,7 +502,7 @@ static int play_TS_packets(TS_reader_p tsreader, TS_writer_p tswriter,
     // If we're looping, remember the location of the first packet of (probable)
     // data - there's not much point rewinding before that point
     if (loop)
-      start_posn = start_count * TS_PACKET_SIZE;
+      start_posn = seek_posn + start_count * TS_PACKET_SIZE;
   }
 
   count = start_count;
@@ -517,7 +520,7 @@ static int play_TS_packets(TS_reader_p tsreader, TS_writer_p tswriter,
     else if (err) {
       if (tsreader->file != STDIN_FILENO) {
         fprint_err("### Last TS packet read was at " LLU_FORMAT "\n",
-                   (uint64_t)count * TS_PACKET_SIZE);
+                   (uint64_t)(seek_posn + (offset_t)count * TS_PACKET_SIZE));
       }
       return 1;
     }
@@ -583,7 +586,8 @@ static int play_TS_packets(TS_reader_p tsreader, TS_writer_p tswriter,
 /*
  * Read TS packets and then output them.
  *
- * Assumes (strongly) that it is starting from the start of the file.
+ * Assumes (strongly) that it is starting from the start of the file (or
+ * from `seek_posn`).
  *
  * - `input` is the input stream (descriptor) to read
  * - `tswriter` is our (maybe buffered) writer
@@ -595,6 +599,9 @@ static int play_TS_packets(TS_reader_p tsreader, TS_writer_p tswriter,
  * - if we are using the PCR read-ahead buffer, and `override_pcr_pid` is
  *   non-zero, then it is the PID to use for PCRs, ignoring any value found in
  *   a PMT
+ * - if `seek_posn` is non-zero, start reading from that offset in the
+ *   input (which must be seekable, and should be the start of a PAT,
+ *   as given by a seek index), rather than its start
  * - if `max` is greater than zero, then at most `max` TS packets should
  *   be read from the input
  * - if `loop`, play the input file repeatedly (up to `max` TS packets
@@ -606,8 +613,9 @@ static int play_TS_packets(TS_reader_p tsreader, TS_writer_p tswriter,
  */
 int play_TS_stream(int input, TS_writer_p tswriter,
                    const tsplay_output_pace_mode pace_mode,
-                   uint32_t pid_to_ignore, uint32_t override_pcr_pid, int max,
-                   int loop, int quiet, int verbose) {
+                   uint32_t pid_to_ignore, uint32_t override_pcr_pid,
+                   offset_t seek_posn, int max, int loop, int quiet,
+                   int verbose) {
   int err;
   TS_reader_p tsreader;
 
@@ -615,14 +623,25 @@ int play_TS_stream(int input, TS_writer_p tswriter,
   if (err)
     return 1;
 
+  if (seek_posn > 0) {
+    err = seek_using_TS_reader(tsreader, seek_posn);
+    if (err) {
+      fprint_err("### Unable to seek to " OFFSET_T_FORMAT " in input\n",
+                 seek_posn);
+      free_TS_reader(&tsreader);
+      return 1;
+    }
+  }
+
   fprint_msg("pace_mode=%d\n", pace_mode);
 
   if (pace_mode == TSPLAY_OUTPUT_PACE_PCR1)
     err = play_buffered_TS_packets(tsreader, tswriter, pid_to_ignore,
-                                   override_pcr_pid, max, loop, quiet, verbose);
+                                   override_pcr_pid, seek_posn, max, loop,
+                                   quiet, verbose);
   else
-    err = play_TS_packets(tsreader, tswriter, pace_mode, pid_to_ignore, max,
-                          loop, quiet, verbose);
+    err = play_TS_packets(tsreader, tswriter, pace_mode, pid_to_ignore,
+                          seek_posn, max, loop, quiet, verbose);
   if (err) {
     free_TS_reader(&tsreader);
     return 1;
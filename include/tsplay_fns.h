@@ -37,7 +37,8 @@
 /*
  * Read TS packets and then output them.
  *
- * Assumes (strongly) that it is starting from the start of the file.
+ * Assumes (strongly) that it is starting from the start of the file (or
+ * from `seek_posn`).
  *
  * - `input` is the input stream (descriptor) to read
  * - `tswriter` is our (maybe buffered) writer
@@ -49,6 +50,9 @@
  * - if we are using the PCR read-ahead buffer, and `override_pcr_pid` is
  *   non-zero, then it is the PID to use for PCRs, ignoring any value found in
  *   a PMT
+ * - if `seek_posn` is non-zero, start reading from that offset in the
+ *   input (which must be seekable, and should be the start of a PAT,
+ *   as given by a seek index), rather than its start
  * - if `max` is greater than zero, then at most `max` TS packets should
  *   be read from the input
  * - if `loop`, play the input file repeatedly (up to `max` TS packets
@@ -60,8 +64,9 @@
  */
 int play_TS_stream(int input, TS_writer_p tswriter,
                    const tsplay_output_pace_mode pace_mode,
-                   uint32_t pid_to_ignore, uint32_t override_pcr_pid, int max,
-                   int loop, int quiet, int verbose);
+                   uint32_t pid_to_ignore, uint32_t override_pcr_pid,
+                   offset_t seek_posn, int max, int loop, int quiet,
+                   int verbose);
 
 /*
  * Read PS packets and then output them as TS.
@@ -42,6 +42,13 @@
 #include <ctime> // Sleeping and timing
 #include <sys/types.h>
 
+#include <pthread.h> // for the "thread" alternative to forking
+#if defined(__linux__)
+#include <linux/futex.h>      // waking the other side of the circular buffer
+#include <linux/net_tstamp.h> // struct sock_txtime
+#include <sys/syscall.h>
+#endif
+
 #include <sys/mman.h>   // memory mapping
 #include <sys/socket.h> // send
 #include <sys/time.h>   // gettimeofday
@@ -54,6 +61,10 @@
 #include "ts_fns.h"
 #include "tswrite_fns.h"
 
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // not all systems can turn off SIGPIPE per send
+#endif
+
 // ------------------------------------------------------------
 // Global flags affecting debugging
 
@@ -126,6 +137,12 @@ static int global_child_wait = DEFAULT_CHILD_WAIT;
 // If not being quiet, report progress every REPORT_EVERY packets read
 #define REPORT_EVERY 10000
 
+// When writing to a file, how many TS packets we gather before writing them
+// out. 1024 packets is 192512 bytes, which is also a whole number of 4096
+// byte blocks, as is needed for O_DIRECT.
+#define TS_PACKETS_IN_FILE_BUFFER 1024
+#define FILE_BUFFER_ALIGNMENT 4096
+
 // ============================================================
 // CIRCULAR BUFFER
 // ============================================================
@@ -140,6 +157,49 @@ static int global_child_wait = DEFAULT_CHILD_WAIT;
 // fill a jumbo packet on a gigabit network.
 #define MAX_TS_PACKETS_IN_ITEM 100
 
+// And the maximum number of circular buffer items that the child may send
+// with a single system call (see `-batch`)
+#define MAX_ITEMS_IN_BATCH 64
+
+// By default, how close (in microseconds) to being due an item must be
+// to be sent in the same batch as the item before it
+#define DEFAULT_BATCH_SLOT 500
+
+// By default, how long (in microseconds) before its launch time we hand each
+// item to the kernel, when using SO_TXTIME
+#define DEFAULT_TXTIME_AHEAD 2000
+
+// When using precise pacing (see `-precise`), we sleep until this long (in
+// nanoseconds) before each deadline, and then spin. Unless the user says
+// otherwise, this "spin tail" is calibrated by seeing how late a few short
+// sleeps wake up, and then adjusted as we go, between these limits.
+#define MIN_SPIN_TAIL 10000
+#define MAX_SPIN_TAIL 1000000
+#define SPIN_CALIBRATION_SLEEPS 20
+
+// An item more than this late (or early), in nanoseconds, makes us start
+// a new timeline, as with the original (relative) pacing
+#define MAX_PACING_ERROR 200000000LL
+
+// The send time jitter histogram (see `-jitter`) counts how late each item
+// was sent, in buckets whose upper limits (in nanoseconds) are given here.
+// Items sent on time, or early, go in the first bucket, and items later than
+// the last limit in an extra, last, bucket.
+#define JITTER_BUCKETS 16
+static const int64_t jitter_limit[JITTER_BUCKETS - 1] = {
+    0,      1000,    2000,    5000,    10000,   20000,    50000,    100000,
+    200000, 500000,  1000000, 2000000, 5000000, 10000000, 100000000};
+
+// An item sent more than this long (in microseconds) after it was due
+// counts as "late" in the buffered writer's statistics (see `-stats`)
+#define LATE_ITEM_THRESHOLD 1000
+
+// The statistics for the buffered writer, as kept in shared memory. These
+// start with this "magic number" (the characters "TSWSTATS") and version,
+// so that another program (with `-statsfile`) can tell what it is reading.
+#define CIRCULAR_STATS_MAGIC 0x5354415453575354ULL
+#define CIRCULAR_STATS_VERSION 1
+
 // ------------------------------------------------------------
 // A circular buffer, usable as a queue
 //
@@ -174,11 +234,52 @@ typedef struct rtp_hdr_info_s {
   uint32_t ssrc;
 } rtp_hdr_info_t;
 
+// ------------------------------------------------------------
+// Statistics for the circular buffer
+//
+// Each counter is only ever changed by one side (as noted), using relaxed
+// atomic operations, so either side (or, with `-statsfile`, any other
+// program that maps the same file) may read them at any time, without
+// locking. The number of items waiting in the buffer is `items_queued -
+// items_sent`.
+struct circular_stats {
+  uint64_t magic;   // CIRCULAR_STATS_MAGIC
+  uint32_t version; // CIRCULAR_STATS_VERSION
+  uint32_t size;    // how many items the buffer can hold
+
+  uint64_t items_queued;        // parent: items put into the buffer
+  uint64_t high_water;          // parent: most items ever waiting
+  uint64_t parent_stalls;       // parent: times it waited for room
+  uint64_t pcr_discontinuities; // parent: times PCR timing restarted
+
+  uint64_t items_sent;   // child: items taken out of the buffer
+  uint64_t packets_sent; // child: TS packets therein
+  uint64_t bytes_sent;   // child: and bytes
+  uint64_t underruns;    // child: times it found the buffer empty
+  uint64_t late_items;   // child: items sent late (see LATE_ITEM_THRESHOLD)
+  uint64_t resets;       // child: times it restarted its timeline
+};
+typedef struct circular_stats *circular_stats_p;
+
 // ------------------------------------------------------------
 // The header for the circular buffer
 //
 // Note that `start` is only ever written to by the child process, and this is
-// the only thing that the child process ever changes in the circular buffer.
+// (apart from `room_seq`, `data_waiting` and the EOF handshake described
+// below) the only thing that the child process ever changes in the circular
+// buffer. There is only ever one writer (the parent) and one reader (the
+// child), so no locking is needed: the parent publishes a new `end` after it
+// has finished filling in the items before it, and the child publishes a new
+// `start` after it has finished with the item it has just written out.
+//
+// When one side has to wait for the other (the child because the buffer is
+// empty, the parent because it is full), it sets its `*_waiting` flag and
+// sleeps on the corresponding sequence number (using a futex on Linux, so
+// this works the same whether the child is a forked process or a thread).
+// The other side bumps that sequence number whenever it moves `end` or
+// `start`, and only makes the (relatively expensive) system call to wake the
+// sleeper if the flag is set. If nothing happens, the sleeper wakes up
+// after its normal wait time anyway, so it can still decide to give up.
 //
 // `maxnowait` is the maximum number of packets to send to the target host
 // without forcing an intermediate wait - required to stop us "swamping" the
@@ -191,6 +292,12 @@ struct circular_buffer {
 
   volatile int eos; // end of stream
 
+  // Wakeup support (see above)
+  uint32_t data_seq;     // bumped by the parent when it moves `end`
+  uint32_t room_seq;     // bumped by the child when it moves `start`
+  uint32_t data_waiting; // true if the child is waiting on `data_seq`
+  uint32_t room_waiting; // true if the parent is waiting on `room_seq`
+
   int TS_in_item; // max number of TS packets in a circular buffer item
   int item_size;  // and thus the size of said item's data array
   int hdr_size;
@@ -202,6 +309,34 @@ struct circular_buffer {
   int maxnowait; // max number consecutive packets to send with no wait
   int waitfor;   // the number of microseconds to wait thereafter
 
+  // If `batch_size` is more than 1, then the child may send up to that
+  // many items with a single system call, as long as they are all due
+  // (according to their `time`) within `batch_slot` microseconds of now.
+  int batch_size;
+  int batch_slot;
+
+  // If `txtime_clock` is not -1, then each item is sent with a launch time
+  // (SCM_TXTIME) on that clock, `txtime_ahead` microseconds after the time
+  // it is due, so that the kernel (the fq or etf qdisc) can do the final,
+  // precise, timing for us.
+  int txtime_clock;
+  int txtime_ahead;
+
+  // If `precise` is true, the child works out an absolute deadline for each
+  // item, sleeping until `spin_tail` nanoseconds (or, if that is -1, a
+  // calibrated time) before it, and then spinning. If `show_jitter` is
+  // true, the child reports on how close to their deadlines it sent items.
+  int precise;
+  int spin_tail;
+  int show_jitter;
+
+  // Our statistics, which are normally `own_stats`, but may instead be in
+  // a file mapped with `-statsfile`. If `stats_interval` is more than 0,
+  // the child prints a line of statistics every that many seconds.
+  circular_stats_p stats;
+  int stats_interval;
+  struct circular_stats own_stats;
+
   // The location of the packet data for the circular buffer items
   byte *item_data;
 
@@ -258,6 +393,56 @@ typedef struct pcr_pace_env_s {
   uint64_t next_pcr_base;
 } pcr_pace_env;
 
+// How close to their due times the child managed to send items
+struct jitter_histogram {
+  uint64_t count[JITTER_BUCKETS];
+  uint64_t total;
+  int64_t min; // in nanoseconds, negative for early
+  int64_t max;
+  double sum; // for the mean
+};
+
+// The child's idea of time, as it writes out the circular buffer. This is
+// only ever used by the child, but it is kept with the buffered output
+// context (rather than in static variables) so that more than one buffered
+// writer can be run (as threads) within the same process.
+struct circular_reader {
+  // Are we starting up for the first time?
+  int starting;
+
+  // Do we need to (re)set our relative timeline? At the start we do.
+  int reset;
+
+  // The time stamp (in microseconds) the parent gave the last item we wrote
+  uint32_t last_packet_time;
+
+  // Our arbitrary start time, and the difference between our time and the
+  // parent's
+  struct timeval start;
+  int32_t delta_start;
+
+  // If we're using SO_TXTIME, `start` on the chosen clock, in nanoseconds
+  uint64_t txtime_start;
+
+  // How many items have we sent without *any* delay?
+  // (not used if maxnowait is off)
+  int sent_without_delay;
+
+  // How many items we have written, for use in grumbling
+  unsigned int count;
+
+  // For precise pacing: the time stamp of the last item, extended to 64
+  // bits (so that it does not wrap around), and where our current timeline
+  // started, in those terms and as CLOCK_MONOTONIC nanoseconds
+  uint64_t item_time;
+  uint64_t origin_time;
+  uint64_t origin_ns;
+  int64_t spin_tail; // or -1 if it is still to be calibrated
+
+  // How late (in nanoseconds) we were in sending each item
+  struct jitter_histogram jitter;
+};
+
 // If we're going to support output via our circular buffer in a manner
 // similar to that for output to a file or socket, then we need a structure
 // to maintain the relevant information. It seems a bit wasteful to burden
@@ -298,6 +483,9 @@ struct buffered_TS_output {
   int prime_speedup;
 
   pcr_pace_env pcr_pace;
+
+  // And the child's state, as it writes the circular buffer out
+  struct circular_reader reader;
 };
 
 // ============================================================
@@ -375,6 +563,19 @@ int map_circular_buffer(circular_buffer_p *circular, int circ_buf_size,
   }
   cb->maxnowait = maxnowait;
   cb->waitfor = waitfor;
+  cb->batch_size = 1;
+  cb->batch_slot = 0;
+  cb->txtime_clock = -1;
+  cb->txtime_ahead = 0;
+  cb->precise = false;
+  cb->spin_tail = -1;
+  cb->show_jitter = false;
+  memset(&cb->own_stats, 0, sizeof(cb->own_stats));
+  cb->own_stats.magic = CIRCULAR_STATS_MAGIC;
+  cb->own_stats.version = CIRCULAR_STATS_VERSION;
+  cb->own_stats.size = circ_buf_size - 1;
+  cb->stats = &cb->own_stats;
+  cb->stats_interval = -1;
   cb->item_data = (byte *)cb + base_size + hdr_size;
   *circular = cb;
   return 0;
@@ -392,7 +593,16 @@ int unmap_circular_buffer(circular_buffer_p circular) {
       SIZEOF_CIRCULAR_BUFFER + (circular->size * SIZEOF_CIRCULAR_BUFFER_ITEM);
   int data_size = circular->size * circular->item_size;
   int total_size = base_size + data_size;
-  int err = munmap(circular, total_size);
+  int err;
+  if (circular->stats != &circular->own_stats) {
+    err = munmap(circular->stats, sizeof(struct circular_stats));
+    if (err) {
+      fprint_err("### Error unmapping circular buffer statistics: %s\n",
+                 strerror(errno));
+      return 1;
+    }
+  }
+  err = munmap(circular, total_size);
   if (err) {
     fprint_err("### Error unmapping circular buffer from shared memory: %s\n",
                strerror(errno));
@@ -401,18 +611,118 @@ int unmap_circular_buffer(circular_buffer_p circular) {
   return 0;
 }
 
+/*
+ * Keep the statistics for our circular buffer in the named file (which is
+ * created if necessary), rather than in the buffer itself, so that other
+ * programs can map it and watch them as we go.
+ *
+ * Returns 0 if all goes well, 1 if something goes wrong.
+ */
+int map_circular_stats(circular_buffer_p circular, const char *filename) {
+  circular_stats_p stats;
+  int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) {
+    fprint_err("### Error opening statistics file %s: %s\n", filename,
+               strerror(errno));
+    return 1;
+  }
+  if (ftruncate(fd, sizeof(struct circular_stats))) {
+    fprint_err("### Error sizing statistics file %s: %s\n", filename,
+               strerror(errno));
+    close(fd);
+    return 1;
+  }
+  stats = (circular_stats_p)mmap(nullptr, sizeof(struct circular_stats),
+                                 PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd); // the mapping keeps the file open for us
+  if (stats == MAP_FAILED) {
+    fprint_err("### Error mapping statistics file %s: %s\n", filename,
+               strerror(errno));
+    return 1;
+  }
+  *stats = *circular->stats;
+  circular->stats = stats;
+  return 0;
+}
+
+/*
+ * Add `num` to one of the circular buffer statistics. Since each counter
+ * only has one writer, this need not be an atomic read-modify-write, just
+ * an atomic store.
+ */
+static inline void add_circular_stat(uint64_t *counter, uint64_t num) {
+  __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + num,
+                   __ATOMIC_RELAXED);
+}
+
+/*
+ * Read one of the circular buffer statistics
+ */
+static inline uint64_t get_circular_stat(uint64_t *counter) {
+  return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+/*
+ * Print the circular buffer statistics, either on one line (for periodic
+ * reports) or as a summary
+ */
+void print_circular_stats(circular_buffer_p circular, int summary) {
+  circular_stats_p stats = circular->stats;
+  uint64_t queued = get_circular_stat(&stats->items_queued);
+  uint64_t sent = get_circular_stat(&stats->items_sent);
+  uint64_t waiting = (queued > sent ? queued - sent : 0);
+  if (summary) {
+    fprint_msg("Buffered output statistics:\n"
+               "  Items queued %" PRIu64 ", sent %" PRIu64
+               " (%" PRIu64 " TS packets, %" PRIu64 " bytes)\n"
+               "  Buffer fill %" PRIu64 "/%u, high water mark %" PRIu64 "\n"
+               "  Parent stalled %" PRIu64 " time%s (buffer full)\n"
+               "  Child underran %" PRIu64 " time%s (buffer empty)\n"
+               "  Items more than %dus late %" PRIu64
+               ", timeline restarted %" PRIu64 " time%s\n"
+               "  PCR discontinuities %" PRIu64 "\n",
+               queued, sent, get_circular_stat(&stats->packets_sent),
+               get_circular_stat(&stats->bytes_sent), waiting, stats->size,
+               get_circular_stat(&stats->high_water),
+               get_circular_stat(&stats->parent_stalls),
+               get_circular_stat(&stats->parent_stalls) == 1 ? "" : "s",
+               get_circular_stat(&stats->underruns),
+               get_circular_stat(&stats->underruns) == 1 ? "" : "s",
+               LATE_ITEM_THRESHOLD, get_circular_stat(&stats->late_items),
+               get_circular_stat(&stats->resets),
+               get_circular_stat(&stats->resets) == 1 ? "" : "s",
+               get_circular_stat(&stats->pcr_discontinuities));
+  } else {
+    fprint_msg("Stats: fill %" PRIu64 "/%u (max %" PRIu64 "), sent %" PRIu64
+               " items %" PRIu64 " bytes, stalls %" PRIu64
+               ", underruns %" PRIu64 ", late %" PRIu64 ", resets %" PRIu64
+               ", PCR discontinuities %" PRIu64 "\n",
+               waiting, stats->size, get_circular_stat(&stats->high_water),
+               sent, get_circular_stat(&stats->bytes_sent),
+               get_circular_stat(&stats->parent_stalls),
+               get_circular_stat(&stats->underruns),
+               get_circular_stat(&stats->late_items),
+               get_circular_stat(&stats->resets),
+               get_circular_stat(&stats->pcr_discontinuities));
+  }
+  flush_msg();
+}
+
 /*
  * Is the buffer empty?
  */
 inline int circular_buffer_empty(circular_buffer_p circular) {
-  return (circular->start == (circular->end + 1) % circular->size);
+  return (__atomic_load_n(&circular->start, __ATOMIC_ACQUIRE) ==
+          (__atomic_load_n(&circular->end, __ATOMIC_ACQUIRE) + 1) %
+              circular->size);
 }
 
 /*
  * Is the buffer full?
  */
 inline int circular_buffer_full(circular_buffer_p circular) {
-  return ((circular->pending + 2) % circular->size == circular->start);
+  return ((circular->pending + 2) % circular->size ==
+          __atomic_load_n(&circular->start, __ATOMIC_ACQUIRE));
 }
 
 // Is the buffer full and never going to empty?
@@ -420,30 +730,146 @@ inline int circular_buffer_jammed(circular_buffer_p circular) {
   return ((circular->pending + 1) % circular->size == circular->end);
 }
 
+/*
+ * Wait (for at most `ms` milliseconds) for the sequence number `seq` to
+ * change from `seen`, flagging that we are doing so in `waiting`.
+ *
+ * Returns 0 if we were woken (or the value had already changed), 1 if we
+ * timed out, and -1 if something went wrong.
+ */
+static int wait_on_circular_seq(uint32_t *seq, uint32_t *waiting,
+                                uint32_t seen, int ms) {
+  struct timespec time = {0, ms * ONE_MS_AS_NANOSECONDS};
+  int err;
+#if defined(__linux__)
+  // Note that we don't use FUTEX_PRIVATE_FLAG, because the circular
+  // buffer may be shared with a forked child process
+  err = syscall(SYS_futex, seq, FUTEX_WAIT, seen, &time, nullptr, 0);
+  __atomic_store_n(waiting, 0, __ATOMIC_SEQ_CST);
+  if (err == -1) {
+    if (errno == ETIMEDOUT)
+      return 1;
+    else if (errno == EAGAIN || errno == EINTR)
+      return 0;
+    fprint_err("### Error waiting on circular buffer: %s\n", strerror(errno));
+    return -1;
+  }
+  return 0;
+#else
+  (void)seq;
+  (void)seen;
+  err = nanosleep(&time, nullptr);
+  __atomic_store_n(waiting, 0, __ATOMIC_SEQ_CST);
+  if (err == -1 && errno == EINVAL) {
+    fprint_err("### Bad value (%ld) for wait time\n", time.tv_nsec);
+    return -1;
+  }
+  return 1;
+#endif
+}
+
+/*
+ * Bump the sequence number `seq`, and wake whoever is waiting on it (if
+ * `waiting` says anyone is)
+ */
+static void wake_circular_seq(uint32_t *seq, uint32_t *waiting) {
+  __atomic_add_fetch(seq, 1, __ATOMIC_SEQ_CST);
+#if defined(__linux__)
+  if (__atomic_load_n(waiting, __ATOMIC_SEQ_CST))
+    (void)syscall(SYS_futex, seq, FUTEX_WAKE, 1, nullptr, nullptr, 0);
+#else
+  (void)waiting;
+#endif
+}
+
+/*
+ * Make the items up to and including `end` available to the child
+ */
+inline void publish_circular_end(circular_buffer_p circular, int end) {
+  __atomic_store_n(&circular->end, end, __ATOMIC_RELEASE);
+  wake_circular_seq(&circular->data_seq, &circular->data_waiting);
+}
+
+/*
+ * Indicate end of stream to the child (waking it if it is waiting)
+ */
+inline void publish_circular_eos(circular_buffer_p circular) {
+  __atomic_store_n(&circular->eos, true, __ATOMIC_RELEASE);
+  wake_circular_seq(&circular->data_seq, &circular->data_waiting);
+}
+
+/*
+ * Give the `num` items from `start` onwards back to the parent, now that the
+ * child has finished with them
+ */
+inline void release_circular_start(circular_buffer_p circular, int num) {
+  __atomic_store_n(&circular->start, (circular->start + num) % circular->size,
+                   __ATOMIC_RELEASE);
+  wake_circular_seq(&circular->room_seq, &circular->room_waiting);
+}
+
+/*
+ * Wait until the parent has done something to the circular buffer, or
+ * until our normal wait time has passed.
+ *
+ * - `condition` says what we're waiting for - it is checked again after
+ *   we've announced we're waiting, so that we can't miss a wakeup.
+ * - `count` is incremented if we waited the full time.
+ *
+ * Returns 0 if all goes well, 1 if something goes wrong.
+ */
+static int child_wait_for_data(circular_buffer_p circular,
+                               int (*condition)(circular_buffer_p),
+                               int *count) {
+  uint32_t seen;
+  int err;
+  __atomic_store_n(&circular->data_waiting, 1, __ATOMIC_SEQ_CST);
+  seen = __atomic_load_n(&circular->data_seq, __ATOMIC_SEQ_CST);
+  if (!condition(circular)) {
+    __atomic_store_n(&circular->data_waiting, 0, __ATOMIC_SEQ_CST);
+    return 0;
+  }
+  err = wait_on_circular_seq(&circular->data_seq, &circular->data_waiting, seen,
+                             global_child_wait);
+  if (err == -1) {
+    print_err("### Child: error waiting for parent\n");
+    return 1;
+  }
+  *count += err;
+  return 0;
+}
+
+static int circular_buffer_starved(circular_buffer_p circular) {
+  return circular_buffer_empty(circular) &&
+         !__atomic_load_n(&circular->eos, __ATOMIC_ACQUIRE);
+}
+
+static int circular_buffer_filling(circular_buffer_p circular) {
+  return !circular_buffer_full(circular) &&
+         !__atomic_load_n(&circular->eos, __ATOMIC_ACQUIRE);
+}
+
 /*
  * If the circular buffer is empty, wait until it gains some data.
  *
  * Returns 0 if all goes well, 1 if something goes wrong.
  */
 inline int wait_if_buffer_empty(circular_buffer_p circular) {
-  static int count = 0;
-  struct timespec time = {0, global_child_wait * ONE_MS_AS_NANOSECONDS};
-  int err;
+  int count = 0;
+
+  if (circular_buffer_starved(circular))
+    add_circular_stat(&circular->stats->underruns, 1);
 
-  while (circular_buffer_empty(circular) && !circular->eos) {
+  while (circular_buffer_starved(circular)) {
 #if DISPLAY_BUFFER
     if (global_show_circular && !global_parent_debug)
       print_msg("<-- wait\n");
 #endif
     if (global_parent_debug)
       print_msg("<-- wait\n");
-    count++;
 
-    err = nanosleep(&time, nullptr);
-    if (err == -1 && errno == EINVAL) {
-      fprint_err("### Child: bad value (%ld) for wait time\n", time.tv_nsec);
+    if (child_wait_for_data(circular, circular_buffer_starved, &count))
       return 1;
-    }
 
     // If we wait for a *very* long time, maybe our parent has crashed
     if (count > CHILD_GIVE_UP_AFTER) {
@@ -451,7 +877,6 @@ inline int wait_if_buffer_empty(circular_buffer_p circular) {
       return 1;
     }
   }
-  count = 0;
   return circular_buffer_empty(circular); // If empty then EOS so return 1
 }
 
@@ -461,24 +886,18 @@ inline int wait_if_buffer_empty(circular_buffer_p circular) {
  * Returns 0 if all goes well, 1 if something goes wrong.
  */
 inline int wait_for_buffer_to_fill(circular_buffer_p circular) {
-  static int count = 0;
-  struct timespec time = {0, global_child_wait * ONE_MS_AS_NANOSECONDS};
-  int err;
+  int count = 0;
 
-  while (!circular_buffer_full(circular) && !circular->eos) {
+  while (circular_buffer_filling(circular)) {
 #if DISPLAY_BUFFER
     if (global_show_circular && !global_child_debug)
       print_msg("<-- wait for buffer to fill\n");
 #endif
     if (global_child_debug)
       print_msg("<-- wait for buffer to fill\n");
-    count++;
 
-    err = nanosleep(&time, nullptr);
-    if (err == -1 && errno == EINVAL) {
-      fprint_err("### Child: bad value (%ld) for wait time\n", time.tv_nsec);
+    if (child_wait_for_data(circular, circular_buffer_filling, &count))
       return 1;
-    }
 
     // If we wait for a *very* long time, maybe our parent has crashed
     if (count > CHILD_GIVE_UP_AFTER) {
@@ -486,7 +905,6 @@ inline int wait_for_buffer_to_fill(circular_buffer_p circular) {
       return 1;
     }
   }
-  count = 0;
   return 0;
 }
 
@@ -496,10 +914,13 @@ inline int wait_for_buffer_to_fill(circular_buffer_p circular) {
  * Returns 0 if all goes well, 1 if something goes wrong.
  */
 inline int wait_if_buffer_full(circular_buffer_p circular) {
-  static int count = 0;
-  struct timespec time = {0, global_child_wait * ONE_MS_AS_NANOSECONDS};
+  int count = 0;
+  uint32_t seen;
   int err;
 
+  if (circular_buffer_full(circular))
+    add_circular_stat(&circular->stats->parent_stalls, 1);
+
   while (circular_buffer_full(circular)) {
 #if DISPLAY_BUFFER
     if (global_show_circular && !global_parent_debug)
@@ -507,17 +928,23 @@ inline int wait_if_buffer_full(circular_buffer_p circular) {
 #endif
     if (global_parent_debug)
       print_msg("--> wait\n");
-    count++;
 
-    err = nanosleep(&time, nullptr);
-    if (err == -1 && errno == EINVAL) {
-      fprint_err("### Parent: bad value (%ld) for wait time\n", time.tv_nsec);
-      return 1;
-    }
+    __atomic_store_n(&circular->room_waiting, 1, __ATOMIC_SEQ_CST);
+    seen = __atomic_load_n(&circular->room_seq, __ATOMIC_SEQ_CST);
+    if (circular_buffer_full(circular)) {
+      err = wait_on_circular_seq(&circular->room_seq, &circular->room_waiting,
+                                 seen, global_child_wait);
+      if (err == -1) {
+        print_err("### Parent: error waiting for child\n");
+        return 1;
+      }
+      count += err;
+    } else
+      __atomic_store_n(&circular->room_waiting, 0, __ATOMIC_SEQ_CST);
 
     if (circular_buffer_jammed(circular)) {
       print_err("### Circular buffer jammed: No PCRs found\n");
-      circular->eos = true;
+      publish_circular_eos(circular);
       return 1;
     }
 
@@ -527,7 +954,6 @@ inline int wait_if_buffer_full(circular_buffer_p circular) {
       return 1;
     }
   }
-  count = 0;
   return 0;
 }
 
@@ -618,6 +1044,10 @@ int build_buffered_TS_output(buffered_TS_output_p *writer, int circ_buf_size,
 
   new2->pcr_scale = pcr_scale;
 
+  new2->reader.starting = true;
+  new2->reader.reset = true;
+  new2->reader.spin_tail = -1;
+
   new2->pcr_pace.prime_speed = prime_speedup;
   new2->pcr_pace.prime_req = (prime_speedup != PRIME_SPEED_NORMAL);
   fprint_msg("prime speed set to %d\n", prime_speedup);
@@ -767,6 +1197,7 @@ int set_buffer_item_time_pcr1(buffered_TS_output_p writer) {
       // back to the start of the file). We plainly don't want to continue
       // using previous PCRs as our basis for calculation, so let's fake
       // starting again...
+      add_circular_stat(&writer->buffer->stats->pcr_discontinuities, 1);
       had_first_pcr = false;
       had_second_pcr = false;
       // And since we don't know what "time" is it, we'd better force
@@ -979,6 +1410,7 @@ retry:
         // Discontinuity
         fprint_msg("PCR2: Discontinuity[%d]: gap=%lld\n", writer->which,
                    pcr_gap);
+        add_circular_stat(&circ->stats->pcr_discontinuities, 1);
 
         idx = finalize_pcr_time(writer, ppe);
         goto retry;
@@ -1092,18 +1524,31 @@ int add_eof_entry(buffered_TS_output_p writer) {
   // and the length to 1.
   circular->item_data[data_pos * circular->item_size] = 1;
   circular->item[data_pos].length = 1;
-  circular->end = data_pos;
+  publish_circular_end(circular, data_pos);
 #if DISPLAY_BUFFER
   if (global_show_circular)
     print_circular_buffer((char *)"eof", circular);
 #endif
-  circular->eos = true;
+  publish_circular_eos(circular);
   return 0;
 }
 
 // ============================================================
 // Output via buffered TS output
 // ============================================================
+/*
+ * Count another item as having been put into the circular buffer, and
+ * remember if the buffer has never been this full before
+ */
+static void note_item_queued(circular_buffer_p circular) {
+  circular_stats_p stats = circular->stats;
+  uint64_t queued = stats->items_queued + 1;
+  uint64_t waiting = queued - get_circular_stat(&stats->items_sent);
+  add_circular_stat(&stats->items_queued, 1);
+  if (waiting > stats->high_water)
+    __atomic_store_n(&stats->high_water, waiting, __ATOMIC_RELAXED);
+}
+
 /*
  * Flush the current circular buffer item. It must contain sensible data.
  *
@@ -1123,10 +1568,11 @@ void internal_flush_buffered_TS_output(const buffered_TS_output_p writer) {
   // Set the `time` within the item appropriately
   idx = set_buffer_item_time(writer, false);
   if (idx >= 0)
-    circular->end = idx;
+    publish_circular_end(circular, idx);
 
   // Make this item available for reading
   circular->pending = writer->which;
+  note_item_queued(circular);
 
   // And then prepare for the next index
   writer->which = (circular->pending + 1) % circular->size;
@@ -1142,10 +1588,12 @@ void discontinuity_buffered_TS_output(buffered_TS_output_p writer) {
   if (writer->pcr_mode != TSWRITE_PCR_MODE_PCR2)
     return;
 
+  add_circular_stat(&circular->stats->pcr_discontinuities, 1);
+
   // Set the `time` within the item appropriately
   idx = discontinuity_pkt_pcr_time(writer, &writer->pcr_pace);
   if (idx >= 0)
-    circular->end = idx;
+    publish_circular_end(circular, idx);
 
   // We need to update the end of the circular buffer but we haven't added
   // any packets so no need to update any of that
@@ -1287,6 +1735,88 @@ void wait_microseconds(int microseconds) {
   return;
 }
 
+/*
+ * Turn O_DIRECT on or off for the file descriptor `fd`
+ *
+ * Returns 0 if all went well, 1 if something went wrong.
+ */
+static int set_direct_io(int fd, int on) {
+#if defined(O_DIRECT)
+  int flags = fcntl(fd, F_GETFL, 0);
+  if (flags == -1)
+    return 1;
+  flags = on ? (flags | O_DIRECT) : (flags & ~O_DIRECT);
+  return fcntl(fd, F_SETFL, flags) == -1;
+#else
+  (void)fd;
+  return on;
+#endif
+}
+
+/*
+ * Write out whatever has been gathered in our file buffer
+ *
+ * - `tswriter` is the TS output context returned by `tswrite_open`
+ *
+ * Returns 0 if all went well, 1 if something went wrong.
+ */
+static int flush_file_data(TS_writer_p tswriter) {
+  int fd = fileno(tswriter->where.file);
+  byte *data = tswriter->file_buf;
+  ssize_t left = tswriter->file_buf_used;
+
+  while (left > 0) {
+    ssize_t written;
+
+    // A direct write must be a whole number of blocks, which will not be
+    // true of the last bufferful, so that has to be written normally
+    if (tswriter->direct_io && (left % FILE_BUFFER_ALIGNMENT) != 0) {
+      (void)set_direct_io(fd, false);
+      tswriter->direct_io = false;
+    }
+
+    written = write(fd, data, left);
+    if (written == -1) {
+      if (errno == EINTR)
+        continue;
+      else if (errno == EINVAL && tswriter->direct_io) {
+        // The file system didn't like our direct write after all
+        print_err("!!! Unable to write output with O_DIRECT - using normal"
+                  " writes instead\n");
+        (void)set_direct_io(fd, false);
+        tswriter->direct_io = false;
+        continue;
+      }
+      fprint_err("### Error writing out TS packet data: %s\n",
+                 strerror(errno));
+      return 1;
+    }
+    data += written;
+    left -= written;
+  }
+  tswriter->file_buf_used = 0;
+  return 0;
+}
+
+/*
+ * Set up the buffer used to gather TS packets for writing to a file
+ *
+ * Returns 0 if all went well, 1 if something went wrong.
+ */
+static int build_file_buffer(TS_writer_p tswriter) {
+  void *buf = nullptr;
+  int size = TS_PACKETS_IN_FILE_BUFFER * TS_PACKET_SIZE;
+  int err = posix_memalign(&buf, FILE_BUFFER_ALIGNMENT, size);
+  if (err) {
+    fprint_err("### Unable to allocate output buffer: %s\n", strerror(err));
+    return 1;
+  }
+  tswriter->file_buf = (byte *)buf;
+  tswriter->file_buf_size = size;
+  tswriter->file_buf_used = 0;
+  return 0;
+}
+
 /*
  * Write data out to a file
  *
@@ -1298,11 +1828,29 @@ void wait_microseconds(int microseconds) {
  */
 int write_file_data(TS_writer_p tswriter, byte data[], size_t data_len) {
   size_t written = 0;
-  errno = 0;
-  written = fwrite(data, 1, data_len, tswriter->where.file);
-  if (written != data_len) {
-    fprint_err("### Error writing out TS packet data: %s\n", strerror(errno));
-    return 1;
+
+  if (tswriter->file_buf == nullptr) {
+    errno = 0;
+    written = fwrite(data, 1, data_len, tswriter->where.file);
+    if (written != data_len) {
+      fprint_err("### Error writing out TS packet data: %s\n",
+                 strerror(errno));
+      return 1;
+    }
+    return 0;
+  }
+
+  while (written < data_len) {
+    size_t space = tswriter->file_buf_size - tswriter->file_buf_used;
+    size_t len = min(space, data_len - written);
+    memcpy(tswriter->file_buf + tswriter->file_buf_used, data + written, len);
+    tswriter->file_buf_used += len;
+    written += len;
+    if (tswriter->file_buf_used == tswriter->file_buf_size) {
+      int err = flush_file_data(tswriter);
+      if (err)
+        return 1;
+    }
   }
   return 0;
 }
@@ -1696,6 +2244,180 @@ int wait_for_command(TS_writer_p tswriter) {
   }
 }
 
+// ============================================================
+// Fan-out output
+// ============================================================
+/*
+ * Describe a type of TS writer, for messages
+ */
+static const char *writer_type_name(TS_WRITER_TYPE how) {
+  return (how == TS_W_TCP      ? "TCP/IP"
+          : how == TS_W_UDP    ? "UDP"
+          : how == TS_W_FILE   ? "file"
+          : how == TS_W_STDOUT ? "<standard output>"
+          : how == TS_W_FANOUT ? "fan-out"
+                               : "???");
+}
+
+/*
+ * Send data to a socket without waiting
+ *
+ * Returns the number of bytes sent (which may be 0 if the socket is not
+ * ready), or -1 if something went wrong.
+ */
+static int send_dest_nowait(struct TS_writer_dest *dest, byte data[],
+                            int data_len) {
+  ssize_t sent = send(dest->tswriter->where.socket, data, data_len,
+                      MSG_DONTWAIT | MSG_NOSIGNAL);
+  if (sent == -1) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS ||
+        errno == EINTR)
+      return 0;
+    return -1;
+  }
+  return (int)sent;
+}
+
+/*
+ * Write data to a TS_W_POLICY_DROP destination, dropping whatever it
+ * cannot take straight away.
+ *
+ * Data is only ever dropped a whole write at a time. If the socket takes
+ * part of a write, the rest is kept back, and must be sent before anything
+ * else is (until then, new data is dropped).
+ *
+ * Returns 0 if all went well, 1 if something went wrong.
+ */
+static int write_dest_nowait(struct TS_writer_dest *dest, byte data[],
+                             int data_len) {
+  int sent;
+
+  if (dest->pending_len > 0) {
+    sent = send_dest_nowait(dest, dest->pending, dest->pending_len);
+    if (sent == -1)
+      return 1;
+    dest->pending_len -= sent;
+    if (dest->pending_len > 0) {
+      memmove(dest->pending, dest->pending + sent, dest->pending_len);
+      dest->dropped += data_len;
+      return 0;
+    }
+  }
+
+  sent = send_dest_nowait(dest, data, data_len);
+  if (sent == -1)
+    return 1;
+  else if (sent == 0)
+    dest->dropped += data_len;
+  else if (sent < data_len) {
+    int left = data_len - sent;
+    if (left > dest->pending_size) {
+      byte *tmp = (byte *)realloc(dest->pending, left);
+      if (tmp == nullptr) {
+        print_err("### Unable to extend fan-out pending data buffer\n");
+        return 1;
+      }
+      dest->pending = tmp;
+      dest->pending_size = left;
+    }
+    memcpy(dest->pending, data + sent, left);
+    dest->pending_len = left;
+  }
+  return 0;
+}
+
+/*
+ * Write data to the `index`th destination of a fan-out TS writer,
+ * according to its policy.
+ *
+ * Returns 0 if all went well (which includes a TS_W_POLICY_DROP destination
+ * failing, in which case it is reported and then no longer used), 1 if
+ * something went wrong.
+ */
+static int write_dest_data(TS_writer_p tswriter, int index, byte data[],
+                           int data_len) {
+  struct TS_writer_dest *dest = &tswriter->dests[index];
+  TS_writer_p output = dest->tswriter;
+  int err;
+
+  if (dest->failed)
+    return 0;
+
+  if (output->how == TS_W_STDOUT || output->how == TS_W_FILE)
+    err = write_file_data(output, data, data_len);
+  else if (dest->policy == TS_W_POLICY_DROP)
+    err = write_dest_nowait(dest, data, data_len);
+  else
+    err = write_socket_data(output->where.socket, data, data_len);
+
+  if (err) {
+    if (dest->policy != TS_W_POLICY_DROP) {
+      fprint_err("### Error writing to output %d (%s)\n", index + 1,
+                 writer_type_name(output->how));
+      return 1;
+    }
+    fprint_err("!!! Error writing to output %d (%s) - no longer writing"
+               " to it\n",
+               index + 1, writer_type_name(output->how));
+    dest->failed = true;
+  }
+  return 0;
+}
+
+/*
+ * Write data to all the destinations of a fan-out TS writer
+ *
+ * Returns 0 if all went well, 1 if something went wrong.
+ */
+static int write_to_dests(TS_writer_p tswriter, byte data[], int data_len) {
+  int ii;
+  for (ii = 0; ii < tswriter->num_dests; ii++) {
+    int err = write_dest_data(tswriter, ii, data, data_len);
+    if (err)
+      return 1;
+  }
+  return 0;
+}
+
+/*
+ * Finish writing to the destinations of a fan-out TS writer, by flushing
+ * any buffered file output, and (if it can be done without waiting) any
+ * partial TS packet kept back for a slow socket, and then reporting on how
+ * much data was dropped.
+ *
+ * This is done by whoever has been doing the writing - the child, if
+ * output is buffered.
+ *
+ * Returns 0 if all went well, 1 if something went wrong.
+ */
+static int finish_dests(TS_writer_p tswriter) {
+  int ii;
+  int result = 0;
+  for (ii = 0; ii < tswriter->num_dests; ii++) {
+    struct TS_writer_dest *dest = &tswriter->dests[ii];
+    TS_writer_p output = dest->tswriter;
+    if (!dest->failed) {
+      if (output->file_buf != nullptr && flush_file_data(output))
+        result = 1;
+      if (dest->pending_len > 0) {
+        // One last try, but we can't wait for a client that's stuck
+        int sent = send_dest_nowait(dest, dest->pending, dest->pending_len);
+        if (sent >= 0)
+          dest->dropped += dest->pending_len - sent;
+        dest->pending_len = 0;
+      }
+    }
+    if (dest->dropped > 0) {
+      fprint_err("!!! Dropped %u TS packets for output %d (%s), which could"
+                 " not keep up\n",
+                 dest->dropped / TS_PACKET_SIZE, ii + 1,
+                 writer_type_name(output->how));
+      dest->dropped = 0;
+    }
+  }
+  return result;
+}
+
 /*
  * Write the next data item in our buffer
  *
@@ -1748,7 +2470,7 @@ int write_circular_data(const SOCKET output, const circular_buffer_p circular) {
   // Once we've finished writing it, we can relinquish this entry in
   // the circular buffer
   buffer[0] = 0; // just for debug output's sake
-  circular->start = (circular->start + 1) % circular->size;
+  release_circular_start(circular, 1);
 
 #if DISPLAY_BUFFER
   if (global_show_circular)
@@ -1757,6 +2479,284 @@ int write_circular_data(const SOCKET output, const circular_buffer_p circular) {
   return 0;
 }
 
+/*
+ * Read CLOCK_MONOTONIC, in nanoseconds
+ */
+static uint64_t monotonic_now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+#if defined(__linux__)
+/*
+ * Read the clock we're using for SO_TXTIME, in nanoseconds
+ */
+static uint64_t txtime_now(circular_buffer_p circular) {
+  struct timespec now;
+  clock_gettime(circular->txtime_clock, &now);
+  return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+#endif
+
+/*
+ * Send the next `num` data items in our buffer, with (on Linux) a single
+ * system call, but leave them in the buffer.
+ *
+ * - `output` is a socket for our output
+ * - `circular` is our circular buffer of "packets"
+ * - `reader` is the child's idea of time, which is used to work out the
+ *   launch time for each item if SO_TXTIME is in use.
+ * - `num` is how many items to send - all of these must be available.
+ * - `flags` are passed on to the sending system call. If they include
+ *   MSG_DONTWAIT, then we stop as soon as the socket is not ready.
+ *
+ * Errors are reported, but otherwise ignored (as in write_circular_data).
+ *
+ * Returns the number of items sent.
+ */
+static int send_circular_items(const SOCKET output,
+                               const circular_buffer_p circular,
+                               struct circular_reader *reader, int num,
+                               int flags) {
+#if defined(__linux__)
+  struct mmsghdr msgs[MAX_ITEMS_IN_BATCH];
+  struct iovec iovs[MAX_ITEMS_IN_BATCH];
+  union {
+    char buf[CMSG_SPACE(sizeof(uint64_t))];
+    struct cmsghdr align;
+  } control[MAX_ITEMS_IN_BATCH];
+  uint64_t earliest = 0;
+  int done = 0;
+  int ii;
+
+  if (circular->txtime_clock != -1)
+    earliest = txtime_now(circular);
+
+  memset(msgs, 0, num * sizeof(struct mmsghdr));
+  for (ii = 0; ii < num; ii++) {
+    int index = (circular->start + ii) % circular->size;
+    iovs[ii].iov_base =
+        circular->item_data + index * circular->item_size - circular->hdr_size;
+    iovs[ii].iov_len = circular->item[index].length + circular->hdr_size;
+    msgs[ii].msg_hdr.msg_iov = &iovs[ii];
+    msgs[ii].msg_hdr.msg_iovlen = 1;
+
+    if (circular->txtime_clock != -1) {
+      // The item's launch time is its time on the parent's timeline,
+      // converted to our clock, and then pushed back by `txtime_ahead` so
+      // that we hand it over before it is needed. Anything that is already
+      // late is just sent as soon as possible.
+      uint32_t since_start = circular->item[index].time - reader->delta_start;
+      uint64_t launch = reader->txtime_start + (uint64_t)since_start * 1000 +
+                        (uint64_t)circular->txtime_ahead * 1000;
+      struct cmsghdr *cmsg;
+      if (launch < earliest)
+        launch = earliest;
+      msgs[ii].msg_hdr.msg_control = control[ii].buf;
+      msgs[ii].msg_hdr.msg_controllen = sizeof(control[ii].buf);
+      cmsg = CMSG_FIRSTHDR(&msgs[ii].msg_hdr);
+      cmsg->cmsg_level = SOL_SOCKET;
+      cmsg->cmsg_type = SCM_TXTIME;
+      cmsg->cmsg_len = CMSG_LEN(sizeof(uint64_t));
+      memcpy(CMSG_DATA(cmsg), &launch, sizeof(uint64_t));
+    }
+  }
+
+  while (done < num) {
+    int sent = sendmmsg(output, &msgs[done], num - done, flags);
+    if (sent == -1) {
+      if ((flags & MSG_DONTWAIT) && (errno == EAGAIN || errno == EWOULDBLOCK))
+        break;
+      if (errno == ENOBUFS) {
+        print_err("!!! Warning: 'no buffer space available' writing out"
+                  " TS packet data - retrying\n");
+        continue;
+      }
+      // As in write_circular_data, an error here is reported but otherwise
+      // ignored, so that we keep on taking data from the parent
+      fprint_err("### Error writing out TS packet data: %s\n",
+                 strerror(errno));
+      break;
+    }
+    done += sent;
+  }
+  return done;
+#else
+  int done;
+  (void)reader;
+  (void)flags;
+  for (done = 0; done < num; done++) {
+    int index = (circular->start + done) % circular->size;
+    byte *buffer =
+        circular->item_data + index * circular->item_size - circular->hdr_size;
+    int err = write_socket_data(
+        output, buffer, circular->item[index].length + circular->hdr_size);
+    if (err)
+      break;
+  }
+  return done;
+#endif
+}
+
+/*
+ * Write the next `num` data items in our buffer, with (on Linux) a single
+ * system call
+ *
+ * - `output` is a socket for our output
+ * - `circular` is our circular buffer of "packets"
+ * - `reader` is the child's idea of time, which is used to work out the
+ *   launch time for each item if SO_TXTIME is in use.
+ * - `num` is how many items to write - all of these must be available.
+ *
+ * Returns 0 if all went well, 1 if something went wrong.
+ */
+int write_circular_batch(const SOCKET output, const circular_buffer_p circular,
+                         struct circular_reader *reader, int num) {
+  int ii;
+
+  (void)send_circular_items(output, circular, reader, num, 0);
+
+  for (ii = 0; ii < num; ii++) {
+    int index = (circular->start + ii) % circular->size;
+    circular->item_data[index * circular->item_size - circular->hdr_size] =
+        0; // just for debug output's sake
+  }
+  release_circular_start(circular, num);
+
+#if DISPLAY_BUFFER
+  if (global_show_circular) {
+    fprint_msg("<-- batch of %d\n", num);
+    print_circular_buffer((char *)"<--", circular);
+  }
+#endif
+  return 0;
+}
+
+/*
+ * Write the next `num` data items in our buffer to each of the destinations
+ * of a fan-out TS writer.
+ *
+ * The items are written straight from the circular buffer, and are only
+ * released when every destination has had them. UDP destinations get each
+ * item as a datagram (with its packet header, if any), as usual, and other
+ * destinations just get the TS packets.
+ *
+ * - `tswriter` is the fan-out TS writer
+ * - `circular` is our circular buffer of "packets"
+ * - `reader` is the child's idea of time (see write_circular_batch)
+ * - `num` is how many items to write - all of these must be available.
+ *
+ * Returns 0 if all went well, 1 if something went wrong.
+ */
+static int write_circular_to_dests(TS_writer_p tswriter,
+                                   circular_buffer_p circular,
+                                   struct circular_reader *reader, int num) {
+  int ii, jj;
+
+  for (ii = 0; ii < tswriter->num_dests; ii++) {
+    struct TS_writer_dest *dest = &tswriter->dests[ii];
+    if (dest->failed)
+      continue;
+    if (dest->tswriter->how == TS_W_UDP) {
+      int flags = (dest->policy == TS_W_POLICY_DROP ? MSG_DONTWAIT : 0);
+      int sent = send_circular_items(dest->tswriter->where.socket, circular,
+                                     reader, num, flags);
+      for (jj = sent; jj < num; jj++)
+        dest->dropped +=
+            circular->item[(circular->start + jj) % circular->size].length;
+    } else {
+      for (jj = 0; jj < num; jj++) {
+        int index = (circular->start + jj) % circular->size;
+        int err = write_dest_data(tswriter, ii,
+                                  circular->item_data +
+                                      index * circular->item_size,
+                                  circular->item[index].length);
+        if (err)
+          return 1;
+      }
+    }
+  }
+  release_circular_start(circular, num);
+
+#if DISPLAY_BUFFER
+  if (global_show_circular) {
+    fprint_msg("<-- fan-out of %d\n", num);
+    print_circular_buffer((char *)"<--", circular);
+  }
+#endif
+  return 0;
+}
+
+/*
+ * Work out how many items, starting with the one at `start`, can be written
+ * together. The item at `start` is always included, and is followed by as
+ * many of the following items as
+ *
+ * - are already available,
+ * - are neither EOF indicators nor the start of a new timeline,
+ * - are due (according to `reader`'s idea of the parent's timeline) no
+ *   later than `batch_slot` microseconds from now, and
+ * - don't take us past `maxnowait`, if that is set.
+ *
+ * Returns the number of items (1 if batching is not enabled).
+ */
+int due_circular_items(circular_buffer_p circular,
+                       struct circular_reader *reader) {
+  struct timeval now;
+  uint32_t due_by;
+  int end, index, num;
+  int max_num = min(circular->batch_size, MAX_ITEMS_IN_BATCH);
+
+  if (max_num < 2)
+    return 1;
+
+  if (circular->precise)
+    due_by = (uint32_t)(reader->origin_time +
+                        (monotonic_now() - reader->origin_ns) / 1000) +
+             circular->batch_slot;
+  else {
+    gettimeofday(&now, nullptr);
+    due_by = (now.tv_sec - reader->start.tv_sec) * 1000000 +
+             (now.tv_usec - reader->start.tv_usec) + reader->delta_start +
+             circular->batch_slot;
+  }
+
+  end = __atomic_load_n(&circular->end, __ATOMIC_ACQUIRE);
+  index = circular->start;
+  for (num = 1; num < max_num && index != end; num++) {
+    int next = (index + 1) % circular->size;
+    circular_buffer_item_p item = &circular->item[next];
+    if (item->discontinuity)
+      break;
+    if (item->length == 1 &&
+        circular->item_data[next * circular->item_size] == 1)
+      break; // EOF
+    if ((int32_t)(item->time - due_by) > 0)
+      break;
+    if (circular->maxnowait != -1 &&
+        reader->sent_without_delay + num > circular->maxnowait)
+      break;
+    index = next;
+  }
+  return num;
+}
+
+/*
+ * Count the `num_items` items at the start of the circular buffer, which we
+ * are about to send, in our statistics
+ */
+static void note_items_sent(circular_buffer_p circular, int num_items) {
+  circular_stats_p stats = circular->stats;
+  uint64_t bytes = 0;
+  int ii;
+  for (ii = 0; ii < num_items; ii++)
+    bytes += circular->item[(circular->start + ii) % circular->size].length;
+  add_circular_stat(&stats->bytes_sent, bytes);
+  add_circular_stat(&stats->packets_sent, bytes / TS_PACKET_SIZE);
+  add_circular_stat(&stats->items_sent, num_items);
+}
+
 /*
  * Check if we have received an end-of-file indicator
  *
@@ -1771,7 +2771,7 @@ int received_EOF(circular_buffer_p circular) {
 
   if (length == 1 && buffer[0] == 1) {
     // Relinquish the buffer entry, just in case...
-    circular->start = (circular->start + 1) % circular->size;
+    release_circular_start(circular, 1);
 #if DISPLAY_BUFFER
     if (global_show_circular) {
       print_msg("Child: found EOF\n");
@@ -1820,11 +2820,280 @@ int32_t perturb_time_by(void) {
   return result * 1000;
 }
 
+// ============================================================
+// Precise pacing
+// ============================================================
+/*
+ * Sleep until CLOCK_MONOTONIC reaches `deadline` (in nanoseconds), or
+ * (since the system may be busy) somewhat later
+ */
+static void sleep_until(uint64_t deadline) {
+  struct timespec when;
+  when.tv_sec = deadline / 1000000000;
+  when.tv_nsec = deadline % 1000000000;
+#if defined(__linux__)
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &when, nullptr) ==
+         EINTR)
+    continue; // cope with being woken too early
+#else
+  for (;;) {
+    uint64_t now = monotonic_now();
+    struct timespec gap;
+    if (now >= deadline)
+      break;
+    gap.tv_sec = (deadline - now) / 1000000000;
+    gap.tv_nsec = (deadline - now) % 1000000000;
+    (void)nanosleep(&gap, nullptr);
+  }
+#endif
+}
+
+/*
+ * Work out how long before a deadline we should stop sleeping and start
+ * spinning, by seeing how late a few short sleeps wake up.
+ *
+ * Returns the spin tail, in nanoseconds.
+ */
+static int64_t calibrate_spin_tail(void) {
+  int64_t worst = 0;
+  int64_t tail;
+  int ii;
+  for (ii = 0; ii < SPIN_CALIBRATION_SLEEPS; ii++) {
+    uint64_t target = monotonic_now() + 200000;
+    int64_t late;
+    sleep_until(target);
+    late = (int64_t)(monotonic_now() - target);
+    if (late > worst)
+      worst = late;
+  }
+  tail = worst + worst / 2;
+  return max(MIN_SPIN_TAIL, min(tail, MAX_SPIN_TAIL));
+}
+
+/*
+ * Wait until CLOCK_MONOTONIC reaches `deadline` (in nanoseconds), by
+ * sleeping until `reader->spin_tail` before it, and then spinning.
+ *
+ * If we wake up too late to spin, the spin tail is lengthened, otherwise
+ * it is very slowly shortened again, so that it tracks how promptly the
+ * system is actually waking us.
+ *
+ * Returns the time at which we stopped waiting.
+ */
+static uint64_t wait_until(struct circular_reader *reader, uint64_t deadline) {
+  uint64_t now = monotonic_now();
+  if (deadline > now + reader->spin_tail) {
+    uint64_t wake = deadline - reader->spin_tail;
+    sleep_until(wake);
+    now = monotonic_now();
+    if (now > deadline)
+      reader->spin_tail = min(reader->spin_tail + (int64_t)(now - deadline),
+                              MAX_SPIN_TAIL);
+    else
+      reader->spin_tail =
+          max(reader->spin_tail - (reader->spin_tail >> 8), MIN_SPIN_TAIL);
+  }
+  while (now < deadline)
+    now = monotonic_now();
+  return now;
+}
+
+/*
+ * Record that an item was sent `late` nanoseconds after it was due
+ */
+static void record_jitter(struct jitter_histogram *jitter, int64_t late) {
+  int bucket;
+  for (bucket = 0; bucket < JITTER_BUCKETS - 1; bucket++)
+    if (late <= jitter_limit[bucket])
+      break;
+  jitter->count[bucket]++;
+  if (jitter->total == 0 || late < jitter->min)
+    jitter->min = late;
+  if (jitter->total == 0 || late > jitter->max)
+    jitter->max = late;
+  jitter->total++;
+  jitter->sum += late;
+}
+
+/*
+ * Report on how close to their due times items were sent
+ */
+static void report_jitter(struct jitter_histogram *jitter, int precise) {
+  uint64_t so_far = 0;
+  int ii;
+  fprint_msg("Send time jitter (%s pacing), for %" PRIu64 " item%s:\n",
+             precise ? "precise" : "relative", jitter->total,
+             jitter->total == 1 ? "" : "s");
+  if (jitter->total == 0)
+    return;
+  fprint_msg("  min %.1fus, mean %.1fus, max %.1fus late\n",
+             jitter->min / 1000.0, jitter->sum / jitter->total / 1000.0,
+             jitter->max / 1000.0);
+  for (ii = 0; ii < JITTER_BUCKETS; ii++) {
+    char label[40];
+    if (jitter->count[ii] == 0)
+      continue;
+    so_far += jitter->count[ii];
+    if (ii == 0)
+      snprintf(label, sizeof(label), "on time or early");
+    else if (ii == JITTER_BUCKETS - 1)
+      snprintf(label, sizeof(label), "more than %.1fus late",
+               jitter_limit[ii - 1] / 1000.0);
+    else
+      snprintf(label, sizeof(label), "up to %.1fus late",
+               jitter_limit[ii] / 1000.0);
+    fprint_msg("  %-24s %10" PRIu64 " (%5.1f%%, %5.1f%% so far)\n", label,
+               jitter->count[ii], 100.0 * jitter->count[ii] / jitter->total,
+               100.0 * so_far / jitter->total);
+  }
+  flush_msg();
+}
+
+/*
+ * Start a new timeline, at (CLOCK_MONOTONIC) time `now`, for the item at
+ * the start of the circular buffer, whose (extended) time stamp is
+ * `reader->item_time`.
+ */
+static void start_precise_timeline(circular_buffer_p circular,
+                                   struct circular_reader *reader,
+                                   uint64_t now) {
+  reader->origin_time = reader->item_time;
+  reader->origin_ns = now;
+  // Keep the relative timeline in step, for batching and SO_TXTIME
+  gettimeofday(&reader->start, nullptr);
+  reader->delta_start = (uint32_t)reader->item_time;
+#if defined(__linux__)
+  if (circular->txtime_clock != -1)
+    reader->txtime_start = txtime_now(circular);
+#endif
+  reader->reset = false;
+}
+
+/*
+ * Work out the (CLOCK_MONOTONIC) deadline for an item with the given
+ * (extended) time stamp
+ */
+static uint64_t precise_deadline(struct circular_reader *reader,
+                                 uint64_t item_time) {
+  return reader->origin_ns +
+         (int64_t)(item_time - reader->origin_time) * 1000;
+}
+
+/*
+ * Extend a 32 bit time stamp from the parent to 64 bits, assuming that it
+ * is within half the range of a 32 bit value of `reader->item_time`
+ */
+static uint64_t extend_item_time(struct circular_reader *reader,
+                                 uint32_t time) {
+  return reader->item_time + (int32_t)(time - (uint32_t)reader->item_time);
+}
+
+/*
+ * Write the next data item(s) in our buffer at the right time, using an
+ * absolute timeline, with nanosecond resolution.
+ *
+ * Each item's deadline is worked out from the start of the timeline
+ * (rather than from the item before it), so errors do not accumulate, and
+ * the parent's 32 bit microsecond time stamps are extended to 64 bits as
+ * they are read, so the timeline does not wrap around. We sleep (with an
+ * absolute timeout) until just before the deadline, and then spin, which
+ * is rather more accurate than sleeping all the way. The "maxnowait" and
+ * "waitfor" values are not needed, and so are not used.
+ *
+ * - `tswriter` is the TS writer that owns the buffer
+ * - `circular` is our circular buffer of "packets", which must have an item
+ *   (other than EOF) waiting
+ * - `reader` is our idea of time, as maintained by this function
+ *
+ * Returns 0 if all went well, 1 if something went wrong.
+ */
+static int write_precisely(TS_writer_p tswriter, circular_buffer_p circular,
+                           struct circular_reader *reader) {
+  circular_buffer_item_p item = &circular->item[circular->start];
+  uint64_t now = monotonic_now();
+  uint64_t deadline;
+  int num_items;
+  int err;
+  int ii;
+
+  if (reader->spin_tail < 0)
+    reader->spin_tail = (circular->spin_tail >= 0 ? circular->spin_tail
+                                                  : calibrate_spin_tail());
+
+  if (reader->reset || item->discontinuity) {
+    reader->item_time = item->time;
+    start_precise_timeline(circular, reader, now);
+    deadline = now;
+    if (global_child_debug)
+      fprint_msg("<-- packet %6u; STARTING\n", item->time);
+  } else {
+    int64_t late;
+    reader->item_time = extend_item_time(reader, item->time);
+    deadline = precise_deadline(reader, reader->item_time);
+    late = (int64_t)(now - deadline);
+    if (global_child_debug)
+      fprint_msg("<-- packet %6u; deadline in %" PRId64 "ns\n", item->time,
+                 -late);
+    if (late > LATE_ITEM_THRESHOLD * 1000LL)
+      add_circular_stat(&circular->stats->late_items, 1);
+    if (late > MAX_PACING_ERROR && global_perturb_range == 0) {
+      fprint_err("!!! [%d] Item %u: Outputting %.2fs late -"
+                 " restarting time sequence\n",
+                 circular->start, reader->count, late / 1000000000.0);
+      add_circular_stat(&circular->stats->resets, 1);
+      start_precise_timeline(circular, reader, now);
+      deadline = now;
+    } else if (-late > MAX_PACING_ERROR) {
+      // The parent's timeline has jumped forwards - wait a while, as the
+      // original pacing does, and then start again
+      fprint_msg("###[%d] (%" PRId64 "us) >0.2s, RESET\n", circular->start,
+                 -late / 1000);
+      deadline = now + MAX_PACING_ERROR;
+      add_circular_stat(&circular->stats->resets, 1);
+      reader->reset = true;
+    }
+  }
+
+  if (global_perturb_range)
+    deadline += (int64_t)perturb_time_by() * 1000;
+
+  now = wait_until(reader, deadline);
+
+  // Send this item, and any following items that are also due
+  num_items = due_circular_items(circular, reader);
+  note_items_sent(circular, num_items);
+  if (circular->show_jitter) {
+    record_jitter(&reader->jitter, (int64_t)(now - deadline));
+    for (ii = 1; ii < num_items; ii++) {
+      uint32_t time =
+          circular->item[(circular->start + ii) % circular->size].time;
+      uint64_t item_time = extend_item_time(reader, time);
+      record_jitter(&reader->jitter,
+                    (int64_t)(now - precise_deadline(reader, item_time)));
+    }
+  }
+  reader->last_packet_time =
+      circular->item[(circular->start + num_items - 1) % circular->size].time;
+  reader->item_time = extend_item_time(reader, reader->last_packet_time);
+  reader->count += num_items - 1;
+
+  if (tswriter->how == TS_W_FANOUT)
+    err = write_circular_to_dests(tswriter, circular, reader, num_items);
+  else if (num_items > 1 || circular->txtime_clock != -1)
+    err = write_circular_batch(tswriter->where.socket, circular, reader,
+                               num_items);
+  else
+    err = write_circular_data(tswriter->where.socket, circular);
+  return err;
+}
+
 /*
  * Write the next data item in our buffer
  *
- * - `output` is a socket for our output
+ * - `tswriter` is the TS writer that owns the buffer, and says where
+ *   to write to
  * - `circular` is our circular buffer of "packets"
+ * - `reader` is our idea of time, as maintained by this function
  * - if `quiet` then don't output extra messages (about filling up
  *   circular buffer)
  * - `had_eof` is set true if we read a packet flagged to indicate
@@ -1832,49 +3101,37 @@ int32_t perturb_time_by(void) {
  *
  * Returns 0 if all went well, 1 if something went wrong.
  */
-int write_from_circular(SOCKET output, circular_buffer_p circular, int quiet,
+int write_from_circular(TS_writer_p tswriter, circular_buffer_p circular,
+                        struct circular_reader *reader, int quiet,
                         int *had_eof) {
   int err;
 
-  // Are we starting up for the first time?
-  static int starting = true;
-
-  // Do we need to (re)set our relative timeline? At the start we do.
-  static int reset = true;
-
   // Monitor time as seen by the parent
   // The parent prefixes each circular buffer item with the time
   // (in microseconds since some arbitrary start time) at which it would
   // like it to be displayed. For a constant rate bitstream, these "ticks"
-  // will be evenly spaced.
-  uint32_t this_packet_time;            // time stamp for this packet
-  static uint32_t last_packet_time = 0; // time stamp for last packet
+  // will be evenly spaced. We remember the time stamp for the last packet
+  // in `reader->last_packet_time`.
+  uint32_t this_packet_time; // time stamp for this packet
   int32_t packet_time_gap; // the difference between the two, in microseconds
 
   // Monitor time as seen by us
   // We have to deduce both an arbitrary start time from which to measure
-  // "ticks", and also when we should (according to the requested gaps,
-  // and the progress through time) be outputing the next packet - i.e.,
-  // as near to the correct tick as possible.
+  // "ticks" (`reader->start`), and also when we should (according to the
+  // requested gaps, and the progress through time) be outputing the next
+  // packet - i.e., as near to the correct tick as possible.
   struct timeval now;
-  static struct timeval start = {0, 0}; // our arbitrary start time
-  uint32_t our_time_now;                // our time, relative to our start time
-  static int32_t delta_start; // difference between our time and the parent's
-  uint32_t adjusted_now;      // our time, adjusted by delta_start
-  int32_t waitfor;            // how long we think we need to wait to adjust
-
-  // How many items have we sent without *any* delay?
-  // (not used if maxnowait is off)
-  static int sent_without_delay = 0;
+  uint32_t our_time_now; // our time, relative to our start time
+  uint32_t adjusted_now; // our time, adjusted by delta_start
+  int32_t waitfor;       // how long we think we need to wait to adjust
+  int num_items;         // how many items we write this time
 
   // When grumbling about having had to restart our time sequence,
   // it is nice to be able to say which packet we were outputting
   // (so the user can tell how frequently we're doing this)
-  static unsigned int count = 0;
+  unsigned int count = ++reader->count;
 
-  count++;
-
-  if (starting) {
+  if (reader->starting) {
     // If we're starting up for the first time, it's probably worth waiting
     // for the circular buffer to fill up
     if (!quiet)
@@ -1886,7 +3143,7 @@ int write_from_circular(SOCKET output, circular_buffer_p circular, int quiet,
     }
     if (!quiet)
       print_msg("Circular buffer filled - starting to send data\n");
-    starting = false;
+    reader->starting = false;
   } else {
     // If the buffer is empty, there's really not much else we can do but
     // wait for it not to be empty.
@@ -1904,15 +3161,18 @@ int write_from_circular(SOCKET output, circular_buffer_p circular, int quiet,
     return 0;
   }
 
+  if (circular->precise)
+    return write_precisely(tswriter, circular, reader);
+
   // Work out the interval that the parent is asking for
   this_packet_time = circular->item[circular->start].time;
-  packet_time_gap = this_packet_time - last_packet_time;
+  packet_time_gap = this_packet_time - reader->last_packet_time;
 
   // Work out the actual position on our own timeline
   gettimeofday(&now, nullptr);
   // We're *actually* at this distance along our time line
-  our_time_now =
-      (now.tv_sec - start.tv_sec) * 1000000 + (now.tv_usec - start.tv_usec);
+  our_time_now = (now.tv_sec - reader->start.tv_sec) * 1000000 +
+                 (now.tv_usec - reader->start.tv_usec);
 
   if (global_perturb_range) {
     // Add a (positive or negative) delta to that so that our
@@ -1923,26 +3183,32 @@ int write_from_circular(SOCKET output, circular_buffer_p circular, int quiet,
 
   // Check whether we've asked for a reset, or if the parent process
   // has told us that the timeline has changed radically
-  if (reset || circular->item[circular->start].discontinuity) {
+  if (reader->reset || circular->item[circular->start].discontinuity) {
     //    fprint_msg("%s: Discontinuity[%d]: reset=%d, pkt_time=%u\n", __func__,
     //    circular->start, reset, this_packet_time);
 
     // We believe out timeline has gone askew - start a new one
     // Set up "now" as our base time, and output our packet right away
-    start = now;
+    reader->start = now;
+#if defined(__linux__)
+    if (circular->txtime_clock != -1)
+      reader->txtime_start = txtime_now(circular);
+#endif
     our_time_now = 0;
-    delta_start = this_packet_time;
+    reader->delta_start = this_packet_time;
     waitfor = 0;
     if (global_child_debug)
       fprint_msg("<-- packet %6u, gap %6u; STARTING delta %6d ",
-                 this_packet_time, packet_time_gap, delta_start);
-    reset = false;
+                 this_packet_time, packet_time_gap, reader->delta_start);
+    reader->reset = false;
   } else {
     // We can try to relate that to the parent's timeline
-    adjusted_now = our_time_now + delta_start;
+    adjusted_now = our_time_now + reader->delta_start;
 
     // So how long do we (notionally) need to wait for the right time?
     waitfor = this_packet_time - adjusted_now;
+    if (waitfor < -LATE_ITEM_THRESHOLD)
+      add_circular_stat(&circular->stats->late_items, 1);
 
     if (global_child_debug)
       fprint_msg("<-- packet %6u, gap %6u; our time %6u = %6u -> wait %6d ",
@@ -1954,7 +3220,8 @@ int write_from_circular(SOCKET output, circular_buffer_p circular, int quiet,
   if (waitfor > 0) {
     if (waitfor > 200000) {
       fprint_msg("###[%d] (%d) >0.2s, RESET\n", circular->start, waitfor);
-      reset = true;
+      add_circular_stat(&circular->stats->resets, 1);
+      reader->reset = true;
       waitfor = 200000;
     }
     if (global_child_debug)
@@ -1988,7 +3255,8 @@ int write_from_circular(SOCKET output, circular_buffer_p circular, int quiet,
                      circular->maxnowait);
       }
       // Ask for a reset, and output the packet right away
-      reset = true;
+      add_circular_stat(&circular->stats->resets, 1);
+      reader->reset = true;
       waitfor = 0;
     }
   }
@@ -1996,13 +3264,13 @@ int write_from_circular(SOCKET output, circular_buffer_p circular, int quiet,
   // We are not allowed to send more than three consecutive packets
   // with no delay (or we might swamp the receiving hardware)
   if (waitfor == 0 && circular->maxnowait != -1) {
-    if (sent_without_delay < circular->maxnowait) {
-      sent_without_delay++;
+    if (reader->sent_without_delay < circular->maxnowait) {
+      reader->sent_without_delay++;
       if (global_child_debug)
-        fprint_msg(", %d)\n", sent_without_delay);
+        fprint_msg(", %d)\n", reader->sent_without_delay);
     } else {
       if (global_child_debug)
-        fprint_msg(", %d -> wait)\n", sent_without_delay + 1);
+        fprint_msg(", %d -> wait)\n", reader->sent_without_delay + 1);
       waitfor = circular->waitfor; // enforce a minimal wait
     }
   } else if (global_child_debug)
@@ -2011,16 +3279,43 @@ int write_from_circular(SOCKET output, circular_buffer_p circular, int quiet,
   // So, finally, do we need to wait before writing?
   if (waitfor > 0) {
     wait_microseconds(waitfor);
-    sent_without_delay = 0;
+    reader->sent_without_delay = 0;
   }
 
-  // Write it...
-  err = write_circular_data(output, circular);
+  if (circular->show_jitter) {
+    gettimeofday(&now, nullptr);
+    our_time_now = (now.tv_sec - reader->start.tv_sec) * 1000000 +
+                   (now.tv_usec - reader->start.tv_usec);
+    record_jitter(&reader->jitter,
+                  (int64_t)(int32_t)(our_time_now + reader->delta_start -
+                                     this_packet_time) *
+                      1000);
+  }
+
+  // Write it (along with any following items that are also due, if we're
+  // allowed to batch them up)...
+  num_items = due_circular_items(circular, reader);
+  note_items_sent(circular, num_items);
+  if (tswriter->how == TS_W_FANOUT || num_items > 1 ||
+      circular->txtime_clock != -1) {
+    this_packet_time =
+        circular->item[(circular->start + num_items - 1) % circular->size]
+            .time;
+    if (circular->maxnowait != -1)
+      reader->sent_without_delay += num_items - 1;
+    reader->count += num_items - 1;
+    if (tswriter->how == TS_W_FANOUT)
+      err = write_circular_to_dests(tswriter, circular, reader, num_items);
+    else
+      err = write_circular_batch(tswriter->where.socket, circular, reader,
+                                 num_items);
+  } else
+    err = write_circular_data(tswriter->where.socket, circular);
   if (err)
     return 1;
 
   // Don't forget to update our memory before we finish
-  last_packet_time = this_packet_time;
+  reader->last_packet_time = this_packet_time;
   return 0;
 }
 
@@ -2047,28 +3342,62 @@ int write_from_circular(SOCKET output, circular_buffer_p circular, int quiet,
  * (0 for success, 1 for failure).
  */
 int tswrite_child_process(TS_writer_p tswriter) {
+  circular_buffer_p circular = tswriter->writer->buffer;
+  uint64_t interval = (uint64_t)max(circular->stats_interval, 0) * 1000000000;
+  uint64_t next_stats = monotonic_now() + interval;
   int had_eof = false;
   for (;;) {
-    int err =
-        write_from_circular(tswriter->where.socket, tswriter->writer->buffer,
-                            tswriter->quiet, &had_eof);
+    int err = write_from_circular(tswriter, circular, &tswriter->writer->reader,
+                                  tswriter->quiet, &had_eof);
     if (err)
       return 1;
     if (had_eof)
       break;
+    if (circular->stats_interval > 0 && monotonic_now() >= next_stats) {
+      print_circular_stats(circular, false);
+      next_stats += interval;
+    }
   }
+  if (circular->show_jitter)
+    report_jitter(&tswriter->writer->reader.jitter, circular->precise);
+  if (tswriter->how == TS_W_FANOUT)
+    return finish_dests(tswriter);
   return 0;
 }
 // ============================================================
-// Unix forking ("thread" alternative)
+// Unix forking, or the thread alternative
 // ============================================================
 /*
- * Start up the child fork, to handle the circular buffering
+ * The body of the child thread, if we're using one
+ */
+static void *tswrite_child_thread(void *arg) {
+  return (void *)(intptr_t)tswrite_child_process((TS_writer_p)arg);
+}
+
+/*
+ * Start up the child fork (or thread), to handle the circular buffering
+ *
+ * A thread shares our address space, so the circular buffer and the
+ * socket are used in place, exactly as a forked child would, but it saves
+ * the cost of a new process, and allows more than one buffered writer to
+ * be run by the same program.
  */
 int start_child(TS_writer_p tswriter) {
   pid_t pid;
 
   tswriter->child = 0;
+  tswriter->have_thread = false;
+
+  if (tswriter->use_thread) {
+    int err = pthread_create(&tswriter->thread, nullptr, tswrite_child_thread,
+                             tswriter);
+    if (err) {
+      fprint_err("### Error starting output thread: %s\n", strerror(err));
+      return 1;
+    }
+    tswriter->have_thread = true;
+    return 0;
+  }
 
   pid = fork();
   if (pid == -1) {
@@ -2085,11 +3414,26 @@ int start_child(TS_writer_p tswriter) {
 }
 
 /*
- * Wait for the child fork to exit
+ * Wait for the child fork (or thread) to exit
  */
 int wait_for_child_to_exit(TS_writer_p tswriter, int quiet) {
   int err;
   pid_t result;
+  if (tswriter->have_thread) {
+    void *status;
+    if (!quiet)
+      print_msg("Waiting for output thread to finish writing and exit\n");
+    err = pthread_join(tswriter->thread, &status);
+    tswriter->have_thread = false;
+    if (err) {
+      fprint_err("### Error waiting for output thread to exit: %s\n",
+                 strerror(err));
+      return 1;
+    }
+    if (!quiet && status == nullptr)
+      print_msg("Output thread exited normally\n");
+    return 0;
+  }
   if (!quiet)
     print_msg("Waiting for child to finish writing and exit\n");
   result = waitpid(tswriter->child, &err, 0);
@@ -2124,6 +3468,18 @@ int tswrite_build(TS_WRITER_TYPE how, int quiet, TS_writer_p *tswriter) {
   new2->how = how;
   new2->writer = nullptr;
   new2->child = 0;
+  new2->use_thread = false;
+  new2->have_thread = false;
+  new2->batch_size = 1;
+  new2->batch_slot = 0;
+  new2->txtime_clock = -1;
+  new2->txtime_ahead = DEFAULT_TXTIME_AHEAD;
+  new2->max_pacing = 0;
+  new2->precise = false;
+  new2->spin_tail = -1;
+  new2->show_jitter = false;
+  new2->stats_interval = -1;
+  new2->stats_file = nullptr;
   new2->count = 0;
   new2->quiet = quiet;
   new2->server = false;          // not being a server
@@ -2132,6 +3488,12 @@ int tswrite_build(TS_WRITER_TYPE how, int quiet, TS_writer_p *tswriter) {
   new2->command_changed = false; // no new command
   new2->atomic_command = false;  // but any command is interruptable
   new2->drop_packets = 0;
+  new2->file_buf = nullptr;
+  new2->file_buf_size = 0;
+  new2->file_buf_used = 0;
+  new2->direct_io = false;
+  new2->dests = nullptr;
+  new2->num_dests = 0;
   *tswriter = new2;
   return 0;
 }
@@ -2184,6 +3546,8 @@ int tswrite_open(TS_WRITER_TYPE how, char *name, char *multicast_if, int port,
     if (!quiet)
       print_msg("Writing to <stdout>\n");
     new2->where.file = stdout;
+    if (build_file_buffer(new2))
+      return 1;
     break;
   case TS_W_FILE:
     if (!quiet)
@@ -2194,6 +3558,8 @@ int tswrite_open(TS_WRITER_TYPE how, char *name, char *multicast_if, int port,
                  strerror(errno));
       return 1;
     }
+    if (build_file_buffer(new2))
+      return 1;
     break;
   case TS_W_TCP:
     if (!quiet)
@@ -2279,6 +3645,238 @@ int tswrite_open_file(char *name, int quiet, TS_writer_p *tswriter) {
                       nullptr, 0, quiet, tswriter);
 }
 
+/*
+ * Ask for a TS writer that is writing to a file to use O_DIRECT - i.e., to
+ * write straight to the disk, bypassing the page cache. This can help when
+ * writing large files, and must be called before anything is written.
+ *
+ * Not all file systems support this (tmpfs, for instance, does not).
+ *
+ * Returns 0 if O_DIRECT is now in use, 1 if it is not (in which case a
+ * warning will have been output, but writing will still work as normal).
+ */
+int tswrite_use_direct_io(TS_writer_p tswriter) {
+  if (tswriter->how != TS_W_FILE || tswriter->file_buf == nullptr) {
+    print_err("!!! O_DIRECT output is only supported when writing to a"
+              " file\n");
+    return 1;
+  }
+  if (set_direct_io(fileno(tswriter->where.file), true)) {
+    fprint_err("!!! Unable to use O_DIRECT for output: %s\n",
+               strerror(errno));
+    return 1;
+  }
+  tswriter->direct_io = true;
+  return 0;
+}
+
+/*
+ * Add a TS writer to the list of destinations of a fan-out TS writer
+ *
+ * Returns 0 if all went well, 1 if something went wrong.
+ */
+static int append_dest(TS_writer_p tswriter, TS_writer_p output,
+                       TS_WRITER_POLICY policy) {
+  struct TS_writer_dest *dest;
+  struct TS_writer_dest *tmp;
+  if (tswriter->num_dests == TSWRITE_MAX_DESTS) {
+    fprint_err("### No more than %d output destinations are allowed\n",
+               TSWRITE_MAX_DESTS);
+    return 1;
+  }
+  tmp = (struct TS_writer_dest *)realloc(
+      tswriter->dests,
+      (tswriter->num_dests + 1) * sizeof(struct TS_writer_dest));
+  if (tmp == nullptr) {
+    print_err("### Unable to extend list of output destinations\n");
+    return 1;
+  }
+  tswriter->dests = tmp;
+  dest = &tswriter->dests[tswriter->num_dests++];
+  dest->tswriter = output;
+  dest->policy = policy;
+  dest->failed = false;
+  dest->dropped = 0;
+  dest->pending = nullptr;
+  dest->pending_len = 0;
+  dest->pending_size = 0;
+  return 0;
+}
+
+/*
+ * Add another destination to a TS writer, so that everything written
+ * through it goes to each of its destinations. This turns it into a
+ * TS_W_FANOUT writer, whose first destination is whatever it was
+ * originally opened to write to.
+ *
+ * Fan-out writers may be buffered (with `tswrite_start_buffering`), in
+ * which case each circular buffer item is written to every destination
+ * in turn, by the one child. Destinations that use TS_W_POLICY_DROP are
+ * written to without waiting, so that a slow client just loses data
+ * (which is reported at the end), rather than holding up everyone else.
+ *
+ * This must be called before any output is written, or buffering is
+ * started. Fan-out is not supported for command input, or by
+ * `tswrite_wait_for_client`.
+ *
+ * - `tswriter` is the TS output context returned by `tswrite_open`
+ * - `how`, `name`, `multicast_if` and `port` are as for `tswrite_open`
+ * - `policy` says what to do if the destination cannot keep up
+ * - `quiet` is true if only error messages should be printed
+ *
+ * Returns 0 if all goes well, 1 if something went wrong.
+ */
+int tswrite_add_destination(TS_writer_p tswriter, TS_WRITER_TYPE how,
+                            char *name, char *multicast_if, int port,
+                            TS_WRITER_POLICY policy, int quiet) {
+  TS_writer_p output;
+  int err;
+
+  if (tswriter->writer != nullptr || tswriter->count != 0) {
+    print_err("### Output destinations must be added before any output is"
+              " written\n");
+    return 1;
+  }
+  if (tswriter->command_socket != -1 || tswriter->server) {
+    print_err("### Cannot add output destinations to an output that is"
+              " taking commands\n");
+    return 1;
+  }
+
+  if (tswriter->how != TS_W_FANOUT) {
+    // Move our original output to be the first destination
+    TS_writer_p first;
+    err = tswrite_build(tswriter->how, tswriter->quiet, &first);
+    if (err)
+      return 1;
+    first->where = tswriter->where;
+    first->file_buf = tswriter->file_buf;
+    first->file_buf_size = tswriter->file_buf_size;
+    first->file_buf_used = tswriter->file_buf_used;
+    first->direct_io = tswriter->direct_io;
+    err = append_dest(tswriter, first, TS_W_POLICY_DEFAULT);
+    if (err) {
+      free(first);
+      return 1;
+    }
+    tswriter->how = TS_W_FANOUT;
+    tswriter->file_buf = nullptr;
+    tswriter->file_buf_size = 0;
+    tswriter->file_buf_used = 0;
+    tswriter->direct_io = false;
+  }
+
+  err = tswrite_open(how, name, multicast_if, port, quiet, &output);
+  if (err)
+    return 1;
+  err = append_dest(tswriter, output, policy);
+  if (err) {
+    (void)tswrite_close(output, true);
+    return 1;
+  }
+  return 0;
+}
+
+/*
+ * Add another destination to a TS writer, as described by a string (as
+ * given by the user, typically to a ``-dest`` switch).
+ *
+ * `spec` is one of:
+ *
+ * - ``udp:<host>[:<port>]`` for UDP output
+ * - ``tcp:<host>[:<port>]`` for TCP/IP output
+ * - ``file:<filename>`` for output to a file
+ * - ``stdout`` for output to standard output
+ *
+ * optionally followed by ``,drop`` or ``,block`` to choose the policy for
+ * what happens if it cannot keep up (see `tswrite_add_destination`).
+ * The default port is 88, and `multicast_if` is used for UDP output.
+ *
+ * Returns 0 if all goes well, 1 if something went wrong.
+ */
+int tswrite_add_destination_spec(TS_writer_p tswriter, const char *spec,
+                                 char *multicast_if, int quiet) {
+  TS_WRITER_POLICY policy = TS_W_POLICY_DEFAULT;
+  TS_WRITER_TYPE how;
+  char *name = nullptr;
+  int port = 88;
+  int err;
+  char *copy = strdup(spec);
+  char *comma;
+
+  if (copy == nullptr) {
+    print_err("### Unable to copy output destination\n");
+    return 1;
+  }
+
+  comma = strrchr(copy, ',');
+  if (comma != nullptr) {
+    if (!strcmp(comma, ",drop"))
+      policy = TS_W_POLICY_DROP;
+    else if (!strcmp(comma, ",block"))
+      policy = TS_W_POLICY_BLOCK;
+    else {
+      fprint_err("### Unrecognised policy '%s' in output destination '%s'"
+                 " (expecting ',drop' or ',block')\n",
+                 comma + 1, spec);
+      free(copy);
+      return 1;
+    }
+    *comma = '\0';
+  }
+
+  if (!strcmp(copy, "stdout"))
+    how = TS_W_STDOUT;
+  else if (!strncmp(copy, "file:", 5) && copy[5] != '\0') {
+    how = TS_W_FILE;
+    name = copy + 5;
+  } else if (!strncmp(copy, "udp:", 4) || !strncmp(copy, "tcp:", 4)) {
+    how = (copy[0] == 'u' ? TS_W_UDP : TS_W_TCP);
+    err = host_value(nullptr, nullptr, copy + 4, &name, &port);
+    if (err) {
+      free(copy);
+      return 1;
+    }
+  } else {
+    fprint_err("### Unrecognised output destination '%s' (expecting"
+               " udp:<host>[:<port>], tcp:<host>[:<port>], file:<name>"
+               " or stdout)\n",
+               spec);
+    free(copy);
+    return 1;
+  }
+
+  err = tswrite_add_destination(tswriter, how, name, multicast_if, port,
+                                policy, quiet);
+  free(copy);
+  return err;
+}
+
+/*
+ * Is this output destination description (as given to a ``-dest`` switch)
+ * for standard output?
+ *
+ * If it is, the caller will want to make sure nothing else gets written to
+ * standard output, just as for ``-stdout``.
+ */
+int tswrite_dest_spec_is_stdout(const char *spec) {
+  return !strncmp(spec, "stdout", 6) && (spec[6] == '\0' || spec[6] == ',');
+}
+
+/*
+ * Does this TS writer need buffered output (i.e., does it write to UDP,
+ * either directly or as one of its fan-out destinations)?
+ */
+int tswrite_needs_buffering(TS_writer_p tswriter) {
+  int ii;
+  if (tswriter->how == TS_W_UDP)
+    return true;
+  for (ii = 0; ii < tswriter->num_dests; ii++)
+    if (tswriter->dests[ii].tswriter->how == TS_W_UDP)
+      return true;
+  return false;
+}
+
 /*
  * Wait for a client to connect and then both write TS data to it and
  * listen for command from it. Uses TCP/IP.
@@ -2316,9 +3914,78 @@ int tswrite_wait_for_client(int server_socket, int quiet,
   return 0;
 }
 
+#if defined(__linux__)
+/*
+ * Ask the kernel to pace output on `socket`, as requested for `tswriter`
+ *
+ * Returns 0 if all went well, 1 if something went wrong.
+ */
+static int pace_socket(TS_writer_p tswriter, SOCKET socket) {
+  if (tswriter->max_pacing) {
+    unsigned int rate = tswriter->max_pacing;
+    int err = setsockopt(socket, SOL_SOCKET, SO_MAX_PACING_RATE, &rate,
+                         sizeof(rate));
+    if (err) {
+      fprint_err("### Error setting maximum pacing rate for output: %s\n",
+                 strerror(errno));
+      return 1;
+    }
+  }
+  if (tswriter->txtime_clock != -1) {
+    struct sock_txtime txtime;
+    int err;
+    txtime.clockid = tswriter->txtime_clock;
+    txtime.flags = 0;
+    err = setsockopt(socket, SOL_SOCKET, SO_TXTIME, &txtime, sizeof(txtime));
+    if (err) {
+      fprint_err("### Error enabling SO_TXTIME for output: %s\n",
+                 strerror(errno));
+      return 1;
+    }
+  }
+  return 0;
+}
+#endif
+
+/*
+ * Ask the kernel to help with pacing our output, if the user asked for that
+ * (with `-txtime` or `-maxpacing`). For a fan-out writer, this applies to
+ * each of its UDP destinations.
+ *
+ * Returns 0 if all went well, 1 if something went wrong.
+ */
+static int start_kernel_pacing(TS_writer_p tswriter) {
+  if (tswriter->txtime_clock == -1 && tswriter->max_pacing == 0)
+    return 0;
+#if defined(__linux__)
+  if (tswriter->how == TS_W_FANOUT) {
+    int ii;
+    for (ii = 0; ii < tswriter->num_dests; ii++) {
+      TS_writer_p output = tswriter->dests[ii].tswriter;
+      if (output->how == TS_W_UDP &&
+          pace_socket(tswriter, output->where.socket))
+        return 1;
+    }
+  } else if (pace_socket(tswriter, tswriter->where.socket))
+    return 1;
+
+  if (tswriter->txtime_clock != -1) {
+    circular_buffer_p circular = tswriter->writer->buffer;
+    circular->txtime_clock = tswriter->txtime_clock;
+    circular->txtime_ahead = tswriter->txtime_ahead;
+  }
+  return 0;
+#else
+  print_err("### Kernel pacing (-txtime, -maxpacing) is only supported on"
+            " Linux\n");
+  return 1;
+#endif
+}
+
 /*
  * Set up internal buffering for TS output. This is necessary for UDP
- * output, and not allowed for other forms of output.
+ * output, and not allowed for other forms of output (except for fan-out
+ * output, which may write to any mixture of destinations).
  *
  * 1. Builds the internal circular buffer and other datastructures
  * 2. Starts a child process to read from the circular buffer and send
@@ -2356,22 +4023,51 @@ int tswrite_start_buffering(TS_writer_p tswriter, int circ_buf_size,
                             int prime_size, int prime_speedup, double pcr_scale,
                             const tswrite_pkt_hdr_type_t hdr_type) {
   int err;
+  int ii;
 
-  if (tswriter->how != TS_W_UDP) {
+  if (tswriter->how != TS_W_UDP && tswriter->how != TS_W_FANOUT) {
     fprint_err("### Buffered output not supported for %s output\n",
-               (tswriter->how == TS_W_TCP      ? "TCP/IP"
-                : tswriter->how == TS_W_FILE   ? "file"
-                : tswriter->how == TS_W_STDOUT ? "<standard output>"
-                                               : "???"));
+               writer_type_name(tswriter->how));
     return 1;
   }
 
+  // Now that output is being paced, a slow TCP/IP destination must not be
+  // allowed to hold up the others
+  for (ii = 0; ii < tswriter->num_dests; ii++) {
+    struct TS_writer_dest *dest = &tswriter->dests[ii];
+    if (dest->policy == TS_W_POLICY_DEFAULT)
+      dest->policy = (dest->tswriter->how == TS_W_TCP ? TS_W_POLICY_DROP
+                                                      : TS_W_POLICY_BLOCK);
+  }
+
   err = build_buffered_TS_output(
       &(tswriter->writer), circ_buf_size, TS_in_packet, maxnowait, waitfor,
       byterate, pcr_mode, prime_size, prime_speedup, pcr_scale, hdr_type);
   if (err)
     return 1;
 
+  tswriter->writer->buffer->batch_size = tswriter->batch_size;
+  tswriter->writer->buffer->batch_slot = tswriter->batch_slot;
+  tswriter->writer->buffer->precise = tswriter->precise;
+  tswriter->writer->buffer->spin_tail =
+      (tswriter->spin_tail < 0 ? -1 : tswriter->spin_tail * 1000);
+  tswriter->writer->buffer->show_jitter = tswriter->show_jitter;
+  tswriter->writer->buffer->stats_interval = tswriter->stats_interval;
+
+  if (tswriter->stats_file != nullptr) {
+    err = map_circular_stats(tswriter->writer->buffer, tswriter->stats_file);
+    if (err) {
+      (void)free_buffered_TS_output(&tswriter->writer);
+      return 1;
+    }
+  }
+
+  err = start_kernel_pacing(tswriter);
+  if (err) {
+    (void)free_buffered_TS_output(&tswriter->writer);
+    return 1;
+  }
+
   err = start_child(tswriter);
   if (err) {
     (void)free_buffered_TS_output(&tswriter->writer);
@@ -2394,6 +4090,17 @@ int tswrite_start_buffering(TS_writer_p tswriter, int circ_buf_size,
  */
 int tswrite_start_buffering_from_context(TS_writer_p tswriter,
                                          TS_context_p context) {
+  tswriter->use_thread = context->use_thread;
+  tswriter->batch_size = context->batch_size;
+  tswriter->batch_slot = context->batch_slot;
+  tswriter->txtime_clock = context->txtime_clock;
+  tswriter->txtime_ahead = context->txtime_ahead;
+  tswriter->max_pacing = context->max_pacing;
+  tswriter->precise = context->precise;
+  tswriter->spin_tail = context->spin_tail;
+  tswriter->show_jitter = context->show_jitter;
+  tswriter->stats_interval = context->stats_interval;
+  tswriter->stats_file = context->stats_file;
   return tswrite_start_buffering(
       tswriter, context->circ_buf_size, context->TS_in_item, context->maxnowait,
       context->waitfor, context->byterate, context->pcr_mode,
@@ -2401,6 +4108,18 @@ int tswrite_start_buffering_from_context(TS_writer_p tswriter,
       context->pkt_hdr_type);
 }
 
+/*
+ * Choose whether buffered output (as started by `tswrite_start_buffering`)
+ * is written out by a thread within this process, or (the default) by a
+ * forked child process.
+ *
+ * Using threads allows a program to run more than one buffered writer at
+ * the same time. This must be called before buffering is started.
+ */
+void tswrite_use_thread(TS_writer_p tswriter, int use_thread) {
+  tswriter->use_thread = use_thread;
+}
+
 /*
  * Indicate to a TS output context that `input` is to be used as
  * command input.
@@ -2491,6 +4210,18 @@ int tswrite_command_changed(TS_writer_p tswriter) {
   }
 }
 
+/*
+ * Report on how buffered output has gone (so far)
+ *
+ * Returns 0 if all goes well, 1 if output is not buffered.
+ */
+int tswrite_report_stats(TS_writer_p tswriter) {
+  if (tswriter->writer == nullptr)
+    return 1;
+  print_circular_stats(tswriter->writer->buffer, true);
+  return 0;
+}
+
 /*
  * Finish off buffered output, and wait for the child to exit
  *
@@ -2505,7 +4236,7 @@ int tswrite_close_child(TS_writer_p tswriter, int quiet) {
   if (tswriter->writer == nullptr)
     return 0;
 
-  if (tswriter->child == 0)
+  if (tswriter->child == 0 && !tswriter->have_thread)
     return 0;
 
   if (tswriter->writer) {
@@ -2519,9 +4250,11 @@ int tswrite_close_child(TS_writer_p tswriter, int quiet) {
     }
   }
 
-  // On Linux/BSD, we have forked, and thus it is reasonable for the parent
-  // process to tidy up when it has finished (since the child process is in
-  // separate memory space). On Windows, this has to be done by the "child".
+  // On Linux/BSD, we have forked (or started a thread), and thus it is
+  // reasonable for the parent process to tidy up when it has finished
+  // (since the child process is in separate memory space, or the thread
+  // will be finished with the buffer by then). On Windows, this has to be
+  // done by the "child".
 
   // So wait for the child to complete
   err = wait_for_child_to_exit(tswriter, quiet);
@@ -2530,6 +4263,9 @@ int tswrite_close_child(TS_writer_p tswriter, int quiet) {
     return 1;
   }
 
+  if (tswriter->stats_interval >= 0)
+    (void)tswrite_report_stats(tswriter);
+
   if (tswriter->writer) {
     // And free the shared memory resources
     err = free_buffered_TS_output(&(tswriter->writer));
@@ -2551,6 +4287,36 @@ int tswrite_close_child(TS_writer_p tswriter, int quiet) {
 int tswrite_close_file(TS_writer_p tswriter) {
   int err;
 
+  if (tswriter->how == TS_W_FANOUT) {
+    // If output was buffered, the child will already have done this
+    int ii;
+    int result = finish_dests(tswriter);
+    for (ii = 0; ii < tswriter->num_dests; ii++) {
+      struct TS_writer_dest *dest = &tswriter->dests[ii];
+      err = tswrite_close_file(dest->tswriter);
+      if (err)
+        result = 1;
+      free(dest->tswriter);
+      free(dest->pending);
+    }
+    free(tswriter->dests);
+    tswriter->dests = nullptr;
+    tswriter->num_dests = 0;
+    return result;
+  }
+
+  if (tswriter->file_buf != nullptr) {
+    err = flush_file_data(tswriter);
+    free(tswriter->file_buf);
+    tswriter->file_buf = nullptr;
+    if (err) {
+      print_err("### Error writing out the end of the output\n");
+      if (tswriter->how == TS_W_FILE)
+        (void)fclose(tswriter->where.file);
+      return 1;
+    }
+  }
+
   switch (tswriter->how) {
   case TS_W_STDOUT:
     // Nothing to do for standard output
@@ -2686,6 +4452,11 @@ int tswrite_write(TS_writer_p tswriter, byte packet[TS_PACKET_SIZE],
       if (err)
         return 1;
       break;
+    case TS_W_FANOUT:
+      err = write_to_dests(tswriter, packet, TS_PACKET_SIZE);
+      if (err)
+        return 1;
+      break;
     default:
       fprint_err("### Unexpected writer type %d to tswrite_write()\n",
                  tswriter->how);
@@ -2702,6 +4473,58 @@ int tswrite_write(TS_writer_p tswriter, byte packet[TS_PACKET_SIZE],
   return 0;
 }
 
+/*
+ * Write a Transport Stream packet, given in (up to) three parts, out via
+ * the TS writer.
+ *
+ * - `tswriter` is the TS output context returned by `tswrite_open`
+ * - `TS_packet` is a TS packet buffer, the first `TS_hdr_len` bytes of
+ *   which are the TS header. The rest of it may be used as scratch space.
+ * - `pes_hdr` is `pes_hdr_len` bytes of PES header (`pes_hdr_len` may be 0)
+ * - `data` is `data_len` bytes of payload (`data_len` may be 0)
+ * - `pid`, `got_pcr` and `pcr` are as for `tswrite_write`
+ *
+ * The three lengths must add up to TS_PACKET_SIZE.
+ *
+ * When writing to a file, the parts are copied straight into the output
+ * buffer. Otherwise, they are assembled in `TS_packet`, which is then
+ * written with `tswrite_write`.
+ *
+ * Returns 0 if all goes well, 1 if something went wrong, and EOF if command
+ * input is enabled (only allowed for TCP/IP output) and the ``q`` command
+ * character has been received.
+ */
+int tswrite_write_parts(TS_writer_p tswriter, byte TS_packet[TS_PACKET_SIZE],
+                        int TS_hdr_len, byte pes_hdr[], int pes_hdr_len,
+                        byte data[], int data_len, uint32_t pid, int got_pcr,
+                        uint64_t pcr) {
+  if (tswriter->file_buf != nullptr && tswriter->drop_packets == 0) {
+    byte *dest;
+    if (tswriter->file_buf_used + TS_PACKET_SIZE > tswriter->file_buf_size) {
+      int err = flush_file_data(tswriter);
+      if (err)
+        return 1;
+    }
+    dest = tswriter->file_buf + tswriter->file_buf_used;
+    memcpy(dest, TS_packet, TS_hdr_len);
+    if (pes_hdr_len > 0)
+      memcpy(dest + TS_hdr_len, pes_hdr, pes_hdr_len);
+    if (data_len > 0)
+      memcpy(dest + TS_hdr_len + pes_hdr_len, data, data_len);
+    tswriter->file_buf_used += TS_PACKET_SIZE;
+    (tswriter->count)++;
+    if (tswriter->file_buf_used == tswriter->file_buf_size)
+      return flush_file_data(tswriter);
+    return 0;
+  }
+
+  if (pes_hdr_len > 0)
+    memcpy(&(TS_packet[TS_hdr_len]), pes_hdr, pes_hdr_len);
+  if (data_len > 0)
+    memcpy(&(TS_packet[TS_hdr_len + pes_hdr_len]), data, data_len);
+  return tswrite_write(tswriter, TS_packet, pid, got_pcr, pcr);
+}
+
 /*
  * Discontinuity on the stream being written (e.g. file looping)
  * If we are pacing the output then this resets the timing info
@@ -2776,6 +4599,59 @@ void tswrite_help_tuning(void) {
       "fill\n"
       "up before it starts sending any data.\n"
       "\n"
+      "  -batch <n>        Allow up to <n> circular buffer items to be sent\n"
+      "                    with a single system call, as long as they are\n"
+      "                    all due to be sent. The default is 1 (no "
+      "batching).\n"
+      "  -batchslot <n>    Items due within <n> microseconds of the first\n"
+      "                    are considered due. The default is %d.\n"
+      "\n"
+      "  -txtime mono|tai  Give each item a launch time (SO_TXTIME), on the\n"
+      "                    monotonic clock (for the 'fq' qdisc) or on TAI\n"
+      "                    (for the 'etf' qdisc, which also requires\n"
+      "                    CAP_NET_ADMIN), so that the kernel does the\n"
+      "                    final timing of each packet.\n"
+      "  -txtimeahead <n>  Hand each item to the kernel <n> microseconds\n"
+      "                    before its launch time. The default is %d.\n"
+      "  -maxpacing <n>    Ask the kernel not to send faster than <n>\n"
+      "                    bits/second (SO_MAX_PACING_RATE, needs 'fq').\n"
+      "\n"
+      "For instance, to try this on the loopback interface:\n"
+      "\n"
+      "  tc qdisc replace dev lo root fq\n"
+      "  tsplay <file> 127.0.0.1:8888 -txtime mono\n"
+      "\n"
+      "  -thread           Write the circular buffer out from a thread within\n"
+      "                    this process, rather than from a forked child\n"
+      "                    process.\n"
+      "\n"
+      "  -precise          Send each item at an absolute deadline (on the\n"
+      "                    monotonic clock, in nanoseconds), sleeping until\n"
+      "                    just before it and then spinning. This is more\n"
+      "                    accurate than the normal pacing, and does not\n"
+      "                    use -maxnowait or -waitfor, but keeps a CPU busy\n"
+      "                    for the spin.\n"
+      "  -spin <n>|auto    With -precise, spin for the last <n> microseconds\n"
+      "                    before each deadline. The default, auto, measures\n"
+      "                    how promptly sleeps wake up, and adjusts as it "
+      "goes.\n"
+      "  -jitter           When finished, report a histogram of how late\n"
+      "                    (or early) each item was sent.\n"
+      "\n"
+      "  -stats <n>        Print a line of statistics about buffered output\n"
+      "                    every <n> seconds (if <n> is 0, just at the end),\n"
+      "                    and a summary when finished. This shows how full\n"
+      "                    the circular buffer is (and has been), how often\n"
+      "                    the parent waited for room (stalls) and the child\n"
+      "                    found it empty (underruns), how many items were\n"
+      "                    sent more than %dus late, and how often the\n"
+      "                    timeline was restarted, which may help in choosing\n"
+      "                    -buffer, -maxnowait and -prime.\n"
+      "  -statsfile <file> Keep those statistics in <file>, mapped into\n"
+      "                    memory, so that other programs can watch them.\n"
+      "                    The layout is `struct circular_stats`, in\n"
+      "                    tswrite.h.\n"
+      "\n"
       "  -prime <n>        Prime the PCR timing mechanism with 'time' for\n"
       "                    <n> circular buffer items. The default is %d\n"
       "  -speedup <n>      Percentage of 'normal speed' to use when\n"
@@ -2822,6 +4698,7 @@ void tswrite_help_tuning(void) {
       "the timing information in the video stream itself).\n"
       "",
       DEFAULT_BYTE_RATE, DEFAULT_BYTE_RATE * 8, DEFAULT_CIRCULAR_BUFFER_SIZE,
+      DEFAULT_BATCH_SLOT, DEFAULT_TXTIME_AHEAD, LATE_ITEM_THRESHOLD,
       DEFAULT_PRIME_SIZE);
 }
 
@@ -2917,6 +4794,41 @@ void tswrite_report_args(TS_context_p context) {
     fprint_msg("Child will wait %dms for buffer to unempty\n",
                global_child_wait);
 
+  if (context->use_thread)
+    print_msg("Writing from a thread, rather than a child process\n");
+
+  if (context->txtime_clock != -1)
+    fprint_msg("Giving each item a %s launch time (SO_TXTIME), %dus"
+               " ahead\n",
+               context->txtime_clock == CLOCK_TAI ? "CLOCK_TAI"
+                                                  : "CLOCK_MONOTONIC",
+               context->txtime_ahead);
+  if (context->max_pacing)
+    fprint_msg("Limiting socket pacing rate to %d bytes/second\n",
+               context->max_pacing);
+
+  if (context->batch_size > 1)
+    fprint_msg("Sending up to %d items at once, if due within %dus\n",
+               context->batch_size, context->batch_slot);
+
+  if (context->precise) {
+    if (context->spin_tail < 0)
+      print_msg("Pacing to absolute deadlines, with a calibrated spin\n");
+    else
+      fprint_msg("Pacing to absolute deadlines, spinning for the last %dus\n",
+                 context->spin_tail);
+  }
+  if (context->show_jitter)
+    print_msg("Reporting on send time jitter when finished\n");
+  if (context->stats_interval > 0)
+    fprint_msg("Reporting buffered output statistics every %ds\n",
+               context->stats_interval);
+  else if (context->stats_interval == 0)
+    print_msg("Reporting buffered output statistics when finished\n");
+  if (context->stats_file != nullptr)
+    fprint_msg("Keeping buffered output statistics in %s\n",
+               context->stats_file);
+
   if (global_perturb_range) {
     fprint_msg("Randomly perturbing child time by -%u..%ums"
                " with seed %u\n",
@@ -2964,6 +4876,17 @@ int tswrite_process_args(char *prefix, int argc, char *argv[],
   context->prime_speedup = 100;
   context->pcr_scale = 1.0;
   context->pkt_hdr_type = PKT_HDR_TYPE_NONE;
+  context->use_thread = false;
+  context->batch_size = 1;
+  context->batch_slot = DEFAULT_BATCH_SLOT;
+  context->txtime_clock = -1;
+  context->txtime_ahead = DEFAULT_TXTIME_AHEAD;
+  context->max_pacing = 0;
+  context->precise = false;
+  context->spin_tail = -1;
+  context->show_jitter = false;
+  context->stats_interval = -1;
+  context->stats_file = nullptr;
 
   while (ii < argc) {
     if (!strcmp("-nopcrs", argv[ii])) {
@@ -3070,6 +4993,95 @@ int tswrite_process_args(char *prefix, int argc, char *argv[],
       }
       argv[ii] = argv[ii + 1] = TSWRITE_PROCESSED;
       ii++;
+    } else if (!strcmp("-batch", argv[ii])) {
+      CHECKARG(prefix, ii);
+      err = int_value(prefix, argv[ii], argv[ii + 1], true, 10,
+                      &context->batch_size);
+      if (err)
+        return 1;
+      if (context->batch_size < 1) {
+        fprint_err("### %s: -batch 0 does not make sense\n", prefix);
+        return 1;
+      } else if (context->batch_size > MAX_ITEMS_IN_BATCH) {
+        fprint_err("### %s: -batch %d is too many (maximum is %d)\n", prefix,
+                   context->batch_size, MAX_ITEMS_IN_BATCH);
+        return 1;
+      }
+      argv[ii] = argv[ii + 1] = TSWRITE_PROCESSED;
+      ii++;
+    } else if (!strcmp("-batchslot", argv[ii])) {
+      CHECKARG(prefix, ii);
+      err = int_value(prefix, argv[ii], argv[ii + 1], true, 10,
+                      &context->batch_slot);
+      if (err)
+        return 1;
+      argv[ii] = argv[ii + 1] = TSWRITE_PROCESSED;
+      ii++;
+    } else if (!strcmp("-txtime", argv[ii])) {
+      CHECKARG(prefix, ii);
+      if (!strcmp(argv[ii + 1], "mono"))
+        context->txtime_clock = CLOCK_MONOTONIC;
+      else if (!strcmp(argv[ii + 1], "tai"))
+        context->txtime_clock = CLOCK_TAI;
+      else {
+        fprint_err("### %s: -txtime must be followed by 'mono' or 'tai',"
+                   " not '%s'\n",
+                   prefix, argv[ii + 1]);
+        return 1;
+      }
+      argv[ii] = argv[ii + 1] = TSWRITE_PROCESSED;
+      ii++;
+    } else if (!strcmp("-txtimeahead", argv[ii])) {
+      CHECKARG(prefix, ii);
+      err = int_value(prefix, argv[ii], argv[ii + 1], true, 10,
+                      &context->txtime_ahead);
+      if (err)
+        return 1;
+      argv[ii] = argv[ii + 1] = TSWRITE_PROCESSED;
+      ii++;
+    } else if (!strcmp("-maxpacing", argv[ii])) {
+      int bitrate;
+      CHECKARG(prefix, ii);
+      err = int_value(prefix, argv[ii], argv[ii + 1], true, 10, &bitrate);
+      if (err)
+        return 1;
+      context->max_pacing = bitrate / 8;
+      argv[ii] = argv[ii + 1] = TSWRITE_PROCESSED;
+      ii++;
+    } else if (!strcmp("-precise", argv[ii])) {
+      context->precise = true;
+      argv[ii] = TSWRITE_PROCESSED;
+    } else if (!strcmp("-spin", argv[ii])) {
+      CHECKARG(prefix, ii);
+      if (!strcmp(argv[ii + 1], "auto"))
+        context->spin_tail = -1;
+      else {
+        err = int_value(prefix, argv[ii], argv[ii + 1], true, 10,
+                        &context->spin_tail);
+        if (err)
+          return 1;
+      }
+      argv[ii] = argv[ii + 1] = TSWRITE_PROCESSED;
+      ii++;
+    } else if (!strcmp("-jitter", argv[ii])) {
+      context->show_jitter = true;
+      argv[ii] = TSWRITE_PROCESSED;
+    } else if (!strcmp("-stats", argv[ii])) {
+      CHECKARG(prefix, ii);
+      err = int_value(prefix, argv[ii], argv[ii + 1], true, 10,
+                      &context->stats_interval);
+      if (err)
+        return 1;
+      argv[ii] = argv[ii + 1] = TSWRITE_PROCESSED;
+      ii++;
+    } else if (!strcmp("-statsfile", argv[ii])) {
+      CHECKARG(prefix, ii);
+      context->stats_file = argv[ii + 1];
+      argv[ii] = argv[ii + 1] = TSWRITE_PROCESSED;
+      ii++;
+    } else if (!strcmp("-thread", argv[ii])) {
+      context->use_thread = true;
+      argv[ii] = TSWRITE_PROCESSED;
     } else if (!strcmp("-rtp", argv[ii])) {
       context->pkt_hdr_type = PKT_HDR_TYPE_RTP;
       argv[ii] = TSWRITE_PROCESSED;
@@ -17,6 +17,7 @@
 #include "ts_defns.h"
 
 typedef int SOCKET;  // for compatibility with Windows
+#include <pthread.h> // for pthread_t
 #include <termios.h> // for struct termios
 
 struct buffered_TS_output;
@@ -36,6 +37,7 @@ enum TS_writer_type {
   TS_W_FILE,   // a file
   TS_W_TCP,    // a socket, over TCP/IP
   TS_W_UDP,    // a socket, over UDP
+  TS_W_FANOUT, // a list of any of the above
 };
 typedef enum TS_writer_type TS_WRITER_TYPE;
 
@@ -46,25 +48,61 @@ union TS_writer_output {
   SOCKET socket;
 };
 
+// ------------------------------------------------------------
+// What a destination of a fan-out writer (see below) should do when it
+// cannot keep up
+enum TS_writer_policy {
+  TS_W_POLICY_DEFAULT, // DROP for buffered TCP/IP output, otherwise BLOCK
+  TS_W_POLICY_BLOCK,   // wait for it, and give up on all output if it fails
+  TS_W_POLICY_DROP,    // drop what it cannot take, stop using it on error
+};
+typedef enum TS_writer_policy TS_WRITER_POLICY;
+
+struct TS_writer;
+
+// The most destinations a fan-out writer may have
+#define TSWRITE_MAX_DESTS 32
+
+// One destination of a fan-out writer
+struct TS_writer_dest {
+  struct TS_writer *tswriter; // an (unbuffered) writer for the destination
+  TS_WRITER_POLICY policy;    // what to do if it can't keep up
+  int failed;                 // true if we've given up on it
+  unsigned int dropped;       // how many bytes we've dropped for it
+  // If a DROP destination takes only part of what we send it, the rest is
+  // kept here, and sent before anything else, so that the receiver never
+  // sees a partial TS packet
+  byte *pending;
+  int pending_len;
+  int pending_size;
+};
+
 // ------------------------------------------------------------
 // A datastructure to allow us to write to various different types of target
 //
 // When writing to a file, "how" will be TS_W_STDOUT or TS_W_FILE, and
 // "where" will be the appropriate file interface. "writer" is not necessary
 // (there's no point in putting a circular buffer and other stuff above
-// the file writes), and no child process is needed.
+// the file writes), and no child process is needed. Instead, TS packets are
+// gathered into "file_buf", and written out (bypassing stdio) when it fills.
 //
 // When writing over UDP, "how" will be TS_W_UDP, and "where" will be the
 // socket that is being written to. For UDP, timing needs to be managed, and
 // thus the circular buffer support is necessary, so "writer" should be
 // set to a buffered output context. Since the circular buffer is being
-// used, there will also be a child process.
+// used, there will also be a child process (or, if `use_thread` was
+// requested, a child thread).
 //
 // When writing over TCP/IP, "how" will be TS_W_TCP, and "where" will be the
 // socket that is being written to. Timing is not an issue, so "writer" will
 // not be needed, and nor will there be a child process.  However, it is
 // possible that we will want to respond to commands (over the same or another
 // socket (or, on Linux/BSD, file descriptor)), so "commander" may be set.
+//
+// When writing to more than one target, "how" will be TS_W_FANOUT, and
+// "dests" will be the list of targets, each with its own (unbuffered)
+// TS_writer. If "writer" is set, the child writes each circular buffer item
+// to every one of the targets in turn, straight from the circular buffer.
 struct TS_writer {
   enum TS_writer_type how;      // what type of output we want
   union TS_writer_output where; // where it's going to
@@ -73,8 +111,25 @@ struct TS_writer {
 
   // Support for the child fork/thread, which actually does the writing when
   // buffered output is enabled.
-  pid_t child; // the PID of the child process (if any)
-  int quiet;   // Should the child be as quiet as possible?
+  pid_t child;      // the PID of the child process (if any)
+  int use_thread;   // use a thread, rather than forking a child process?
+  int have_thread;  // true if `thread` has been started
+  pthread_t thread; // the child thread (if any)
+  int batch_size;   // max circular buffer items per system call
+  int batch_slot;   // and how near to due they must be, in microseconds
+  int txtime_clock; // clock for SO_TXTIME launch times, or -1 for none
+  int txtime_ahead; // how far ahead of launch to send, in microseconds
+  int max_pacing;   // SO_MAX_PACING_RATE in bytes/second, or 0
+  int precise;      // pace to absolute deadlines, sleeping then spinning
+  int spin_tail;    // how long to spin for, in microseconds, or -1 for auto
+  int show_jitter;  // report on send time accuracy when finished
+  int quiet;        // Should the child be as quiet as possible?
+
+  // Statistics for buffered output are printed every `stats_interval`
+  // seconds (or, if it is 0, only when finished, or if -1, not at all), and
+  // kept in the file `stats_file`, if that is not nullptr
+  int stats_interval;
+  const char *stats_file;
 
   // Support for "commands" being sent to us via a socket (or, on Linux/BSD,
   // from any other file descriptor). The "normal" way this is used is for
@@ -100,10 +155,22 @@ struct TS_writer {
   // should interrup them, we can provide a flag to say "don't do that"...
   int atomic_command;
 
+  // When writing to a file (or standard output), TS packets are gathered
+  // in this (page aligned) buffer, and written out with a single write()
+  // each time it fills up.
+  byte *file_buf;
+  int file_buf_size; // in bytes, always a whole number of TS packets
+  int file_buf_used; // how many bytes are waiting to be written
+  int direct_io;     // true if the file is being written with O_DIRECT
+
   // Should some TS packets be thrown away every <n> packets? This can be
   // useful for debugging other applications
   int drop_packets; // 0 to keep all packets, otherwise keep <n> packets
   int drop_number;  // and then drop this many
+
+  // The destinations, if "how" is TS_W_FANOUT
+  struct TS_writer_dest *dests;
+  int num_dests;
 };
 typedef struct TS_writer *TS_writer_p;
 #define SIZEOF_TS_WRITER sizeof(struct TS_writer)
@@ -164,6 +231,19 @@ struct TS_context {
   int prime_speedup;         // percentage of normal speed to prime with
   tswrite_pkt_hdr_type_t pkt_hdr_type;
   double pcr_scale; // multiplier for PCRs -- see buffered_TS_output
+  int use_thread;   // write from a thread rather than a child process
+  int batch_size;   // max circular buffer items per system call
+  int batch_slot;   // microseconds within which items count as due
+  int txtime_clock; // clock for SO_TXTIME launch times, or -1 for none
+  int txtime_ahead; // how far ahead of launch to send, in microseconds
+  int max_pacing;   // SO_MAX_PACING_RATE in bytes/second, or 0
+  int precise;      // pace to absolute deadlines, sleeping then spinning
+  int spin_tail;    // how long to spin for, in microseconds, or -1 for auto
+  int show_jitter;  // report on send time accuracy when finished
+
+  // Statistics for buffered output (as for the `TS_writer`)
+  int stats_interval;
+  const char *stats_file;
 };
 typedef struct TS_context *TS_context_p;
 
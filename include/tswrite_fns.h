@@ -110,6 +110,75 @@ int tswrite_open_connection(int use_tcp, char *name, int port, int quiet,
  * Returns 0 if all goes well, 1 if something went wrong.
  */
 int tswrite_open_file(char *name, int quiet, TS_writer_p *tswriter);
+/*
+ * Ask for a TS writer that is writing to a file to use O_DIRECT - i.e., to
+ * write straight to the disk, bypassing the page cache. This can help when
+ * writing large files, and must be called before anything is written.
+ *
+ * Not all file systems support this (tmpfs, for instance, does not).
+ *
+ * Returns 0 if O_DIRECT is now in use, 1 if it is not (in which case a
+ * warning will have been output, but writing will still work as normal).
+ */
+int tswrite_use_direct_io(TS_writer_p tswriter);
+/*
+ * Add another destination to a TS writer, so that everything written
+ * through it goes to each of its destinations. This turns it into a
+ * TS_W_FANOUT writer, whose first destination is whatever it was
+ * originally opened to write to.
+ *
+ * Fan-out writers may be buffered (with `tswrite_start_buffering`), in
+ * which case each circular buffer item is written to every destination
+ * in turn, by the one child. Destinations that use TS_W_POLICY_DROP are
+ * written to without waiting, so that a slow client just loses data
+ * (which is reported at the end), rather than holding up everyone else.
+ *
+ * This must be called before any output is written, or buffering is
+ * started. Fan-out is not supported for command input, or by
+ * `tswrite_wait_for_client`.
+ *
+ * - `tswriter` is the TS output context returned by `tswrite_open`
+ * - `how`, `name`, `multicast_if` and `port` are as for `tswrite_open`
+ * - `policy` says what to do if the destination cannot keep up
+ * - `quiet` is true if only error messages should be printed
+ *
+ * Returns 0 if all goes well, 1 if something went wrong.
+ */
+int tswrite_add_destination(TS_writer_p tswriter, TS_WRITER_TYPE how,
+                            char *name, char *multicast_if, int port,
+                            TS_WRITER_POLICY policy, int quiet);
+/*
+ * Add another destination to a TS writer, as described by a string (as
+ * given by the user, typically to a ``-dest`` switch).
+ *
+ * `spec` is one of:
+ *
+ * - ``udp:<host>[:<port>]`` for UDP output
+ * - ``tcp:<host>[:<port>]`` for TCP/IP output
+ * - ``file:<filename>`` for output to a file
+ * - ``stdout`` for output to standard output
+ *
+ * optionally followed by ``,drop`` or ``,block`` to choose the policy for
+ * what happens if it cannot keep up (see `tswrite_add_destination`).
+ * The default port is 88, and `multicast_if` is used for UDP output.
+ *
+ * Returns 0 if all goes well, 1 if something went wrong.
+ */
+int tswrite_add_destination_spec(TS_writer_p tswriter, const char *spec,
+                                 char *multicast_if, int quiet);
+/*
+ * Is this output destination description (as given to a ``-dest`` switch)
+ * for standard output?
+ *
+ * If it is, the caller will want to make sure nothing else gets written to
+ * standard output, just as for ``-stdout``.
+ */
+int tswrite_dest_spec_is_stdout(const char *spec);
+/*
+ * Does this TS writer need buffered output (i.e., does it write to UDP,
+ * either directly or as one of its fan-out destinations)?
+ */
+int tswrite_needs_buffering(TS_writer_p tswriter);
 /*
  * Wait for a client to connect and then both write TS data to it and
  * listen for command from it. Uses TCP/IP.
@@ -178,6 +247,27 @@ int tswrite_start_buffering(TS_writer_p tswriter, int circ_buf_size,
  */
 int tswrite_start_buffering_from_context(TS_writer_p tswriter,
                                          TS_context_p context);
+/*
+ * Choose whether buffered output (as started by `tswrite_start_buffering`)
+ * is written out by a thread within this process, or (the default) by a
+ * forked child process.
+ *
+ * Using threads allows a program to run more than one buffered writer at
+ * the same time. This must be called before buffering is started.
+ */
+void tswrite_use_thread(TS_writer_p tswriter, int use_thread);
+/*
+ * Report on how buffered output has gone so far: how many items and bytes
+ * have been sent, how full the circular buffer is (and has been), how
+ * often each side has had to wait for the other, and how many items were
+ * sent late.
+ *
+ * This is done automatically when the writer is closed, if statistics were
+ * asked for (with `-stats`).
+ *
+ * Returns 0 if all goes well, 1 if output is not buffered.
+ */
+int tswrite_report_stats(TS_writer_p tswriter);
 /*
  * Indicate to a TS output context that `input` is to be used as
  * command input.
@@ -268,6 +358,31 @@ int wait_for_command(TS_writer_p tswriter);
  */
 int tswrite_write(TS_writer_p tswriter, byte packet[TS_PACKET_SIZE],
                   uint32_t pid, int got_pcr, uint64_t pcr);
+/*
+ * Write a Transport Stream packet, given in (up to) three parts, out via
+ * the TS writer.
+ *
+ * - `tswriter` is the TS output context returned by `tswrite_open`
+ * - `TS_packet` is a TS packet buffer, the first `TS_hdr_len` bytes of
+ *   which are the TS header. The rest of it may be used as scratch space.
+ * - `pes_hdr` is `pes_hdr_len` bytes of PES header (`pes_hdr_len` may be 0)
+ * - `data` is `data_len` bytes of payload (`data_len` may be 0)
+ * - `pid`, `got_pcr` and `pcr` are as for `tswrite_write`
+ *
+ * The three lengths must add up to TS_PACKET_SIZE.
+ *
+ * When writing to a file, the parts are copied straight into the output
+ * buffer. Otherwise, they are assembled in `TS_packet`, which is then
+ * written with `tswrite_write`.
+ *
+ * Returns 0 if all goes well, 1 if something went wrong, and EOF if command
+ * input is enabled (only allowed for TCP/IP output) and the ``q`` command
+ * character has been received.
+ */
+int tswrite_write_parts(TS_writer_p tswriter, byte TS_packet[TS_PACKET_SIZE],
+                        int TS_hdr_len, byte pes_hdr[], int pes_hdr_len,
+                        byte data[], int data_len, uint32_t pid, int got_pcr,
+                        uint64_t pcr);
 
 int tswrite_discontinuity(const TS_writer_p tswriter);
 
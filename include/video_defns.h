@@ -36,6 +36,7 @@
 #define VIDEO_UNKNOWN 0 // which is a reserved value
 #define VIDEO_H262 MPEG2_VIDEO_STREAM_TYPE
 #define VIDEO_H264 AVC_VIDEO_STREAM_TYPE
+#define VIDEO_H265 H265_VIDEO_STREAM_TYPE
 #define VIDEO_AVS AVS_VIDEO_STREAM_TYPE
 #define VIDEO_MPEG4_PART2 MPEG4_PART2_VIDEO_STREAM_TYPE
 
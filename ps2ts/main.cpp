@@ -82,6 +82,8 @@ static void print_usage() {
       "\n"
       "Input switches:\n"
       "  -stdin            Take input from <stdin>, instead of a named file\n"
+      "  -async            Read the input in a separate thread, so that\n"
+      "                    reading and conversion overlap.\n"
       "  -dvd              The PS data is from a DVD. This is the default.\n"
       "                    This switch has no effect on MPEG-1 PS data.\n"
       "  -notdvd, -nodvd   The PS data is not from a DVD.\n"
@@ -112,6 +114,14 @@ static void print_usage() {
       "                    Writes output (over TCP/IP) to the named <host>,\n"
       "                    instead of to a named file. If <port> is not\n"
       "                    specified, it defaults to 88.\n"
+      "  -direct           Write the output file with O_DIRECT (bypassing\n"
+      "                    the page cache), which may help for large files.\n"
+      "  -dest <dest>      Also write output to <dest>, which may be\n"
+      "                    udp:<host>[:<port>], tcp:<host>[:<port>],\n"
+      "                    file:<name> or stdout. This may be given more\n"
+      "                    than once - the input is still only read once.\n"
+      "                    As with -stdout, -dest stdout forces -quiet and\n"
+      "                    -err stderr.\n"
       "  -vpid <pid>       <pid> is the video PID to use for the data.\n"
       "                    Use '-vpid 0x<pid>' to specify a hex value.\n"
       "                    Defaults to 0x68.\n"
@@ -173,7 +183,12 @@ static void print_usage() {
 int main(int argc, char **argv) {
   int use_stdin = false;
   int use_stdout = false;
+  int use_async = false;
   int use_tcpip = false;
+  int use_direct_io = false;
+  char *dest_specs[TSWRITE_MAX_DESTS]; // any other destinations
+  int num_dest_specs = 0;
+  int dest_stdout = false; // is one of them <stdout>?
   int port = 88; // Useful default port number
   char *input_name = nullptr;
   char *output_name = nullptr;
@@ -242,9 +257,27 @@ int main(int argc, char **argv) {
           return 1;
         }
         ii++;
+      } else if (!strcmp("-direct", argv[ii])) {
+        use_direct_io = true;
+      } else if (!strcmp("-dest", argv[ii])) {
+        CHECKARG("ps2ts", ii);
+        if (num_dest_specs == TSWRITE_MAX_DESTS - 1) {
+          fprint_err("### ps2ts: No more than %d -dest switches are"
+                     " allowed\n",
+                     TSWRITE_MAX_DESTS - 1);
+          return 1;
+        }
+        dest_specs[num_dest_specs++] = argv[ii + 1];
+        if (tswrite_dest_spec_is_stdout(argv[ii + 1])) {
+          dest_stdout = true;
+          redirect_output_stderr();
+        }
+        ii++;
       } else if (!strcmp("-stdin", argv[ii])) {
         had_input_name = true; // more or less
         use_stdin = true;
+      } else if (!strcmp("-async", argv[ii])) {
+        use_async = true;
       } else if (!strcmp("-stdout", argv[ii])) {
         had_output_name = true; // more or less
         use_stdout = true;
@@ -375,7 +408,7 @@ int main(int argc, char **argv) {
   }
 
   // Try to stop extraneous data ending up in our output stream
-  if (use_stdout) {
+  if (use_stdout || dest_stdout) {
     verbose = false;
     quiet = true;
   }
@@ -386,6 +419,8 @@ int main(int argc, char **argv) {
                (use_stdin ? "<stdin>" : input_name));
     return 1;
   }
+  if (use_async && start_PS_read_ahead(ps, ASYNC_READ_BUFFERS))
+    print_err("!!! ps2ts: Unable to read input asynchronously\n");
 
   if (!quiet)
     fprint_msg("Reading from %s\n", (use_stdin ? "<stdin>" : input_name));
@@ -445,6 +480,17 @@ int main(int argc, char **argv) {
     (void)close_PS_file(&ps);
     return 1;
   }
+  if (use_direct_io && !use_stdout && !use_tcpip)
+    (void)tswrite_use_direct_io(output);
+  for (ii = 0; ii < num_dest_specs; ii++) {
+    err = tswrite_add_destination_spec(output, dest_specs[ii], nullptr, quiet);
+    if (err) {
+      fprint_err("### ps2ts: Unable to open %s\n", dest_specs[ii]);
+      (void)close_PS_file(&ps);
+      (void)tswrite_close(output, true);
+      return 1;
+    }
+  }
 
   err = ps_to_ts(ps, output, pad_start, repeat_program_every, video_type,
                  input_is_dvd, video_stream, audio_stream, want_ac3_audio,
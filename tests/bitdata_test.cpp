@@ -0,0 +1,238 @@
+/*
+ * Test reading bits (through the bit cache) against a bit-at-a-time version
+ *
+ */
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "accessunit.h"
+#include "bitdata.h"
+#include "compat.h"
+#include "es.h"
+#include "h222.h"
+#include "h262.h"
+#include "misc.h"
+#include "nalunit.h"
+#include "pes.h"
+#include "pidint.h"
+#include "printing.h"
+#include "ps.h"
+#include "reverse.h"
+#include "ts.h"
+#include "tswrite.h"
+
+#define TEST_DATA_LEN 100
+#define TEST_RUNS 2000
+
+/*
+ * The obvious (and slow) way of reading bits
+ */
+struct reference_bits {
+  const byte *data;
+  int data_len;
+  int posn; // in bits
+};
+
+static int reference_left(struct reference_bits *ref) {
+  return ref->data_len * 8 - ref->posn;
+}
+
+static uint32_t reference_read(struct reference_bits *ref, int count) {
+  uint32_t result = 0;
+  int ii;
+  for (ii = 0; ii < count; ii++, ref->posn++) {
+    int bit = (ref->data[ref->posn / 8] >> (7 - ref->posn % 8)) & 1;
+    result = (result << 1) | bit;
+  }
+  return result;
+}
+
+/*
+ * Count the zero bits before the next one bit, or the end of the data,
+ * without reading them
+ */
+static int reference_zeros(struct reference_bits *ref) {
+  int posn = ref->posn;
+  int count = 0;
+  for (; posn < ref->data_len * 8; posn++, count++) {
+    if ((ref->data[posn / 8] >> (7 - posn % 8)) & 1)
+      break;
+  }
+  return count;
+}
+
+/*
+ * Fill `data` with random bytes, with plenty of zeros so that there are
+ * long Exp-Golomb codes
+ */
+static void make_test_data(byte data[], int data_len) {
+  int ii;
+  for (ii = 0; ii < data_len; ii++) {
+    if (rand() % 2)
+      data[ii] = 0x00;
+    else
+      data[ii] = (byte)rand();
+  }
+}
+
+/*
+ * Read all of `data` with a random mixture of the bitdata functions,
+ * checking each against the reference.
+ *
+ * Returns 0 if they agree, 1 if they don't.
+ */
+static int check_reads(byte data[], int data_len) {
+  struct bitdata bits;
+  struct reference_bits ref = {data, data_len, 0};
+  uint32_t value, expected;
+  int32_t svalue;
+  byte bvalue;
+  int err, count;
+
+  setup_bitdata(&bits, data, data_len, false);
+  while (reference_left(&ref) > 0) {
+    int left = reference_left(&ref);
+    int zeros = reference_zeros(&ref);
+    int choice = rand() % 7;
+    count = 1 + rand() % 32;
+    if (count > left)
+      count = left;
+
+    if (choice == 0) {
+      err = read_bit(&bits, &bvalue);
+      value = bvalue;
+      count = 1;
+    } else if (choice == 1) {
+      if (count > 8)
+        count = 1 + count % 8;
+      err = read_bits_into_byte(&bits, count, &bvalue);
+      value = bvalue;
+    } else if (choice == 2) {
+      // Peek, and then read the same bits
+      err = peek_bits(&bits, count, &value);
+      expected = reference_read(&ref, count);
+      ref.posn -= count;
+      if (err || value != expected) {
+        printf("Test failed - peeking %d bits with %d left gave %08x (%d),"
+               " expected %08x\n",
+               count, left, value, err, expected);
+        return 1;
+      }
+      err = read_bits(&bits, count, &value);
+    } else if (choice == 3) {
+      err = skip_bits(&bits, count);
+      if (err) {
+        printf("Test failed - skipping %d bits with %d left\n", count, left);
+        return 1;
+      }
+      ref.posn += count;
+      continue;
+    } else if (choice == 4 && zeros < left) {
+      // count_zero_bits also reads the one bit after the zeros
+      value = count_zero_bits(&bits);
+      if ((int)value != zeros) {
+        printf("Test failed - counting zero bits with %d left gave %u,"
+               " expected %d\n",
+               left, value, zeros);
+        return 1;
+      }
+      ref.posn += zeros + 1;
+      continue;
+    } else if (choice >= 5 && zeros < 32 && 2 * zeros + 1 <= left) {
+      expected = reference_read(&ref, 2 * zeros + 1) - 1;
+      if (choice == 5) {
+        err = read_exp_golomb(&bits, &value);
+      } else {
+        // Odd values are positive, even values negative
+        err = read_signed_exp_golomb(&bits, &svalue);
+        value = (uint32_t)svalue;
+        if (expected & 1)
+          expected = (expected + 1) / 2;
+        else
+          expected = (uint32_t)(-(int32_t)(expected / 2));
+      }
+      if (err || value != expected) {
+        printf("Test failed - Exp-Golomb (%d zeros) with %d left gave %u"
+               " (%d), expected %u\n",
+               zeros, left, value, err, expected);
+        return 1;
+      }
+      continue;
+    } else {
+      err = read_bits(&bits, count, &value);
+    }
+
+    expected = reference_read(&ref, count);
+    if (err || value != expected) {
+      printf("Test failed - reading %d bits with %d left gave %08x (%d),"
+             " expected %08x\n",
+             count, left, value, err, expected);
+      return 1;
+    }
+  }
+
+  // There should be nothing left to read
+  if (peek_bits(&bits, 1, &value) == 0) {
+    printf("Test failed - bits left over after reading %d bytes\n", data_len);
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  byte data[TEST_DATA_LEN];
+  struct bitdata bits;
+  uint32_t value;
+  int ii, len;
+
+  printf("Testing bit reading\n");
+
+  printf("Test 1 - whole reads of every size\n");
+  srand(1);
+  make_test_data(data, TEST_DATA_LEN);
+  for (len = 1; len <= 32; len++) {
+    struct reference_bits ref = {data, TEST_DATA_LEN, 0};
+    setup_bitdata(&bits, data, TEST_DATA_LEN, false);
+    while (reference_left(&ref) >= len) {
+      uint32_t expected = reference_read(&ref, len);
+      if (read_bits(&bits, len, &value) || value != expected) {
+        printf("Test failed - reading %d bits at bit %d gave %08x,"
+               " expected %08x\n",
+               len, ref.posn - len, value, expected);
+        return 1;
+      }
+    }
+  }
+  printf("Test 1 succeeded\n");
+
+  printf("Test 2 - mixed reads against the reference\n");
+  for (ii = 0; ii < TEST_RUNS; ii++) {
+    len = rand() % (TEST_DATA_LEN + 1);
+    make_test_data(data, len);
+    if (check_reads(data, len))
+      return 1;
+  }
+  printf("Test 2 succeeded\n");
+
+  printf("Test 3 - reading past the end of the data\n");
+  data[0] = 0xA5;
+  setup_bitdata(&bits, data, 1, false);
+  if (read_bits(&bits, 4, &value) || value != 0xA ||
+      peek_bits(&bits, 5, &value) == 0 || read_bits(&bits, 4, &value) ||
+      value != 0x5) {
+    printf("Test failed - reading the last bits of the data\n");
+    return 1;
+  }
+  if (read_bits(&bits, 1, &value) == 0) {
+    printf("Test failed - read a bit after the end of the data\n");
+    return 1;
+  }
+  printf("Test 3 succeeded\n");
+  return 0;
+}
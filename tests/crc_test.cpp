@@ -0,0 +1,104 @@
+/*
+ * Test the CRC32 calculation from misc.c against a bit-at-a-time version
+ *
+ */
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "accessunit.h"
+#include "bitdata.h"
+#include "compat.h"
+#include "es.h"
+#include "h222.h"
+#include "h262.h"
+#include "misc.h"
+#include "nalunit.h"
+#include "pes.h"
+#include "pidint.h"
+#include "printing.h"
+#include "ps.h"
+#include "reverse.h"
+#include "ts.h"
+#include "tswrite.h"
+
+#define TEST_DATA_LEN 1000
+
+/*
+ * The obvious (and slow) way of calculating the MPEG-2 CRC
+ */
+static uint32_t reference_crc32(uint32_t crc, const byte *data, int len) {
+  int ii, jj;
+  for (ii = 0; ii < len; ii++) {
+    crc ^= (uint32_t)data[ii] << 24;
+    for (jj = 0; jj < 8; jj++) {
+      if (crc & 0x80000000L)
+        crc = (crc << 1) ^ CRC32_POLY;
+      else
+        crc = (crc << 1);
+    }
+  }
+  return crc;
+}
+
+int main(int argc, char **argv) {
+  byte data[TEST_DATA_LEN];
+  byte check[] = "123456789";
+  uint32_t crc;
+  int ii, start, len;
+
+  printf("Testing CRC32\n");
+
+  printf("Test 1 - the standard check value\n");
+  // CRC-32/MPEG-2 of "123456789" is well known
+  crc = crc32_block(0xffffffff, check, 9);
+  if (crc != 0x0376E6E7) {
+    printf("Test failed - CRC of \"123456789\" is %08x, not 0376e6e7\n", crc);
+    return 1;
+  }
+  printf("Test 1 succeeded\n");
+
+  printf("Test 2 - all lengths and alignments against the reference\n");
+  srand(1);
+  for (ii = 0; ii < TEST_DATA_LEN; ii++)
+    data[ii] = (byte)rand();
+  for (start = 0; start < 16; start++) {
+    for (len = 0; start + len <= TEST_DATA_LEN; len++) {
+      uint32_t expected = reference_crc32(0xffffffff, &data[start], len);
+      crc = crc32_block(0xffffffff, &data[start], len);
+      if (crc != expected) {
+        printf("Test failed - CRC of %d bytes at %d is %08x, expected %08x\n",
+               len, start, crc, expected);
+        return 1;
+      }
+      // And the table method on its own, in case we're not using it above
+      crc = crc32_block_sliced(0xffffffff, &data[start], len);
+      if (crc != expected) {
+        printf("Test failed - sliced CRC of %d bytes at %d is %08x,"
+               " expected %08x\n",
+               len, start, crc, expected);
+        return 1;
+      }
+    }
+  }
+  printf("Test 2 succeeded\n");
+
+  printf("Test 3 - a CRC calculated in pieces\n");
+  for (len = 0; len <= TEST_DATA_LEN; len += 37) {
+    uint32_t expected = reference_crc32(0xffffffff, data, TEST_DATA_LEN);
+    crc = crc32_block(0xffffffff, data, len);
+    crc = crc32_block(crc, &data[len], TEST_DATA_LEN - len);
+    if (crc != expected) {
+      printf("Test failed - CRC split at %d is %08x, expected %08x\n", len,
+             crc, expected);
+      return 1;
+    }
+  }
+  printf("Test 3 succeeded\n");
+  return 0;
+}
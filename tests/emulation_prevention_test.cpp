@@ -0,0 +1,211 @@
+/*
+ * Test removing H.264 emulation prevention bytes, both from a whole NAL unit
+ * at once and as we read bits from escaped data, against a byte-at-a-time
+ * version
+ *
+ */
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "accessunit.h"
+#include "bitdata.h"
+#include "compat.h"
+#include "es.h"
+#include "h222.h"
+#include "h262.h"
+#include "misc.h"
+#include "nalunit.h"
+#include "pes.h"
+#include "pidint.h"
+#include "printing.h"
+#include "ps.h"
+#include "reverse.h"
+#include "ts.h"
+#include "tswrite.h"
+
+#define TEST_DATA_LEN 200
+#define TEST_RUNS 2000
+
+/*
+ * The obvious (and slow) way of removing emulation prevention bytes,
+ * following H.264 7.3.1
+ */
+static int reference_unescape(const byte data[], int data_len, byte rbsp[]) {
+  int ii, posn = 0, zeros = 0;
+  for (ii = 0; ii < data_len; ii++) {
+    if (zeros >= 2 && data[ii] == 0x03) {
+      zeros = 0;
+      continue;
+    }
+    zeros = (data[ii] == 0x00 ? zeros + 1 : 0);
+    rbsp[posn++] = data[ii];
+  }
+  return posn;
+}
+
+/*
+ * Fill `data` with random bytes that are mostly 00 and 03, so that there
+ * are plenty of emulation prevention sequences (valid or otherwise)
+ */
+static void make_test_data(byte data[], int data_len) {
+  int ii;
+  for (ii = 0; ii < data_len; ii++) {
+    int choice = rand() % 8;
+    if (choice < 4)
+      data[ii] = 0x00;
+    else if (choice < 6)
+      data[ii] = 0x03;
+    else
+      data[ii] = (byte)rand();
+  }
+}
+
+/*
+ * Check remove_emulation_prevention() on `data` (whose first byte is the
+ * NAL unit header, and is not part of the RBSP) against the reference.
+ *
+ * Returns 0 if they agree, 1 if they don't.
+ */
+static int check_unescape(const char *what, byte data[], int data_len) {
+  byte expected[TEST_DATA_LEN];
+  byte rbsp[TEST_DATA_LEN];
+  int expected_len, rbsp_len;
+
+  expected_len = reference_unescape(&data[1], data_len - 1, expected);
+  remove_emulation_prevention(data, data_len, rbsp, &rbsp_len);
+  if (rbsp_len != expected_len || memcmp(rbsp, expected, rbsp_len)) {
+    printf("Test failed - %s\n", what);
+    print_data(true, "Data    ", data, data_len, 20);
+    print_data(true, "RBSP    ", rbsp, rbsp_len, 20);
+    print_data(true, "Expected", expected, expected_len, 20);
+    return 1;
+  }
+  return 0;
+}
+
+/*
+ * How many zero bits are there in `data` from bit `posn` onwards, before
+ * the next one bit (or the end of the data)?
+ */
+static int zeros_from(const byte data[], int data_len, int posn) {
+  int count = 0;
+  for (; posn < data_len * 8; posn++, count++) {
+    if (data[posn / 8] & (0x80 >> (posn % 8)))
+      break;
+  }
+  return count;
+}
+
+/*
+ * Read all of `data` as escaped bits, and all of its unescaped version,
+ * in the same (random) sized pieces, and check they give the same values.
+ *
+ * Returns 0 if they agree, 1 if they don't.
+ */
+static int check_escaped_reads(byte data[], int data_len) {
+  byte rbsp[TEST_DATA_LEN];
+  struct bitdata escaped, plain;
+  int rbsp_len, left;
+  uint32_t a = 0, b = 0;
+
+  rbsp_len = reference_unescape(data, data_len, rbsp);
+  setup_bitdata(&escaped, data, data_len, true);
+  setup_bitdata(&plain, rbsp, rbsp_len, false);
+
+  for (left = rbsp_len * 8; left > 0;) {
+    int count = 1 + rand() % 32;
+    int zeros = zeros_from(rbsp, rbsp_len, rbsp_len * 8 - left);
+    int err_a, err_b;
+    if (rand() % 4 == 0 && zeros < 32 && 2 * zeros + 1 <= left) {
+      err_a = read_exp_golomb(&escaped, &a);
+      err_b = read_exp_golomb(&plain, &b);
+      if (err_a || err_b || a != b) {
+        printf("Test failed - Exp-Golomb with %d bits left gave %u (%d),"
+               " expected %u (%d)\n",
+               left, a, err_a, b, err_b);
+        return 1;
+      }
+      left -= 2 * zeros + 1;
+      continue;
+    }
+    if (count > left)
+      count = left;
+    err_a = read_bits(&escaped, count, &a);
+    err_b = read_bits(&plain, count, &b);
+    if (err_a || err_b || a != b) {
+      printf("Test failed - reading %d bits with %d left gave %08x (%d),"
+             " expected %08x (%d)\n",
+             count, left, a, err_a, b, err_b);
+      return 1;
+    }
+    left -= count;
+  }
+  // And both should now be at the end of their data
+  if (peek_bits(&escaped, 1, &a) == 0 || peek_bits(&plain, 1, &b) == 0) {
+    printf("Test failed - bits left over after reading %d bytes of RBSP\n",
+           rbsp_len);
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  byte data[TEST_DATA_LEN];
+  int ii, len;
+
+  printf("Testing emulation prevention\n");
+
+  printf("Test 1 - sequences at the ends of the data\n");
+  {
+    // The first byte of each is the NAL unit header
+    byte at_start[] = {0x65, 0x00, 0x00, 0x03, 0x01, 0x02};
+    byte at_end[] = {0x65, 0x01, 0x02, 0x00, 0x00, 0x03};
+    byte just_one[] = {0x65, 0x00, 0x00, 0x03};
+    byte three_zeros[] = {0x65, 0x00, 0x00, 0x00, 0x03, 0x01};
+    byte twice[] = {0x65, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00};
+    byte double_03[] = {0x65, 0x00, 0x00, 0x03, 0x03, 0x00};
+    byte header_zero[] = {0x00, 0x00, 0x03, 0x01};
+    byte unfinished[] = {0x65, 0x01, 0x00, 0x00};
+    if (check_unescape("00 00 03 at the start", at_start, sizeof(at_start)) ||
+        check_unescape("00 00 03 at the end", at_end, sizeof(at_end)) ||
+        check_unescape("just 00 00 03", just_one, sizeof(just_one)) ||
+        check_unescape("00 00 00 03", three_zeros, sizeof(three_zeros)) ||
+        check_unescape("00 00 03 00 00 03", twice, sizeof(twice)) ||
+        check_unescape("00 00 03 03", double_03, sizeof(double_03)) ||
+        check_unescape("header byte of 00", header_zero,
+                       sizeof(header_zero)) ||
+        check_unescape("ending in 00 00", unfinished, sizeof(unfinished)))
+      return 1;
+    for (len = 1; len <= 4; len++) {
+      if (check_unescape("short data", three_zeros, len))
+        return 1;
+    }
+  }
+  printf("Test 1 succeeded\n");
+
+  printf("Test 2 - random data against the reference\n");
+  srand(1);
+  for (ii = 0; ii < TEST_RUNS; ii++) {
+    len = 1 + rand() % TEST_DATA_LEN;
+    make_test_data(data, len);
+    if (check_unescape("random data", data, len))
+      return 1;
+  }
+  printf("Test 2 succeeded\n");
+
+  printf("Test 3 - escaped bit reads against unescaped ones\n");
+  for (ii = 0; ii < TEST_RUNS; ii++) {
+    len = 1 + rand() % TEST_DATA_LEN;
+    make_test_data(data, len);
+    if (check_escaped_reads(data, len))
+      return 1;
+  }
+  printf("Test 3 succeeded\n");
+  return 0;
+}
@@ -0,0 +1,179 @@
+/*
+ * Test remembering HEVC parameter sets by their kind and id
+ *
+ */
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "accessunit.h"
+#include "bitdata.h"
+#include "compat.h"
+#include "es.h"
+#include "h222.h"
+#include "h262.h"
+#include "hevc.h"
+#include "misc.h"
+#include "nalunit.h"
+#include "pes.h"
+#include "pidint.h"
+#include "printing.h"
+#include "ps.h"
+#include "reverse.h"
+#include "ts.h"
+#include "tswrite.h"
+
+static byte vps_0[] = {0x00, 0x00, 0x01, 0x40, 0x01, 0x0c, 0x01, 0xff};
+// Two different SPS with id 0, and one with id 3 that has sub-layers (and
+// so a longer profile_tier_level to skip over)
+static byte sps_0_a[] = {0x00, 0x00, 0x01, 0x42, 0x01, 0x01, 0x01, 0x60,
+                         0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                         0x11, 0x5d, 0xa0, 0x0a};
+static byte sps_0_b[] = {0x00, 0x00, 0x01, 0x42, 0x01, 0x01, 0x01, 0x60,
+                         0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                         0x11, 0x5d, 0xa0, 0x0b};
+static byte sps_3[] = {0x00, 0x00, 0x01, 0x42, 0x01, 0x05, 0x01, 0x60, 0x11,
+                       0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x5d,
+                       0xd0, 0x00, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x22,
+                       0x22, 0x22, 0x22, 0x22, 0x22, 0x22, 0x21, 0x80};
+static byte pps_0[] = {0x00, 0x00, 0x01, 0x44, 0x01, 0xc1, 0x72};
+static byte idr[] = {0x00, 0x00, 0x01, 0x26, 0x01, 0x80, 0xaa};
+static byte trail[] = {0x00, 0x00, 0x01, 0x02, 0x01, 0x80, 0xaa};
+
+struct test_unit {
+  byte *data;
+  int data_len;
+};
+
+#define UNIT(data) {data, sizeof(data)}
+
+// The same SPS id is used with content A, then B, then A again
+static struct test_unit units[] = {
+    UNIT(vps_0),   UNIT(sps_0_a), UNIT(pps_0), UNIT(idr),   UNIT(sps_0_b),
+    UNIT(trail),   UNIT(sps_0_a), UNIT(trail), UNIT(sps_3), UNIT(trail),
+};
+#define NUM_UNITS (int)(sizeof(units) / sizeof(units[0]))
+
+/*
+ * Write our test NAL units out as an ES file
+ *
+ * Returns 0 if it works, 1 if something went wrong.
+ */
+static int write_test_stream(int file) {
+  int ii;
+  for (ii = 0; ii < NUM_UNITS; ii++) {
+    if (write(file, units[ii].data, units[ii].data_len) != units[ii].data_len)
+      return 1;
+  }
+  return 0;
+}
+
+/*
+ * Is the parameter set we have remembered the same as `data`?
+ */
+static int same_data(ES_unit_p unit, byte *data, int data_len) {
+  return unit != nullptr && (int)unit->data_len == data_len &&
+         !memcmp(unit->data, data, data_len);
+}
+
+int main(int argc, char **argv) {
+  char filename[] = "/tmp/hevc_param_set_testXXXXXX";
+  ES_p es = nullptr;
+  hevc_context_p context = nullptr;
+  int file, err, ii, count = 0;
+
+  printf("Testing HEVC parameter sets\n");
+  file = mkstemp(filename);
+  if (file == -1) {
+    printf("Test failed - unable to create temporary file: %s\n",
+           strerror(errno));
+    return 1;
+  }
+  err = write_test_stream(file);
+  close(file);
+  if (err) {
+    printf("Test failed - writing test stream %s\n", filename);
+    goto fail;
+  }
+
+  err = open_elementary_stream(filename, &es);
+  if (err) {
+    printf("Test failed - opening test stream %s\n", filename);
+    goto fail;
+  }
+  err = build_hevc_context(es, &context);
+  if (err) {
+    printf("Test failed - building HEVC context\n");
+    goto fail;
+  }
+
+  printf("Test 1 - read the access units\n");
+  for (;;) {
+    hevc_access_unit_p access_unit;
+    err = get_next_hevc_access_unit(context, false, false, true,
+                                    &access_unit);
+    if (err == EOF)
+      break;
+    if (err) {
+      printf("Test failed - reading access unit %d\n", count + 1);
+      goto fail;
+    }
+    free_hevc_access_unit(&access_unit);
+    count++;
+  }
+  if (count != 4) {
+    printf("Test failed - read %d access units, expected 4\n", count);
+    goto fail;
+  }
+  printf("Test 1 succeeded\n");
+
+  printf("Test 2 - the latest parameter set for each id is kept\n");
+  if (!same_data(context->sps[0], sps_0_a, sizeof(sps_0_a))) {
+    printf("Test failed - SPS 0 is not the last one in the stream\n");
+    goto fail;
+  }
+  if (!same_data(context->sps[3], sps_3, sizeof(sps_3))) {
+    printf("Test failed - SPS 3 (with sub-layers) was not found\n");
+    goto fail;
+  }
+  if (!same_data(context->vps[0], vps_0, sizeof(vps_0)) ||
+      !same_data(context->pps[0], pps_0, sizeof(pps_0))) {
+    printf("Test failed - VPS 0 or PPS 0 was not found\n");
+    goto fail;
+  }
+  for (ii = 1; ii < HEVC_MAX_VPS_IDS; ii++) {
+    if (context->vps[ii] != nullptr) {
+      printf("Test failed - found a VPS with id %d\n", ii);
+      goto fail;
+    }
+  }
+  for (ii = 0; ii < HEVC_MAX_SPS_IDS; ii++) {
+    if (ii != 0 && ii != 3 && context->sps[ii] != nullptr) {
+      printf("Test failed - found an SPS with id %d\n", ii);
+      goto fail;
+    }
+  }
+  for (ii = 1; ii < HEVC_MAX_PPS_IDS; ii++) {
+    if (context->pps[ii] != nullptr) {
+      printf("Test failed - found a PPS with id %d\n", ii);
+      goto fail;
+    }
+  }
+  printf("Test 2 succeeded\n");
+
+  free_hevc_context(&context);
+  close_elementary_stream(&es);
+  (void)unlink(filename);
+  return 0;
+
+fail:
+  free_hevc_context(&context);
+  close_elementary_stream(&es);
+  (void)unlink(filename);
+  return 1;
+}
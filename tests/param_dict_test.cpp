@@ -0,0 +1,173 @@
+/*
+ * Test remembering H.264 parameter sets in their "dictionaries"
+ *
+ */
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "accessunit.h"
+#include "bitdata.h"
+#include "compat.h"
+#include "es.h"
+#include "h222.h"
+#include "h262.h"
+#include "misc.h"
+#include "nalunit.h"
+#include "pes.h"
+#include "pidint.h"
+#include "printing.h"
+#include "ps.h"
+#include "reverse.h"
+#include "ts.h"
+#include "tswrite.h"
+
+// A sequence parameter set (id 0), and the same again with num_ref_frames
+// changed from 1 to 2 - which is not one of the fields we decode
+static byte sps_0[] = {0x00, 0x00, 0x01, 0x67, 0x4d, 0x00, 0x1e,
+                       0xda, 0x02, 0xd0, 0x49, 0x90, 0x00};
+static byte sps_0_changed[] = {0x00, 0x00, 0x01, 0x67, 0x4d, 0x00, 0x1e,
+                               0xdb, 0x02, 0xd0, 0x49, 0x90, 0x00};
+// Picture parameter sets with ids 0 and 1
+static byte pps_0[] = {0x00, 0x00, 0x01, 0x68, 0xce, 0x3c, 0x80};
+static byte pps_1[] = {0x00, 0x00, 0x01, 0x68, 0x53, 0x8f, 0x20};
+// And parameter sets with ids that are out of range
+static byte pps_256[] = {0x00, 0x00, 0x01, 0x68, 0x00,
+                         0x80, 0xce, 0x3c, 0x80};
+static byte sps_32[] = {0x00, 0x00, 0x01, 0x67, 0x4d, 0x00, 0x1e,
+                        0x04, 0x36, 0x80, 0xb4, 0x12, 0x64};
+
+struct expected_state {
+  const char *what;
+  byte *data;
+  int data_len;
+  // What we expect the dictionaries to look like after reading it
+  uint32_t seq_version;
+  int seq_length;
+  uint32_t pic_version;
+  int pic_length;
+};
+
+#define ITEM(what, data, sv, sl, pv, pl)                                      \
+  {what, data, sizeof(data), sv, sl, pv, pl}
+
+static struct expected_state items[] = {
+    ITEM("first SPS", sps_0, 1, 1, 0, 0),
+    ITEM("repeated SPS", sps_0, 1, 1, 0, 0),
+    ITEM("changed SPS", sps_0_changed, 2, 1, 0, 0),
+    ITEM("first PPS", pps_0, 2, 1, 1, 1),
+    ITEM("repeated PPS", pps_0, 2, 1, 1, 1),
+    ITEM("second PPS", pps_1, 2, 1, 2, 2),
+    ITEM("PPS with id 256", pps_256, 2, 1, 2, 2),
+    ITEM("SPS with id 32", sps_32, 2, 1, 2, 2),
+};
+#define NUM_ITEMS (int)(sizeof(items) / sizeof(items[0]))
+
+/*
+ * Write our test NAL units out as an ES file
+ *
+ * Returns 0 if it works, 1 if something went wrong.
+ */
+static int write_test_stream(int file) {
+  int ii;
+  for (ii = 0; ii < NUM_ITEMS; ii++) {
+    if (write(file, items[ii].data, items[ii].data_len) != items[ii].data_len)
+      return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  char filename[] = "/tmp/param_dict_testXXXXXX";
+  ES_p es = nullptr;
+  nal_unit_context_p context = nullptr;
+  param_dict_p seq_dict, pic_dict;
+  int file, err, ii;
+
+  printf("Testing parameter set dictionaries\n");
+  file = mkstemp(filename);
+  if (file == -1) {
+    printf("Test failed - unable to create temporary file: %s\n",
+           strerror(errno));
+    return 1;
+  }
+  err = write_test_stream(file);
+  close(file);
+  if (err) {
+    printf("Test failed - writing test stream %s\n", filename);
+    goto fail;
+  }
+
+  err = open_elementary_stream(filename, &es);
+  if (err) {
+    printf("Test failed - opening test stream %s\n", filename);
+    goto fail;
+  }
+  err = build_nal_unit_context(es, &context);
+  if (err) {
+    printf("Test failed - building NAL unit context\n");
+    goto fail;
+  }
+  seq_dict = context->seq_param_dict;
+  pic_dict = context->pic_param_dict;
+
+  printf("Test 1 - versions only move when a parameter set changes\n");
+  for (ii = 0; ii < NUM_ITEMS; ii++) {
+    nal_unit_p nal = nullptr;
+    err = find_next_NAL_unit(context, false, &nal);
+    if (err) {
+      printf("Test failed - reading %s gave error %d\n", items[ii].what, err);
+      goto fail;
+    }
+    free_nal_unit(&nal);
+    if (seq_dict->version != items[ii].seq_version ||
+        seq_dict->length != items[ii].seq_length ||
+        pic_dict->version != items[ii].pic_version ||
+        pic_dict->length != items[ii].pic_length) {
+      printf("Test failed - after %s, SPS version %u (%d ids) and PPS"
+             " version %u (%d ids), expected %u (%d) and %u (%d)\n",
+             items[ii].what, seq_dict->version, seq_dict->length,
+             pic_dict->version, pic_dict->length, items[ii].seq_version,
+             items[ii].seq_length, items[ii].pic_version,
+             items[ii].pic_length);
+      goto fail;
+    }
+  }
+  printf("Test 1 succeeded\n");
+
+  printf("Test 2 - the versions of individual ids\n");
+  if (seq_dict->versions[0] != 2 || pic_dict->versions[0] != 1 ||
+      pic_dict->versions[1] != 1) {
+    printf("Test failed - SPS 0 is version %u, PPS 0 version %u and PPS 1"
+           " version %u, expected 2, 1 and 1\n",
+           seq_dict->versions[0], pic_dict->versions[0],
+           pic_dict->versions[1]);
+    goto fail;
+  }
+  // The SPS we now have should be the changed one, at its own position
+  if (seq_dict->posns[0].infile != (offset_t)(2 * sizeof(sps_0)) ||
+      seq_dict->data_lens[0] != sizeof(sps_0_changed)) {
+    printf("Test failed - SPS 0 is at " OFFSET_T_FORMAT " for %u bytes,"
+           " expected %d for %d\n",
+           seq_dict->posns[0].infile, seq_dict->data_lens[0],
+           (int)(2 * sizeof(sps_0)), (int)sizeof(sps_0_changed));
+    goto fail;
+  }
+  printf("Test 2 succeeded\n");
+
+  free_nal_unit_context(&context);
+  close_elementary_stream(&es);
+  (void)unlink(filename);
+  return 0;
+
+fail:
+  free_nal_unit_context(&context);
+  close_elementary_stream(&es);
+  (void)unlink(filename);
+  return 1;
+}
@@ -0,0 +1,248 @@
+/*
+ * Test writing PES packets held as slices out as TS, against writing the
+ * same PES packets out from a single array
+ *
+ */
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "accessunit.h"
+#include "bitdata.h"
+#include "compat.h"
+#include "es.h"
+#include "h222.h"
+#include "h262.h"
+#include "misc.h"
+#include "nalunit.h"
+#include "pes.h"
+#include "pidint.h"
+#include "printing.h"
+#include "ps.h"
+#include "reverse.h"
+#include "ts.h"
+#include "tswrite.h"
+
+#define TEST_PID 0x68
+#define TEST_DATA_LEN 1000
+#define MAX_TEST_SLICES 8
+#define TEST_RUNS 2000
+
+static char reference_name[] = "/tmp/pes_slices_test_aXXXXXX";
+static char slices_name[] = "/tmp/pes_slices_test_bXXXXXX";
+
+/*
+ * Fill `data` with a PES packet of `data_len` bytes (at least 9), starting
+ * with an H.222.0 PES header that has `hdr_extra` bytes of optional fields
+ */
+static void make_test_PES(byte data[], int data_len, int hdr_extra) {
+  int ii;
+  data[0] = 0x00;
+  data[1] = 0x00;
+  data[2] = 0x01;
+  data[3] = DEFAULT_VIDEO_STREAM_ID;
+  data[4] = (byte)(((data_len - 6) >> 8) & 0xFF);
+  data[5] = (byte)((data_len - 6) & 0xFF);
+  data[6] = 0x80;
+  data[7] = 0x00;
+  data[8] = (byte)hdr_extra;
+  for (ii = 9; ii < data_len; ii++)
+    data[ii] = (byte)rand();
+}
+
+/*
+ * Read all of `filename` into `data`, returning how much there was
+ * (or -1 if it could not be read)
+ */
+static int read_back(const char *filename, byte data[], int data_size) {
+  int length;
+  FILE *file = fopen(filename, "rb");
+  if (file == nullptr)
+    return -1;
+  length = (int)fread(data, 1, data_size, file);
+  fclose(file);
+  return length;
+}
+
+/*
+ * Write the PES packet in `data` out once as a whole, and once as a head of
+ * `head_len` bytes followed by slices of the given lengths (which add up to
+ * the rest of the data), and check the TS packets are the same.
+ *
+ * Returns 0 if they are, 1 if they are not (or something went wrong).
+ */
+static int check_slices(const char *what, byte data[], int data_len,
+                        int head_len, int slice_len[], int num_slices) {
+  static byte expected[TEST_DATA_LEN * 2];
+  static byte got[TEST_DATA_LEN * 2];
+  struct iovec slice[MAX_TEST_SLICES];
+  TS_writer_p output;
+  int expected_len, got_len;
+  int ii, posn = head_len;
+  int err;
+
+  for (ii = 0; ii < num_slices; ii++) {
+    slice[ii].iov_base = &data[posn];
+    slice[ii].iov_len = slice_len[ii];
+    posn += slice_len[ii];
+  }
+
+  // Both should start from the same continuity counter
+  continuity_counter[TEST_PID] = 0;
+  err = tswrite_open(TS_W_FILE, reference_name, nullptr, 0, true, &output);
+  if (err)
+    return 1;
+  err = write_PES_as_TS_PES_packet(output, data, data_len, TEST_PID,
+                                   DEFAULT_VIDEO_STREAM_ID, false, 0, 0);
+  if (tswrite_close(output, true) || err) {
+    printf("Test failed - %s: error writing the whole PES packet\n", what);
+    return 1;
+  }
+
+  continuity_counter[TEST_PID] = 0;
+  err = tswrite_open(TS_W_FILE, slices_name, nullptr, 0, true, &output);
+  if (err)
+    return 1;
+  err = write_PES_slices_as_TS_PES_packet(output, data, head_len, slice,
+                                          num_slices, TEST_PID);
+  if (tswrite_close(output, true) || err) {
+    printf("Test failed - %s: error writing the PES packet as slices\n",
+           what);
+    return 1;
+  }
+
+  expected_len = read_back(reference_name, expected, sizeof(expected));
+  got_len = read_back(slices_name, got, sizeof(got));
+  if (expected_len <= 0 || got_len != expected_len ||
+      memcmp(got, expected, got_len)) {
+    printf("Test failed - %s: PES packet of %d bytes, head %d bytes,"
+           " %d slice%s\n",
+           what, data_len, head_len, num_slices, (num_slices == 1 ? "" : "s"));
+    for (ii = 0; ii < num_slices; ii++)
+      printf("    slice %d is %d bytes\n", ii, slice_len[ii]);
+    printf("    wrote %d bytes of TS, expected %d\n", got_len, expected_len);
+    for (ii = 0; ii < min(got_len, expected_len); ii += TS_PACKET_SIZE) {
+      if (memcmp(&got[ii], &expected[ii], TS_PACKET_SIZE)) {
+        print_data(true, "    Got     ", &got[ii], TS_PACKET_SIZE, 20);
+        print_data(true, "    Expected", &expected[ii], TS_PACKET_SIZE, 20);
+        break;
+      }
+    }
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  byte data[TEST_DATA_LEN];
+  int slice_len[MAX_TEST_SLICES];
+  int ii, len, split, result = 1;
+  int file;
+
+  printf("Testing writing PES packets from slices\n");
+  file = mkstemp(reference_name);
+  if (file == -1) {
+    printf("Test failed - unable to create temporary file: %s\n",
+           strerror(errno));
+    return 1;
+  }
+  close(file);
+  file = mkstemp(slices_name);
+  if (file == -1) {
+    printf("Test failed - unable to create temporary file: %s\n",
+           strerror(errno));
+    (void)unlink(reference_name);
+    return 1;
+  }
+  close(file);
+  srand(1);
+
+  printf("Test 1 - every length, with the data in one slice\n");
+  for (len = 9; len <= 3 * TS_PACKET_SIZE; len++) {
+    make_test_PES(data, len, 0);
+    if (check_slices("all in the head", data, len, len, slice_len, 0))
+      goto finish;
+    slice_len[0] = len - 9;
+    if (check_slices("one slice", data, len, 9, slice_len, 1))
+      goto finish;
+  }
+  printf("Test 1 succeeded\n");
+
+  printf("Test 2 - splits either side of each packet boundary\n");
+  // Including those where the last packet is padded by one byte
+  // (MAX_TS_PAYLOAD_SIZE - 1), or more
+  {
+    int lengths[] = {MAX_TS_PAYLOAD_SIZE - 1,     MAX_TS_PAYLOAD_SIZE,
+                     MAX_TS_PAYLOAD_SIZE + 1,     2 * MAX_TS_PAYLOAD_SIZE - 1,
+                     2 * MAX_TS_PAYLOAD_SIZE,     2 * MAX_TS_PAYLOAD_SIZE + 1,
+                     3 * MAX_TS_PAYLOAD_SIZE - 1, 3 * MAX_TS_PAYLOAD_SIZE - 2,
+                     MAX_TS_PAYLOAD_SIZE + 50};
+    for (ii = 0; ii < (int)(sizeof(lengths) / sizeof(lengths[0])); ii++) {
+      len = lengths[ii];
+      make_test_PES(data, len, 5);
+      for (split = 14; split <= len; split++) {
+        // A head of 14 bytes (PES header and 5 bytes of optional fields),
+        // then two slices split at `split`
+        slice_len[0] = split - 14;
+        slice_len[1] = len - split;
+        if (check_slices("two slices", data, len, 14, slice_len, 2))
+          goto finish;
+        // Or the head ends at `split`
+        slice_len[0] = len - split;
+        if (check_slices("head and one slice", data, len, split, slice_len,
+                         1))
+          goto finish;
+      }
+    }
+  }
+  printf("Test 2 succeeded\n");
+
+  printf("Test 3 - many small slices, straddling packets\n");
+  for (len = 9; len <= 2 * TS_PACKET_SIZE; len++) {
+    // 9 bytes of head, then slices of 1, 2, 3... bytes and the remainder
+    int num_slices = 0;
+    int left = len - 9;
+    make_test_PES(data, len, 0);
+    while (left > 0 && num_slices < MAX_TEST_SLICES) {
+      int this_len = num_slices + 1;
+      if (num_slices == MAX_TEST_SLICES - 1 || this_len > left)
+        this_len = left;
+      slice_len[num_slices++] = this_len;
+      left -= this_len;
+    }
+    if (check_slices("small slices", data, len, 9, slice_len, num_slices))
+      goto finish;
+  }
+  printf("Test 3 succeeded\n");
+
+  printf("Test 4 - random splits\n");
+  for (ii = 0; ii < TEST_RUNS; ii++) {
+    int num_slices = 1 + rand() % MAX_TEST_SLICES;
+    int head_len, left, jj;
+    len = 9 + rand() % (TEST_DATA_LEN - 8);
+    make_test_PES(data, len, 0);
+    head_len = 9 + rand() % (len - 8);
+    left = len - head_len;
+    for (jj = 0; jj < num_slices - 1; jj++) {
+      slice_len[jj] = (rand() % 2 ? rand() % (left + 1)
+                                   : rand() % (min(left, 4) + 1));
+      left -= slice_len[jj];
+    }
+    slice_len[num_slices - 1] = left;
+    if (check_slices("random slices", data, len, head_len, slice_len,
+                     num_slices))
+      goto finish;
+  }
+  printf("Test 4 succeeded\n");
+  result = 0;
+
+finish:
+  (void)unlink(reference_name);
+  (void)unlink(slices_name);
+  return result;
+}
@@ -0,0 +1,195 @@
+/*
+ * Test the start code prefix searches from misc.c against a byte-at-a-time
+ * version
+ *
+ */
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "accessunit.h"
+#include "bitdata.h"
+#include "compat.h"
+#include "es.h"
+#include "h222.h"
+#include "h262.h"
+#include "misc.h"
+#include "nalunit.h"
+#include "pes.h"
+#include "pidint.h"
+#include "printing.h"
+#include "ps.h"
+#include "reverse.h"
+#include "ts.h"
+#include "tswrite.h"
+
+#define TEST_DATA_LEN 300
+#define TEST_RUNS 3000
+
+/*
+ * The obvious (and slow) way of finding 00 00 `last`
+ */
+static int reference_find(const byte *data, int data_len, byte last) {
+  int ii;
+  for (ii = 0; ii + 2 < data_len; ii++) {
+    if (data[ii] == 0x00 && data[ii + 1] == 0x00 && data[ii + 2] == last)
+      return ii;
+  }
+  return -1;
+}
+
+struct search_method {
+  const char *name;
+  start_code_fn fn;
+};
+
+static struct search_method methods[] = {
+    {"memchr", find_start_code_memchr},
+#if defined(__x86_64__) && defined(__GNUC__)
+    {"SSE2", find_start_code_sse2},
+    {"AVX2", find_start_code_avx2},
+#endif
+};
+#define NUM_METHODS (int)(sizeof(methods) / sizeof(methods[0]))
+
+/*
+ * Can we run this method on this machine?
+ */
+static int method_supported(struct search_method *method) {
+#if defined(__x86_64__) && defined(__GNUC__)
+  __builtin_cpu_init();
+  if (method->fn == find_start_code_avx2)
+    return __builtin_cpu_supports("avx2");
+  if (method->fn == find_start_code_sse2)
+    return __builtin_cpu_supports("sse2");
+#endif
+  return true;
+}
+
+/*
+ * Check each method, and the public functions, against the reference
+ * for `data_len` bytes at `data`.
+ *
+ * Returns 0 if they all agree, 1 if any doesn't.
+ */
+static int check_all(const byte *data, int data_len) {
+  int ii, jj;
+  byte lasts[] = {0x01, 0x03};
+
+  for (jj = 0; jj < 2; jj++) {
+    int expected = reference_find(data, data_len, lasts[jj]);
+    int found;
+    for (ii = 0; ii < NUM_METHODS; ii++) {
+      if (!method_supported(&methods[ii]))
+        continue;
+      found = methods[ii].fn(data, data_len, lasts[jj]);
+      if (found != expected) {
+        printf("Test failed - %s search for 00 00 %02x in %d bytes found %d,"
+               " expected %d\n",
+               methods[ii].name, lasts[jj], data_len, found, expected);
+        return 1;
+      }
+    }
+    if (lasts[jj] == 0x01)
+      found = find_start_code_prefix(data, data_len);
+    else
+      found = find_emulation_prevention(data, data_len);
+    if (found != expected) {
+      printf("Test failed - search for 00 00 %02x in %d bytes found %d,"
+             " expected %d\n",
+             lasts[jj], data_len, found, expected);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  // Room to start the data at any alignment within a 32 byte block
+  byte buffer[TEST_DATA_LEN + 32];
+  byte *data;
+  int ii, posn, len, start;
+
+  printf("Testing start code prefix search\n");
+  for (ii = 0; ii < NUM_METHODS; ii++) {
+    if (!method_supported(&methods[ii]))
+      printf("(%s is not supported here, and will not be tested)\n",
+             methods[ii].name);
+  }
+
+  printf("Test 1 - a single prefix at each position and alignment\n");
+  for (start = 0; start < 32; start++) {
+    data = &buffer[start];
+    for (len = 0; len <= 100; len++) {
+      memset(data, 0xff, len);
+      if (check_all(data, len))
+        return 1;
+      for (posn = 0; posn + 3 <= len; posn++) {
+        memset(data, 0xff, len);
+        data[posn] = 0x00;
+        data[posn + 1] = 0x00;
+        data[posn + 2] = 0x01;
+        if (check_all(data, len))
+          return 1;
+        data[posn + 2] = 0x03;
+        if (check_all(data, len))
+          return 1;
+      }
+    }
+  }
+  printf("Test 1 succeeded\n");
+
+  printf("Test 2 - near misses, and runs of zeros\n");
+  for (len = 0; len <= 100; len++) {
+    data = buffer;
+    // All zeros, and then all zeros with a final 01
+    memset(data, 0x00, len);
+    if (check_all(data, len))
+      return 1;
+    if (len > 0) {
+      data[len - 1] = 0x01;
+      if (check_all(data, len))
+        return 1;
+    }
+    // 00 01 and 01 00 00, which are not prefixes, repeated
+    for (ii = 0; ii < len; ii++)
+      data[ii] = (ii % 2 == 0 ? 0x00 : 0x01);
+    if (check_all(data, len))
+      return 1;
+    for (ii = 0; ii < len; ii++)
+      data[ii] = (ii % 3 == 0 ? 0x01 : 0x00);
+    if (check_all(data, len))
+      return 1;
+  }
+  printf("Test 2 succeeded\n");
+
+  printf("Test 3 - random data against the reference\n");
+  srand(1);
+  for (ii = 0; ii < TEST_RUNS; ii++) {
+    int jj;
+    start = rand() % 32;
+    len = rand() % (TEST_DATA_LEN + 1);
+    data = &buffer[start];
+    // Mostly 00, with some 01 and 03, so that prefixes are common
+    for (jj = 0; jj < len; jj++) {
+      int choice = rand() % 8;
+      if (choice < 5)
+        data[jj] = 0x00;
+      else if (choice < 6)
+        data[jj] = 0x01;
+      else if (choice < 7)
+        data[jj] = 0x03;
+      else
+        data[jj] = (byte)rand();
+    }
+    if (check_all(data, len))
+      return 1;
+  }
+  printf("Test 3 succeeded\n");
+  return 0;
+}
@@ -0,0 +1,284 @@
+/*
+ * Test building a TS index, writing it out and reading it back in
+ *
+ */
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "accessunit.h"
+#include "bitdata.h"
+#include "compat.h"
+#include "es.h"
+#include "h222.h"
+#include "h262.h"
+#include "misc.h"
+#include "nalunit.h"
+#include "pes.h"
+#include "pidint.h"
+#include "printing.h"
+#include "ps.h"
+#include "reverse.h"
+#include "ts.h"
+#include "tsindex.h"
+#include "tswrite.h"
+
+#define TEST_PMT_PID 0x66
+#define TEST_VIDEO_PID 0x68
+#define TEST_FRAMES 10
+#define TEST_I_FREQ 3      // an I picture every this many frames
+#define TEST_PTS_STEP 3600 // 25 frames a second at 90KHz
+#define TEST_TRAILING_BYTES 50
+
+/*
+ * Write a small MPEG-2 stream as TS, with a PCR before each picture, and
+ * then some bytes that don't make a whole TS packet.
+ *
+ * Returns 0 if it works, 1 if something went wrong.
+ */
+static int write_test_stream(char *filename) {
+  TS_writer_p output;
+  FILE *file;
+  byte user_data[] = {0x00, 0x00, 0x01, 0xB2, 0x55, 0x55, 0x55, 0x55};
+  byte picture[400];
+  byte trailing[TEST_TRAILING_BYTES];
+  int ii, err;
+
+  err = tswrite_open(TS_W_FILE, filename, nullptr, 0, true, &output);
+  if (err)
+    return 1;
+  err = write_TS_program_data(output, 1, 1, TEST_PMT_PID, TEST_VIDEO_PID,
+                              MPEG2_VIDEO_STREAM_TYPE);
+  for (ii = 0; ii < TEST_FRAMES && !err; ii++) {
+    int is_I = (ii % TEST_I_FREQ) == 0;
+    uint64_t pts = (uint64_t)(ii + 1) * TEST_PTS_STEP;
+
+    memset(picture, 0x55, sizeof(picture));
+    // A picture header, with picture_coding_type in byte 5
+    picture[0] = 0x00;
+    picture[1] = 0x00;
+    picture[2] = 0x01;
+    picture[3] = 0x00;
+    picture[4] = 0x00;
+    picture[5] = (is_I ? 1 : 2) << 3;
+    // And a slice
+    picture[10] = 0x00;
+    picture[11] = 0x00;
+    picture[12] = 0x01;
+    picture[13] = 0x01;
+
+    err = write_ES_as_TS_PES_packet_with_pcr(
+        output, user_data, sizeof(user_data), TEST_VIDEO_PID,
+        DEFAULT_VIDEO_STREAM_ID, pts, 0);
+    if (!err)
+      err = write_ES_as_TS_PES_packet_with_pts_dts(
+          output, picture, sizeof(picture), TEST_VIDEO_PID,
+          DEFAULT_VIDEO_STREAM_ID, true, pts, false, 0);
+  }
+  if (tswrite_close(output, true) || err)
+    return 1;
+
+  file = fopen(filename, "ab");
+  if (file == nullptr)
+    return 1;
+  memset(trailing, 0x47, sizeof(trailing));
+  if (fwrite(trailing, 1, sizeof(trailing), file) != sizeof(trailing)) {
+    fclose(file);
+    return 1;
+  }
+  return fclose(file) != 0;
+}
+
+/*
+ * Build an index for `filename`, reading at most `max` TS packets, and
+ * write it out next to it.
+ *
+ * Returns 0 if it works, 1 if something went wrong.
+ */
+static int index_test_stream(char *filename, int max, ts_index_p *index) {
+  TS_reader_p tsreader;
+  char index_name[100];
+  int err;
+
+  err = open_file_for_TS_read(filename, &tsreader);
+  if (err)
+    return 1;
+  err = build_TS_index(tsreader, 1, max, false, true, index);
+  (void)close_TS_reader(&tsreader);
+  if (err)
+    return 1;
+
+  snprintf(index_name, sizeof(index_name), "%s%s", filename, TS_INDEX_SUFFIX);
+  err = write_TS_index(*index, index_name);
+  if (err) {
+    free_TS_index(index);
+    return 1;
+  }
+  return 0;
+}
+
+/*
+ * Check that the index read back from file is the same as the one we built
+ *
+ * Returns 0 if it is, 1 if it isn't.
+ */
+static int compare_indexes(ts_index_p built, ts_index_p opened) {
+  ts_index_header_p a = &built->header;
+  ts_index_header_p b = &opened->header;
+  if (a->file_size != b->file_size || a->pcr_pid != b->pcr_pid ||
+      a->video_pid != b->video_pid || a->num_pcrs != b->num_pcrs ||
+      a->num_pes != b->num_pes || a->num_raps != b->num_raps ||
+      a->first_pts != b->first_pts) {
+    printf("Test failed - index header differs after reading it back\n");
+    return 1;
+  }
+  if (memcmp(built->pcr, opened->pcr, a->num_pcrs * SIZEOF_TS_INDEX_PCR) ||
+      memcmp(built->pes, opened->pes, a->num_pes * SIZEOF_TS_INDEX_PES) ||
+      memcmp(built->rap, opened->rap, a->num_raps * SIZEOF_TS_INDEX_RAP)) {
+    printf("Test failed - index entries differ after reading them back\n");
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  char filename[] = "/tmp/tsindex_testXXXXXX";
+  char index_name[100];
+  ts_index_p built = nullptr;
+  ts_index_p opened = nullptr;
+  int file, err, ii, rap;
+  off_t file_size;
+  struct stat info;
+
+  printf("Testing TS index\n");
+  file = mkstemp(filename);
+  if (file == -1) {
+    printf("Test failed - unable to create temporary file: %s\n",
+           strerror(errno));
+    return 1;
+  }
+  close(file);
+  snprintf(index_name, sizeof(index_name), "%s%s", filename, TS_INDEX_SUFFIX);
+
+  err = write_test_stream(filename);
+  if (err) {
+    printf("Test failed - writing test stream %s\n", filename);
+    goto fail;
+  }
+  if (stat(filename, &info) == -1) {
+    printf("Test failed - unable to stat %s\n", filename);
+    goto fail;
+  }
+  file_size = info.st_size;
+
+  printf("Test 1 - build an index and read it back\n");
+  err = index_test_stream(filename, 0, &built);
+  if (err) {
+    printf("Test failed - building index\n");
+    goto fail;
+  }
+  err = open_TS_index_for_file(filename, &opened);
+  if (err) {
+    printf("Test failed - index for a file ending in part of a packet was"
+           " not accepted\n");
+    goto fail;
+  }
+  if (compare_indexes(built, opened))
+    goto fail;
+  if (built->header.video_pid != TEST_VIDEO_PID ||
+      built->header.num_pcrs != TEST_FRAMES ||
+      built->header.num_raps !=
+          (TEST_FRAMES + TEST_I_FREQ - 1) / TEST_I_FREQ) {
+    printf("Test failed - found video PID %u, %u PCRs and %u RAPs\n",
+           built->header.video_pid, built->header.num_pcrs,
+           built->header.num_raps);
+    goto fail;
+  }
+  printf("Test 1 succeeded\n");
+
+  printf("Test 2 - look things up in the index\n");
+  for (ii = 0; ii < TEST_FRAMES; ii++) {
+    uint64_t pts = (uint64_t)(ii + 1) * TEST_PTS_STEP;
+    int expected = ii / TEST_I_FREQ;
+    rap = find_TS_index_rap(opened, pts, false);
+    if (rap != expected || opened->rap[rap].type != TS_INDEX_RAP_I) {
+      printf("Test failed - RAP before PTS " LLU_FORMAT
+             " is %d, expected %d\n",
+             pts, rap, expected);
+      goto fail;
+    }
+    rap = find_TS_index_rap(opened, pts, true);
+    expected = (ii + TEST_I_FREQ - 1) / TEST_I_FREQ;
+    if (expected >= (int)opened->header.num_raps)
+      expected = -1;
+    if (rap != expected) {
+      printf("Test failed - RAP after PTS " LLU_FORMAT
+             " is %d, expected %d\n",
+             pts, rap, expected);
+      goto fail;
+    }
+    if (find_TS_index_pcr(opened, opened->pcr[ii].posn) != ii) {
+      printf("Test failed - PCR %d not found at its own position\n", ii);
+      goto fail;
+    }
+  }
+  if (find_TS_index_rap(opened, 0, false) != -1 ||
+      find_TS_index_pcr(opened, 0) != -1) {
+    printf("Test failed - found an entry before the start of the data\n");
+    goto fail;
+  }
+  printf("Test 2 succeeded\n");
+  free_TS_index(&built);
+  free_TS_index(&opened);
+
+  printf("Test 3 - an index of only the start of the file\n");
+  err = index_test_stream(filename, 5, &built);
+  if (err) {
+    printf("Test failed - building partial index\n");
+    goto fail;
+  }
+  err = open_TS_index_for_file(filename, &opened);
+  if (err) {
+    printf("Test failed - partial index was not accepted\n");
+    goto fail;
+  }
+  if (compare_indexes(built, opened))
+    goto fail;
+  if (opened->header.file_size != (uint64_t)file_size) {
+    printf("Test failed - index records file size " LLU_FORMAT
+           ", expected " LLU_FORMAT "\n",
+           opened->header.file_size, (uint64_t)file_size);
+    goto fail;
+  }
+  printf("Test 3 succeeded\n");
+  free_TS_index(&built);
+  free_TS_index(&opened);
+
+  printf("Test 4 - an index for a file that has changed size\n");
+  if (truncate(filename, file_size - TEST_TRAILING_BYTES)) {
+    printf("Test failed - unable to truncate %s\n", filename);
+    goto fail;
+  }
+  err = open_TS_index_for_file(filename, &opened);
+  if (!err) {
+    printf("Test failed - index for a different sized file was accepted\n");
+    goto fail;
+  }
+  printf("Test 4 succeeded\n");
+
+  (void)unlink(index_name);
+  (void)unlink(filename);
+  return 0;
+
+fail:
+  free_TS_index(&built);
+  free_TS_index(&opened);
+  (void)unlink(index_name);
+  (void)unlink(filename);
+  return 1;
+}
@@ -62,6 +62,11 @@ enum pid_extract {
 };
 typedef enum pid_extract EXTRACT;
 
+// Should the input be read in a separate thread (-async)?
+static int use_async = false;
+// Should we skip over any garbage that loses us TS sync (-resync)?
+static int resync = false;
+
 /*
  * Extract all the TS packets for either a video or audio stream.
  *
@@ -103,6 +108,8 @@ static int extract_av_via_pes(char *input_name, char *output_name,
     (void)fclose(output);
     return 1;
   }
+  // Each ES unit is written out as soon as it is read
+  (void)use_ES_unit_views(es);
 
   for (;;) {
     ES_unit_p unit;
@@ -134,6 +141,119 @@ static int extract_av_via_pes(char *input_name, char *output_name,
   return 0;
 }
 
+// The state of extracting the ES data for a single PID
+struct es_extract {
+  uint32_t pid;
+  FILE *output; // where it is going (nullptr if not opened yet)
+  char *buffer; // our own buffer for `output`, or nullptr
+  int pes_packet_len;
+  int got_pes_packet_len;
+  // It doesn't make sense to start outputting data for our PID until we
+  // get the start of a packet
+  int need_packet_start;
+  int extracted; // How many of its TS packets we've used
+};
+
+// When extracting several streams in one pass, each output file gets its
+// own (large) buffer, so that the streams are written out in big chunks
+// rather than interleaved a TS packet's worth at a time
+#define MAX_DEMUX_STREAMS 64
+#define MAX_DEMUX_PROGRAMS 32
+#define DEMUX_BUFFER_SIZE (1024 * 1024)
+
+static void start_es_extract(struct es_extract *ex, uint32_t pid,
+                             FILE *output) {
+  ex->pid = pid;
+  ex->output = output;
+  ex->buffer = nullptr;
+  ex->pes_packet_len = 0;
+  ex->got_pes_packet_len = false;
+  ex->need_packet_start = true;
+  ex->extracted = 0;
+}
+
+/*
+ * Write out the ES data in the payload of a TS packet for our PID.
+ *
+ * - `count` is the index of the TS packet in the file, for reporting
+ *
+ * Returns 0 if all went well, 1 if something went wrong.
+ */
+static int extract_payload(struct es_extract *ex, int count,
+                           int payload_unit_start_indicator, byte *payload,
+                           int payload_len, int verbose) {
+  byte *data;
+  int data_len;
+  size_t written;
+
+  if (verbose) {
+    fprint_msg("%4d: TS Packet PID %04x", count, ex->pid);
+    if (payload_unit_start_indicator)
+      print_msg(" (start)");
+    else if (ex->need_packet_start)
+      print_msg(" <ignored>");
+    print_msg("\n");
+  }
+
+  if (payload_unit_start_indicator) {
+    // It's the start of a PES packet, so we need to drop the header
+    int offset;
+
+    if (ex->need_packet_start)
+      ex->need_packet_start = false;
+
+    ex->pes_packet_len = (payload[4] << 8) | payload[5];
+    if (verbose)
+      fprint_msg("PES packet length %d\n", ex->pes_packet_len);
+    ex->got_pes_packet_len = (ex->pes_packet_len > 0);
+
+    if (IS_H222_PES(payload)) {
+      // It's H.222.0 - payload[8] is the PES_header_data_length,
+      // so our ES data starts that many bytes after that field
+      offset = payload[8] + 9;
+    } else {
+      // We assume it's MPEG-1
+      offset = calc_mpeg1_pes_offset(payload, payload_len);
+    }
+    data = &payload[offset];
+    data_len = payload_len - offset;
+    if (verbose)
+      print_data(true, "data", data, data_len, 1000);
+  } else {
+    // If we haven't *started* a packet, we can't use this,
+    // since it will just look like random bytes when written out.
+    if (ex->need_packet_start)
+      return 0;
+
+    data = payload;
+    data_len = payload_len;
+    if (verbose)
+      print_data(true, "Data", payload, payload_len, 1000);
+
+    if (ex->got_pes_packet_len) {
+      // Try not to write more data than the PES packet declares
+      if (data_len > ex->pes_packet_len) {
+        data_len = ex->pes_packet_len;
+        if (verbose)
+          print_data(true, "Reduced data", data, data_len, 1000);
+        ex->pes_packet_len = 0;
+      } else
+        ex->pes_packet_len -= data_len;
+    }
+  }
+  if (data_len > 0) {
+    // Windows doesn't seem to like writing 0 bytes, so be careful...
+    written = fwrite(data, data_len, 1, ex->output);
+    if (written != 1) {
+      fprint_err("### Error writing TS packet - units written = %d\n",
+                 (int)written);
+      return 1;
+    }
+  }
+  ex->extracted++;
+  return 0;
+}
+
 /*
  * Extract all the TS packets for a nominated PID to another file.
  *
@@ -144,12 +264,9 @@ static int extract_pid_packets(TS_reader_p tsreader, FILE *output,
                                int quiet) {
   int err;
   int count = 0;
-  int extracted = 0;
-  int pes_packet_len = 0;
-  int got_pes_packet_len = false;
-  // It doesn't make sense to start outputting data for our PID until we
-  // get the start of a packet
-  int need_packet_start = true;
+  struct es_extract ex;
+
+  start_es_extract(&ex, pid_wanted, output);
 
   for (;;) {
     uint32_t pid;
@@ -179,87 +296,21 @@ static int extract_pid_packets(TS_reader_p tsreader, FILE *output,
       continue;
 
     if (pid == pid_wanted) {
-      byte *data;
-      int data_len;
-      size_t written;
-
-      if (verbose) {
-        fprint_msg("%4d: TS Packet PID %04x", count, pid);
-        if (payload_unit_start_indicator)
-          print_msg(" (start)");
-        else if (need_packet_start)
-          print_msg(" <ignored>");
-        print_msg("\n");
-      }
-
-      if (payload_unit_start_indicator) {
-        // It's the start of a PES packet, so we need to drop the header
-        int offset;
-
-        if (need_packet_start)
-          need_packet_start = false;
-
-        pes_packet_len = (payload[4] << 8) | payload[5];
-        if (verbose)
-          fprint_msg("PES packet length %d\n", pes_packet_len);
-        got_pes_packet_len = (pes_packet_len > 0);
-
-        if (IS_H222_PES(payload)) {
-          // It's H.222.0 - payload[8] is the PES_header_data_length,
-          // so our ES data starts that many bytes after that field
-          offset = payload[8] + 9;
-        } else {
-          // We assume it's MPEG-1
-          offset = calc_mpeg1_pes_offset(payload, payload_len);
-        }
-        data = &payload[offset];
-        data_len = payload_len - offset;
-        if (verbose)
-          print_data(true, "data", data, data_len, 1000);
-      } else {
-        // If we haven't *started* a packet, we can't use this,
-        // since it will just look like random bytes when written out.
-        if (need_packet_start) {
-          continue;
-        }
-
-        data = payload;
-        data_len = payload_len;
-        if (verbose)
-          print_data(true, "Data", payload, payload_len, 1000);
-
-        if (got_pes_packet_len) {
-          // Try not to write more data than the PES packet declares
-          if (data_len > pes_packet_len) {
-            data_len = pes_packet_len;
-            if (verbose)
-              print_data(true, "Reduced data", data, data_len, 1000);
-            pes_packet_len = 0;
-          } else
-            pes_packet_len -= data_len;
-        }
-      }
-      if (data_len > 0) {
-        // Windows doesn't seem to like writing 0 bytes, so be careful...
-        written = fwrite(data, data_len, 1, output);
-        if (written != 1) {
-          fprint_err("### Error writing TS packet - units written = %d\n",
-                     (int)written);
-          return 1;
-        }
-      }
-      extracted++;
+      err = extract_payload(&ex, count, payload_unit_start_indicator, payload,
+                            payload_len, verbose);
+      if (err)
+        return 1;
     }
   }
 
   if (!quiet)
-    fprint_msg("Extracted %d of %d TS packet%s\n", extracted, count,
+    fprint_msg("Extracted %d of %d TS packet%s\n", ex.extracted, count,
                (count == 1 ? "" : "s"));
 
   // If the user has forgotten to say -pid XX, or -video/-audio,
   // and are piping the output to another program, it can be surprising
   // if there is no data!
-  if (quiet && extracted == 0)
+  if (quiet && ex.extracted == 0)
     fprint_err("### No data extracted for PID %#04x (%d)\n", pid_wanted,
                pid_wanted);
   return 0;
@@ -283,6 +334,9 @@ static int extract_av(int input, FILE *output, int want_video, int max,
   err = build_TS_reader(input, &tsreader);
   if (err)
     return 1;
+  if (use_async && start_TS_read_ahead(tsreader, ASYNC_READ_BUFFERS))
+    print_err("!!! Unable to read input asynchronously\n");
+  set_TS_reader_resync(tsreader, resync);
 
   // First, find out what program streams we actually have
   for (;;) {
@@ -362,6 +416,9 @@ static int extract_pid(int input, FILE *output, uint32_t pid_wanted, int max,
   err = build_TS_reader(input, &tsreader);
   if (err)
     return 1;
+  if (use_async && start_TS_read_ahead(tsreader, ASYNC_READ_BUFFERS))
+    print_err("!!! Unable to read input asynchronously\n");
+  set_TS_reader_resync(tsreader, resync);
 
   err = extract_pid_packets(tsreader, output, pid_wanted, max, verbose, quiet);
 
@@ -369,6 +426,297 @@ static int extract_pid(int input, FILE *output, uint32_t pid_wanted, int max,
   return err;
 }
 
+// A PAT or PMT being put together from its TS packets
+struct psi_section {
+  uint32_t pid;
+  byte *data;
+  int data_len;
+  int data_used;
+};
+
+/*
+ * Add the payload of a TS packet to a PAT or PMT. When it is complete,
+ * `complete` is set true, and the caller is then responsible for the data
+ * (and should forget it once it has been used).
+ *
+ * Returns 0 if all went well, 1 if something went wrong.
+ */
+static int build_psi_section(struct psi_section *psi,
+                             int payload_unit_start_indicator, byte *payload,
+                             int payload_len, int verbose, int *complete) {
+  int err;
+
+  *complete = false;
+  if (payload_unit_start_indicator && psi->data) {
+    // Lose any data we started but didn't complete
+    free(psi->data);
+    psi->data = nullptr;
+  } else if (!payload_unit_start_indicator && !psi->data)
+    return 0; // A continuation of something we didn't see start
+  if (psi->data == nullptr) {
+    psi->data_len = 0;
+    psi->data_used = 0;
+  }
+
+  err = build_psi_data(verbose, payload, payload_len, psi->pid, &psi->data,
+                       &psi->data_len, &psi->data_used);
+  if (err) {
+    fprint_err("### Error %s PSI data for PID %04x\n",
+               (payload_unit_start_indicator ? "starting new" : "continuing"),
+               psi->pid);
+    return 1;
+  }
+  *complete = (psi->data_len == psi->data_used);
+  return 0;
+}
+
+/*
+ * Make the name of the output file for a PID when extracting several streams
+ */
+static void demux_output_name(char *name, size_t name_len,
+                              const char *output_prefix, uint32_t pid) {
+  snprintf(name, name_len, "%s_%04x.es", output_prefix, pid);
+}
+
+/*
+ * Open the output file for a stream being extracted along with others,
+ * and give it its own buffer.
+ *
+ * Returns 0 if all went well, 1 if something went wrong.
+ */
+static int open_demux_output(struct es_extract *ex, const char *output_prefix,
+                             int quiet) {
+  char name[1024];
+
+  demux_output_name(name, sizeof(name), output_prefix, ex->pid);
+  ex->output = fopen(name, "wb");
+  if (ex->output == nullptr) {
+    fprint_err("### ts2es: Unable to open output file %s: %s\n", name,
+               strerror(errno));
+    return 1;
+  }
+  ex->buffer = (char *)malloc(DEMUX_BUFFER_SIZE);
+  if (ex->buffer != nullptr)
+    (void)setvbuf(ex->output, ex->buffer, _IOFBF, DEMUX_BUFFER_SIZE);
+  if (!quiet)
+    fprint_msg("Writing PID %04x (%d) to %s\n", ex->pid, ex->pid, name);
+  return 0;
+}
+
+/*
+ * Close the output files for the streams extracted along with each other.
+ *
+ * Returns 0 if all went well, 1 if any of them could not be closed.
+ */
+static int close_demux_outputs(struct es_extract stream[], int num_streams,
+                               const char *output_prefix, int quiet) {
+  int ii;
+  int result = 0;
+  for (ii = 0; ii < num_streams; ii++) {
+    struct es_extract *ex = &stream[ii];
+    if (ex->output == nullptr)
+      continue;
+    errno = 0;
+    if (fclose(ex->output)) {
+      char name[1024];
+      demux_output_name(name, sizeof(name), output_prefix, ex->pid);
+      fprint_err("### ts2es: Error closing output file %s: %s\n", name,
+                 strerror(errno));
+      result = 1;
+    } else if (!quiet)
+      fprint_msg("Extracted %d TS packet%s for PID %04x (%d)\n",
+                 ex->extracted, (ex->extracted == 1 ? "" : "s"), ex->pid,
+                 ex->pid);
+    ex->output = nullptr;
+    if (ex->buffer != nullptr) {
+      free(ex->buffer);
+      ex->buffer = nullptr;
+    }
+  }
+  return result;
+}
+
+/*
+ * Extract the data for several streams in a single pass over the input,
+ * each stream going to its own file, named from `output_prefix` and its
+ * PID.
+ *
+ * - `pids` is the list of PIDs to extract, and `num_pids` how many there
+ *   are. If `num_pids` is 0, then every stream named by any PMT (in any
+ *   program) is extracted, starting when its PMT is found.
+ *
+ * A stream's output file is only created when its first PES packet is
+ * found, so streams that are not carried as PES (e.g., private sections)
+ * do not produce a file.
+ *
+ * Returns 0 if all went well, 1 if something went wrong.
+ */
+static int extract_streams(int input, const char *output_prefix,
+                           uint32_t pids[], int num_pids, int max, int verbose,
+                           int quiet) {
+  int err = 0;
+  int ii;
+  int count = 0;
+  TS_reader_p tsreader = nullptr;
+  pid_index_p index = nullptr; // PID -> stream, or MAX_DEMUX_STREAMS + PSI
+  struct es_extract stream[MAX_DEMUX_STREAMS];
+  int num_streams = 0;
+  struct psi_section psi[MAX_DEMUX_PROGRAMS + 1]; // the PAT, then the PMTs
+  int num_psi = 0;
+  int all = (num_pids == 0);
+
+  err = build_TS_reader(input, &tsreader);
+  if (err)
+    return 1;
+  if (use_async && start_TS_read_ahead(tsreader, ASYNC_READ_BUFFERS))
+    print_err("!!! Unable to read input asynchronously\n");
+  set_TS_reader_resync(tsreader, resync);
+
+  err = build_pid_index(&index);
+  if (err) {
+    free_TS_reader(&tsreader);
+    return 1;
+  }
+
+  if (all) {
+    // Start by looking for the PAT, which will tell us the PMTs
+    psi[0].pid = 0x0000;
+    psi[0].data = nullptr;
+    (void)set_pid_index(index, 0x0000, MAX_DEMUX_STREAMS, true);
+    num_psi = 1;
+  } else {
+    for (ii = 0; ii < num_pids; ii++) {
+      if (lookup_pid_index(index, pids[ii]) != -1)
+        continue; // we already have it
+      start_es_extract(&stream[num_streams], pids[ii], nullptr);
+      (void)set_pid_index(index, pids[ii], num_streams, true);
+      num_streams++;
+    }
+  }
+
+  for (;;) {
+    uint32_t pid;
+    int payload_unit_start_indicator;
+    byte *adapt, *payload;
+    int adapt_len, payload_len;
+    int which;
+
+    if (max > 0 && count >= max) {
+      if (!quiet)
+        fprint_msg("Stopping after %d packets\n", max);
+      break;
+    }
+
+    err = get_next_TS_packet(tsreader, &pid, &payload_unit_start_indicator,
+                             &adapt, &adapt_len, &payload, &payload_len);
+    if (err == EOF) {
+      err = 0;
+      break;
+    } else if (err) {
+      print_err("### Error reading TS packet\n");
+      break;
+    }
+
+    count++;
+
+    // If the packet is empty, or not one we want, all we can do is ignore it
+    if (payload_len == 0)
+      continue;
+    which = lookup_pid_index(index, pid);
+    if (which == -1)
+      continue;
+
+    if (which < MAX_DEMUX_STREAMS) {
+      struct es_extract *ex = &stream[which];
+      if (ex->output == nullptr) {
+        // Wait for the start of a PES packet before creating its file
+        if (!payload_unit_start_indicator || payload_len < 9 ||
+            payload[0] != 0 || payload[1] != 0 || payload[2] != 1)
+          continue;
+        err = open_demux_output(ex, output_prefix, quiet);
+        if (err)
+          break;
+      }
+      err = extract_payload(ex, count, payload_unit_start_indicator, payload,
+                            payload_len, verbose);
+      if (err)
+        break;
+    } else {
+      struct psi_section *section = &psi[which - MAX_DEMUX_STREAMS];
+      int complete;
+      err = build_psi_section(section, payload_unit_start_indicator, payload,
+                              payload_len, verbose, &complete);
+      if (err)
+        break;
+      if (!complete)
+        continue;
+
+      if (pid == 0x0000) {
+        pidint_list_p prog_list = nullptr;
+        err = extract_prog_list_from_pat(verbose, section->data,
+                                         section->data_len, &prog_list);
+        free(section->data);
+        section->data = nullptr;
+        if (err)
+          break;
+        for (ii = 0; ii < prog_list->length; ii++) {
+          uint32_t pmt_pid = prog_list->pid[ii];
+          if (prog_list->number[ii] == 0 ||
+              lookup_pid_index(index, pmt_pid) != -1)
+            continue; // the network PID, or a PMT we already know about
+          if (num_psi == MAX_DEMUX_PROGRAMS + 1) {
+            fprint_err("!!! Too many programs - ignoring program %d\n",
+                       prog_list->number[ii]);
+            continue;
+          }
+          psi[num_psi].pid = pmt_pid;
+          psi[num_psi].data = nullptr;
+          (void)set_pid_index(index, pmt_pid, MAX_DEMUX_STREAMS + num_psi,
+                              true);
+          num_psi++;
+        }
+        free_pidint_list(&prog_list);
+      } else {
+        pmt_p pmt = nullptr;
+        err = extract_pmt(verbose, section->data, section->data_len, pid, &pmt);
+        free(section->data);
+        section->data = nullptr;
+        if (err)
+          break;
+        for (ii = 0; ii < pmt->num_streams; ii++) {
+          uint32_t es_pid = pmt->streams[ii].elementary_PID;
+          if (lookup_pid_index(index, es_pid) != -1)
+            continue; // we already know about it
+          if (num_streams == MAX_DEMUX_STREAMS) {
+            fprint_err("!!! Too many streams - ignoring PID %04x\n", es_pid);
+            continue;
+          }
+          if (!quiet)
+            fprint_msg("Program %d has PID %04x (%d): %s\n",
+                       pmt->program_number, es_pid, es_pid,
+                       h222_stream_type_str(pmt->streams[ii].stream_type));
+          start_es_extract(&stream[num_streams], es_pid, nullptr);
+          (void)set_pid_index(index, es_pid, num_streams, true);
+          num_streams++;
+        }
+        free_pmt(&pmt);
+      }
+    }
+  }
+
+  if (!quiet)
+    fprint_msg("Read %d TS packet%s\n", count, (count == 1 ? "" : "s"));
+
+  if (close_demux_outputs(stream, num_streams, output_prefix, quiet))
+    err = 1;
+  for (ii = 0; ii < num_psi; ii++)
+    if (psi[ii].data != nullptr)
+      free(psi[ii].data);
+  free_pid_index(&index);
+  free_TS_reader(&tsreader);
+  return err;
+}
+
 static void print_usage() {
   print_msg("Usage: ts2es [switches] [<infile>] [<outfile>]\n"
             "\n");
@@ -381,15 +729,22 @@ static void print_usage() {
       "Files:\n"
       "  <infile>  is an H.222 Transport Stream file (but see -stdin and "
       "-pes)\n"
-      "  <outfile> is a single elementary stream file (but see -stdout)\n"
+      "  <outfile> is a single elementary stream file (but see -stdout).\n"
+      "            When extracting several streams, it is instead a prefix,\n"
+      "            and each stream is written to <outfile>_<pid>.es, with\n"
+      "            the PID as four hex digits.\n"
       "\n"
       "Which stream to extract:\n"
       "  -pid <pid>         Output data for the stream with the given\n"
-      "                     <pid>. Use -pid 0x<pid> to specify a hex value\n"
+      "                     <pid>. Use -pid 0x<pid> to specify a hex value.\n"
+      "                     If -pid is given more than once, all of the\n"
+      "                     streams are extracted, in a single pass.\n"
       "  -video             Output data for the (first) video stream\n"
       "                     named in the (first) PMT. This is the default.\n"
       "  -audio             Output data for the (first) audio stream\n"
       "                     named in the (first) PMT\n"
+      "  -all               Output data for every stream named in any PMT,\n"
+      "                     in a single pass over the input.\n"
       "\n"
       "General switches:\n"
       "  -err stdout        Write error messages to standard output (the "
@@ -397,6 +752,10 @@ static void print_usage() {
       "  -err stderr        Write error messages to standard error (Unix "
       "traditional)\n"
       "  -stdin             Input from standard input, instead of a file\n"
+      "  -async             Read the input in a separate thread, so that\n"
+      "                     reading and extraction overlap.\n"
+      "  -resync            If the input loses TS sync, skip forwards until\n"
+      "                     packets are found again, rather than giving up.\n"
       "  -stdout            Output to standard output, instead of a file\n"
       "                     Forces -quiet and -err stderr.\n"
       "  -verbose, -v       Output informational/diagnostic messages\n"
@@ -406,7 +765,7 @@ static void print_usage() {
       "  -pes, -ps          Use the PES interface to read ES units from\n"
       "                     the input file. This allows PS data to be read\n"
       "                     (there is no point in using this for TS data).\n"
-      "                     Does not support -pid, -stdin or -stdout.\n");
+      "                     Does not support -pid, -all, -stdin or -stdout.\n");
 }
 
 int main(int argc, char **argv) {
@@ -423,6 +782,10 @@ int main(int argc, char **argv) {
   FILE *output = nullptr;          // The stream we're writing to (if any)
   int max = 0;         // The maximum number of TS packets to read (or 0)
   uint32_t pid = 0;    // The PID of the (single) stream to extract
+  uint32_t pids[MAX_DEMUX_STREAMS]; // All of the PIDs asked for
+  int num_pids = 0;                 // and how many there are
+  int all = false;     // True => extract every stream in a single pass
+  int demux;           // True => extracting several streams at once
   int quiet = false;   // True => be as quiet as possible
   int verbose = false; // True => output diagnostic/progress messages
   int use_pes = false;
@@ -462,10 +825,22 @@ int main(int argc, char **argv) {
           return 1;
         ii++;
         extract = EXTRACT_PID;
+        if (num_pids == MAX_DEMUX_STREAMS) {
+          fprint_err("### ts2es: Cannot extract more than %d PIDs at once\n",
+                     MAX_DEMUX_STREAMS);
+          return 1;
+        }
+        pids[num_pids++] = pid;
       } else if (!strcmp("-video", argv[ii])) {
         extract = EXTRACT_VIDEO;
       } else if (!strcmp("-audio", argv[ii])) {
         extract = EXTRACT_AUDIO;
+      } else if (!strcmp("-all", argv[ii])) {
+        all = true;
+      } else if (!strcmp("-async", argv[ii])) {
+        use_async = true;
+      } else if (!strcmp("-resync", argv[ii])) {
+        resync = true;
       } else if (!strcmp("-stdin", argv[ii])) {
         use_stdin = true;
         had_input_name = true; // so to speak
@@ -521,8 +896,23 @@ int main(int argc, char **argv) {
     return 1;
   }
 
+  demux = all || (extract == EXTRACT_PID && num_pids > 1);
+  if (all && extract == EXTRACT_PID) {
+    print_err("### ts2es: -all and -pid cannot be used together\n");
+    return 1;
+  }
+  if (demux && use_stdout) {
+    print_err("### ts2es: -stdout is not supported when extracting several"
+              " streams\n");
+    return 1;
+  }
+
   // ============================================================
   // Testing PES output
+  if (use_pes && all) {
+    print_err("### ts2es: -all is not supported with -pes\n");
+    return 1;
+  }
   if (use_pes && extract == EXTRACT_PID) {
     print_err("### ts2es: -pid is not supported with -pes\n");
     return 1;
@@ -564,6 +954,20 @@ int main(int argc, char **argv) {
   if (!quiet)
     fprint_msg("Reading from %s\n", (use_stdin ? "<stdin>" : input_name));
 
+  if (demux) {
+    if (max && !quiet)
+      fprint_msg("Stopping after %d TS packets\n", max);
+    err = extract_streams(input, output_name, pids, (all ? 0 : num_pids), max,
+                          verbose, quiet);
+    if (err)
+      print_err("### ts2es: Error extracting data\n");
+    if (!use_stdin && close_file(input)) {
+      fprint_err("### ts2es: Error closing input file %s\n", input_name);
+      err = 1;
+    }
+    return err;
+  }
+
   if (had_output_name) {
     if (use_stdout)
       output = stdout;
@@ -119,13 +119,35 @@ static int write_PES_packet(FILE *output, byte *data, uint16_t data_len,
   return 0;
 }
 
+/*
+ * Write out all of a PES packet's data, which may be in slices if the input
+ * is memory mapped
+ *
+ * Returns 0 if all went well, 1 if something went wrong
+ */
+static int write_PES_packet_data(FILE *output, PES_packet_data_p packet) {
+  size_t count;
+  int ii;
+
+  count = fwrite(packet->data, packet->flat_len, 1, output);
+  if (count != 1)
+    return 1;
+  for (ii = 0; ii < packet->num_slices; ii++) {
+    count = fwrite(packet->slice[ii].iov_base, packet->slice[ii].iov_len, 1,
+                   output);
+    if (count != 1)
+      return 1;
+  }
+  return 0;
+}
+
 /*
  * Extract data and output it as PS
  *
  * Returns 0 if all went well, 1 if something went wrong.
  */
 static int extract_data(int input, FILE *output, uint16_t program_number,
-                        int max, int verbose, int quiet) {
+                        int max, int use_mmap, int verbose, int quiet) {
   int err;
   PES_reader_p reader;
 
@@ -134,6 +156,8 @@ static int extract_data(int input, FILE *output, uint16_t program_number,
     print_err("### Error building PES reader over input file\n");
     return 1;
   }
+  if (use_mmap && map_PES_reader(reader) && !quiet)
+    print_msg("!!! Unable to memory map input - reading it instead\n");
 
   // Temporarily, just writes out PES packets, not a PS stream...
   for (;;) {
@@ -166,6 +190,13 @@ static int extract_data(int input, FILE *output, uint16_t program_number,
       // bytes and PES_header_data_length that come thereafter.
 #define MAX_LENGTH 0xFFFF
       if (PES_packet_length > MAX_LENGTH) {
+        // This needs to be split up, which is easier if it is all in one
+        err = flatten_PES_packet_data(reader->packet);
+        if (err) {
+          (void)free_PES_reader(&reader);
+          return 1;
+        }
+        start = reader->packet->data;
         fprint_err("PES packet of 'zero' length is really %6d - too long for "
                    "one packet\n",
                    PES_packet_length);
@@ -212,17 +243,16 @@ static int extract_data(int input, FILE *output, uint16_t program_number,
                    reader->packet->data[3], reader->packet->length);
         reader->packet->data[4] = (PES_packet_length & 0xFF00) >> 8;
         reader->packet->data[5] = (PES_packet_length & 0x00FF);
-        count =
-            fwrite(reader->packet->data, reader->packet->data_len, 1, output);
-        if (count != 1) {
+        err = write_PES_packet_data(output, reader->packet);
+        if (err) {
           print_err("### Error writing PES packet out to file\n");
           (void)free_PES_reader(&reader);
           return 1;
         }
       }
     } else {
-      count = fwrite(reader->packet->data, reader->packet->data_len, 1, output);
-      if (count != 1) {
+      err = write_PES_packet_data(output, reader->packet);
+      if (err) {
         print_err("### Error writing PES packet out to file\n");
         (void)free_PES_reader(&reader);
         return 1;
@@ -265,6 +295,9 @@ static void print_usage() {
       "                     Forces -quiet and -err stderr.\n"
       "  -verbose, -v       Output informational/diagnostic messages\n"
       "  -quiet, -q         Only output error messages\n"
+      "  -mmap              Memory map the input file, rather than reading it,\n"
+      "                     and write out PES data straight from the mapping.\n"
+      "                     Ignored with -stdin.\n"
       "  -max <n>, -m <n>   Maximum number of TS packets to read\n"
       "                     (not currently used)\n"
       "  -prog <n>          Choose program number <n> (default 0, which means\n"
@@ -284,6 +317,7 @@ int main(int argc, char **argv) {
   int max = 0;            // The maximum number of TS packets to read (or 0)
   int quiet = false;      // True => be as quiet as possible
   int verbose = false;    // True => output diagnostic/progress messages
+  int use_mmap = false;   // True => memory map the input file
   uint16_t program_number = 0;
 
   int err = 0;
@@ -320,6 +354,8 @@ int main(int argc, char **argv) {
           return 1;
         program_number = temp;
         ii++;
+      } else if (!strcmp("-mmap", argv[ii])) {
+        use_mmap = true;
       } else if (!strcmp("-stdin", argv[ii])) {
         use_stdin = true;
         had_input_name = true; // so to speak
@@ -412,7 +448,8 @@ int main(int argc, char **argv) {
   if (max && !quiet)
     fprint_msg("Stopping after %d TS packets\n", max);
 
-  err = extract_data(input, output, program_number, max, verbose, quiet);
+  err = extract_data(input, output, program_number, max, use_mmap, verbose,
+                     quiet);
   if (err) {
     print_err("### ts2ps: Error extracting data\n");
     if (!use_stdin)
@@ -54,6 +54,8 @@
 /** List of PIDs to filter in */
 int *pidList = nullptr;
 unsigned int pidListAlloc = 0, pidListUsed = 0;
+/** And the same PIDs, for looking up directly */
+static struct pid_index pidIndex;
 
 static void print_usage(void);
 
@@ -69,6 +71,9 @@ int main(int argn, char *args[]) {
   int ii = 1;
   //    int verbose = false;  // Currently unused - squash warning
   int invert = 0;
+  int use_mmap = 0;
+  int resync = 0;
+  int direct = 0;
   unsigned int max_pkts = (unsigned int)-1;
   const char *input_file = nullptr, *output_file = nullptr;
 
@@ -96,6 +101,12 @@ int main(int argn, char *args[]) {
         ++ii;
       } else if (!strcmp("-!", args[ii]) || !strcmp("-invert", args[ii])) {
         invert = 1;
+      } else if (!strcmp("-mmap", args[ii])) {
+        use_mmap = 1;
+      } else if (!strcmp("-resync", args[ii])) {
+        resync = 1;
+      } else if (!strcmp("-direct", args[ii])) {
+        direct = 1;
       } else if (!strcmp("-i", args[ii]) || !strcmp("-input", args[ii])) {
         if (argn <= ii) {
           fprint_err("### tsfilter: -input requires an argument\n");
@@ -138,16 +149,20 @@ int main(int argn, char *args[]) {
     return 1;
   }
 
+  // A PID too big to index can't match any TS packet anyway
+  clear_pid_index(&pidIndex);
+  for (ii = 0; ii < pidListUsed; ++ii)
+    (void)set_pid_index(&pidIndex, pidList[ii], 0, false);
+
   // Now ..
   {
     int err;
     TS_reader_p tsreader;
     TS_writer_p tswriter;
-    byte *pkt = nullptr;
+    struct _ts_packet_batch batch;
+    int done = 0;
 
-    unsigned int pid, pkt_num;
-    int pusi, adapt_len, payload_len;
-    byte *adapt, *payload;
+    unsigned int pkt_num;
 
     pkt_num = 0;
     err = open_file_for_TS_read((char *)input_file, &tsreader);
@@ -155,6 +170,10 @@ int main(int argn, char *args[]) {
       fprint_err("## tsfilter: Unable to open stdin for reading TS.\n");
       return 1;
     }
+    if (use_mmap && input_file && map_TS_reader(tsreader))
+      fprint_err("!!! tsfilter: Unable to memory map %s - reading it instead\n",
+                 input_file);
+    set_TS_reader_resync(tsreader, resync);
     if (output_file) {
       err = tswrite_open(TS_W_FILE, (char *)output_file, nullptr, 0, 1,
                          &tswriter);
@@ -165,33 +184,39 @@ int main(int argn, char *args[]) {
       fprint_err("## tsfilter: Unable to open stdout for writing TS. \n");
       return 1;
     }
+    if (direct && output_file)
+      (void)tswrite_use_direct_io(tswriter);
+
+    while (!done) {
+      int jj;
 
-    while (1) {
-      err = read_next_TS_packet(tsreader, &pkt);
+      err = read_TS_packet_batch(tsreader, TS_BATCH_SIZE, &batch);
       if (err == EOF) {
         /* We're done */
         break;
+      } else if (err) {
+        fprint_err("### tsfilter: Error reading TS packets\n");
+        return 1;
       }
 
-      err = split_TS_packet(pkt, &pid, &pusi, &adapt, &adapt_len, &payload,
-                            &payload_len);
-      if (err) {
-        fprint_err("### Error splitting TS packet - continuing. \n");
-      } else {
-        int i;
+      for (jj = 0; jj < batch.count; jj++) {
+        unsigned int pid = batch.pid[jj];
         int found = 0;
 
-        for (i = 0; i < pidListUsed; ++i) {
-          if (pid == pidList[i]) {
-            ++found; // Yes!
-            break;
-          }
+        if (batch.bad_sync[jj]) {
+          fprint_err("### TS packet starts %02x, not %02x\n",
+                     batch.packet[jj][0], 0x47);
+          fprint_err("### Error splitting TS packet - continuing. \n");
+          continue;
         }
 
+        found = (lookup_pid_index(&pidIndex, pid) != -1);
+
         if (max_pkts != (unsigned int)-1 && pkt_num > max_pkts) {
           // We're done processing. If invert is on,
           // copy the rest of the output, otherwise quit.
           if (!invert) {
+            done = 1;
             break;
           } else {
             found = 0;
@@ -205,7 +230,7 @@ int main(int argn, char *args[]) {
 
         if (found) {
           // Write it out.
-          err = tswrite_write(tswriter, pkt, pid, 0, 0);
+          err = tswrite_write(tswriter, batch.packet[jj], pid, 0, 0);
 
           if (err) {
             fprint_err("### Error writing output - %d \n", err);
@@ -216,6 +241,14 @@ int main(int argn, char *args[]) {
       }
     }
 
+    if (tsreader->resync_count)
+      fprint_err("!!! tsfilter: Lost sync %d time%s, skipping " OFFSET_T_FORMAT
+                 " byte%s\n",
+                 tsreader->resync_count,
+                 (tsreader->resync_count == 1 ? "" : "s"),
+                 tsreader->resync_skipped,
+                 (tsreader->resync_skipped == 1 ? "" : "s"));
+
     // It's the end!
     tswrite_close(tswriter, 1);
     close_TS_reader(&tsreader);
@@ -234,6 +267,11 @@ static void print_usage(void) {
       "Switches:\n"
       "  -i <infile>      Take input from this file and not stdin.\n"
       "  -o <outfile>     Send output to this file and not stdout.\n"
+      "  -mmap            Memory map the input file, rather than reading it.\n"
+      "  -resync          If the input loses TS sync, skip forwards until\n"
+      "                    packets are found again.\n"
+      "  -direct          Write the output file with O_DIRECT (bypassing\n"
+      "                    the page cache).\n"
       "  -verbose, -v     Be verbose.\n"
       "  -max <n>, -m <n> All packets after the nth are regarded as\n"
       "                    not matching any pids.\n"
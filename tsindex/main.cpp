@@ -0,0 +1,226 @@
+/*
+ * Build a seek index for an H.222 transport stream (TS), recording where
+ * its PCRs, PES packets and random access points are, so that other tools
+ * can start playing from a given time without reading the whole file.
+ *
+ * ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is the MPEG TS, PS and ES tools.
+ *
+ * The Initial Developer of the Original Code is Amino Communications Ltd.
+ * Portions created by the Initial Developer are Copyright (C) 2008
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *   Amino Communications Ltd, Swavesey, Cambridge UK
+ *
+ * ***** END LICENSE BLOCK *****
+ */
+
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "accessunit.h"
+#include "bitdata.h"
+#include "compat.h"
+#include "es.h"
+#include "h222.h"
+#include "h262.h"
+#include "misc.h"
+#include "nalunit.h"
+#include "pes.h"
+#include "pidint.h"
+#include "printing.h"
+#include "ps.h"
+#include "reverse.h"
+#include "ts.h"
+#include "tsindex.h"
+#include "tswrite.h"
+#include "version.h"
+
+void print_usage() {
+  print_msg("Usage: tsindex [switches] <infile> [<indexfile>]\n"
+            "       tsindex -dump [switches] <indexfile>\n"
+            "\n");
+  REPORT_VERSION("tsindex");
+  print_msg(
+      "\n"
+      "  Build a seek index for a Transport Stream, recording the position\n"
+      "  of each PCR, each PES packet start (with its PTS and DTS) and each\n"
+      "  random access point (IDR or I picture) in the first video stream.\n"
+      "  Other tools (for instance, tsplay -seek and tsserve -index) can\n"
+      "  then use it to start playing from a given time.\n"
+      "\n"
+      "Files:\n"
+      "  <infile>     is an H.222 Transport Stream file\n"
+      "  <indexfile>  is the index file. Defaults to <infile>" TS_INDEX_SUFFIX
+      "\n"
+      "\n"
+      "Switches:\n"
+      "  -err stdout        Write error messages to standard output (the "
+      "default)\n"
+      "  -err stderr        Write error messages to standard error (Unix "
+      "traditional)\n"
+      "  -verbose, -v       Output extra information\n"
+      "  -quiet, -q         Only output error messages\n"
+      "  -max <n>, -m <n>   Index at most <n> TS packets\n"
+      "  -prog <n>          Index program <n> (the first is 1, the default)\n"
+      "  -dump              Report on an existing index file. With -v, list\n"
+      "                     all of its entries\n");
+}
+
+int main(int argc, char **argv) {
+  char *input_name = nullptr;
+  char *index_name = nullptr;
+  char *default_name = nullptr;
+  int max = 0;
+  int req_prog_no = 1;
+  int verbose = false;
+  int quiet = false;
+  int dump = false;
+  int err = 0;
+
+  TS_reader_p tsreader = nullptr;
+  ts_index_p index = nullptr;
+
+  int ii = 1;
+
+  if (argc < 2) {
+    print_usage();
+    return 0;
+  }
+
+  while (ii < argc) {
+    if (argv[ii][0] == '-') {
+      if (!strcmp("--help", argv[ii]) || !strcmp("-h", argv[ii]) ||
+          !strcmp("-help", argv[ii])) {
+        print_usage();
+        return 0;
+      } else if (!strcmp("-err", argv[ii])) {
+        CHECKARG("tsindex", ii);
+        if (!strcmp(argv[ii + 1], "stderr"))
+          redirect_output_stderr();
+        else if (!strcmp(argv[ii + 1], "stdout"))
+          redirect_output_stdout();
+        else {
+          fprint_err("### tsindex: "
+                     "Unrecognised option '%s' to -err (not 'stdout' or"
+                     " 'stderr')\n",
+                     argv[ii + 1]);
+          return 1;
+        }
+        ii++;
+      } else if (!strcmp("-verbose", argv[ii]) || !strcmp("-v", argv[ii])) {
+        verbose = true;
+        quiet = false;
+      } else if (!strcmp("-quiet", argv[ii]) || !strcmp("-q", argv[ii])) {
+        verbose = false;
+        quiet = true;
+      } else if (!strcmp("-max", argv[ii]) || !strcmp("-m", argv[ii])) {
+        CHECKARG("tsindex", ii);
+        err = int_value("tsindex", argv[ii], argv[ii + 1], true, 10, &max);
+        if (err)
+          return 1;
+        ii++;
+      } else if (!strcmp("-prog", argv[ii])) {
+        CHECKARG("tsindex", ii);
+        err = int_value("tsindex", argv[ii], argv[ii + 1], true, 10,
+                        &req_prog_no);
+        if (err)
+          return 1;
+        ii++;
+      } else if (!strcmp("-dump", argv[ii])) {
+        dump = true;
+      } else {
+        fprint_err("### tsindex: "
+                   "Unrecognised command line switch '%s'\n",
+                   argv[ii]);
+        return 1;
+      }
+    } else {
+      if (input_name == nullptr)
+        input_name = argv[ii];
+      else if (index_name == nullptr)
+        index_name = argv[ii];
+      else {
+        fprint_err("### tsindex: Unexpected '%s'\n", argv[ii]);
+        return 1;
+      }
+    }
+    ii++;
+  }
+
+  if (input_name == nullptr) {
+    print_err("### tsindex: No input file specified\n");
+    return 1;
+  }
+
+  if (dump) {
+    if (index_name != nullptr) {
+      fprint_err("### tsindex: Unexpected '%s' with -dump\n", index_name);
+      return 1;
+    }
+    err = open_TS_index(input_name, &index);
+    if (err) {
+      fprint_err("### tsindex: Unable to read index file %s\n", input_name);
+      return 1;
+    }
+    report_TS_index(index, verbose);
+    free_TS_index(&index);
+    return 0;
+  }
+
+  if (index_name == nullptr) {
+    default_name =
+        (char *)malloc(strlen(input_name) + strlen(TS_INDEX_SUFFIX) + 1);
+    if (default_name == nullptr) {
+      print_err("### tsindex: Unable to allocate index filename\n");
+      return 1;
+    }
+    strcpy(default_name, input_name);
+    strcat(default_name, TS_INDEX_SUFFIX);
+    index_name = default_name;
+  }
+
+  err = open_file_for_TS_read(input_name, &tsreader);
+  if (err) {
+    fprint_err("### tsindex: Unable to open input file %s for reading TS\n",
+               input_name);
+    free(default_name);
+    return 1;
+  }
+  if (!quiet)
+    fprint_msg("Reading from %s\n", input_name);
+
+  err = build_TS_index(tsreader, req_prog_no, max, verbose, quiet, &index);
+  (void)close_TS_reader(&tsreader);
+  if (err) {
+    print_err("### tsindex: Error building index\n");
+    free(default_name);
+    return 1;
+  }
+
+  err = write_TS_index(index, index_name);
+  if (!err && !quiet)
+    fprint_msg("Written index to %s\n", index_name);
+  free_TS_index(&index);
+  free(default_name);
+  return (err ? 1 : 0);
+}
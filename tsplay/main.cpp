@@ -49,6 +49,7 @@
 #include "ps.h"
 #include "reverse.h"
 #include "ts.h"
+#include "tsindex.h"
 #include "tsplay.h"
 #include "tswrite.h"
 #include "version.h"
@@ -98,7 +99,22 @@ static void print_usage(int summary) {
       "  -o <name>         Output is to file <name>.\n"
       "\n"
       "  -tcp              Output to the host is via TCP.\n"
-      "  -udp              Output to the host is via UDP (the default).\n");
+      "  -udp              Output to the host is via UDP (the default).\n"
+      "  -dest <dest>      Also output to <dest>, which may be "
+      "udp:<host>[:<port>],\n"
+      "                    tcp:<host>[:<port>], file:<name> or stdout, "
+      "optionally\n"
+      "                    followed by ,drop or ,block. This may be given "
+      "more than\n"
+      "                    once. The input is only read once, and each "
+      "destination\n"
+      "                    is written to in turn. A TCP/IP destination that "
+      "cannot\n"
+      "                    keep up with UDP output loses data (,drop), "
+      "rather than\n"
+      "                    holding everything up (,block). As with "
+      "-stdout,\n"
+      "                    -dest stdout forces -quiet and -err stderr.\n");
   if (summary)
     print_msg("  -stdout           Output is to standard output. Forces -quiet "
               "and -err stderr.\n");
@@ -245,7 +261,15 @@ static void print_help_ts() {
       "\n"
       "Note that after the first PCR is read, *all* TS packets are inspected "
       "for\n"
-      "PCRs, irrespective of PID.\n");
+      "PCRs, irrespective of PID.\n"
+      "\n"
+      "If the input file has a seek index (as written by tsindex, in "
+      "<infile>" TS_INDEX_SUFFIX ")\n"
+      "then playing can start part way through it:\n"
+      "\n"
+      "  -seek <seconds>   Start at the last random access point (IDR or I\n"
+      "                    picture) at or before <seconds> into the video.\n"
+      "                    When looping, loop back to that point.\n");
 }
 
 static void print_help_ps() {
@@ -360,11 +384,16 @@ int main(int argc, char **argv) {
   char *output_name = nullptr;              // the output filename/host
   int port = 88;                            // the port to connect to
   char *multicast_if = nullptr;             // IP address of multicast i/f
+  char *dest_specs[TSWRITE_MAX_DESTS];      // any other destinations
+  int num_dest_specs = 0;
+  int dest_stdout = false;                  // is one of them <stdout>?
 
   tsplay_output_pace_mode pace_mode = TSPLAY_OUTPUT_PACE_PCR2_TS;
 
   uint32_t pid_to_ignore = 0;
   uint32_t override_pcr_pid = 0; // 0 means "use the PCR found in the PMT"
+  double seek_secs = -1;          // -1 means "play from the start"
+  offset_t seek_posn = 0;
 
   // Program Stream specific options
   uint32_t pmt_pid = 0x66;
@@ -497,6 +526,20 @@ int main(int argc, char **argv) {
           return 1;
         }
         how = TS_W_UDP;
+      } else if (!strcmp("-dest", argv[ii])) {
+        CHECKARG("tsplay", ii);
+        if (num_dest_specs == TSWRITE_MAX_DESTS - 1) {
+          fprint_err("### tsplay: No more than %d -dest switches are"
+                     " allowed\n",
+                     TSWRITE_MAX_DESTS - 1);
+          return 1;
+        }
+        dest_specs[num_dest_specs++] = argv[ii + 1];
+        if (tswrite_dest_spec_is_stdout(argv[ii + 1])) {
+          dest_stdout = true;
+          redirect_output_stderr();
+        }
+        ii++;
       } else if (!strcmp("-max", argv[ii]) || !strcmp("-m", argv[ii])) {
         CHECKARG("tsplay", ii);
         err =
@@ -591,6 +634,13 @@ int main(int argc, char **argv) {
           return 1;
         }
         ii++;
+      } else if (!strcmp("-seek", argv[ii])) {
+        CHECKARG("tsplay", ii);
+        err = double_value((char *)"tsplay", argv[ii], argv[ii + 1], true,
+                           &seek_secs);
+        if (err)
+          return 1;
+        ii++;
       } else if (!strcmp("-vpid", argv[ii])) {
         CHECKARG("tsplay", ii);
         err = unsigned_value((char *)"tsplay", argv[ii], argv[ii + 1], 0,
@@ -669,22 +719,11 @@ int main(int argc, char **argv) {
     output_name = (char *)"<stdout>";
 
   // Try to stop extraneous data ending up in our output stream
-  if (how == TS_W_STDOUT) {
+  if (how == TS_W_STDOUT || dest_stdout) {
     verbose = false;
     quiet = true;
   }
 
-  // This is an important check
-  if (max > 0 && how == TS_W_UDP && (max / 7) < context.circ_buf_size) {
-    fprint_err("### tsplay: -max %d cannot work with -buffer %d"
-               " - max must be at least %d",
-               max, context.circ_buf_size, context.circ_buf_size * 7);
-    if (max / 7 > 0)
-      fprint_err(",\n            or buffer size reduced to %d", max / 7);
-    print_err("\n");
-    return 1;
-  }
-
   // If tswrite found '-nopcrs' in the switches, make sure that we've
   // switched PCR lookahead off.
   if (context.pcr_mode == TSWRITE_PCR_MODE_NONE)
@@ -710,6 +749,40 @@ int main(int argc, char **argv) {
     input = STDIN_FILENO;
     is_TS = true; // an assertion
   }
+
+  if (seek_secs >= 0) {
+    ts_index_p index = nullptr;
+    int rap;
+    if (input == STDIN_FILENO || !is_TS) {
+      print_err("### tsplay: -seek can only be used with a TS file\n");
+      (void)close_file(input);
+      return 1;
+    }
+    err = open_TS_index_for_file(input_name, &index);
+    if (err) {
+      fprint_err("### tsplay: -seek needs a seek index for %s"
+                 " (use tsindex to make one)\n",
+                 input_name);
+      (void)close_file(input);
+      return 1;
+    }
+    rap = find_TS_index_rap(
+        index, index->header.first_pts + (uint64_t)(seek_secs * 90000), false);
+    if (rap >= 0)
+      seek_posn = (offset_t)index->rap[rap].pat_posn;
+    if (!quiet) {
+      if (rap >= 0)
+        fprint_msg("Seeking to random access point at %s (PAT at offset "
+                   OFFSET_T_FORMAT ")\n",
+                   fmtx_timestamp(index->rap[rap].pts - index->header.first_pts,
+                                  FMTX_TS_DISPLAY_HMS),
+                   seek_posn);
+      else
+        print_msg("No random access point before that time,"
+                  " starting at the beginning\n");
+    }
+    free_TS_index(&index);
+  }
   if (!quiet)
     fprint_msg("Reading from  %s%s\n", input_name,
                (loop ? " (and looping)" : ""));
@@ -720,6 +793,30 @@ int main(int argc, char **argv) {
     (void)close_file(input);
     return 1;
   }
+  for (ii = 0; ii < num_dest_specs; ii++) {
+    err = tswrite_add_destination_spec(tswriter, dest_specs[ii], multicast_if,
+                                       quiet);
+    if (err) {
+      fprint_err("### tsplay: Cannot open/connect to %s\n", dest_specs[ii]);
+      (void)close_file(input);
+      (void)tswrite_close(tswriter, true);
+      return 1;
+    }
+  }
+
+  // This is an important check
+  if (max > 0 && tswrite_needs_buffering(tswriter) &&
+      (max / 7) < context.circ_buf_size) {
+    fprint_err("### tsplay: -max %d cannot work with -buffer %d"
+               " - max must be at least %d",
+               max, context.circ_buf_size, context.circ_buf_size * 7);
+    if (max / 7 > 0)
+      fprint_err(",\n            or buffer size reduced to %d", max / 7);
+    print_err("\n");
+    (void)close_file(input);
+    (void)tswrite_close(tswriter, true);
+    return 1;
+  }
 
   if (!quiet) {
     if (is_TS) {
@@ -741,7 +838,7 @@ int main(int argc, char **argv) {
     if (max)
       fprint_msg("Stopping after at most %d packets\n", max);
 
-    if (how == TS_W_UDP)
+    if (tswrite_needs_buffering(tswriter))
       tswrite_report_args(&context);
   }
 
@@ -759,7 +856,7 @@ int main(int argc, char **argv) {
 
   // We can only use buffered output for TCP/IP and UDP
   // (it doesn't make much sense for output to a file)
-  if (how == TS_W_UDP) {
+  if (tswrite_needs_buffering(tswriter)) {
     err = tswrite_start_buffering_from_context(tswriter, &context);
     if (err) {
       print_err("### tsplay: Error setting up buffering\n");
@@ -771,7 +868,8 @@ int main(int argc, char **argv) {
 
   if (is_TS) {
     err = play_TS_stream(input, tswriter, pace_mode, pid_to_ignore,
-                         override_pcr_pid, max, loop, quiet, verbose);
+                         override_pcr_pid, seek_posn, max, loop, quiet,
+                         verbose);
   } else
     err = play_PS_stream(input, tswriter, pad_start, repeat_program_every,
                          force_stream_type, want_h262, input_is_dvd,
@@ -137,14 +137,6 @@ struct stream_data {
   uint8_t last_pkt[188];
 };
 
-static int pid_index(struct stream_data *data, int num_streams, uint32_t pid) {
-  int ii;
-  for (ii = 0; ii < num_streams; ii++)
-    if (data[ii].pid == pid)
-      return ii;
-  return -1;
-}
-
 unsigned int avg_rate_inc(avg_rate_t *ar, unsigned int n) {
   return n + 1 >= ar->max_els ? 0 : n + 1;
 }
@@ -205,6 +197,7 @@ static int report_buffering_stats(TS_reader_p tsreader, const int req_prog_no,
 #define MAX_NUM_STREAMS 100
 
   struct stream_data stats[MAX_NUM_STREAMS];
+  struct pid_index stream_index; // PID -> index in `stats`
 
   // We want to be able to report on how well a simple linear-prediction
   // model for PCRs would work (i.e., given the last two PCRs, how well
@@ -239,6 +232,7 @@ static int report_buffering_stats(TS_reader_p tsreader, const int req_prog_no,
   uint32_t start_count = 0;
 
   memset(stats, 0, sizeof(stats));
+  clear_pid_index(&stream_index);
   for (ii = 0; ii < MAX_NUM_STREAMS; ii++) {
     stats[ii].pcr_pts_diff.min = LONG_MAX;
     stats[ii].pcr_dts_diff.min = LONG_MAX;
@@ -288,6 +282,7 @@ static int report_buffering_stats(TS_reader_p tsreader, const int req_prog_no,
     if (pid >= 0x10 && pid <= 0x1FFE) {
       stats[num_streams].stream_type = pmt->streams[ii].stream_type;
       stats[num_streams].pid = pid;
+      (void)set_pid_index(&stream_index, pid, num_streams, false);
       num_streams++;
     }
   }
@@ -430,7 +425,7 @@ static int report_buffering_stats(TS_reader_p tsreader, const int req_prog_no,
     } // end of working with a PCR PID packet
     // ========================================================================
 
-    index = pid_index(stats, num_streams, pid);
+    index = lookup_pid_index(&stream_index, pid);
 
     if (index != -1) {
       // Do continuity counter checking
@@ -1106,43 +1101,60 @@ static int report_single_pid(TS_reader_p tsreader, int max, int quiet,
   int err;
   int count = 0;
   int pid_count = 0;
+  struct _ts_packet_batch batch;
 
   for (;;) {
-    uint32_t pid;
-    int payload_unit_start_indicator;
-    byte *adapt, *payload;
-    int adapt_len, payload_len;
+    int ii;
 
     if (max > 0 && pid_count >= max) {
       fprint_msg("Stopping after %d packets with PID %0x\n", max, just_pid);
       break;
     }
 
-    err = get_next_TS_packet(tsreader, &pid, &payload_unit_start_indicator,
-                             &adapt, &adapt_len, &payload, &payload_len);
+    err = read_TS_packet_batch(tsreader, TS_BATCH_SIZE, &batch);
     if (err == EOF)
       break;
     else if (err) {
       fprint_err("### Error reading TS packet %d at " OFFSET_T_FORMAT "\n",
-                 count, tsreader->posn - TS_PACKET_SIZE);
+                 count, tsreader->posn);
       return 1;
     }
 
-    count++;
+    // Most packets won't be wanted, so only look at the PIDs to start with
+    for (ii = 0; ii < batch.count; ii++) {
+      offset_t posn = batch.posn + ii * TS_PACKET_SIZE;
 
-    if (pid != just_pid)
-      continue;
+      if (batch.bad_sync[ii]) {
+        fprint_err("### TS packet starts %02x, not %02x\n",
+                   batch.packet[ii][0], 0x47);
+        fprint_err("### Error reading TS packet %d at " OFFSET_T_FORMAT "\n",
+                   count, posn);
+        return 1;
+      }
 
-    pid_count++;
+      count++;
 
-    if (!quiet) {
-      fprint_msg(OFFSET_T_FORMAT_8 ": TS Packet %2d PID %04x%s\n",
-                 tsreader->posn - TS_PACKET_SIZE, count, pid,
-                 (payload_unit_start_indicator ? " [pusi]" : ""));
+      if (batch.pid[ii] != just_pid)
+        continue;
+
+      pid_count++;
+
+      if (!quiet) {
+        int adapt_len = batch.adapt_len[ii];
+        int payload_len = TS_BATCH_PAYLOAD_LEN(&batch, ii);
+
+        fprint_msg(OFFSET_T_FORMAT_8 ": TS Packet %2d PID %04x%s\n", posn,
+                   count, batch.pid[ii], (batch.pusi[ii] ? " [pusi]" : ""));
+
+        if (adapt_len > 0)
+          print_data(true, "    Adapt", TS_BATCH_ADAPT(&batch, ii), adapt_len,
+                     adapt_len);
+        print_data(true, "  Payload", TS_BATCH_PAYLOAD(&batch, ii),
+                   payload_len, payload_len);
+      }
 
-      if (adapt_len > 0)
-        print_data(true, "    Adapt", adapt, adapt_len, adapt_len);
-      print_data(true, "  Payload", payload, payload_len, payload_len);
+      if (max > 0 && pid_count >= max)
+        break;
     }
   }
   fprint_msg("Read %d TS packet%s, %d with PID %0x\n", count,
@@ -1168,6 +1180,13 @@ static void print_usage() {
       "  <infile>          Read data from the named H.222 Transport Stream "
       "file\n"
       "  -stdin            Read data from standard input\n"
+      "  -mmap             Memory map the input file, rather than reading it\n"
+      "                    (ignored for standard input)\n"
+      "  -async            Read the input in a separate thread, so that\n"
+      "                    reading and reporting overlap.\n"
+      "  -resync           If the input loses TS sync, skip forwards until\n"
+      "                    packets are found again, rather than giving up.\n"
+      "  -nocrc            Don't check the CRC of PAT and PMT sections.\n"
       "\n"
       "Normal operation:\n"
       "  By default, normal operation just reports the number of TS packets.\n"
@@ -1236,6 +1255,9 @@ static void print_usage() {
 
 int main(int argc, char **argv) {
   int use_stdin = false;
+  int use_mmap = false;
+  int use_async = false;
+  int resync = false;
   char *input_name = nullptr;
   int had_input_name = false;
 
@@ -1343,6 +1365,14 @@ int main(int argc, char **argv) {
         if (err)
           return 1;
         ii++;
+      } else if (!strcmp("-mmap", argv[ii])) {
+        use_mmap = true;
+      } else if (!strcmp("-async", argv[ii])) {
+        use_async = true;
+      } else if (!strcmp("-resync", argv[ii])) {
+        resync = true;
+      } else if (!strcmp("-nocrc", argv[ii])) {
+        set_PSI_CRC_checking(false);
       } else if (!strcmp("-stdin", argv[ii])) {
         use_stdin = true;
         had_input_name = true; // so to speak
@@ -1383,6 +1413,13 @@ int main(int argc, char **argv) {
     return 1;
   }
   fprint_msg("Reading from %s\n", (use_stdin ? "<stdin>" : input_name));
+  if (use_mmap && map_TS_reader(tsreader))
+    print_msg("!!! Unable to memory map input - reading it instead\n");
+  // Reading ahead is only worth it (or possible) if we're not mapped
+  if (use_async && tsreader->mapped == nullptr &&
+      start_TS_read_ahead(tsreader, ASYNC_READ_BUFFERS))
+    print_msg("!!! Unable to read input asynchronously\n");
+  set_TS_reader_resync(tsreader, resync);
 
   if (max)
     fprint_msg("Stopping after %d TS packets\n", max);
@@ -1399,6 +1436,16 @@ int main(int argc, char **argv) {
     (void)close_TS_reader(&tsreader);
     return 1;
   }
+  if (tsreader->resync_count)
+    fprint_msg("Lost sync %d time%s, skipping " OFFSET_T_FORMAT " byte%s\n",
+               tsreader->resync_count,
+               (tsreader->resync_count == 1 ? "" : "s"),
+               tsreader->resync_skipped,
+               (tsreader->resync_skipped == 1 ? "" : "s"));
+  if (get_PSI_CRC_error_count())
+    fprint_msg("Found %d PSI section%s with a bad CRC\n",
+               get_PSI_CRC_error_count(),
+               (get_PSI_CRC_error_count() == 1 ? "" : "s"));
   err = close_TS_reader(&tsreader);
   return (err ? 1 : 0);
 }
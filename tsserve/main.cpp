@@ -50,6 +50,7 @@
 #include "fmtx.h"
 #include "h222.h"
 #include "h262.h"
+#include "hevc.h"
 #include "misc.h"
 #include "nalunit.h"
 #include "pes.h"
@@ -58,6 +59,7 @@
 #include "ps.h"
 #include "reverse.h"
 #include "ts.h"
+#include "tsindex.h"
 #include "tswrite.h"
 #include "version.h"
 
@@ -120,25 +122,30 @@ struct tsserve_context {
 
   // Transport Stream specific options
   int tsdirect;
+  int use_index; // Use a seek index (if there is one) when skipping
+  int use_mmap;  // Memory map the input files
 };
 typedef struct tsserve_context *tsserve_context_p;
 
 // ============================================================
-// Unions to give us a single view of the two forms of data stream
+// Unions to give us a single view of the three forms of data stream
 // ============================================================
 // The form of this single view is limited solely to what is needed
 // in this program - it is not intended to be a general unification
-// of the two types of data.
+// of the types of data.
 
 // Accessing the data stream
 union u_stream_context {
   h262_context_p h262;
   access_unit_context_p h264;
+  hevc_context_p hevc;
 };
 struct _stream_context {
   int is_h262;
+  int is_hevc; // if neither, then it's H.264
   int program_number;
   union u_stream_context u;
+  ts_index_p index; // The seek index for a TS file, if we have one
 };
 typedef struct _stream_context stream_context;
 typedef struct _stream_context *stream_context_p;
@@ -147,9 +154,11 @@ typedef struct _stream_context *stream_context_p;
 union u_filter_context {
   h262_filter_context_p h262;
   h264_filter_context_p h264;
+  hevc_filter_context_p hevc;
 };
 struct _filter_context {
   int is_h262;
+  int is_hevc;
   union u_filter_context u;
 };
 typedef struct _filter_context filter_context;
@@ -160,10 +169,12 @@ union u_picture {
   int is_h262;
   h262_picture_p h262;
   access_unit_p h264;
+  hevc_access_unit_p hevc;
 };
 
 struct _picture {
   int is_h262;
+  int is_hevc;
   union u_picture u;
   int type; // For H.262, the picture coding type. 0xFF means seq hdr
 };
@@ -171,25 +182,29 @@ typedef struct _picture picture;
 typedef struct _picture *picture_p;
 
 // ============================================================
-// Utilities to hide the difference between the two data stream types
+// Utilities to hide the difference between the data stream types
 // ============================================================
 
 // A macro to avoid my mistyping this on the several occasions I need it
 #define EXTRACT_ES_FROM_STREAM(stream)                                         \
-  ((stream).is_h262 ? (stream).u.h262->es : (stream).u.h264->nac->es)
+  ((stream).is_h262   ? (stream).u.h262->es                                    \
+   : (stream).is_hevc ? (stream).u.hevc->es                                    \
+                      : (stream).u.h264->nac->es)
 
 // A related macro for reverse data
 #define EXTRACT_REVERSE_FROM_STREAM(stream)                                    \
-  ((stream).is_h262 ? (stream).u.h262->reverse_data                            \
-                    : (stream).u.h264->reverse_data)
+  ((stream).is_h262   ? (stream).u.h262->reverse_data                          \
+   : (stream).is_hevc ? (stream).u.hevc->reverse_data                          \
+                      : (stream).u.h264->reverse_data)
 
 /*
  * Note that `program_number` should be 1 or more.
  */
-static int build_stream(ES_p es, int is_h262, int program_number,
+static int build_stream(ES_p es, int is_h262, int is_hevc, int program_number,
                         stream_context *stream) {
   int err;
   stream->is_h262 = is_h262;
+  stream->is_hevc = is_hevc;
   stream->program_number = program_number;
   if (is_h262) {
     err = build_h262_context(es, &(stream->u.h262));
@@ -197,12 +212,19 @@ static int build_stream(ES_p es, int is_h262, int program_number,
       print_err("### Error building H.262 context\n");
       return 1;
     }
+  } else if (is_hevc) {
+    err = build_hevc_context(es, &(stream->u.hevc));
+    if (err) {
+      print_err("### Error building HEVC context\n");
+      return 1;
+    }
   } else {
     err = build_access_unit_context(es, &(stream->u.h264));
     if (err) {
       print_err("### Error building H.264 access unit context\n");
       return 1;
     }
+    set_nal_headers_only(stream->u.h264->nac, true);
   }
   return 0;
 }
@@ -210,8 +232,33 @@ static int build_stream(ES_p es, int is_h262, int program_number,
 static void close_stream(stream_context stream) {
   if (stream.is_h262)
     free_h262_context(&(stream.u.h262));
+  else if (stream.is_hevc)
+    free_hevc_context(&(stream.u.hevc));
   else
     free_access_unit_context(&(stream.u.h264));
+  free_TS_index(&(stream.index));
+}
+
+/*
+ * If requested, and if the input is TS, look for a seek index for it.
+ *
+ * Not finding one is not an error - we just skip by reading instead.
+ */
+static void open_stream_index(tsserve_context_p context, PES_reader_p reader,
+                              const char *input_name, int quiet,
+                              stream_context *stream) {
+  int err;
+  stream->index = nullptr;
+  if (!context->use_index || !reader->is_TS || input_name == nullptr)
+    return;
+  err = open_TS_index_for_file(input_name, &stream->index);
+  if (err)
+    fprint_err("!!! No usable seek index for %s,"
+               " skipping forwards by reading\n",
+               input_name);
+  else if (!quiet)
+    fprint_msg("Using seek index for %s (%u random access points)\n",
+               input_name, stream->index->header.num_raps);
 }
 
 static int build_and_attach_reverse(stream_context stream,
@@ -225,16 +272,19 @@ static int build_and_attach_reverse(stream_context stream,
 
   if (stream.is_h262)
     add_h262_reverse_context(stream.u.h262, *reverse_data);
+  else if (stream.is_hevc)
+    err = add_hevc_reverse_context(stream.u.hevc, *reverse_data);
   else
     add_access_unit_reverse_context(stream.u.h264, *reverse_data);
 
-  return 0;
+  return err;
 }
 
 static int build_filter_context(stream_context stream, int is_strip,
                                 int frequency, filter_context *fcontext) {
   int err;
   fcontext->is_h262 = stream.is_h262;
+  fcontext->is_hevc = stream.is_hevc;
   if (stream.is_h262) {
     if (is_strip)
       err = build_h262_filter_context_strip(&(fcontext->u.h262), stream.u.h262,
@@ -242,6 +292,13 @@ static int build_filter_context(stream_context stream, int is_strip,
     else
       err = build_h262_filter_context(&(fcontext->u.h262), stream.u.h262,
                                       frequency);
+  } else if (stream.is_hevc) {
+    if (is_strip)
+      err = build_hevc_filter_context_strip(&(fcontext->u.hevc), stream.u.hevc,
+                                            true);
+    else
+      err = build_hevc_filter_context(&(fcontext->u.hevc), stream.u.hevc,
+                                      frequency);
   } else {
     if (is_strip)
       err = build_h264_filter_context_strip(&(fcontext->u.h264), stream.u.h264,
@@ -256,6 +313,8 @@ static int build_filter_context(stream_context stream, int is_strip,
 static void free_filter_context(filter_context fcontext) {
   if (fcontext.is_h262)
     free_h262_filter_context(&(fcontext.u.h262));
+  else if (fcontext.is_hevc)
+    free_hevc_filter_context(&(fcontext.u.hevc));
   else
     free_h264_filter_context(&(fcontext.u.h264));
 }
@@ -268,6 +327,8 @@ static inline void reset_stream(stream_context stream) {
   if (stream.is_h262) {
     if (stream.u.h262->last_item)
       free_h262_item(&stream.u.h262->last_item);
+  } else if (stream.is_hevc) {
+    reset_hevc_context(stream.u.hevc);
   } else {
     reset_access_unit_context(stream.u.h264);
   }
@@ -291,12 +352,23 @@ static inline int get_next_picture(stream_context stream, int verbose,
       pic->type = picture->picture_coding_type;
     else
       pic->type = 0xff;
+    pic->is_hevc = false;
+  } else if (stream.is_hevc) {
+    hevc_access_unit_p unit;
+    err = get_next_hevc_access_unit(stream.u.hevc, false, verbose, quiet,
+                                    &unit);
+    if (err)
+      return err;
+    pic->is_h262 = false;
+    pic->is_hevc = true;
+    pic->u.hevc = unit;
   } else {
     access_unit_p unit;
     err = get_next_h264_frame(stream.u.h264, quiet, verbose, &unit);
     if (err)
       return err;
     pic->is_h262 = false;
+    pic->is_hevc = false;
     pic->u.h264 = unit;
   }
   return 0;
@@ -305,26 +377,33 @@ static inline int get_next_picture(stream_context stream, int verbose,
 static inline void free_picture(picture *pic) {
   if (pic->is_h262)
     free_h262_picture(&pic->u.h262);
+  else if (pic->is_hevc)
+    free_hevc_access_unit(&pic->u.hevc);
   else
     free_access_unit(&pic->u.h264);
   pic->type = 0;
 }
 
 /*
- * Needs to be told if the picture is H.262 or not, because this may be
+ * Needs to be told what sort of picture it is, because this may be
  * called on an unused instance of the picture data structure.
  */
-static inline void unset_picture(int is_h262, picture *pic) {
+static inline void unset_picture(int is_h262, int is_hevc, picture *pic) {
   if (is_h262)
     pic->u.h262 = nullptr;
+  else if (is_hevc)
+    pic->u.hevc = nullptr;
   else
     pic->u.h264 = nullptr;
   pic->is_h262 = is_h262;
+  pic->is_hevc = is_hevc;
 }
 
 static inline int is_null_picture(picture pic) {
   if (pic.is_h262)
     return pic.u.h262 == nullptr;
+  else if (pic.is_hevc)
+    return pic.u.hevc == nullptr;
   else
     return pic.u.h264 == nullptr;
 }
@@ -334,9 +413,12 @@ static inline int is_non_frame(picture pic) {
   return (pic.is_h262 && pic.type == 0xff);
 }
 
-static inline int is_reference_picture(picture pic) {
+static inline int is_reference_picture(stream_context stream, picture pic) {
   if (pic.is_h262)
     return (pic.type == 1 || pic.type == 2);
+  else if (pic.is_hevc)
+    return is_hevc_ref_access_unit(pic.u.hevc,
+                                   HEVC_HIGHEST_TEMPORAL_ID(stream.u.hevc));
   else
     return (pic.u.h264->primary_start != nullptr &&
             pic.u.h264->primary_start->nal_ref_idc != 0);
@@ -345,6 +427,8 @@ static inline int is_reference_picture(picture pic) {
 static inline int is_I_or_IDR_picture(picture pic) {
   if (pic.is_h262)
     return (pic.type == 1);
+  else if (pic.is_hevc)
+    return is_hevc_IRAP_access_unit(pic.u.hevc);
   else
     return (pic.u.h264->primary_start != nullptr &&
             pic.u.h264->primary_start->nal_ref_idc != 0 &&
@@ -358,6 +442,13 @@ static void print_picture(picture pic) {
       print_msg("sequence header");
     else
       fprint_msg("%s picture", H262_PICTURE_CODING_STR(pic.type));
+  } else if (pic.is_hevc) {
+    if (!pic.u.hevc->has_picture)
+      print_msg("<null>");
+    else
+      fprint_msg("tid %d/type %d (%s)", pic.u.hevc->temporal_id,
+                 pic.u.hevc->nal_unit_type,
+                 HEVC_NAL_UNIT_TYPE_STR(pic.u.hevc->nal_unit_type));
   } else {
     if (pic.u.h264->primary_start == nullptr)
       print_msg("<null>");
@@ -374,6 +465,9 @@ static inline int write_picture_as_TS(stream_context stream, TS_writer_p output,
   if (stream.is_h262)
     return write_h262_picture_as_TS(output, pic.u.h262,
                                     es->reader->output_video_pid);
+  else if (stream.is_hevc)
+    return write_hevc_access_unit_as_TS(pic.u.hevc, output,
+                                        es->reader->output_video_pid);
   else
     return write_access_unit_as_TS(pic.u.h264, stream.u.h264, output,
                                    es->reader->output_video_pid);
@@ -384,6 +478,9 @@ static inline void reset_filter_context(filter_context fcontext,
   if (fcontext.is_h262) {
     reset_h262_filter_context(fcontext.u.h262);
     fcontext.u.h262->freq = frequency;
+  } else if (fcontext.is_hevc) {
+    reset_hevc_filter_context(fcontext.u.hevc);
+    fcontext.u.hevc->freq = frequency;
   } else {
     reset_h264_filter_context(fcontext.u.h264);
     fcontext.u.h264->freq = frequency;
@@ -396,8 +493,8 @@ static inline int get_next_stripped(filter_context fcontext, int verbose,
                                     int *delta_pictures_seen) {
   int err;
 
-  unset_picture(fcontext.is_h262, seq_hdr);
-  unset_picture(fcontext.is_h262, this_picture);
+  unset_picture(fcontext.is_h262, fcontext.is_hevc, seq_hdr);
+  unset_picture(fcontext.is_h262, fcontext.is_hevc, this_picture);
 
   if (fcontext.is_h262) {
     h262_picture_p _this_picture = nullptr;
@@ -407,6 +504,11 @@ static inline int get_next_stripped(filter_context fcontext, int verbose,
                                      &_this_picture, delta_pictures_seen);
     seq_hdr->u.h262 = _seq_hdr;
     this_picture->u.h262 = _this_picture;
+  } else if (fcontext.is_hevc) {
+    hevc_access_unit_p this_unit = nullptr;
+    err = get_next_stripped_hevc_frame(fcontext.u.hevc, verbose, quiet,
+                                       &this_unit, delta_pictures_seen);
+    this_picture->u.hevc = this_unit;
   } else {
     access_unit_p this_unit = nullptr;
     err = get_next_stripped_h264_frame(fcontext.u.h264, verbose, quiet,
@@ -422,8 +524,8 @@ static inline int get_next_filtered(filter_context fcontext, int verbose,
                                     int *delta_pictures_seen) {
   int err;
 
-  unset_picture(fcontext.is_h262, seq_hdr);
-  unset_picture(fcontext.is_h262, this_picture);
+  unset_picture(fcontext.is_h262, fcontext.is_hevc, seq_hdr);
+  unset_picture(fcontext.is_h262, fcontext.is_hevc, this_picture);
 
   if (fcontext.is_h262) {
     h262_picture_p _this_picture = nullptr;
@@ -433,6 +535,11 @@ static inline int get_next_filtered(filter_context fcontext, int verbose,
                                      &_this_picture, delta_pictures_seen);
     seq_hdr->u.h262 = _seq_hdr;
     this_picture->u.h262 = _this_picture;
+  } else if (fcontext.is_hevc) {
+    hevc_access_unit_p this_unit = nullptr;
+    err = get_next_filtered_hevc_frame(fcontext.u.hevc, verbose, quiet,
+                                       &this_unit, delta_pictures_seen);
+    this_picture->u.hevc = this_unit;
   } else {
     access_unit_p this_unit = nullptr;
     err = get_next_filtered_h264_frame(fcontext.u.h264, verbose, quiet,
@@ -443,7 +550,7 @@ static inline int get_next_filtered(filter_context fcontext, int verbose,
 }
 
 // ============================================================
-// A common view of handling the two types of data stream
+// A common view of handling the types of data stream
 // ============================================================
 /*
  * Playing at normal speed happens as a "side effect" of gathering
@@ -482,6 +589,10 @@ static int play_normal(stream_context stream, TS_writer_p output, int verbose,
     err = collect_reverse_h262(stream.u.h262, num_normal, verbose, quiet);
     if (err)
       return err;
+  } else if (stream.is_hevc) {
+    err = collect_reverse_hevc(stream.u.hevc, num_normal, verbose, quiet);
+    if (err)
+      return err;
   } else {
     err =
         collect_reverse_access_units(stream.u.h264, num_normal, verbose, quiet);
@@ -545,6 +656,12 @@ static int flush_after_normal(stream_context stream, TS_writer_p output,
     // The ES item that comes after (and thus marks the end of) the
     // last picture *starts* at:
     item_start = stream.u.h262->last_item->unit.start_posn;
+  } else if (stream.is_hevc) {
+    ES_unit_p pending = hevc_pending_unit(stream.u.hevc);
+    if (pending == nullptr)
+      item_start = es->posn_of_next_byte;
+    else
+      item_start = pending->start_posn;
   } else {
     if (stream.u.h264->pending_nal == nullptr) {
       // We ended the previous access unit for some reason that didn't
@@ -589,7 +706,13 @@ static int flush_after_normal(stream_context stream, TS_writer_p output,
     // item
     if (stream.is_h262)
       item_start = stream.u.h262->last_item->unit.start_posn;
-    else {
+    else if (stream.is_hevc) {
+      ES_unit_p pending = hevc_pending_unit(stream.u.hevc);
+      if (pending == nullptr)
+        item_start = es->posn_of_next_byte;
+      else
+        item_start = pending->start_posn;
+    } else {
       if (stream.u.h264->pending_nal == nullptr)
         item_start = es->posn_of_next_byte;
       else
@@ -673,7 +796,7 @@ static int output_next_reference_picture(stream_context stream,
         return 1;
       }
     } else if ((I_only && is_I_or_IDR_picture(picture)) ||
-               (!I_only && is_reference_picture(picture))) {
+               (!I_only && is_reference_picture(stream, picture))) {
       if (extra_info)
         print_msg(".. picture acceptable\n");
       break;
@@ -774,6 +897,8 @@ static int rewind_stream(stream_context stream) {
     print_msg("\nRewinding\n");
   if (stream.is_h262)
     return rewind_h262_context(stream.u.h262);
+  else if (stream.is_hevc)
+    return rewind_hevc_context(stream.u.hevc);
   else
     return rewind_access_unit_context(stream.u.h264);
 }
@@ -900,6 +1025,13 @@ static int back_to_normal(stream_context stream, TS_writer_p output,
       // picture *starts* at:
       item_start = stream.u.h262->last_item->unit.start_posn;
     }
+  } else if (stream.is_hevc) {
+    // As for H.264, below
+    ES_unit_p pending = hevc_pending_unit(stream.u.hevc);
+    if (pending == nullptr)
+      item_start = es->posn_of_next_byte;
+    else
+      item_start = pending->start_posn;
   } else {
     if (stream.u.h264->pending_nal == nullptr) {
       // Either we ended the previous access unit for some reason that
@@ -925,6 +1057,14 @@ static int back_to_normal(stream_context stream, TS_writer_p output,
         print_data(true, "   last item", stream.u.h262->last_item->unit.data,
                    stream.u.h262->last_item->unit.data_len, 20);
       }
+    } else if (stream.is_hevc) {
+      ES_unit_p pending = hevc_pending_unit(stream.u.hevc);
+      if (pending) {
+        fprint_msg("   last item starts at " OFFSET_T_FORMAT "/%d,\n",
+                   pending->start_posn.infile, pending->start_posn.inpacket);
+        print_data(true, "   pending NAL unit", pending->data,
+                   pending->data_len, 20);
+      }
     } else {
       if (stream.u.h264->pending_nal) {
         fprint_msg("   last item starts at " OFFSET_T_FORMAT "/%d,\n",
@@ -965,6 +1105,16 @@ static int back_to_normal(stream_context stream, TS_writer_p output,
       err = write_ES_as_TS_PES_packet(
           output, stream.u.h262->last_item->unit.data, length_wanted,
           reader->output_video_pid, DEFAULT_VIDEO_STREAM_ID);
+    } else if (stream.is_hevc) {
+      ES_unit_p pending = hevc_pending_unit(stream.u.hevc);
+      length_wanted = pending->data_len - curposn;
+      if (extra_info)
+        fprint_msg(".. next byte is %d, so length wanted is %d"
+                   " - outputting it\n",
+                   curposn, length_wanted);
+      err = write_ES_as_TS_PES_packet(output, pending->data, length_wanted,
+                                      reader->output_video_pid,
+                                      DEFAULT_VIDEO_STREAM_ID);
     } else {
       // @@@ For H.264, do we know, when we get here, that we always
       // have a pending NAL unit?
@@ -1128,8 +1278,8 @@ static int play_filtered(stream_context stream, filter_context fcontext,
   if (extra_info)
     print_msg("Fast forwarding (filter)\n");
 
-  unset_picture(stream.is_h262, &this_picture);
-  unset_picture(stream.is_h262, &last_picture);
+  unset_picture(stream.is_h262, stream.is_hevc, &this_picture);
+  unset_picture(stream.is_h262, stream.is_hevc, &last_picture);
   for (;;) {
     int delta_pictures_seen;
     if (tswrite_command_changed(output)) {
@@ -1151,7 +1301,7 @@ static int play_filtered(stream_context stream, filter_context fcontext,
     if (is_null_picture(this_picture)) {
       // We need to repeat the last picture
       this_picture = last_picture;
-      unset_picture(stream.is_h262, &last_picture);
+      unset_picture(stream.is_h262, stream.is_hevc, &last_picture);
     }
     if (!is_null_picture(this_picture)) {
       if (with_seq_hdrs && !is_null_picture(seq_hdr)) {
@@ -1215,12 +1365,79 @@ static int play_filtered(stream_context stream, filter_context fcontext,
   return 0;
 }
 
+/*
+ * Use the stream's seek index to jump straight to the random access point
+ * (roughly) `num_to_skip` frames ahead, rather than reading our way there.
+ *
+ * We only jump if the target is after everything we have remembered for
+ * reversing, so that the reverse arrays stay in file order (they just
+ * won't know about the pictures we jumped over).
+ *
+ * `jumped` is set true if we moved, in which case the next I or IDR
+ * picture read will be the one at the random access point.
+ *
+ * Returns 0 if all went well, 1 if an error occurred.
+ */
+static int skip_using_index(stream_context stream, int num_to_skip,
+                            int *jumped) {
+  int err;
+  ES_p es = EXTRACT_ES_FROM_STREAM(stream);
+  reverse_data_p reverse_data = EXTRACT_REVERSE_FROM_STREAM(stream);
+  ts_index_p index = stream.index;
+  uint32_t video_pid = index->header.video_pid;
+  offset_t posn = es->posn_of_next_byte.infile;
+  uint64_t target;
+  ts_index_rap_p rap;
+  ES_offset where;
+  int ii;
+
+  *jumped = false;
+
+  // Where are we now (in time)?
+  for (ii = find_TS_index_pes(index, posn, video_pid); ii >= 0; ii--)
+    if (index->pes[ii].pid == video_pid && index->pes[ii].got_pts)
+      break;
+  if (ii < 0)
+    return 0;
+  target = index->pes[ii].pts +
+           (uint64_t)num_to_skip * 90000 / FRAMES_FOR_ONE_SECOND;
+
+  ii = find_TS_index_rap(index, target, true);
+  if (ii < 0)
+    return 0; // Let the normal mechanism find the end of file
+  rap = &index->rap[ii];
+  if ((offset_t)rap->posn <= posn)
+    return 0;
+  if (reverse_data != nullptr && reverse_data->length > 0 &&
+      (offset_t)rap->posn <= reverse_data->start_file[reverse_data->length - 1])
+    return 0;
+
+  if (extra_info)
+    fprint_msg("Seek index says skip to " OFFSET_T_FORMAT "\n",
+               (offset_t)rap->posn);
+
+  where.infile = rap->posn;
+  where.inpacket = 0;
+  err = seek_ES(es, where);
+  if (err) {
+    print_err("### Error seeking to random access point from seek index\n");
+    return 1;
+  }
+  reset_stream(stream);
+  if (reverse_data != nullptr && reverse_data->length > 0)
+    reverse_data->last_posn_added = reverse_data->length - 1;
+  *jumped = true;
+  return 0;
+}
+
 /*
  * Returns 0 if all went well, EOF if the end of file is reached,
  * otherwise 1 if an error occurred.
  *
  * - `num_to_skip` is the number of frames to skip
  *
+ * If the stream has a seek index, use it to get (most of) the way there.
+ *
  * If command input is enabled, then it can also return COMMAND_RETURN_CODE
  * if the current command has changed.
  */
@@ -1242,6 +1459,15 @@ static int skip_forwards(stream_context stream, TS_writer_p output,
   start_clock = clock();
 #endif
 
+  if (stream.index != nullptr) {
+    int jumped;
+    err = skip_using_index(stream, num_to_skip, &jumped);
+    if (err)
+      return 1;
+    if (jumped)
+      num_to_skip = 1; // i.e., the picture we've jumped to
+  }
+
   // Reset our filter context so that we start filtering without remembering
   // anything about last time we filtered
   reset_filter_context(fcontext, num_to_skip);
@@ -1257,7 +1483,7 @@ static int skip_forwards(stream_context stream, TS_writer_p output,
   if (extra_info)
     fprint_msg("Skipping forwards (%d frames)\n", num_to_skip);
 
-  unset_picture(stream.is_h262, &this_picture);
+  unset_picture(stream.is_h262, stream.is_hevc, &this_picture);
 
   // Say that we don't want our skipping to be interrupted by the next command
   tswrite_set_command_atomic(output, true);
@@ -1838,7 +2064,9 @@ static int play_pes_packets(PES_reader_p reader[MAX_INPUT_FILES],
     // functions for streams and filter contexts sensibly do nothing
     // with a nullptr value - so we might as well just say the same for all...
     stream[ii].is_h262 = fcontext[ii].is_h262 = scontext[ii].is_h262 = false;
+    stream[ii].is_hevc = fcontext[ii].is_hevc = scontext[ii].is_hevc = false;
     stream[ii].u.h262 = nullptr;
+    stream[ii].index = nullptr;
     fcontext[ii].u.h262 = scontext[ii].u.h262 = nullptr;
   }
 
@@ -1872,13 +2100,21 @@ static int play_pes_packets(PES_reader_p reader[MAX_INPUT_FILES],
       goto tidy_up;
     }
 
-    // Put an access unit or H.262 unit context around that
-    err = build_stream(es[ii], !(reader[ii]->is_h264), ii + 1, &stream[ii]);
+    // Put an access unit, HEVC or H.262 unit context around that
+    err = build_stream(es[ii],
+                       !reader[ii]->is_h264 &&
+                           reader[ii]->video_type != VIDEO_H265,
+                       reader[ii]->video_type == VIDEO_H265, ii + 1,
+                       &stream[ii]);
     if (err) {
       fprint_err("### Unable to build input stream %d\n", ii);
       goto tidy_up;
     }
 
+    // And see if we can use a seek index to skip forwards
+    open_stream_index(context, reader[ii], context->input_names[ii], quiet,
+                      &stream[ii]);
+
     // Build our reverse memory datastructure
     err = build_and_attach_reverse(stream[ii], &reverse_data[ii]);
     if (err) {
@@ -2303,6 +2539,7 @@ static int test_play_pes_packets(PES_reader_p reader, TS_writer_p tswriter,
                                  int with_seq_hdrs) {
   int err;
   int ii;
+  int is_hevc;
   ES_p es; // A view of our PES packets as ES units
   reverse_data_p reverse_data = nullptr;
   stream_context stream;
@@ -2338,17 +2575,72 @@ static int test_play_pes_packets(PES_reader_p reader, TS_writer_p tswriter,
     return 1;
   }
 
-  // Build our reverse memory datastructure
-  err = build_reverse_data(&reverse_data, reader->is_h264);
+  // Build our reverse memory datastructure (HEVC reverses as H.264 does)
+  is_hevc = (reader->video_type == VIDEO_H265);
+  err = build_reverse_data(&reverse_data, reader->is_h264 || is_hevc);
   if (err) {
     print_err("### Unable to build reverse memory\n");
     close_elementary_stream(&es);
     return 1;
   }
 
-  stream.is_h262 = fcontext.is_h262 = scontext.is_h262 = !(reader->is_h264);
+  stream.is_h262 = fcontext.is_h262 = scontext.is_h262 =
+      !(reader->is_h264) && !is_hevc;
+  stream.is_hevc = fcontext.is_hevc = scontext.is_hevc = is_hevc;
+  open_stream_index(context, reader,
+                    context->input_names[context->default_file_index], quiet,
+                    &stream);
+
+  if (is_hevc) {
+    hevc_context_p hevc;                       // Our ES data as access units
+    hevc_filter_context_p fcontext5 = nullptr; // And a filter over that
+    hevc_filter_context_p scontext5 = nullptr; // And another
+
+    err = build_hevc_context(es, &hevc);
+    if (err) {
+      print_err("### Error trying to build HEVC reader from ES reader\n");
+      close_elementary_stream(&es);
+      free_reverse_data(&reverse_data);
+      return 1;
+    }
+    (void)add_hevc_reverse_context(hevc, reverse_data);
+
+    err = build_hevc_filter_context(&fcontext5, hevc, ffrequency);
+    if (err) {
+      print_err("### Unable to build filter context\n");
+      close_elementary_stream(&es);
+      free_reverse_data(&reverse_data);
+      free_hevc_context(&hevc);
+      return 1;
+    }
+
+    err = build_hevc_filter_context_strip(&scontext5, hevc, true);
+    if (err) {
+      print_err("### Unable to build strip context\n");
+      close_elementary_stream(&es);
+      free_reverse_data(&reverse_data);
+      free_hevc_context(&hevc);
+      free_hevc_filter_context(&fcontext5);
+      return 1;
+    }
+
+    stream.u.hevc = hevc;
+    fcontext.u.hevc = fcontext5;
+    scontext.u.hevc = scontext5;
 
-  if (reader->is_h264) {
+    if (skiptest)
+      err = test_skip(reader, stream, fcontext, scontext, reverse_data,
+                      tswriter, video_only, verbose, quiet, tsdirect, false);
+    else
+      err =
+          test_play(reader, stream, fcontext, scontext, reverse_data, tswriter,
+                    video_only, verbose, quiet, tsdirect, num_normal, num_fast,
+                    num_faster, num_reverse, ffrequency, rfrequency, false);
+
+    free_hevc_context(&hevc);
+    free_hevc_filter_context(&fcontext5);
+    free_hevc_filter_context(&scontext5);
+  } else if (reader->is_h264) {
     access_unit_context_p acontext;            // Our ES data as access units
     h264_filter_context_p fcontext4 = nullptr; // And a filter over that
     h264_filter_context_p scontext4 = nullptr; // And another
@@ -2361,6 +2653,7 @@ static int test_play_pes_packets(PES_reader_p reader, TS_writer_p tswriter,
       free_reverse_data(&reverse_data);
       return 1;
     }
+    set_nal_headers_only(acontext->nac, true);
     add_access_unit_reverse_context(acontext, reverse_data);
 
     err = build_h264_filter_context(&fcontext4, acontext, ffrequency);
@@ -2455,6 +2748,7 @@ static int test_play_pes_packets(PES_reader_p reader, TS_writer_p tswriter,
 
   close_elementary_stream(&es);
   free_reverse_data(&reverse_data);
+  free_TS_index(&stream.index);
 
   return err;
 }
@@ -2474,6 +2768,10 @@ static int open_input_file(tsserve_context_p context, int quiet, int verbose,
                context->input_names[context->default_file_index],
                ((*reader)->is_TS ? "TS" : "PS"));
 
+  if (context->use_mmap && (*reader)->is_TS && map_PES_reader(*reader) &&
+      !quiet)
+    print_msg("!!! Unable to memory map input - reading it instead\n");
+
   // If it's PS data, check if we're overriding its stream type
   if (!(*reader)->is_TS && context->force_stream_type &&
       (*reader)->is_h264 == context->want_h262) {
@@ -2526,6 +2824,10 @@ static int open_input_files(tsserve_context_p context, int quiet, int verbose,
       fprint_msg("Opened input file %2d, %s, as %s\n", ii,
                  context->input_names[ii], (reader[ii]->is_TS ? "TS" : "PS"));
 
+    if (context->use_mmap && reader[ii]->is_TS && map_PES_reader(reader[ii]) &&
+        !quiet)
+      print_msg("!!! Unable to memory map input - reading it instead\n");
+
     // If it's PS data, check if we're overriding its stream type
     // (for the moment, we only allow overriding of *all* files,
     // which is clumsy, but may be sufficient for our needs)
@@ -3072,6 +3374,18 @@ static void print_detailed_usage() {
       "  Also, -prepeat, -pes_padding and -drop will have no effect with this "
       "switch.\n"
       "\n"
+      "  -index            When skipping forwards, use the seek index for "
+      "each\n"
+      "                    input file (as written by tsindex, in <file>"
+      TS_INDEX_SUFFIX ")\n"
+      "                    to jump straight to the target random access "
+      "point,\n"
+      "                    instead of reading all the data in between.\n"
+      "\n"
+      "  -mmap             Memory map each input file, rather than reading "
+      "it,\n"
+      "                    and write out PES data straight from the mapping.\n"
+      "\n"
       "Other stuff:\n"
       "\n"
       "  -prepeat <n>      Output the program data (PAT/PMT) after every <n>\n"
@@ -3208,6 +3522,8 @@ int main(int argc, char **argv) {
 
   // Transport Stream specific options
   context.tsdirect = false; // Write to server as a side effect of PES reading
+  context.use_index = false;
+  context.use_mmap = false;
 
   context.force_stream_type = false;
   context.want_h262 = true; // shouldn't matter
@@ -3253,6 +3569,10 @@ int main(int argc, char **argv) {
       } else if (!strcmp("-tsdirect", argv[argno])) {
         context.tsdirect =
             true; // Write to server as a side effect of TS reading
+      } else if (!strcmp("-index", argv[argno])) {
+        context.use_index = true;
+      } else if (!strcmp("-mmap", argv[argno])) {
+        context.use_mmap = true;
       } else if (!strcmp("-n", argv[argno])) {
         CHECKARG("tsserve", argno);
         err = int_value("tsserve", argv[argno], argv[argno + 1], true, 10,